@@ -50,6 +50,50 @@ namespace AkVCam
         {
             return rgba >> 24;
         }
+
+        // YUV utility functions
+
+        inline uint8_t rgbY(int r, int g, int b)
+        {
+            return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+
+        inline uint8_t rgbU(int r, int g, int b)
+        {
+            return uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        }
+
+        inline uint8_t rgbV(int r, int g, int b)
+        {
+            return uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+
+        inline uint8_t clampByte(int value)
+        {
+            return uint8_t(value < 0? 0: value > 255? 255: value);
+        }
+
+        inline uint8_t yuvR(int y, int u, int v)
+        {
+            (void) u;
+
+            return clampByte((298 * (y - 16) + 409 * (v - 128) + 128) >> 8);
+        }
+
+        inline uint8_t yuvG(int y, int u, int v)
+        {
+            return clampByte((298 * (y - 16)
+                              - 100 * (u - 128)
+                              - 208 * (v - 128)
+                              + 128) >> 8);
+        }
+
+        inline uint8_t yuvB(int y, int u, int v)
+        {
+            (void) v;
+
+            return clampByte((298 * (y - 16) + 516 * (u - 128) + 128) >> 8);
+        }
     }
 }
 
@@ -27,136 +27,68 @@
 
 namespace AkVCam
 {
-    class FractionPrivate
+    template<typename T>
+    static inline int signOf(T value)
     {
-        public:
-            int64_t m_num;
-            int64_t m_den;
-
-            template<typename T> inline static int sign(T value)
-            {
-                return value < 0? -1: 1;
-            }
-    };
-}
-
-AkVCam::Fraction::Fraction()
-{
-    this->d = new FractionPrivate;
-    this->d->m_num = 0;
-    this->d->m_den = 0;
-}
-
-AkVCam::Fraction::Fraction(int64_t num, int64_t den)
-{
-    this->d = new FractionPrivate;
-    this->d->m_num = num;
-    this->d->m_den = den;
+        return value < 0? -1: 1;
+    }
 }
 
-AkVCam::Fraction::Fraction(const std::string &str)
+AkVCam::Fraction::Fraction(const std::string &str):
+    m_num(0),
+    m_den(1)
 {
-    this->d = new FractionPrivate;
-    this->d->m_num = 0;
-    this->d->m_den = 1;
     auto pos = str.find('/');
 
     if (pos == std::string::npos) {
         auto strCpy = trimmed(str);
-        this->d->m_num = uint32_t(strtol(strCpy.c_str(), nullptr, 10));
+        this->m_num = uint32_t(strtol(strCpy.c_str(), nullptr, 10));
     } else {
         auto numStr = trimmed(str.substr(0, pos));
         auto denStr = trimmed(str.substr(pos + 1));
 
-        this->d->m_num = uint32_t(strtol(numStr.c_str(), nullptr, 10));
-        this->d->m_den = uint32_t(strtol(denStr.c_str(), nullptr, 10));
+        this->m_num = uint32_t(strtol(numStr.c_str(), nullptr, 10));
+        this->m_den = uint32_t(strtol(denStr.c_str(), nullptr, 10));
 
-        if (this->d->m_den < 1) {
-            this->d->m_num = 0;
-            this->d->m_den = 1;
+        if (this->m_den < 1) {
+            this->m_num = 0;
+            this->m_den = 1;
         }
     }
 }
 
-AkVCam::Fraction::Fraction(const Fraction &other)
-{
-    this->d = new FractionPrivate;
-    this->d->m_num = other.d->m_num;
-    this->d->m_den = other.d->m_den;
-}
-
-AkVCam::Fraction::~Fraction()
-{
-    delete this->d;
-}
-
-AkVCam::Fraction &AkVCam::Fraction::operator =(const Fraction &other)
-{
-    if (this != &other) {
-        this->d->m_num = other.d->m_num;
-        this->d->m_den = other.d->m_den;
-    }
-
-    return *this;
-}
-
 bool AkVCam::Fraction::operator ==(const Fraction &other) const
 {
-    if (this->d->m_den == 0 && other.d->m_den != 0)
+    if (this->m_den == 0 && other.m_den != 0)
         return false;
 
-    if (this->d->m_den != 0 && other.d->m_den == 0)
+    if (this->m_den != 0 && other.m_den == 0)
         return false;
 
-    return this->d->m_num * other.d->m_den == this->d->m_den * other.d->m_num;
+    return this->m_num * other.m_den == this->m_den * other.m_num;
 }
 
 bool AkVCam::Fraction::operator <(const Fraction &other) const
 {
-    return this->d->m_num * other.d->m_den < this->d->m_den * other.d->m_num;
-}
-
-int64_t AkVCam::Fraction::num() const
-{
-    return this->d->m_num;
-}
-
-int64_t &AkVCam::Fraction::num()
-{
-    return this->d->m_num;
-}
-
-int64_t AkVCam::Fraction::den() const
-{
-    return this->d->m_den;
-}
-
-int64_t &AkVCam::Fraction::den()
-{
-    return this->d->m_den;
-}
-
-double AkVCam::Fraction::value() const
-{
-    return double(this->d->m_num) / double(this->d->m_den);
+    return this->m_num * other.m_den < this->m_den * other.m_num;
 }
 
 std::string AkVCam::Fraction::toString() const
 {
     std::stringstream ss;
-    ss << this->d->m_num << '/' << this->d->m_den;
+    ss << this->m_num << '/' << this->m_den;
 
     return ss.str();
 }
 
 bool AkVCam::Fraction::isInfinity() const
 {
-    return this->d->m_num != 0 && this->d->m_den == 0;
+    return this->m_num != 0 && this->m_den == 0;
 }
 
 int AkVCam::Fraction::sign() const
 {
-    return FractionPrivate::sign(this->d->m_num) == FractionPrivate::sign(this->d->m_den)? 1: -1;
+    return signOf(this->m_num) == signOf(this->m_den)? 1: -1;
 }
 
 bool AkVCam::Fraction::isFraction(const std::string &str)
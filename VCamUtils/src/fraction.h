@@ -26,33 +26,58 @@
 namespace AkVCam
 {
     class Fraction;
-    class FractionPrivate;
     using FractionRange = std::pair<Fraction, Fraction>;
 
+    /* A plain value, it's copied and moved without allocating, so it can be
+     * passed around freely in the streaming paths.
+     */
     class Fraction
     {
         public:
-            Fraction();
-            Fraction(int64_t num, int64_t den);
+            Fraction() = default;
+            Fraction(int64_t num, int64_t den):
+                m_num(num),
+                m_den(den)
+            {
+            }
+
             Fraction(const std::string &str);
-            Fraction(const Fraction &other);
-            virtual ~Fraction();
-            Fraction &operator =(const Fraction &other);
             bool operator ==(const Fraction &other) const;
             bool operator <(const Fraction &other) const;
 
-            int64_t num() const;
-            int64_t &num();
-            int64_t den() const;
-            int64_t &den();
-            double value() const;
+            inline int64_t num() const
+            {
+                return this->m_num;
+            }
+
+            inline int64_t &num()
+            {
+                return this->m_num;
+            }
+
+            inline int64_t den() const
+            {
+                return this->m_den;
+            }
+
+            inline int64_t &den()
+            {
+                return this->m_den;
+            }
+
+            inline double value() const
+            {
+                return double(this->m_num) / double(this->m_den);
+            }
+
             std::string toString() const;
             bool isInfinity() const;
             int sign() const;
             static bool isFraction(const std::string &str);
 
         private:
-            FractionPrivate *d;
+            int64_t m_num {0};
+            int64_t m_den {0};
     };
 }
 
@@ -0,0 +1,437 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach/vm_statistics.h>
+#endif
+
+#include "framebufferpool.h"
+#include "utils.h"
+
+// Released buffers kept for each size class by default.
+#define DEFAULT_MAX_BUFFERS 8
+
+// Buffers of this size or more, a 4K frame, may be backed by huge pages.
+#define HUGEPAGE_MIN_SIZE (3840 * 2160)
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+// Number of size classes between two powers of 2.
+#define SIZE_CLASS_STEPS 8
+
+namespace AkVCam
+{
+    /* Stored at the start of every allocation, FRAMEBUFFER_ALIGNMENT bytes
+     * before the buffer, so it can be freed the same way it was allocated.
+     */
+    struct FrameBufferHeader
+    {
+        size_t m_length;
+        bool m_mapped;
+    };
+
+    struct FrameBufferBlock
+    {
+        std::atomic<int> m_ref {1};
+        size_t m_sizeClass {0};
+        VideoData m_data;
+        std::shared_ptr<FrameBufferPoolPrivate> m_pool;
+    };
+
+    class FrameBufferPoolPrivate:
+        public std::enable_shared_from_this<FrameBufferPoolPrivate>
+    {
+        public:
+            std::map<size_t, std::vector<FrameBufferBlock *>> m_buffers;
+            std::mutex m_mutex;
+            size_t m_maxBuffers {DEFAULT_MAX_BUFFERS};
+            bool m_closed {false};
+
+            FrameBuffer take(size_t size);
+            void release(FrameBufferBlock *block);
+            void clear();
+            static inline size_t sizeClass(size_t size);
+    };
+
+    static std::atomic<bool> frameBufferHugePages {false};
+
+    static void *hugePagesAlloc(size_t size, FrameBufferHeader *header);
+    static void *alignedAlloc(size_t size, FrameBufferHeader *header);
+}
+
+void *AkVCam::frameBufferAlloc(size_t size)
+{
+    FrameBufferHeader header {size + FRAMEBUFFER_ALIGNMENT, false};
+    void *block = nullptr;
+
+    if (size >= HUGEPAGE_MIN_SIZE && frameBufferHugePages)
+        block = hugePagesAlloc(header.m_length, &header);
+
+    if (!block)
+        block = alignedAlloc(header.m_length, &header);
+
+    if (!block)
+        return nullptr;
+
+    memcpy(block, &header, sizeof(FrameBufferHeader));
+
+    return reinterpret_cast<uint8_t *>(block) + FRAMEBUFFER_ALIGNMENT;
+}
+
+void AkVCam::frameBufferFree(void *data)
+{
+    if (!data)
+        return;
+
+    auto block = reinterpret_cast<uint8_t *>(data) - FRAMEBUFFER_ALIGNMENT;
+    FrameBufferHeader header;
+    memcpy(&header, block, sizeof(FrameBufferHeader));
+
+#ifdef _WIN32
+    if (header.m_mapped)
+        VirtualFree(block, 0, MEM_RELEASE);
+    else
+        _aligned_free(block);
+#else
+    if (header.m_mapped)
+        munmap(block, header.m_length);
+    else
+        free(block);
+#endif
+}
+
+AkVCam::FrameBuffer::FrameBuffer(FrameBufferBlock *block):
+    m_block(block)
+{
+}
+
+AkVCam::FrameBuffer::FrameBuffer(const FrameBuffer &other):
+    m_block(other.m_block)
+{
+    if (this->m_block)
+        this->m_block->m_ref.fetch_add(1, std::memory_order_relaxed);
+}
+
+AkVCam::FrameBuffer::FrameBuffer(FrameBuffer &&other):
+    m_block(other.m_block)
+{
+    other.m_block = nullptr;
+}
+
+AkVCam::FrameBuffer::~FrameBuffer()
+{
+    this->reset();
+}
+
+AkVCam::FrameBuffer &AkVCam::FrameBuffer::operator =(const FrameBuffer &other)
+{
+    if (this->m_block != other.m_block) {
+        if (other.m_block)
+            other.m_block->m_ref.fetch_add(1, std::memory_order_relaxed);
+
+        this->reset();
+        this->m_block = other.m_block;
+    }
+
+    return *this;
+}
+
+AkVCam::FrameBuffer &AkVCam::FrameBuffer::operator =(FrameBuffer &&other)
+{
+    if (this != &other) {
+        this->reset();
+        this->m_block = other.m_block;
+        other.m_block = nullptr;
+    }
+
+    return *this;
+}
+
+bool AkVCam::FrameBuffer::operator ==(const FrameBuffer &other) const
+{
+    return this->m_block == other.m_block;
+}
+
+bool AkVCam::FrameBuffer::operator !=(const FrameBuffer &other) const
+{
+    return this->m_block != other.m_block;
+}
+
+AkVCam::FrameBuffer::operator bool() const
+{
+    return this->m_block != nullptr;
+}
+
+AkVCam::VideoData &AkVCam::FrameBuffer::operator *() const
+{
+    return this->m_block->m_data;
+}
+
+AkVCam::VideoData *AkVCam::FrameBuffer::operator ->() const
+{
+    return &this->m_block->m_data;
+}
+
+int AkVCam::FrameBuffer::useCount() const
+{
+    return this->m_block?
+                this->m_block->m_ref.load(std::memory_order_acquire): 0;
+}
+
+void AkVCam::FrameBuffer::reset()
+{
+    if (!this->m_block)
+        return;
+
+    auto block = this->m_block;
+    this->m_block = nullptr;
+
+    if (block->m_ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        auto pool = block->m_pool;
+        pool->release(block);
+    }
+}
+
+AkVCam::FrameBufferPool::FrameBufferPool():
+    d(std::make_shared<FrameBufferPoolPrivate>())
+{
+}
+
+AkVCam::FrameBufferPool::~FrameBufferPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->d->m_mutex);
+        this->d->m_closed = true;
+    }
+
+    this->d->clear();
+}
+
+size_t AkVCam::FrameBufferPool::maxBuffers() const
+{
+    std::lock_guard<std::mutex> lock(this->d->m_mutex);
+
+    return this->d->m_maxBuffers;
+}
+
+void AkVCam::FrameBufferPool::setMaxBuffers(size_t maxBuffers)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->d->m_mutex);
+
+        if (this->d->m_maxBuffers == maxBuffers)
+            return;
+
+        this->d->m_maxBuffers = maxBuffers;
+    }
+
+    this->d->clear();
+}
+
+AkVCam::FrameBuffer AkVCam::FrameBufferPool::buffer(size_t size)
+{
+    return this->d->take(size);
+}
+
+AkVCam::FrameBuffer AkVCam::FrameBufferPool::copy(const VideoData &data)
+{
+    auto buffer = this->d->take(data.size());
+
+    if (!data.empty())
+        memcpy(buffer->data(), data.data(), data.size());
+
+    return buffer;
+}
+
+void AkVCam::FrameBufferPool::clear()
+{
+    this->d->clear();
+}
+
+bool AkVCam::FrameBufferPool::hugePages()
+{
+    return frameBufferHugePages;
+}
+
+void AkVCam::FrameBufferPool::setHugePages(bool enable)
+{
+    frameBufferHugePages = enable;
+}
+
+AkVCam::FrameBufferPool *AkVCam::FrameBufferPool::globalInstance()
+{
+    // Never destroyed, frames may still be released while exiting.
+    static auto frameBufferPool = new FrameBufferPool;
+
+    return frameBufferPool;
+}
+
+AkVCam::FrameBuffer AkVCam::FrameBufferPoolPrivate::take(size_t size)
+{
+    auto sizeClass = FrameBufferPoolPrivate::sizeClass(size);
+    FrameBufferBlock *block = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        auto it = this->m_buffers.find(sizeClass);
+
+        if (it != this->m_buffers.end() && !it->second.empty()) {
+            block = it->second.back();
+            it->second.pop_back();
+        }
+    }
+
+    if (block) {
+        block->m_ref.store(1, std::memory_order_relaxed);
+    } else {
+        block = new FrameBufferBlock;
+        block->m_sizeClass = sizeClass;
+        block->m_data.reserve(sizeClass);
+        block->m_pool = this->shared_from_this();
+    }
+
+    // The capacity is already reserved, so this never allocates nor fills.
+    block->m_data.resize(size);
+
+    return FrameBuffer(block);
+}
+
+void AkVCam::FrameBufferPoolPrivate::release(FrameBufferBlock *block)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+
+        // The buffer may have been shrunk while it was in use.
+        if (!this->m_closed
+            && block->m_data.capacity() >= block->m_sizeClass) {
+            auto &buffers = this->m_buffers[block->m_sizeClass];
+
+            if (buffers.size() < this->m_maxBuffers) {
+                buffers.push_back(block);
+
+                return;
+            }
+        }
+    }
+
+    delete block;
+}
+
+void AkVCam::FrameBufferPoolPrivate::clear()
+{
+    decltype(this->m_buffers) buffers;
+
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        std::swap(buffers, this->m_buffers);
+    }
+
+    for (auto &sizeClass: buffers)
+        for (auto block: sizeClass.second)
+            delete block;
+}
+
+size_t AkVCam::FrameBufferPoolPrivate::sizeClass(size_t size)
+{
+    /* Round 'size' up to one of SIZE_CLASS_STEPS steps between two powers of
+     * 2, so no more than 1 / SIZE_CLASS_STEPS of a buffer is wasted.
+     */
+    size_t step = FRAMEBUFFER_ALIGNMENT;
+
+    while (2 * step * SIZE_CLASS_STEPS <= size)
+        step <<= 1;
+
+    return (size + step - 1) & ~(step - 1);
+}
+
+void *AkVCam::hugePagesAlloc(size_t size, FrameBufferHeader *header)
+{
+#if defined(_WIN32)
+    // Only works if the process has the SeLockMemoryPrivilege.
+    auto pageSize = GetLargePageMinimum();
+
+    if (pageSize < 1)
+        return nullptr;
+
+    header->m_length = (size + pageSize - 1) / pageSize * pageSize;
+    header->m_mapped = true;
+
+    return VirtualAlloc(nullptr,
+                        header->m_length,
+                        MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                        PAGE_READWRITE);
+#elif defined(__APPLE__) && defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+    header->m_length = (size + HUGEPAGE_SIZE - 1) & ~size_t(HUGEPAGE_SIZE - 1);
+    header->m_mapped = true;
+    auto block = mmap(nullptr,
+                      header->m_length,
+                      PROT_READ | PROT_WRITE,
+                      MAP_ANON | MAP_PRIVATE,
+                      VM_FLAGS_SUPERPAGE_SIZE_2MB,
+                      0);
+
+    return block == MAP_FAILED? nullptr: block;
+#elif defined(MADV_HUGEPAGE)
+    // Transparent huge pages need the region to be aligned to the page size.
+    header->m_length = (size + HUGEPAGE_SIZE - 1) & ~size_t(HUGEPAGE_SIZE - 1);
+    header->m_mapped = false;
+    void *block = nullptr;
+
+    if (posix_memalign(&block, HUGEPAGE_SIZE, header->m_length) != 0)
+        return nullptr;
+
+    madvise(block, header->m_length, MADV_HUGEPAGE);
+
+    return block;
+#else
+    UNUSED(size);
+    UNUSED(header);
+
+    return nullptr;
+#endif
+}
+
+void *AkVCam::alignedAlloc(size_t size, FrameBufferHeader *header)
+{
+    header->m_length = size;
+    header->m_mapped = false;
+
+#ifdef _WIN32
+    return _aligned_malloc(size, FRAMEBUFFER_ALIGNMENT);
+#else
+    void *block = nullptr;
+
+    if (posix_memalign(&block, FRAMEBUFFER_ALIGNMENT, size) != 0)
+        return nullptr;
+
+    return block;
+#endif
+}
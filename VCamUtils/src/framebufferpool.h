@@ -0,0 +1,177 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_FRAMEBUFFERPOOL_H
+#define AKVCAMUTILS_FRAMEBUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Alignment of the frame buffers, enough for the widest SIMD loads.
+#define FRAMEBUFFER_ALIGNMENT 64
+
+namespace AkVCam
+{
+    class FrameBufferPoolPrivate;
+    struct FrameBufferBlock;
+
+    void *frameBufferAlloc(size_t size);
+    void frameBufferFree(void *data);
+
+    /* Allocator for the frame pixels, the memory is aligned to
+     * FRAMEBUFFER_ALIGNMENT and the pixels are left uninitialized when the
+     * buffer grows, since they are always overwritten.
+     */
+    template<typename T>
+    class FrameBufferAllocator
+    {
+        public:
+            using value_type = T;
+
+            template<typename U>
+            struct rebind
+            {
+                using other = FrameBufferAllocator<U>;
+            };
+
+            FrameBufferAllocator() = default;
+
+            template<typename U>
+            FrameBufferAllocator(const FrameBufferAllocator<U> &)
+            {
+            }
+
+            inline T *allocate(size_t n)
+            {
+                auto data = frameBufferAlloc(n * sizeof(T));
+
+                if (!data)
+                    throw std::bad_alloc();
+
+                return static_cast<T *>(data);
+            }
+
+            inline void deallocate(T *data, size_t)
+            {
+                frameBufferFree(data);
+            }
+
+            template<typename U>
+            inline void construct(U *p)
+            {
+                ::new (static_cast<void *>(p)) U;
+            }
+
+            template<typename U, typename... Args>
+            inline void construct(U *p, Args &&... args)
+            {
+                ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+            }
+
+            template<typename U>
+            inline bool operator ==(const FrameBufferAllocator<U> &) const
+            {
+                return true;
+            }
+
+            template<typename U>
+            inline bool operator !=(const FrameBufferAllocator<U> &) const
+            {
+                return false;
+            }
+    };
+
+    using VideoData = std::vector<uint8_t, FrameBufferAllocator<uint8_t>>;
+
+    /* Reference counted handle to a VideoData taken from a FrameBufferPool,
+     * the buffer goes back to the pool when the last handle is released.
+     */
+    class FrameBuffer
+    {
+        public:
+            FrameBuffer() = default;
+            FrameBuffer(const FrameBuffer &other);
+            FrameBuffer(FrameBuffer &&other);
+            ~FrameBuffer();
+            FrameBuffer &operator =(const FrameBuffer &other);
+            FrameBuffer &operator =(FrameBuffer &&other);
+            bool operator ==(const FrameBuffer &other) const;
+            bool operator !=(const FrameBuffer &other) const;
+            explicit operator bool() const;
+            VideoData &operator *() const;
+            VideoData *operator ->() const;
+
+            // Number of handles sharing the buffer.
+            int useCount() const;
+            void reset();
+
+        private:
+            FrameBufferBlock *m_block {nullptr};
+
+            explicit FrameBuffer(FrameBufferBlock *block);
+
+        friend class FrameBufferPoolPrivate;
+    };
+
+    /* Recycles the frame buffers, so streaming frames of the same format
+     * doesn't touch the heap after the first frames.
+     *
+     * The released buffers are kept by size class, a buffer can be taken for
+     * any size of its class. Buffers are never zero filled.
+     */
+    class FrameBufferPool
+    {
+        public:
+            FrameBufferPool();
+            FrameBufferPool(const FrameBufferPool &other) = delete;
+            FrameBufferPool &operator =(const FrameBufferPool &other) = delete;
+            ~FrameBufferPool();
+
+            // Maximum number of released buffers kept for each size class.
+            size_t maxBuffers() const;
+            void setMaxBuffers(size_t maxBuffers);
+
+            // Get a buffer of 'size' bytes, the contents are undefined.
+            FrameBuffer buffer(size_t size);
+
+            // Get a buffer with a copy of 'data'.
+            FrameBuffer copy(const VideoData &data);
+
+            // Free all the released buffers.
+            void clear();
+
+            /* Back the buffers of 4K frames and bigger with huge pages when
+             * the system allows it, reducing the TLB misses. Disabled by
+             * default.
+             */
+            static bool hugePages();
+            static void setHugePages(bool enable);
+
+            static FrameBufferPool *globalInstance();
+
+        private:
+            std::shared_ptr<FrameBufferPoolPrivate> d;
+    };
+}
+
+#endif // AKVCAMUTILS_FRAMEBUFFERPOOL_H
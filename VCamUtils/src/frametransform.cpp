@@ -0,0 +1,3335 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frametransform.h"
+#include "color.h"
+#include "pixeltraits.h"
+#include "scalerplan.h"
+#include "simd.h"
+#include "threadpool.h"
+#include "videoconvert.h"
+#include "videoformat.h"
+#include "videoframe.h"
+
+// Size in bytes of the stripes of lines processed at once.
+#define STRIPE_SIZE (64 * 1024)
+
+// Size of the frames used for measuring the kernels.
+#define CALIBRATION_WIDTH 320
+#define CALIBRATION_HEIGHT 240
+#define CALIBRATION_RUNS 3
+
+// Bytes of each source line read at once when rotating.
+#define ROTATE_BLOCK_SIZE 64
+
+// Nodes in each axis of the 3D color tables.
+#define COLOR_LUT_SIZE 33
+
+// Number of color tables kept by FrameTransformPrivate::colorLut().
+#define COLOR_LUT_CACHE_SIZE 4
+
+/* Pixels closer than two nodes to the gray axis are adjusted without the
+ * color table when raising the saturation, the chroma is max - min.
+ */
+#define COLOR_LUT_GRAY_CHROMA (2 * 256 / (COLOR_LUT_SIZE - 1))
+
+// Pixels looked up in the color table at once when fixing the grays.
+#define COLOR_LUT_BLOCK 64
+
+namespace AkVCam
+{
+    /* Intermediate lines, each thread has its own. The plan keeps one per
+     * thread, sized when it's built, so processing a frame doesn't allocate.
+     */
+    struct FrameTransformCache
+    {
+        // Source lines adjusted before scaling.
+        std::vector<uint8_t> m_data;
+        int m_line[2] {-1, -1};
+
+        // Source lines scaled horizontally, for the vertical pass.
+        std::vector<uint8_t> m_scaledData;
+        int m_scaledLine[2] {-1, -1};
+
+        // Source pixels gathered for the horizontal pass.
+        std::vector<uint8_t> m_gather;
+
+        // Sums of the source columns, for ScalingArea.
+        std::vector<uint16_t> m_sums;
+
+        // Scaled line of a YUV component, before interleaving it.
+        std::vector<uint8_t> m_output;
+
+        /* Source lines filtered horizontally, for the vertical pass of the
+         * polyphase scaler, line 'l' goes to the slot l % taps.
+         */
+        std::vector<int16_t> m_filtered;
+        std::vector<int> m_filteredLine;
+        std::vector<const int16_t *> m_rows;
+
+        // Luma and chroma of a YUV line split apart, for adjusting them.
+        std::vector<uint8_t> m_yuv;
+
+        // Source line unpacked to RGB24.
+        std::vector<uint8_t> m_unpacked;
+
+        // Lines transformed before converting them to the output format.
+        std::vector<uint8_t> m_stripe;
+
+        // Set while a thread is using the cache.
+        std::atomic<bool> m_busy {false};
+    };
+
+    using FrameTransformCaches = std::vector<FrameTransformCache>;
+    using FrameTransformCachesPtr = std::shared_ptr<FrameTransformCaches>;
+
+    /* Takes a free cache of the plan for the current thread, or a new one if
+     * all of them are in use.
+     */
+    class FrameTransformCacheLocker
+    {
+        public:
+            FrameTransformCacheLocker(const FrameTransformCachesPtr &caches);
+            ~FrameTransformCacheLocker();
+
+            inline FrameTransformCache &cache();
+
+        private:
+            FrameTransformCache *m_cache {nullptr};
+            FrameTransformCache m_ownCache;
+    };
+
+    /* A component of a YUV frame, scaled on its own at its own resolution.
+     * The samples are 'step' bytes apart, starting 'offset' bytes after the
+     * start of each line of 'plane', and the component is subsampled by
+     * 2^xShift horizontally and 2^yShift vertically.
+     */
+    struct FrameTransformComponent
+    {
+        size_t plane;
+        int offset;
+        int step;
+        int xShift;
+        int yShift;
+        uint8_t black;
+        ScalerPlanPtr scaler;
+        std::vector<uint16_t> weights;
+        std::vector<int16_t> coeffs;
+    };
+
+    using FrameTransformComponents = std::vector<FrameTransformComponent>;
+
+    /* Rotate the lines from 'first' to 'first + count' of the destination
+     * clockwise by 90, 180 or 270 degrees.
+     */
+    using FrameTransformRotateFunc = void (*)(const VideoFrame &src,
+                                              uint8_t *const *planes,
+                                              const size_t *strides,
+                                              int rotation,
+                                              int first,
+                                              int count);
+
+    /* Mirror the lines from 'first' to 'first + count' of the destination,
+     * swapping their red and blue components if 'swapRgb' is set. If
+     * 'planes' are the planes of 'src' and the frame is mirrored vertically,
+     * the lines are swapped in pairs, and 'first' and 'count' are pairs of
+     * lines instead.
+     */
+    using FrameTransformFlipFunc = void (*)(const VideoFrame &src,
+                                            uint8_t *const *planes,
+                                            const size_t *strides,
+                                            bool horizontalMirror,
+                                            bool verticalMirror,
+                                            bool swapRgb,
+                                            int first,
+                                            int count);
+
+    /* Flip the lines of a plane of 'height' lines of 'lineSize' bytes,
+     * 'flipLine' copies a line mirroring it if needed, and must work in
+     * place. The pair 'y' are the lines 'y' and 'height - y - 1'.
+     */
+    template<typename FlipLine>
+    inline void flipPlane(const uint8_t *src,
+                          size_t srcStride,
+                          uint8_t *dst,
+                          size_t dstStride,
+                          int height,
+                          size_t lineSize,
+                          bool verticalMirror,
+                          int first,
+                          int count,
+                          FlipLine flipLine)
+    {
+        if (src == dst && verticalMirror) {
+            int last = std::min(first + count, (height + 1) / 2);
+
+            for (int y = first; y < last; y++) {
+                auto top = dst + size_t(y) * dstStride;
+                auto bottom = dst + size_t(height - y - 1) * dstStride;
+                flipLine(top, top);
+
+                if (bottom != top) {
+                    flipLine(bottom, bottom);
+                    std::swap_ranges(top, top + lineSize, bottom);
+                }
+            }
+
+            return;
+        }
+
+        int last = std::min(first + count, height);
+
+        for (int y = first; y < last; y++) {
+            int srcY = verticalMirror? height - y - 1: y;
+            flipLine(src + size_t(srcY) * srcStride, dst + size_t(y) * dstStride);
+        }
+    }
+
+    /* Adjust in place the lines from 'first' to 'first + count' of a YUV
+     * frame 'width' pixels wide. The luma is mapped with 'yLut' and the
+     * (U, V) pairs are multiplied by the 'chroma' matrix, with the
+     * adjustChroma kernel. Any of them is null if it does nothing.
+     */
+    using FrameTransformAdjustFunc = void (*)(uint8_t *const *planes,
+                                              const size_t *strides,
+                                              int width,
+                                              int first,
+                                              int count,
+                                              const uint8_t *yLut,
+                                              const int16_t *chroma,
+                                              FrameTransformCache &cache);
+
+    // Map 'width' bytes, 'step' bytes apart, with 'lut'.
+    inline void mapBytes(uint8_t *data, int step, int width, const uint8_t *lut)
+    {
+        for (int x = 0; x < width; x++, data += step)
+            *data = lut[*data];
+    }
+
+    /* The (U, V) matrix 'uv' for chroma pairs stored in (V, U) order if
+     * 'uFirst' is false.
+     */
+    inline void chromaMatrix(const int16_t *uv, bool uFirst, int16_t *matrix)
+    {
+        for (int i = 0; i < 4; i++)
+            matrix[i] = uv[uFirst? i: 3 - i];
+    }
+
+    /* Rotate a plane of 'width' x 'height' elements of 'Bytes' bytes, by
+     * transposing blocks of a cache line of the source. Clockwise the source
+     * is read from the bottom line, counterclockwise the destination is
+     * written from the bottom line. By 180 degrees the lines are copied
+     * backwards.
+     */
+    template<int Bytes>
+    inline void rotatePlane(const uint8_t *src,
+                            size_t srcStride,
+                            int width,
+                            int height,
+                            uint8_t *dst,
+                            size_t dstStride,
+                            int rotation,
+                            int first,
+                            int count)
+    {
+        if (rotation == 180) {
+            int last = std::min(first + count, height);
+
+            for (int y = first; y < last; y++) {
+                auto srcLine = src
+                               + size_t(height - y - 1) * srcStride
+                               + Bytes * size_t(width - 1);
+                auto dstLine = dst + size_t(y) * dstStride;
+
+                for (int x = 0; x < width; x++)
+                    memcpy(dstLine + Bytes * x, srcLine - Bytes * x, Bytes);
+            }
+
+            return;
+        }
+
+        auto &kernels = Simd::kernels();
+        auto transpose = Bytes == 1? kernels.transpose8:
+                         Bytes == 2? kernels.transpose16:
+                         Bytes == 3? kernels.transpose24:
+                                     kernels.transpose32;
+        const int block = std::max(ROTATE_BLOCK_SIZE / Bytes, 1);
+        auto stride = ptrdiff_t(srcStride);
+        auto bottom = src + (height - 1) * stride;
+        int last = std::min(first + count, width);
+
+        for (int line = first; line < last; line += block) {
+            int lines = std::min(block, last - line);
+
+            if (rotation == 90) {
+                transpose(bottom + Bytes * line,
+                          -stride,
+                          dst + size_t(line) * dstStride,
+                          ptrdiff_t(dstStride),
+                          lines,
+                          height);
+            } else {
+                int column = width - line - lines;
+                transpose(src + Bytes * column,
+                          stride,
+                          dst + size_t(line + lines - 1) * dstStride,
+                          -ptrdiff_t(dstStride),
+                          lines,
+                          height);
+            }
+        }
+    }
+
+    template<PixelFormat F, PixelLayout Layout=PixelTraits<F>::layout>
+    struct FrameTransformLayout
+    {
+        static bool components(FrameTransformComponents &)
+        {
+            return false;
+        }
+
+        static void rotate(const VideoFrame &src,
+                           uint8_t *const *planes,
+                           const size_t *strides,
+                           int rotation,
+                           int first,
+                           int count)
+        {
+            auto format = src.format();
+            rotatePlane<int(PixelTraits<F>::bytes)>(src.line(0, 0),
+                                                    format.bypl(0),
+                                                    format.width(),
+                                                    format.height(),
+                                                    planes[0],
+                                                    strides[0],
+                                                    rotation,
+                                                    first,
+                                                    count);
+        }
+
+        static void flip(const VideoFrame &src,
+                         uint8_t *const *planes,
+                         const size_t *strides,
+                         bool horizontalMirror,
+                         bool verticalMirror,
+                         bool swapRgb,
+                         int first,
+                         int count)
+        {
+            using T = PixelTraits<F>;
+            auto &kernels = Simd::kernels();
+            auto mirror = T::bytes == 2? kernels.mirror16:
+                          T::bytes == 3? kernels.mirror24:
+                                         kernels.mirror32;
+            auto swap = T::bytes == 2? (T::gBits == 6?
+                                            kernels.swapRgb16:
+                                            kernels.swapRgb15):
+                        T::bytes == 3? kernels.swapRgb24:
+                        T::bShift == 16? kernels.swapBgr32:
+                                         kernels.swapRgb32;
+            auto format = src.format();
+            int width = format.width();
+            auto lineSize = T::bytes * size_t(width);
+            flipPlane(src.line(0, 0),
+                      format.bypl(0),
+                      planes[0],
+                      strides[0],
+                      format.height(),
+                      lineSize,
+                      verticalMirror,
+                      first,
+                      count,
+                      [&] (const uint8_t *srcLine, uint8_t *dstLine) {
+                if (horizontalMirror)
+                    mirror(srcLine, dstLine, width);
+                else if (srcLine != dstLine)
+                    memcpy(dstLine, srcLine, lineSize);
+
+                if (swapRgb)
+                    swap(dstLine, dstLine, width);
+            });
+        }
+
+        static void adjust(uint8_t *const *,
+                           const size_t *,
+                           int,
+                           int,
+                           int,
+                           const uint8_t *,
+                           const int16_t *,
+                           FrameTransformCache &)
+        {
+        }
+    };
+
+    template<PixelFormat F>
+    struct FrameTransformLayout<F, PixelLayoutPacked422>
+    {
+        static bool components(FrameTransformComponents &components)
+        {
+            using T = PixelTraits<F>;
+            int y = T::y0 < T::y1? T::y0: T::y1;
+            components = {
+                {0, y   , 2, 0, 0, Color::rgbY(0, 0, 0), {}, {}, {}},
+                {0, T::u, 4, 1, 0, Color::rgbU(0, 0, 0), {}, {}, {}},
+                {0, T::v, 4, 1, 0, Color::rgbV(0, 0, 0), {}, {}, {}},
+            };
+
+            return true;
+        }
+
+        /* The chroma is shared by two horizontal pixels, after rotating by
+         * 90 degrees it is shared by two vertical pixels, so each destination
+         * macropixel averages the chroma of the two source lines it comes
+         * from. By 180 degrees the macropixels are copied backwards with the
+         * lumas swapped.
+         */
+        static void rotate(const VideoFrame &src,
+                           uint8_t *const *planes,
+                           const size_t *strides,
+                           int rotation,
+                           int first,
+                           int count)
+        {
+            using T = PixelTraits<F>;
+            auto format = src.format();
+            int width = format.width();
+            int height = format.height();
+            auto srcLine = src.line(0, 0);
+            auto srcStride = format.bypl(0);
+
+            if (rotation == 180) {
+                int macropixels = width / 2;
+                int last = std::min(first + count, height);
+
+                for (int y = first; y < last; y++) {
+                    auto srcYuv = srcLine
+                                  + size_t(height - y - 1) * srcStride
+                                  + 4 * size_t(macropixels - 1);
+                    auto dstYuv = planes[0] + size_t(y) * strides[0];
+
+                    for (int i = 0; i < macropixels; i++) {
+                        dstYuv[T::y0] = srcYuv[T::y1];
+                        dstYuv[T::y1] = srcYuv[T::y0];
+                        dstYuv[T::u] = srcYuv[T::u];
+                        dstYuv[T::v] = srcYuv[T::v];
+                        srcYuv -= 4;
+                        dstYuv += 4;
+                    }
+                }
+
+                return;
+            }
+
+            bool clockwise = rotation == 90;
+            int macropixels = (height + 1) / 2;
+            int last = std::min(first + count, width);
+            const int lineBlock = ROTATE_BLOCK_SIZE / 2;
+            const int pixelBlock = ROTATE_BLOCK_SIZE;
+
+            for (int line = first; line < last; line += lineBlock) {
+                int lastLine = std::min(line + lineBlock, last);
+
+                for (int pixel = 0; pixel < macropixels; pixel += pixelBlock) {
+                    int lastPixel = std::min(pixel + pixelBlock, macropixels);
+
+                    for (int y = line; y < lastLine; y++) {
+                        int x = clockwise? y: width - y - 1;
+                        auto column = srcLine + 4 * size_t(x / 2);
+                        auto yOffset = x & 1? T::y1: T::y0;
+                        auto dstLine = planes[0] + size_t(y) * strides[0];
+
+                        for (int i = pixel; i < lastPixel; i++) {
+                            // For odd heights repeat the last pixel.
+                            int y0 = clockwise? height - 2 * i - 1: 2 * i;
+                            int y1 = clockwise?
+                                         std::max(y0 - 1, 0):
+                                         std::min(y0 + 1, height - 1);
+                            auto p0 = column + size_t(y0) * srcStride;
+                            auto p1 = column + size_t(y1) * srcStride;
+                            auto yuv = dstLine + 4 * size_t(i);
+                            yuv[T::y0] = p0[yOffset];
+                            yuv[T::y1] = p1[yOffset];
+                            yuv[T::u] = uint8_t((p0[T::u] + p1[T::u] + 1) >> 1);
+                            yuv[T::v] = uint8_t((p0[T::v] + p1[T::v] + 1) >> 1);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Macropixels are mirrored whole, with their lumas swapped.
+        static void flip(const VideoFrame &src,
+                         uint8_t *const *planes,
+                         const size_t *strides,
+                         bool horizontalMirror,
+                         bool verticalMirror,
+                         bool,
+                         int first,
+                         int count)
+        {
+            using T = PixelTraits<F>;
+            auto &kernels = Simd::kernels();
+            auto mirror = T::y0 == 0? kernels.mirrorYuy2: kernels.mirrorUyvy;
+            auto format = src.format();
+            int macropixels = format.width() / 2;
+            auto lineSize = 4 * size_t(macropixels);
+            flipPlane(src.line(0, 0),
+                      format.bypl(0),
+                      planes[0],
+                      strides[0],
+                      format.height(),
+                      lineSize,
+                      verticalMirror,
+                      first,
+                      count,
+                      [&] (const uint8_t *srcLine, uint8_t *dstLine) {
+                if (horizontalMirror)
+                    mirror(srcLine, dstLine, macropixels);
+                else if (srcLine != dstLine)
+                    memcpy(dstLine, srcLine, lineSize);
+            });
+        }
+
+        /* The lumas and the chromas are split in two lines of byte pairs,
+         * adjusted, and interleaved again.
+         */
+        static void adjust(uint8_t *const *planes,
+                           const size_t *strides,
+                           int width,
+                           int first,
+                           int count,
+                           const uint8_t *yLut,
+                           const int16_t *chroma,
+                           FrameTransformCache &cache)
+        {
+            using T = PixelTraits<F>;
+            auto &kernels = Simd::kernels();
+            int yOffset = T::y0 < T::y1? T::y0: T::y1;
+            int pairs = 2 * ((width + 1) / 2);
+            int16_t matrix[4];
+
+            if (chroma)
+                chromaMatrix(chroma, T::u < T::v, matrix);
+
+            cache.m_yuv.resize(2 * size_t(pairs));
+            auto luma = cache.m_yuv.data();
+            auto uv = luma + pairs;
+            auto even = yOffset == 0? luma: uv;
+            auto odd = yOffset == 0? uv: luma;
+
+            for (int y = first; y < first + count; y++) {
+                auto line = planes[0] + size_t(y) * strides[0];
+
+                if (!chroma) {
+                    mapBytes(line + yOffset, 2, pairs, yLut);
+
+                    continue;
+                }
+
+                kernels.splitBytes(line, even, odd, pairs);
+
+                if (yLut)
+                    mapBytes(luma, 1, pairs, yLut);
+
+                kernels.adjustChroma(uv, uv, matrix, pairs / 2);
+                kernels.mergeBytes(even, odd, line, pairs);
+            }
+        }
+    };
+
+    template<PixelFormat F>
+    struct FrameTransformLayout<F, PixelLayoutYuv420>
+    {
+        static bool components(FrameTransformComponents &components)
+        {
+            using T = PixelTraits<F>;
+            components = {
+                {0        , 0         , 1      , 0, 0, Color::rgbY(0, 0, 0), {}, {}, {}},
+                {T::uPlane, T::uOffset, T::step, 1, 1, Color::rgbU(0, 0, 0), {}, {}, {}},
+                {T::vPlane, T::vOffset, T::step, 1, 1, Color::rgbV(0, 0, 0), {}, {}, {}},
+            };
+
+            return true;
+        }
+
+        // The chroma planes are rotated as planes of half the size.
+        static void rotate(const VideoFrame &src,
+                           uint8_t *const *planes,
+                           const size_t *strides,
+                           int rotation,
+                           int first,
+                           int count)
+        {
+            using T = PixelTraits<F>;
+            auto format = src.format();
+            int width = format.width();
+            int height = format.height();
+            rotatePlane<1>(src.line(0, 0),
+                           format.bypl(0),
+                           width,
+                           height,
+                           planes[0],
+                           strides[0],
+                           rotation,
+                           first,
+                           count);
+            int chromaFirst = first / 2;
+            int chromaCount = (first + count + 1) / 2 - chromaFirst;
+
+            for (size_t plane = 1; plane < T::planes; plane++)
+                rotatePlane<T::step>(src.line(plane, 0),
+                                     format.bypl(plane),
+                                     (width + 1) / 2,
+                                     (height + 1) / 2,
+                                     planes[plane],
+                                     strides[plane],
+                                     rotation,
+                                     chromaFirst,
+                                     chromaCount);
+        }
+
+        /* The chroma pairs of the semi-planar formats are mirrored as 16 bits
+         * pixels.
+         */
+        static void flip(const VideoFrame &src,
+                         uint8_t *const *planes,
+                         const size_t *strides,
+                         bool horizontalMirror,
+                         bool verticalMirror,
+                         bool,
+                         int first,
+                         int count)
+        {
+            using T = PixelTraits<F>;
+            auto &kernels = Simd::kernels();
+            auto format = src.format();
+            int chromaFirst = first / 2;
+            int chromaCount = (first + count + 1) / 2 - chromaFirst;
+
+            for (size_t plane = 0; plane < T::planes; plane++) {
+                int width = plane < 1? format.width(): format.width() / 2;
+                int step = plane < 1? 1: T::step;
+                auto mirror = step == 1? kernels.mirror8: kernels.mirror16;
+                auto lineSize = size_t(step * width);
+                flipPlane(src.line(plane, 0),
+                          format.bypl(plane),
+                          planes[plane],
+                          strides[plane],
+                          plane < 1? format.height(): format.height() / 2,
+                          lineSize,
+                          verticalMirror,
+                          plane < 1? first: chromaFirst,
+                          plane < 1? count: chromaCount,
+                          [&] (const uint8_t *srcLine, uint8_t *dstLine) {
+                    if (horizontalMirror)
+                        mirror(srcLine, dstLine, width);
+                    else if (srcLine != dstLine)
+                        memcpy(dstLine, srcLine, lineSize);
+                });
+            }
+        }
+
+        /* Semi-planar chromas are adjusted in place, planar ones are
+         * interleaved first.
+         */
+        static void adjust(uint8_t *const *planes,
+                           const size_t *strides,
+                           int width,
+                           int first,
+                           int count,
+                           const uint8_t *yLut,
+                           const int16_t *chroma,
+                           FrameTransformCache &cache)
+        {
+            using T = PixelTraits<F>;
+            auto &kernels = Simd::kernels();
+
+            if (yLut)
+                for (int y = first; y < first + count; y++)
+                    mapBytes(planes[0] + size_t(y) * strides[0],
+                             1,
+                             width,
+                             yLut);
+
+            if (!chroma)
+                return;
+
+            int chromaWidth = (width + 1) / 2;
+            int chromaLast = (first + count + 1) / 2;
+            int16_t matrix[4];
+            chromaMatrix(chroma, T::step == 1 || T::uOffset < T::vOffset, matrix);
+
+            if (T::step == 1)
+                cache.m_yuv.resize(2 * size_t(chromaWidth));
+
+            for (int y = first / 2; y < chromaLast; y++) {
+                auto uLine = planes[T::uPlane]
+                             + size_t(y) * strides[T::uPlane]
+                             + T::uOffset;
+                auto vLine = planes[T::vPlane]
+                             + size_t(y) * strides[T::vPlane]
+                             + T::vOffset;
+
+                if (T::step == 1) {
+                    auto uv = cache.m_yuv.data();
+                    kernels.mergeBytes(uLine, vLine, uv, chromaWidth);
+                    kernels.adjustChroma(uv, uv, matrix, chromaWidth);
+                    kernels.splitBytes(uv, uLine, vLine, chromaWidth);
+                } else {
+                    auto uvLine = std::min(uLine, vLine);
+                    kernels.adjustChroma(uvLine, uvLine, matrix, chromaWidth);
+                }
+            }
+        }
+    };
+
+    /* Average the K x K blocks of the RGB24 column sums in 'sums', the
+     * factor is a constant so the division is done with a multiplication.
+     */
+    template<int K>
+    inline void reduceArea(const uint16_t *sums, uint8_t *dst, int width)
+    {
+        for (int x = 0; x < width; x++) {
+            auto block = sums + 3 * K * x;
+            auto pixel = dst + 3 * x;
+
+            for (int c = 0; c < 3; c++) {
+                int sum = 0;
+
+                for (int i = 0; i < K; i++)
+                    sum += block[3 * i + c];
+
+                pixel[c] = uint8_t((sum + K * K / 2) / (K * K));
+            }
+        }
+    }
+
+    /* The color adjusts of 'params' sampled in a grid of COLOR_LUT_SIZE^3
+     * colors, for the lut3d kernel. The tables are immutable and shared by
+     * the transforms with the same adjusts.
+     */
+    struct FrameTransformColorLut
+    {
+        FrameTransformParams params;
+        std::vector<uint32_t> nodes;
+        uint32_t axis[3 * 256];
+    };
+
+    using FrameTransformColorLutPtr = std::shared_ptr<const FrameTransformColorLut>;
+
+    class FrameTransformColorLuts
+    {
+        public:
+            std::list<FrameTransformColorLutPtr> m_luts;
+            std::mutex m_mutex;
+
+            static FrameTransformColorLuts &instance();
+    };
+
+    enum FrameTransformKernel
+    {
+        FrameTransformKernelResample,
+        FrameTransformKernelResampleLinear,
+        FrameTransformKernelResampleArea,
+        FrameTransformKernelResampleFilter,
+        FrameTransformKernelAdjust,
+        FrameTransformKernelAdjustHsl,
+        FrameTransformKernelFlip,
+        FrameTransformKernelCount
+    };
+
+    /* Nanoseconds per pixel of each stage of the transform, the conversion
+     * costs are taken from VideoConvert. The area scaler cost is per source
+     * pixel, the polyphase scaler cost is for 4 taps in each axis, the other
+     * ones are per processed pixel.
+     */
+    class FrameTransformCosts
+    {
+        public:
+            double m_costs[FrameTransformKernelCount] {1.5, 4.0, 1.0, 10.0, 2.0, 8.0, 0.5};
+            std::mutex m_mutex;
+
+            static FrameTransformCosts &instance();
+            double cost(FrameTransformKernel kernel);
+            void setCost(FrameTransformKernel kernel, double cost);
+    };
+
+    class FrameTransformPrivate
+    {
+        public:
+            VideoFormat m_inputFormat;
+            VideoFormat m_outputFormat;
+            FrameTransformParams m_params;
+            bool m_configured {false};
+            bool m_valid {false};
+
+            // Plan
+            VideoFormat m_sourceFormat;
+            int m_rotation {0};
+            FrameTransformRotateFunc m_rotate {nullptr};
+            VideoFrame m_rotated;
+            FrameTransformFlipFunc m_flip {nullptr};
+            bool m_flipSwapRgb {false};
+            bool m_horizontalMirror {false};
+            bool m_verticalMirror {false};
+            VideoConvertFunction m_convert {nullptr};
+            VideoConvertFunction m_unpack {nullptr};
+            bool m_packComponents {false};
+            bool m_direct {false};
+            bool m_inPlace {false};
+            bool m_preScale {false};
+            bool m_adjust {false};
+            bool m_hsl {false};
+            bool m_useLut {false};
+            uint8_t m_lut[256];
+            FrameTransformColorLutPtr m_colorLut;
+            FrameTransformAdjustFunc m_adjustYuv {nullptr};
+            bool m_useYLut {false};
+            uint8_t m_yLut[256];
+            bool m_useChroma {false};
+            int16_t m_chroma[4];
+            Viewport m_viewport;
+            bool m_cropped {false};
+            ScalerPlanPtr m_scaler;
+            bool m_linear {false};
+            std::vector<uint16_t> m_xWeights;
+            std::vector<int16_t> m_xCoeffs;
+            int m_areaFactor {0};
+            FrameTransformComponents m_components;
+            int m_stripeLines {0};
+            size_t m_stripeLineSize {0};
+            VideoFormat m_stripeFormat;
+            FrameTransformCachesPtr m_caches;
+
+            bool build();
+            void reserveCaches(bool rebuild=false);
+            Viewport viewport() const;
+            bool processRotated(const VideoFrame &frame,
+                                uint8_t *const *planes,
+                                const size_t *strides);
+            void rotate(const VideoFrame &frame,
+                        uint8_t *const *planes,
+                        const size_t *strides) const;
+            double cost() const;
+            inline bool canProcess(const VideoFormat &format) const;
+            inline int outputLine(int line) const;
+            inline void processLines(const VideoFrame &frame,
+                                     uint8_t *const *planes,
+                                     const size_t *strides,
+                                     int first,
+                                     int count) const;
+            static double measure(const VideoFormat &inputFormat,
+                                  const VideoFormat &outputFormat,
+                                  const FrameTransformParams &params);
+            void convertLines(const VideoFrame &frame,
+                              uint8_t *const *planes,
+                              const size_t *strides,
+                              int first,
+                              int count) const;
+            void resizeCache(FrameTransformCache &cache) const;
+            void transformLines(const VideoFrame &frame,
+                                uint8_t *const *planes,
+                                const size_t *strides,
+                                int first,
+                                int count) const;
+            void scaleComponents(const VideoFrame &frame,
+                                 uint8_t *const *planes,
+                                 const size_t *strides,
+                                 int first,
+                                 int count) const;
+            void resizeComponentCache(const FrameTransformComponent &component,
+                                      FrameTransformCache &cache) const;
+            inline void componentLines(const VideoFrame &frame,
+                                       FrameTransformCache &cache,
+                                       uint8_t *const *planes,
+                                       const size_t *strides,
+                                       int origin,
+                                       int first,
+                                       int count) const;
+            inline void componentLine(const VideoFrame &frame,
+                                      const FrameTransformComponent &component,
+                                      FrameTransformCache &cache,
+                                      int y,
+                                      uint8_t *dstLine) const;
+            inline const uint8_t *scaledComponentLine(const VideoFrame &frame,
+                                                      const FrameTransformComponent &component,
+                                                      FrameTransformCache &cache,
+                                                      int line,
+                                                      int keep) const;
+            inline void scaleComponentLine(const uint8_t *srcLine,
+                                           const FrameTransformComponent &component,
+                                           FrameTransformCache &cache,
+                                           uint8_t *dstLine) const;
+            inline void areaComponentLine(const VideoFrame &frame,
+                                          const FrameTransformComponent &component,
+                                          FrameTransformCache &cache,
+                                          const ScalerSample &sampleY,
+                                          uint8_t *dstLine) const;
+            inline const uint8_t *inputLine(const VideoFrame &frame,
+                                            FrameTransformCache &cache,
+                                            int line) const;
+            inline const uint8_t *sourceLine(const VideoFrame &frame,
+                                             FrameTransformCache &cache,
+                                             int line,
+                                             int keep) const;
+            inline const uint8_t *scaledLine(const VideoFrame &frame,
+                                             FrameTransformCache &cache,
+                                             int line,
+                                             int keep) const;
+            inline void scaleLine(const uint8_t *srcLine,
+                                  FrameTransformCache &cache,
+                                  uint8_t *dstLine) const;
+            inline void filterLine(const uint8_t *srcLine,
+                                   int pixelSize,
+                                   int channels,
+                                   uint8_t black,
+                                   const ScalerPlan &scaler,
+                                   const int16_t *coeffs,
+                                   FrameTransformCache &cache,
+                                   int16_t *dstLine) const;
+            inline const int16_t *filteredLine(const VideoFrame &frame,
+                                               FrameTransformCache &cache,
+                                               int line) const;
+            inline const int16_t *filteredComponentLine(const VideoFrame &frame,
+                                                        const FrameTransformComponent &component,
+                                                        FrameTransformCache &cache,
+                                                        int line) const;
+            inline void areaLine(const VideoFrame &frame,
+                                 FrameTransformCache &cache,
+                                 int y,
+                                 uint8_t *dstLine) const;
+            inline void transformLine(const VideoFrame &frame,
+                                      FrameTransformCache &cache,
+                                      int y,
+                                      uint8_t *dstLine) const;
+            inline void adjustLine(const uint8_t *srcLine,
+                                   uint8_t *dstLine,
+                                   int width) const;
+            void adjustPixels(const uint8_t *srcLine,
+                              uint8_t *dstLine,
+                              int width) const;
+            FrameTransformColorLutPtr colorLut() const;
+            void yuvAdjusts();
+
+            template<typename T>
+            static inline T bound(T min, T value, T max)
+            {
+                return value < min? min: value > max? max: value;
+            }
+
+            template<typename T>
+            static inline T mod(T value, T mod)
+            {
+                return (value % mod + mod) % mod;
+            }
+
+            // Formats supported by the per pixel stages.
+            inline static bool canAdjust(FourCC fourcc);
+            static bool yuvComponents(FourCC fourcc,
+                                      FrameTransformComponents &components);
+            static FrameTransformRotateFunc rotator(FourCC fourcc);
+            static FrameTransformAdjustFunc yuvAdjuster(FourCC fourcc);
+            static FrameTransformFlipFunc flipper(const VideoFormat &inputFormat,
+                                                  const VideoFormat &outputFormat,
+                                                  const FrameTransformParams &params);
+            inline static const uint8_t *componentSource(const VideoFrame &frame,
+                                                         const FrameTransformComponent &component,
+                                                         int line);
+            inline static int grayval(int r, int g, int b);
+            static int areaFactor(const ScalerPlan &plan);
+            static std::vector<int16_t> filterCoeffs(const ScalerPlan &plan,
+                                                     int channels);
+            static void resizeFilterCache(const ScalerPlan &plan,
+                                          size_t lineSize,
+                                          FrameTransformCache &cache);
+            inline static void rgbToHsl(int r, int g, int b,
+                                        int *h, int *s, int *l);
+            inline static void hslToRgb(int h, int s, int l,
+                                        int *r, int *g, int *b);
+            static uint8_t gammaValue(int gamma, int value);
+            static uint8_t contrastValue(int contrast, int value);
+    };
+}
+
+bool AkVCam::FrameTransformParams::operator ==(const FrameTransformParams &other) const
+{
+    return this->horizontalMirror == other.horizontalMirror
+            && this->verticalMirror == other.verticalMirror
+            && this->rotation == other.rotation
+            && this->swapRgb == other.swapRgb
+            && this->scaling == other.scaling
+            && this->aspectRatio == other.aspectRatio
+            && this->viewport.x == other.viewport.x
+            && this->viewport.y == other.viewport.y
+            && this->viewport.width == other.viewport.width
+            && this->viewport.height == other.viewport.height
+            && this->zoom == other.zoom
+            && this->pan == other.pan
+            && this->tilt == other.tilt
+            && this->hue == other.hue
+            && this->saturation == other.saturation
+            && this->luminance == other.luminance
+            && this->gamma == other.gamma
+            && this->contrast == other.contrast
+            && this->gray == other.gray;
+}
+
+bool AkVCam::FrameTransformParams::operator !=(const FrameTransformParams &other) const
+{
+    return !(*this == other);
+}
+
+AkVCam::FrameTransform::FrameTransform()
+{
+    this->d = new FrameTransformPrivate;
+}
+
+AkVCam::FrameTransform::FrameTransform(const FrameTransform &other)
+{
+    this->d = new FrameTransformPrivate;
+    *this->d = *other.d;
+    this->d->reserveCaches(true);
+}
+
+AkVCam::FrameTransform &AkVCam::FrameTransform::operator =(const FrameTransform &other)
+{
+    if (this != &other) {
+        *this->d = *other.d;
+        this->d->reserveCaches(true);
+    }
+
+    return *this;
+}
+
+AkVCam::FrameTransform::~FrameTransform()
+{
+    delete this->d;
+}
+
+bool AkVCam::FrameTransform::configure(const VideoFormat &inputFormat,
+                                       const VideoFormat &outputFormat,
+                                       const FrameTransformParams &params)
+{
+    if (this->d->m_configured
+        && this->d->m_inputFormat == inputFormat
+        && this->d->m_outputFormat == outputFormat
+        && this->d->m_params == params)
+        return this->d->m_valid;
+
+    this->d->m_inputFormat = inputFormat;
+    this->d->m_outputFormat = outputFormat;
+    this->d->m_params = params;
+    this->d->m_configured = true;
+    this->d->m_valid = this->d->build();
+    this->d->reserveCaches(true);
+
+    return this->d->m_valid;
+}
+
+bool AkVCam::FrameTransform::isValid() const
+{
+    return this->d->m_valid;
+}
+
+AkVCam::VideoFormat AkVCam::FrameTransform::inputFormat() const
+{
+    return this->d->m_inputFormat;
+}
+
+AkVCam::VideoFormat AkVCam::FrameTransform::outputFormat() const
+{
+    return this->d->m_outputFormat;
+}
+
+AkVCam::FrameTransformParams AkVCam::FrameTransform::params() const
+{
+    return this->d->m_params;
+}
+
+bool AkVCam::FrameTransform::process(const VideoFrame &frame,
+                                     uint8_t *const *planes,
+                                     const size_t *strides)
+{
+    if (!this->d->m_valid || !this->d->canProcess(frame.format()))
+        return false;
+
+    this->d->reserveCaches();
+
+    if (this->d->m_rotation != 0)
+        return this->d->processRotated(frame, planes, strides);
+
+    /* Split the frame between the threads, stripes start at even lines so
+     * chroma subsampled planes are not split in the middle of a line.
+     */
+    ThreadPool::globalInstance()->runStripes(this->d->m_outputFormat.height(),
+                                             this->d->m_stripeLines,
+                                             2,
+                                             [&] (int first, int count) {
+        this->d->processLines(frame, planes, strides, first, count);
+    });
+
+    return true;
+}
+
+bool AkVCam::FrameTransform::process(const VideoFrame &frame,
+                                     const std::vector<FrameTransform *> &transforms,
+                                     const std::vector<uint8_t *const *> &planes,
+                                     const std::vector<const size_t *> &strides)
+{
+    if (planes.size() != transforms.size()
+        || strides.size() != transforms.size())
+        return false;
+
+    auto format = frame.format();
+    int stripeLines = 0;
+
+    for (auto &transform: transforms) {
+        if (!transform
+            || !transform->d->m_valid
+            || !transform->d->canProcess(format))
+            return false;
+
+        if (stripeLines < 1 || transform->d->m_stripeLines < stripeLines)
+            stripeLines = transform->d->m_stripeLines;
+    }
+
+    for (auto &transform: transforms)
+        transform->d->reserveCaches();
+
+    // The rotated outputs don't follow the source lines, do them apart.
+    bool rotated = false;
+
+    for (size_t i = 0; i < transforms.size(); i++)
+        if (transforms[i]->d->m_rotation != 0) {
+            transforms[i]->d->processRotated(frame, planes[i], strides[i]);
+            rotated = true;
+        }
+
+    if (transforms.empty() || stripeLines < 1)
+        return true;
+
+    /* Walk the frame in stripes of source lines, and for each stripe produce
+     * the matching lines of every output, so the source lines are still in
+     * cache when the next output reads them.
+     */
+    int height = format.height();
+    ThreadPool::globalInstance()->runStripes(height,
+                                             stripeLines,
+                                             2,
+                                             [&] (int first, int count) {
+        for (int y = first; y < first + count; y += stripeLines) {
+            int lines = std::min(stripeLines, first + count - y);
+
+            for (size_t i = 0; i < transforms.size(); i++) {
+                auto d = transforms[i]->d;
+
+                if (rotated && d->m_rotation != 0)
+                    continue;
+
+                int outputFirst = d->outputLine(y);
+                int outputLast = y + lines < height?
+                                     d->outputLine(y + lines):
+                                     d->m_outputFormat.height();
+
+                if (outputLast > outputFirst)
+                    d->processLines(frame,
+                                    planes[i],
+                                    strides[i],
+                                    outputFirst,
+                                    outputLast - outputFirst);
+            }
+        }
+    });
+
+    return true;
+}
+
+bool AkVCam::FrameTransform::process(const VideoFrame &frame,
+                                     uint8_t *data,
+                                     size_t size)
+{
+    if (!data || size < this->d->m_outputFormat.size())
+        return false;
+
+    uint8_t *planes[4];
+    size_t strides[4];
+
+    for (size_t plane = 0; plane < this->d->m_outputFormat.planes(); plane++) {
+        planes[plane] = data + this->d->m_outputFormat.offset(plane);
+        strides[plane] = this->d->m_outputFormat.bypl(plane);
+    }
+
+    return this->process(frame, planes, strides);
+}
+
+AkVCam::VideoFrame AkVCam::FrameTransform::process(const VideoFrame &frame)
+{
+    if (!this->d->m_valid)
+        return {};
+
+    VideoFrame dst(this->d->m_outputFormat);
+
+    if (!this->process(frame, dst.data().data(), dst.data().size()))
+        return {};
+
+    return dst;
+}
+
+double AkVCam::FrameTransform::cost(const VideoFormat &inputFormat,
+                                     const VideoFormat &outputFormat,
+                                     const FrameTransformParams &params)
+{
+    FrameTransform transform;
+
+    if (!transform.configure(inputFormat, outputFormat, params))
+        return -1.0;
+
+    return transform.d->cost();
+}
+
+AkVCam::VideoFormat AkVCam::FrameTransform::negotiate(const VideoFormat &inputFormat,
+                                                      const std::vector<VideoFormat> &formats,
+                                                      const FrameTransformParams &params)
+{
+    VideoFormat cheapestFormat;
+    double cheapestCost = -1.0;
+
+    for (auto &format: formats) {
+        auto input = inputFormat;
+
+        if (input.width() < 1 || input.height() < 1) {
+            input.width() = format.width();
+            input.height() = format.height();
+        }
+
+        auto cost = FrameTransform::cost(input, format, params);
+
+        if (cost < 0.0)
+            continue;
+
+        if (cheapestCost < 0.0 || cost < cheapestCost) {
+            cheapestFormat = format;
+            cheapestCost = cost;
+        }
+    }
+
+    return cheapestFormat;
+}
+
+void AkVCam::FrameTransform::calibrate()
+{
+    VideoConvert::calibrate();
+
+    VideoFormat format(PixelFormatRGB24,
+                       CALIBRATION_WIDTH,
+                       CALIBRATION_HEIGHT);
+    VideoFormat halfFormat(PixelFormatRGB24,
+                           CALIBRATION_WIDTH / 2,
+                           CALIBRATION_HEIGHT / 2);
+    auto copyCost = VideoConvert::cost(PixelFormatRGB24, PixelFormatRGB24);
+
+    FrameTransformParams mirror;
+    mirror.horizontalMirror = true;
+    FrameTransformParams linear;
+    linear.scaling = ScalingLinear;
+    FrameTransformParams area;
+    area.scaling = ScalingArea;
+    FrameTransformParams cubic;
+    cubic.scaling = ScalingCubic;
+    FrameTransformParams adjust;
+    adjust.gamma = 64;
+    FrameTransformParams hsl;
+    hsl.hue = 64;
+
+    // Every stage is measured alone, without the final copy.
+    auto &costs = FrameTransformCosts::instance();
+    costs.setCost(FrameTransformKernelResample,
+                  FrameTransformPrivate::measure(halfFormat, format, {})
+                  - copyCost);
+    costs.setCost(FrameTransformKernelResampleLinear,
+                  FrameTransformPrivate::measure(halfFormat, format, linear)
+                  - copyCost);
+    // Measured per output pixel, each one averages 4 source pixels.
+    costs.setCost(FrameTransformKernelResampleArea,
+                  (FrameTransformPrivate::measure(format, halfFormat, area)
+                   - copyCost) / 4);
+    costs.setCost(FrameTransformKernelResampleFilter,
+                  FrameTransformPrivate::measure(halfFormat, format, cubic)
+                  - copyCost);
+    costs.setCost(FrameTransformKernelAdjust,
+                  FrameTransformPrivate::measure(format, format, adjust)
+                  - copyCost);
+    costs.setCost(FrameTransformKernelAdjustHsl,
+                  FrameTransformPrivate::measure(format, format, hsl)
+                  - copyCost);
+
+    // Mirroring doesn't need a copy after it.
+    costs.setCost(FrameTransformKernelFlip,
+                  FrameTransformPrivate::measure(format, format, mirror));
+}
+
+bool AkVCam::FrameTransform::flip(VideoFrame &frame,
+                                  bool horizontalMirror,
+                                  bool verticalMirror,
+                                  bool swapRgb)
+{
+    auto format = frame.format();
+
+    if (format.size() < 1)
+        return false;
+
+    if (!horizontalMirror && !verticalMirror && !swapRgb)
+        return true;
+
+    FrameTransformParams params;
+    params.horizontalMirror = horizontalMirror;
+    params.verticalMirror = verticalMirror;
+    params.swapRgb = swapRgb;
+    auto flip = FrameTransformPrivate::flipper(format, format, params);
+
+    if (!flip)
+        return false;
+
+    uint8_t *planes[4];
+    size_t strides[4];
+
+    for (size_t plane = 0; plane < format.planes(); plane++) {
+        planes[plane] = frame.line(plane, 0);
+        strides[plane] = format.bypl(plane);
+    }
+
+    // Mirrored vertically the stripes are pairs of lines.
+    int lines = verticalMirror? (format.height() + 1) / 2: format.height();
+    int stripeLines = std::max(2, int(STRIPE_SIZE / format.bypl(0)) & ~1);
+    ThreadPool::globalInstance()->runStripes(lines,
+                                             stripeLines,
+                                             2,
+                                             [&] (int first, int count) {
+        flip(frame,
+             planes,
+             strides,
+             horizontalMirror,
+             verticalMirror,
+             swapRgb,
+             first,
+             count);
+    });
+
+    return true;
+}
+
+void AkVCam::FrameTransformRepeats::reset()
+{
+    this->m_repeats = 0;
+    this->m_kept = false;
+}
+
+bool AkVCam::FrameTransformRepeats::isKept(const VideoFormat &format) const
+{
+    return this->m_kept && this->m_format == format;
+}
+
+bool AkVCam::FrameTransformRepeats::isKept(const VideoFormat &format,
+                                           const FrameTransformParams &params) const
+{
+    return this->isKept(format) && this->m_params == params;
+}
+
+bool AkVCam::FrameTransformRepeats::keep(const VideoFormat &format,
+                                         const FrameTransformParams &params)
+{
+    if (this->m_repeats++ < 1)
+        return false;
+
+    this->m_format = format;
+    this->m_params = params;
+    this->m_kept = true;
+
+    return true;
+}
+
+AkVCam::FrameTransformColorLuts &AkVCam::FrameTransformColorLuts::instance()
+{
+    static FrameTransformColorLuts luts;
+
+    return luts;
+}
+
+AkVCam::FrameTransformCosts &AkVCam::FrameTransformCosts::instance()
+{
+    static FrameTransformCosts costs;
+
+    return costs;
+}
+
+double AkVCam::FrameTransformCosts::cost(FrameTransformKernel kernel)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+
+    return this->m_costs[kernel];
+}
+
+void AkVCam::FrameTransformCosts::setCost(FrameTransformKernel kernel,
+                                          double cost)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    this->m_costs[kernel] = std::max(cost, 0.0);
+}
+
+AkVCam::FrameTransformCacheLocker::FrameTransformCacheLocker(const FrameTransformCachesPtr &caches)
+{
+    if (caches)
+        for (auto &cache: *caches) {
+            bool busy = false;
+
+            if (cache.m_busy.compare_exchange_strong(busy, true)) {
+                this->m_cache = &cache;
+
+                break;
+            }
+        }
+
+    if (!this->m_cache)
+        this->m_cache = &this->m_ownCache;
+
+    // The lines kept from the last frame are not valid anymore.
+    this->m_cache->m_line[0] = -1;
+    this->m_cache->m_line[1] = -1;
+    this->m_cache->m_scaledLine[0] = -1;
+    this->m_cache->m_scaledLine[1] = -1;
+}
+
+AkVCam::FrameTransformCacheLocker::~FrameTransformCacheLocker()
+{
+    if (this->m_cache != &this->m_ownCache)
+        this->m_cache->m_busy = false;
+}
+
+AkVCam::FrameTransformCache &AkVCam::FrameTransformCacheLocker::cache()
+{
+    return *this->m_cache;
+}
+
+bool AkVCam::FrameTransformPrivate::build()
+{
+    this->m_direct = false;
+    this->m_unpack = nullptr;
+    this->m_packComponents = false;
+    this->m_scaler.reset();
+    this->m_linear = false;
+    this->m_xWeights.clear();
+    this->m_xCoeffs.clear();
+    this->m_areaFactor = 0;
+    this->m_components.clear();
+    this->m_colorLut.reset();
+    this->m_adjustYuv = nullptr;
+
+    if (this->m_inputFormat.size() < 1 || this->m_outputFormat.size() < 1)
+        return false;
+
+    /* The frame is rotated before the other stages. A rotation by 180
+     * degrees is a mirror in both axes, if the format can be mirrored.
+     */
+    auto &params = this->m_params;
+    auto fourcc = this->m_inputFormat.fourcc();
+    int rotation = mod(params.rotation / 90, 4) * 90;
+    this->m_flip = flipper(this->m_inputFormat, this->m_outputFormat, params);
+    FrameTransformComponents components;
+    bool mirror180 =
+            rotation == 180
+            && (this->m_flip
+                || VideoConvert::converter(fourcc, PixelFormatRGB24)
+                || (fourcc == this->m_outputFormat.fourcc()
+                    && yuvComponents(fourcc, components)));
+    this->m_sourceFormat = this->m_inputFormat;
+    this->m_rotation = mirror180? 0: rotation;
+    this->m_rotate = nullptr;
+    this->m_horizontalMirror = params.horizontalMirror != mirror180;
+    this->m_verticalMirror = params.verticalMirror != mirror180;
+
+    if (this->m_rotation != 0) {
+        this->m_rotate = rotator(fourcc);
+
+        if (!this->m_rotate)
+            return false;
+
+        if (this->m_rotation != 180) {
+            this->m_sourceFormat.width() = this->m_inputFormat.height();
+            this->m_sourceFormat.height() = this->m_inputFormat.width();
+        }
+    }
+
+    auto inputFourcc = this->m_sourceFormat.fourcc();
+    this->m_convert = VideoConvert::converter(inputFourcc,
+                                              this->m_outputFormat.fourcc());
+
+    if (!this->m_convert)
+        return false;
+
+    // Color adjusts.
+    int gamma = bound(-255, params.gamma, 255);
+    int contrast = bound(-255, params.contrast, 255);
+    this->m_hsl = params.hue != 0
+                  || params.saturation != 0
+                  || params.luminance != 0;
+    this->m_useLut = gamma != 0 || contrast != 0;
+    this->m_adjust = params.swapRgb
+                     || this->m_hsl
+                     || this->m_useLut
+                     || params.gray;
+
+    for (int i = 0; i < 256; i++) {
+        int value = i;
+
+        if (gamma != 0)
+            value = gammaValue(gamma, value);
+
+        if (contrast != 0)
+            value = contrastValue(contrast, value);
+
+        this->m_lut[i] = uint8_t(value);
+    }
+
+    this->m_viewport = this->viewport();
+    this->m_cropped =
+            this->m_viewport.x != 0
+            || this->m_viewport.y != 0
+            || this->m_viewport.width != this->m_sourceFormat.width()
+            || this->m_viewport.height != this->m_sourceFormat.height();
+    bool scale = this->m_sourceFormat.width() != this->m_outputFormat.width()
+                 || this->m_sourceFormat.height() != this->m_outputFormat.height()
+                 || this->m_cropped;
+    bool mirror = this->m_horizontalMirror || this->m_verticalMirror;
+
+    int oWidth = this->m_outputFormat.width();
+    this->m_stripeLineSize = 3 * size_t(oWidth);
+    this->m_stripeLines =
+            std::max(2, int(STRIPE_SIZE / this->m_stripeLineSize) & ~1);
+
+    /* Only mirroring, or swapping the red and blue components, keeping the
+     * layout of the pixels.
+     */
+    if (this->m_flip) {
+        this->m_flipSwapRgb =
+                params.swapRgb != (inputFourcc != this->m_outputFormat.fourcc());
+
+        return true;
+    }
+
+    // Nothing to do apart from converting the format.
+    if (!scale && !mirror && !this->m_adjust) {
+        this->m_direct = true;
+
+        return true;
+    }
+
+    int iWidth = this->m_sourceFormat.width();
+    int iHeight = this->m_sourceFormat.height();
+    int oHeight = this->m_outputFormat.height();
+
+    /* YUV frames that are only scaled, mirrored or adjusted are processed
+     * per component, luma and chroma at their own resolution, instead of
+     * going through RGB. The adjusts are done in the YUV frame after
+     * scaling it. If the output is another YUV format, the stripes are
+     * scaled and adjusted in the input format and then packed to the
+     * output format.
+     */
+    FrameTransformComponents outputComponents;
+
+    if ((!this->m_adjust || !params.swapRgb)
+        && yuvComponents(this->m_outputFormat.fourcc(), outputComponents)
+        && yuvComponents(inputFourcc, this->m_components)) {
+        this->m_packComponents = inputFourcc != this->m_outputFormat.fourcc();
+
+        if (this->m_packComponents)
+            this->m_stripeFormat = VideoFormat(inputFourcc,
+                                               oWidth,
+                                               this->m_stripeLines);
+
+        if (this->m_adjust) {
+            this->m_adjustYuv = yuvAdjuster(inputFourcc);
+            this->yuvAdjusts();
+        }
+
+        int xAlign = 0;
+        int yAlign = 0;
+
+        for (auto &component: this->m_components) {
+            xAlign = std::max(xAlign, component.xShift);
+            yAlign = std::max(yAlign, component.yShift);
+        }
+
+        // Start the viewport at a whole chroma block.
+        auto viewport = this->m_viewport;
+        int xBlock = (1 << xAlign) - 1;
+        int yBlock = (1 << yAlign) - 1;
+        viewport.width += viewport.x & xBlock;
+        viewport.height += viewport.y & yBlock;
+        viewport.x &= ~xBlock;
+        viewport.y &= ~yBlock;
+
+        for (auto &component: this->m_components) {
+            int xDiv = 1 << component.xShift;
+            int yDiv = 1 << component.yShift;
+            component.scaler =
+                    ScalerPlan::plan((iWidth + xDiv - 1) / xDiv,
+                                     (iHeight + yDiv - 1) / yDiv,
+                                     (oWidth + xDiv - 1) / xDiv,
+                                     (oHeight + yDiv - 1) / yDiv,
+                                     params.scaling,
+                                     params.aspectRatio,
+                                     viewport,
+                                     component.xShift,
+                                     component.yShift,
+                                     xAlign,
+                                     yAlign);
+
+            if (mirror)
+                component.scaler =
+                        component.scaler->mirrored(this->m_horizontalMirror,
+                                                   this->m_verticalMirror,
+                                                   false);
+
+            if (component.scaler->linearX)
+                for (auto &sample: component.scaler->xMap)
+                    component.weights.push_back(uint16_t(sample.weight));
+
+            if (component.scaler->filter)
+                component.coeffs = filterCoeffs(*component.scaler, 1);
+        }
+
+        return true;
+    }
+
+    /* The per pixel stages work in RGB24, the other formats are unpacked
+     * line by line as they are read.
+     */
+    if (!canAdjust(inputFourcc)) {
+        this->m_unpack = VideoConvert::converter(inputFourcc,
+                                                 PixelFormatRGB24);
+        this->m_convert = VideoConvert::converter(PixelFormatRGB24,
+                                                  this->m_outputFormat.fourcc());
+
+        if (!this->m_unpack || !this->m_convert)
+            return false;
+    }
+
+    /* The HSL adjusts are too slow to do per pixel, sample all the adjusts
+     * in a 3D table instead, so the cost doesn't depend on how many of them
+     * are enabled.
+     */
+    this->m_colorLut = this->m_hsl? this->colorLut(): nullptr;
+
+    /* Adjusting the colors is the most expensive stage, do it where there
+     * are fewer pixels.
+     */
+    this->m_preScale = oWidth * oHeight
+                       > this->m_viewport.width * this->m_viewport.height;
+    this->m_inPlace = !this->m_unpack
+                      && inputFourcc == this->m_outputFormat.fourcc();
+    this->m_scaler = ScalerPlan::plan(iWidth,
+                                      iHeight,
+                                      oWidth,
+                                      oHeight,
+                                      params.scaling,
+                                      params.aspectRatio,
+                                      this->m_viewport);
+
+    if (mirror)
+        this->m_scaler = this->m_scaler->mirrored(this->m_horizontalMirror,
+                                                  this->m_verticalMirror,
+                                                  this->m_preScale);
+
+    /* Bilinear scaling is done in two passes, the weights of the horizontal
+     * pass are repeated for each component.
+     */
+    for (auto &sample: this->m_scaler->yMap)
+        if (sample.weight != 0)
+            this->m_linear = true;
+
+    this->m_areaFactor = areaFactor(*this->m_scaler);
+
+    if (this->m_scaler->filter)
+        this->m_xCoeffs = filterCoeffs(*this->m_scaler, 3);
+
+    if (this->m_scaler->linearX) {
+        this->m_linear = true;
+        this->m_xWeights.reserve(3 * this->m_scaler->xMap.size());
+
+        for (auto &sample: this->m_scaler->xMap)
+            this->m_xWeights.insert(this->m_xWeights.end(),
+                                    3,
+                                    uint16_t(sample.weight));
+    }
+
+    return true;
+}
+
+void AkVCam::FrameTransformPrivate::reserveCaches(bool rebuild)
+{
+    if (!this->m_valid || this->m_direct || this->m_flip) {
+        this->m_caches.reset();
+
+        return;
+    }
+
+    /* A frame is processed by up to maxThreadCount() threads at once, make
+     * the caches again if the count was raised after building the plan.
+     */
+    auto threads =
+            size_t(std::max(ThreadPool::globalInstance()->maxThreadCount(), 1));
+
+    if (!rebuild && this->m_caches && this->m_caches->size() >= threads)
+        return;
+
+    this->m_caches = std::make_shared<FrameTransformCaches>(threads);
+
+    for (auto &cache: *this->m_caches) {
+        if (this->m_components.empty()) {
+            this->resizeCache(cache);
+
+            continue;
+        }
+
+        for (auto &component: this->m_components)
+            this->resizeComponentCache(component, cache);
+
+        if (this->m_packComponents)
+            cache.m_stripe.resize(this->m_stripeFormat.size());
+
+        // Luma and chroma of a line for the YUV adjusts.
+        if (this->m_adjustYuv)
+            cache.m_yuv.reserve(2 * size_t(this->m_outputFormat.width() + 1));
+    }
+}
+
+AkVCam::Viewport AkVCam::FrameTransformPrivate::viewport() const
+{
+    auto &params = this->m_params;
+    int width = this->m_sourceFormat.width();
+    int height = this->m_sourceFormat.height();
+    auto rect = params.viewport;
+
+    if (rect.width < 1 || rect.height < 1) {
+        rect.x = 0;
+        rect.y = 0;
+        rect.width = width;
+        rect.height = height;
+    } else {
+        rect.x = bound(0, rect.x, width - 1);
+        rect.y = bound(0, rect.y, height - 1);
+        rect.width = bound(1, rect.width, width - rect.x);
+        rect.height = bound(1, rect.height, height - rect.y);
+    }
+
+    // Zoom into the viewport, and move the zoomed area inside it.
+    int zoom = std::max(params.zoom, 0);
+    int pan = bound(-100, params.pan, 100);
+    int tilt = bound(-100, params.tilt, 100);
+    int zoomedWidth = std::max(100 * rect.width / (100 + zoom), 1);
+    int zoomedHeight = std::max(100 * rect.height / (100 + zoom), 1);
+    rect.x += (rect.width - zoomedWidth) * (100 + pan) / 200;
+    rect.y += (rect.height - zoomedHeight) * (100 + tilt) / 200;
+    rect.width = zoomedWidth;
+    rect.height = zoomedHeight;
+
+    /* The viewport is in the coordinates of the rotated frame, when the
+     * rotation by 180 degrees is done by the mirrored scaler, it reads the
+     * viewport from the other side of the frame.
+     */
+    if (this->m_rotation == 0 && mod(params.rotation / 90, 4) == 2) {
+        rect.x = width - rect.x - rect.width;
+        rect.y = height - rect.y - rect.height;
+    }
+
+    return rect;
+}
+
+bool AkVCam::FrameTransformPrivate::processRotated(const VideoFrame &frame,
+                                                  uint8_t *const *planes,
+                                                  const size_t *strides)
+{
+    // Only rotating, write the result straight into the destination.
+    if (this->m_direct
+        && this->m_sourceFormat.fourcc() == this->m_outputFormat.fourcc()) {
+        this->rotate(frame, planes, strides);
+
+        return true;
+    }
+
+    if (this->m_rotated.format() != this->m_sourceFormat)
+        this->m_rotated = VideoFrame(this->m_sourceFormat);
+
+    uint8_t *rotatedPlanes[4];
+    size_t rotatedStrides[4];
+    auto data = this->m_rotated.data().data();
+
+    for (size_t plane = 0; plane < this->m_sourceFormat.planes(); plane++) {
+        rotatedPlanes[plane] = data + this->m_sourceFormat.offset(plane);
+        rotatedStrides[plane] = this->m_sourceFormat.bypl(plane);
+    }
+
+    this->rotate(frame, rotatedPlanes, rotatedStrides);
+    ThreadPool::globalInstance()->runStripes(this->m_outputFormat.height(),
+                                             this->m_stripeLines,
+                                             2,
+                                             [&] (int first, int count) {
+        this->processLines(this->m_rotated, planes, strides, first, count);
+    });
+
+    return true;
+}
+
+void AkVCam::FrameTransformPrivate::rotate(const VideoFrame &frame,
+                                           uint8_t *const *planes,
+                                           const size_t *strides) const
+{
+    ThreadPool::globalInstance()->runStripes(this->m_sourceFormat.height(),
+                                             ROTATE_BLOCK_SIZE,
+                                             2,
+                                             [&] (int first, int count) {
+        this->m_rotate(frame, planes, strides, this->m_rotation, first, count);
+    });
+}
+
+double AkVCam::FrameTransformPrivate::cost() const
+{
+    auto inputFourcc = this->m_sourceFormat.fourcc();
+    auto outputFourcc = this->m_outputFormat.fourcc();
+    double inputPixels = double(this->m_sourceFormat.width())
+                         * this->m_sourceFormat.height();
+    double outputPixels = double(this->m_outputFormat.width())
+                          * this->m_outputFormat.height();
+    double viewportPixels = double(this->m_viewport.width)
+                            * this->m_viewport.height;
+
+    auto &costs = FrameTransformCosts::instance();
+
+    /* Rotating moves every pixel once, it costs about the same as a
+     * nearest neighbour resample.
+     */
+    double cost = this->m_rotation != 0?
+                      costs.cost(FrameTransformKernelResample) * inputPixels:
+                      0.0;
+
+    if (this->m_direct)
+        return cost
+               + VideoConvert::cost(inputFourcc, outputFourcc) * outputPixels;
+
+    if (this->m_flip)
+        return cost + costs.cost(FrameTransformKernelFlip) * outputPixels;
+
+    bool scale = this->m_sourceFormat.width() != this->m_outputFormat.width()
+                 || this->m_sourceFormat.height() != this->m_outputFormat.height()
+                 || this->m_cropped;
+
+    // YUV frames scaled and adjusted natively only need to be repacked.
+    if (!this->m_components.empty()) {
+        auto &scaler = *this->m_components[0].scaler;
+
+        if (this->m_packComponents)
+            cost += VideoConvert::cost(inputFourcc, outputFourcc)
+                    * outputPixels;
+
+        if (this->m_adjustYuv)
+            cost += costs.cost(FrameTransformKernelAdjust) * outputPixels;
+
+        if (scaler.area)
+            return cost
+                   + costs.cost(FrameTransformKernelResampleArea) * inputPixels;
+
+        if (scaler.filter)
+            return cost
+                   + costs.cost(FrameTransformKernelResampleFilter)
+                     * outputPixels
+                     * (scaler.xFilter.taps + scaler.yFilter.taps) / 8;
+
+        return cost
+               + costs.cost(this->m_params.scaling == ScalingLinear?
+                                FrameTransformKernelResampleLinear:
+                                FrameTransformKernelResample)
+                 * outputPixels;
+    }
+
+    if (this->m_scaler && this->m_scaler->area)
+        cost += costs.cost(FrameTransformKernelResampleArea) * inputPixels;
+    else if (this->m_scaler && this->m_scaler->filter)
+        cost += costs.cost(FrameTransformKernelResampleFilter)
+                * outputPixels
+                * (this->m_scaler->xFilter.taps + this->m_scaler->yFilter.taps)
+                / 8;
+    else if (scale
+             || this->m_horizontalMirror
+             || this->m_verticalMirror)
+        cost += costs.cost(scale && this->m_params.scaling == ScalingLinear?
+                               FrameTransformKernelResampleLinear:
+                               FrameTransformKernelResample)
+                * outputPixels;
+
+    if (this->m_adjust)
+        cost += costs.cost(this->m_hsl?
+                               FrameTransformKernelAdjustHsl:
+                               FrameTransformKernelAdjust)
+                * (this->m_preScale? viewportPixels: outputPixels);
+
+    if (this->m_unpack)
+        return cost
+               + VideoConvert::cost(inputFourcc, PixelFormatRGB24) * inputPixels
+               + VideoConvert::cost(PixelFormatRGB24, outputFourcc)
+                 * outputPixels;
+
+    cost += VideoConvert::cost(inputFourcc, outputFourcc) * outputPixels;
+
+    return cost;
+}
+
+double AkVCam::FrameTransformPrivate::measure(const VideoFormat &inputFormat,
+                                              const VideoFormat &outputFormat,
+                                              const FrameTransformParams &params)
+{
+    FrameTransform transform;
+
+    if (!transform.configure(inputFormat, outputFormat, params))
+        return 0.0;
+
+    VideoFrame frame(inputFormat);
+    std::fill(frame.data().begin(), frame.data().end(), 0x80);
+    VideoFrame output(outputFormat);
+    auto data = output.data().data();
+    auto size = output.data().size();
+
+    // Warm up the caches, then keep the fastest run.
+    transform.process(frame, data, size);
+    double best = 0.0;
+
+    for (int i = 0; i < CALIBRATION_RUNS; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        transform.process(frame, data, size);
+        auto t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+        if (i == 0 || ns < best)
+            best = ns;
+    }
+
+    return best / (double(outputFormat.width()) * outputFormat.height());
+}
+
+bool AkVCam::FrameTransformPrivate::canProcess(const VideoFormat &format) const
+{
+    return format.fourcc() == this->m_inputFormat.fourcc()
+           && format.width() == this->m_inputFormat.width()
+           && format.height() == this->m_inputFormat.height();
+}
+
+int AkVCam::FrameTransformPrivate::outputLine(int line) const
+{
+    // Output line at the same height than 'line', rounded to an even line.
+    auto y = int64_t(line)
+             * this->m_outputFormat.height()
+             / this->m_sourceFormat.height();
+
+    return int(y) & ~1;
+}
+
+void AkVCam::FrameTransformPrivate::processLines(const VideoFrame &frame,
+                                                 uint8_t *const *planes,
+                                                 const size_t *strides,
+                                                 int first,
+                                                 int count) const
+{
+    if (this->m_direct)
+        this->convertLines(frame, planes, strides, first, count);
+    else if (this->m_flip)
+        this->m_flip(frame,
+                     planes,
+                     strides,
+                     this->m_horizontalMirror,
+                     this->m_verticalMirror,
+                     this->m_flipSwapRgb,
+                     first,
+                     count);
+    else if (!this->m_components.empty())
+        this->scaleComponents(frame, planes, strides, first, count);
+    else
+        this->transformLines(frame, planes, strides, first, count);
+}
+
+void AkVCam::FrameTransformPrivate::convertLines(const VideoFrame &frame,
+                                                 uint8_t *const *planes,
+                                                 const size_t *strides,
+                                                 int first,
+                                                 int count) const
+{
+    auto inputFourcc = this->m_sourceFormat.fourcc();
+    auto outputFourcc = this->m_outputFormat.fourcc();
+    const uint8_t *srcPlanes[4];
+    size_t srcStrides[4];
+    uint8_t *dstPlanes[4];
+
+    for (size_t plane = 0; plane < this->m_sourceFormat.planes(); plane++) {
+        srcStrides[plane] = this->m_sourceFormat.bypl(plane);
+        srcPlanes[plane] =
+                frame.line(plane, 0)
+                + size_t(VideoConvert::planeHeight(inputFourcc, plane, first))
+                * srcStrides[plane];
+    }
+
+    for (size_t plane = 0; plane < this->m_outputFormat.planes(); plane++)
+        dstPlanes[plane] =
+                planes[plane]
+                + size_t(VideoConvert::planeHeight(outputFourcc, plane, first))
+                * strides[plane];
+
+    this->m_convert(srcPlanes,
+                    srcStrides,
+                    dstPlanes,
+                    strides,
+                    this->m_outputFormat.width(),
+                    count);
+}
+
+void AkVCam::FrameTransformPrivate::resizeCache(FrameTransformCache &cache) const
+{
+    if (this->m_unpack)
+        cache.m_unpacked.resize(3 * size_t(this->m_sourceFormat.width()));
+
+    if (this->m_preScale && this->m_adjust)
+        cache.m_data.resize(2 * 3 * size_t(this->m_sourceFormat.width()));
+
+    if (this->m_scaler && this->m_scaler->area)
+        cache.m_sums.resize(3 * size_t(this->m_sourceFormat.width()));
+
+    if (this->m_scaler && this->m_scaler->filter)
+        resizeFilterCache(*this->m_scaler,
+                          3 * size_t(this->m_outputFormat.width()),
+                          cache);
+
+    if (this->m_linear) {
+        auto lineSize = 3 * size_t(this->m_outputFormat.width());
+        cache.m_scaledData.resize(2 * lineSize);
+
+        if (this->m_scaler->linearX)
+            cache.m_gather.resize(2 * lineSize);
+    }
+
+    if (!this->m_inPlace)
+        cache.m_stripe.resize(size_t(this->m_stripeLines)
+                              * this->m_stripeLineSize);
+}
+
+void AkVCam::FrameTransformPrivate::transformLines(const VideoFrame &frame,
+                                                   uint8_t *const *planes,
+                                                   const size_t *strides,
+                                                   int first,
+                                                   int count) const
+{
+    FrameTransformCacheLocker locker(this->m_caches);
+    auto &cache = locker.cache();
+    this->resizeCache(cache);
+
+    if (this->m_inPlace) {
+        for (int y = first; y < first + count; y++)
+            this->transformLine(frame,
+                                cache,
+                                y,
+                                planes[0] + size_t(y) * strides[0]);
+
+        return;
+    }
+
+    /* Transform a few lines at a time into a buffer that stays in cache and
+     * convert them to the output format.
+     */
+    auto fourcc = this->m_outputFormat.fourcc();
+    auto stripe = cache.m_stripe.data();
+    const uint8_t *stripePlanes[] = {stripe};
+    size_t stripeStrides[] = {this->m_stripeLineSize};
+    uint8_t *dstPlanes[4];
+
+    for (int y = first; y < first + count; y += this->m_stripeLines) {
+        int lines = std::min(this->m_stripeLines, first + count - y);
+
+        for (int i = 0; i < lines; i++)
+            this->transformLine(frame,
+                                cache,
+                                y + i,
+                                stripe + size_t(i) * this->m_stripeLineSize);
+
+        for (size_t plane = 0; plane < this->m_outputFormat.planes(); plane++)
+            dstPlanes[plane] =
+                    planes[plane]
+                    + size_t(VideoConvert::planeHeight(fourcc, plane, y))
+                    * strides[plane];
+
+        this->m_convert(stripePlanes,
+                        stripeStrides,
+                        dstPlanes,
+                        strides,
+                        this->m_outputFormat.width(),
+                        lines);
+    }
+}
+
+void AkVCam::FrameTransformPrivate::scaleComponents(const VideoFrame &frame,
+                                                    uint8_t *const *planes,
+                                                    const size_t *strides,
+                                                    int first,
+                                                    int count) const
+{
+    FrameTransformCacheLocker locker(this->m_caches);
+    auto &cache = locker.cache();
+
+    if (!this->m_packComponents) {
+        this->componentLines(frame, cache, planes, strides, 0, first, count);
+
+        return;
+    }
+
+    /* Scale and adjust a few lines at a time in the input format, into a
+     * buffer that stays in cache, and pack them to the output format.
+     */
+    auto fourcc = this->m_outputFormat.fourcc();
+    auto &stripeFormat = this->m_stripeFormat;
+    cache.m_stripe.resize(stripeFormat.size());
+    uint8_t *stripePlanes[4];
+    size_t stripeStrides[4];
+
+    for (size_t plane = 0; plane < stripeFormat.planes(); plane++) {
+        stripePlanes[plane] = cache.m_stripe.data() + stripeFormat.offset(plane);
+        stripeStrides[plane] = stripeFormat.bypl(plane);
+    }
+
+    const uint8_t *const *srcPlanes = stripePlanes;
+    uint8_t *dstPlanes[4];
+
+    for (int y = first; y < first + count; y += this->m_stripeLines) {
+        int lines = std::min(this->m_stripeLines, first + count - y);
+        this->componentLines(frame,
+                             cache,
+                             stripePlanes,
+                             stripeStrides,
+                             y,
+                             y,
+                             lines);
+
+        for (size_t plane = 0; plane < this->m_outputFormat.planes(); plane++)
+            dstPlanes[plane] =
+                    planes[plane]
+                    + size_t(VideoConvert::planeHeight(fourcc, plane, y))
+                    * strides[plane];
+
+        this->m_convert(srcPlanes,
+                        stripeStrides,
+                        dstPlanes,
+                        strides,
+                        this->m_outputFormat.width(),
+                        lines);
+    }
+}
+
+void AkVCam::FrameTransformPrivate::resizeComponentCache(const FrameTransformComponent &component,
+                                                         FrameTransformCache &cache) const
+{
+    auto &scaler = *component.scaler;
+    auto width = size_t(scaler.outputWidth);
+    cache.m_scaledData.resize(2 * width);
+    cache.m_scaledLine[0] = -1;
+    cache.m_scaledLine[1] = -1;
+    cache.m_output.resize(width);
+
+    if (scaler.linearX)
+        cache.m_gather.resize(2 * width);
+
+    if (scaler.area) {
+        cache.m_data.resize(size_t(scaler.inputWidth));
+        cache.m_sums.resize(size_t(scaler.inputWidth));
+    }
+
+    if (scaler.filter)
+        resizeFilterCache(scaler, width, cache);
+}
+
+void AkVCam::FrameTransformPrivate::componentLines(const VideoFrame &frame,
+                                                   FrameTransformCache &cache,
+                                                   uint8_t *const *planes,
+                                                   const size_t *strides,
+                                                   int origin,
+                                                   int first,
+                                                   int count) const
+{
+    // 'planes' start at the line 'origin' of the output, an even line.
+    for (auto &component: this->m_components) {
+        this->resizeComponentCache(component, cache);
+
+        /* Stripes start at even lines, so each line of the subsampled
+         * components is written by one stripe only.
+         */
+        int firstLine = first >> component.yShift;
+        int lastLine = (first + count + (1 << component.yShift) - 1)
+                       >> component.yShift;
+        int originLine = origin >> component.yShift;
+
+        for (int y = firstLine; y < lastLine; y++)
+            this->componentLine(frame,
+                                component,
+                                cache,
+                                y,
+                                planes[component.plane]
+                                + size_t(y - originLine)
+                                  * strides[component.plane]
+                                + component.offset);
+    }
+
+    if (this->m_adjustYuv && (this->m_useYLut || this->m_useChroma))
+        this->m_adjustYuv(planes,
+                          strides,
+                          this->m_outputFormat.width(),
+                          first - origin,
+                          count,
+                          this->m_useYLut? this->m_yLut: nullptr,
+                          this->m_useChroma? this->m_chroma: nullptr,
+                          cache);
+}
+
+void AkVCam::FrameTransformPrivate::componentLine(const VideoFrame &frame,
+                                                 const FrameTransformComponent &component,
+                                                 FrameTransformCache &cache,
+                                                 int y,
+                                                 uint8_t *dstLine) const
+{
+    auto &scaler = *component.scaler;
+    auto &sampleY = scaler.yMap[size_t(y)];
+    int width = scaler.outputWidth;
+    int step = component.step;
+
+    // Interleaved components are scaled apart and then copied in place.
+    auto line = step == 1? dstLine: cache.m_output.data();
+
+    if (sampleY.min < 0) {
+        memset(line, component.black, size_t(width));
+    } else if (scaler.area) {
+        this->areaComponentLine(frame, component, cache, sampleY, line);
+    } else if (scaler.filter) {
+        auto taps = scaler.yFilter.taps;
+
+        for (int k = 0; k < taps; k++)
+            cache.m_rows[size_t(k)] =
+                    this->filteredComponentLine(frame,
+                                                component,
+                                                cache,
+                                                sampleY.min + k);
+
+        Simd::kernels().filterRows(cache.m_rows.data(),
+                                   scaler.yFilter.coeffs.data()
+                                   + size_t(y) * size_t(taps),
+                                   taps,
+                                   line,
+                                   width);
+    } else if (sampleY.weight == 0) {
+        this->scaleComponentLine(componentSource(frame,
+                                                 component,
+                                                 sampleY.min),
+                                 component,
+                                 cache,
+                                 line);
+    } else {
+        auto scaledLine0 = this->scaledComponentLine(frame,
+                                                     component,
+                                                     cache,
+                                                     sampleY.min,
+                                                     sampleY.max);
+        auto scaledLine1 = this->scaledComponentLine(frame,
+                                                     component,
+                                                     cache,
+                                                     sampleY.max,
+                                                     sampleY.min);
+        Simd::kernels().blendRows(scaledLine0,
+                                  scaledLine1,
+                                  sampleY.weight,
+                                  line,
+                                  width);
+    }
+
+    if (step != 1)
+        for (int x = 0; x < width; x++)
+            dstLine[x * step] = line[x];
+}
+
+const uint8_t *AkVCam::FrameTransformPrivate::scaledComponentLine(const VideoFrame &frame,
+                                                                  const FrameTransformComponent &component,
+                                                                  FrameTransformCache &cache,
+                                                                  int line,
+                                                                  int keep) const
+{
+    auto lineSize = size_t(component.scaler->outputWidth);
+
+    for (int i = 0; i < 2; i++)
+        if (cache.m_scaledLine[i] == line)
+            return cache.m_scaledData.data() + size_t(i) * lineSize;
+
+    int i = cache.m_scaledLine[0] == keep? 1: 0;
+    auto cacheLine = cache.m_scaledData.data() + size_t(i) * lineSize;
+    this->scaleComponentLine(componentSource(frame, component, line),
+                             component,
+                             cache,
+                             cacheLine);
+    cache.m_scaledLine[i] = line;
+
+    return cacheLine;
+}
+
+void AkVCam::FrameTransformPrivate::scaleComponentLine(const uint8_t *srcLine,
+                                                       const FrameTransformComponent &component,
+                                                       FrameTransformCache &cache,
+                                                       uint8_t *dstLine) const
+{
+    auto &xMap = component.scaler->xMap;
+    auto width = xMap.size();
+    int step = component.step;
+
+    if (!component.scaler->linearX) {
+        for (size_t x = 0; x < width; x++) {
+            auto &sampleX = xMap[x];
+            dstLine[x] = sampleX.min < 0?
+                             component.black:
+                             srcLine[sampleX.min * step];
+        }
+
+        return;
+    }
+
+    auto gather0 = cache.m_gather.data();
+    auto gather1 = gather0 + width;
+
+    for (size_t x = 0; x < width; x++) {
+        auto &sampleX = xMap[x];
+
+        if (sampleX.min < 0) {
+            gather0[x] = component.black;
+            gather1[x] = component.black;
+        } else {
+            gather0[x] = srcLine[sampleX.min * step];
+            gather1[x] = srcLine[sampleX.max * step];
+        }
+    }
+
+    Simd::kernels().blendBytes(gather0,
+                               gather1,
+                               component.weights.data(),
+                               dstLine,
+                               int(width));
+}
+
+void AkVCam::FrameTransformPrivate::areaComponentLine(const VideoFrame &frame,
+                                                      const FrameTransformComponent &component,
+                                                      FrameTransformCache &cache,
+                                                      const ScalerSample &sampleY,
+                                                      uint8_t *dstLine) const
+{
+    auto &scaler = *component.scaler;
+    auto sums = cache.m_sums.data();
+    int iWidth = scaler.inputWidth;
+    int step = component.step;
+    memset(sums, 0, size_t(iWidth) * sizeof(uint16_t));
+    auto &kernels = Simd::kernels();
+
+    for (int line = sampleY.min; line <= sampleY.max; line++) {
+        auto srcLine = componentSource(frame, component, line);
+
+        if (step != 1) {
+            auto samples = cache.m_data.data();
+
+            for (int x = 0; x < iWidth; x++)
+                samples[x] = srcLine[x * step];
+
+            srcLine = samples;
+        }
+
+        kernels.accumulateRow(srcLine, sums, iWidth);
+    }
+
+    int lines = sampleY.max - sampleY.min + 1;
+
+    for (size_t x = 0; x < scaler.xMap.size(); x++) {
+        auto &sampleX = scaler.xMap[x];
+
+        if (sampleX.min < 0) {
+            dstLine[x] = component.black;
+
+            continue;
+        }
+
+        int sum = 0;
+
+        for (int i = sampleX.min; i <= sampleX.max; i++)
+            sum += sums[i];
+
+        int count = (sampleX.max - sampleX.min + 1) * lines;
+        dstLine[x] = uint8_t((sum + count / 2) / count);
+    }
+}
+
+const uint8_t *AkVCam::FrameTransformPrivate::inputLine(const VideoFrame &frame,
+                                                        FrameTransformCache &cache,
+                                                        int line) const
+{
+    if (!this->m_unpack)
+        return frame.line(0, size_t(line));
+
+    /* The unpacked line is only valid until the next call, it's always
+     * consumed right away.
+     */
+    auto fourcc = this->m_sourceFormat.fourcc();
+    const uint8_t *srcPlanes[4];
+    size_t srcStrides[4];
+
+    for (size_t plane = 0; plane < this->m_sourceFormat.planes(); plane++) {
+        // Line of the plane with the samples of 'line'.
+        int planeLine = VideoConvert::planeHeight(fourcc, plane, line + 1) - 1;
+        srcPlanes[plane] = frame.line(plane, size_t(planeLine));
+        srcStrides[plane] = this->m_sourceFormat.bypl(plane);
+    }
+
+    uint8_t *dstPlanes[] = {cache.m_unpacked.data()};
+    size_t dstStrides[] = {cache.m_unpacked.size()};
+    this->m_unpack(srcPlanes,
+                   srcStrides,
+                   dstPlanes,
+                   dstStrides,
+                   this->m_sourceFormat.width(),
+                   1);
+
+    return cache.m_unpacked.data();
+}
+
+const uint8_t *AkVCam::FrameTransformPrivate::sourceLine(const VideoFrame &frame,
+                                                         FrameTransformCache &cache,
+                                                         int line,
+                                                         int keep) const
+{
+    if (!this->m_preScale || !this->m_adjust)
+        return this->inputLine(frame, cache, line);
+
+    // Keep the last two adjusted lines, consecutive lines share them.
+    auto lineSize = 3 * size_t(this->m_sourceFormat.width());
+
+    for (int i = 0; i < 2; i++)
+        if (cache.m_line[i] == line)
+            return cache.m_data.data() + size_t(i) * lineSize;
+
+    // Only the pixels in the viewport are read.
+    int i = cache.m_line[0] == keep? 1: 0;
+    auto cacheLine = cache.m_data.data() + size_t(i) * lineSize;
+    auto offset = 3 * size_t(this->m_viewport.x);
+    this->adjustLine(this->inputLine(frame, cache, line) + offset,
+                     cacheLine + offset,
+                     this->m_viewport.width);
+    cache.m_line[i] = line;
+
+    return cacheLine;
+}
+
+const uint8_t *AkVCam::FrameTransformPrivate::scaledLine(const VideoFrame &frame,
+                                                         FrameTransformCache &cache,
+                                                         int line,
+                                                         int keep) const
+{
+    // Keep the last two scaled lines, consecutive lines share them.
+    auto lineSize = 3 * size_t(this->m_outputFormat.width());
+
+    for (int i = 0; i < 2; i++)
+        if (cache.m_scaledLine[i] == line)
+            return cache.m_scaledData.data() + size_t(i) * lineSize;
+
+    int i = cache.m_scaledLine[0] == keep? 1: 0;
+    auto cacheLine = cache.m_scaledData.data() + size_t(i) * lineSize;
+    this->scaleLine(this->sourceLine(frame, cache, line, -1),
+                    cache,
+                    cacheLine);
+    cache.m_scaledLine[i] = line;
+
+    return cacheLine;
+}
+
+void AkVCam::FrameTransformPrivate::scaleLine(const uint8_t *srcLine,
+                                              FrameTransformCache &cache,
+                                              uint8_t *dstLine) const
+{
+    auto &xMap = this->m_scaler->xMap;
+    auto width = xMap.size();
+
+    if (!this->m_scaler->linearX) {
+        for (size_t x = 0; x < width; x++) {
+            auto &sampleX = xMap[x];
+            auto dstPixel = dstLine + 3 * x;
+
+            if (sampleX.min < 0) {
+                dstPixel[0] = 0;
+                dstPixel[1] = 0;
+                dstPixel[2] = 0;
+            } else {
+                auto srcPixel = srcLine + 3 * sampleX.min;
+                dstPixel[0] = srcPixel[0];
+                dstPixel[1] = srcPixel[1];
+                dstPixel[2] = srcPixel[2];
+            }
+        }
+
+        return;
+    }
+
+    // Gather the pixels at both sides of each sample and blend them.
+    auto gather0 = cache.m_gather.data();
+    auto gather1 = gather0 + 3 * width;
+
+    for (size_t x = 0; x < width; x++) {
+        auto &sampleX = xMap[x];
+        auto pixel0 = gather0 + 3 * x;
+        auto pixel1 = gather1 + 3 * x;
+
+        if (sampleX.min < 0) {
+            memset(pixel0, 0, 3);
+            memset(pixel1, 0, 3);
+        } else {
+            auto srcPixel0 = srcLine + 3 * sampleX.min;
+            auto srcPixel1 = srcLine + 3 * sampleX.max;
+            pixel0[0] = srcPixel0[0];
+            pixel0[1] = srcPixel0[1];
+            pixel0[2] = srcPixel0[2];
+            pixel1[0] = srcPixel1[0];
+            pixel1[1] = srcPixel1[1];
+            pixel1[2] = srcPixel1[2];
+        }
+    }
+
+    Simd::kernels().blendBytes(gather0,
+                               gather1,
+                               this->m_xWeights.data(),
+                               dstLine,
+                               int(3 * width));
+}
+
+void AkVCam::FrameTransformPrivate::filterLine(const uint8_t *srcLine,
+                                               int pixelSize,
+                                               int channels,
+                                               uint8_t black,
+                                               const ScalerPlan &scaler,
+                                               const int16_t *coeffs,
+                                               FrameTransformCache &cache,
+                                               int16_t *dstLine) const
+{
+    /* Gather the source pixels of each tap in its own row, so the taps can
+     * be multiplied and added a row at a time.
+     */
+    auto &xMap = scaler.xMap;
+    int taps = scaler.xFilter.taps;
+    auto width = xMap.size() * size_t(channels);
+    auto gather = cache.m_gather.data();
+
+    for (int k = 0; k < taps; k++) {
+        auto row = gather + size_t(k) * width;
+
+        for (size_t x = 0; x < xMap.size(); x++) {
+            auto &sampleX = xMap[x];
+            auto pixel = row + x * size_t(channels);
+
+            if (sampleX.min < 0) {
+                memset(pixel, black, size_t(channels));
+            } else {
+                auto srcPixel = srcLine + (sampleX.min + k) * pixelSize;
+
+                for (int c = 0; c < channels; c++)
+                    pixel[c] = srcPixel[c];
+            }
+        }
+    }
+
+    Simd::kernels().filterBytes(gather, coeffs, taps, dstLine, int(width));
+}
+
+const int16_t *AkVCam::FrameTransformPrivate::filteredLine(const VideoFrame &frame,
+                                                          FrameTransformCache &cache,
+                                                          int line) const
+{
+    auto slot = size_t(line % this->m_scaler->yFilter.taps);
+    auto lineSize = 3 * size_t(this->m_outputFormat.width());
+    auto filtered = cache.m_filtered.data() + slot * lineSize;
+
+    if (cache.m_filteredLine[slot] != line) {
+        this->filterLine(this->sourceLine(frame, cache, line, -1),
+                         3,
+                         3,
+                         0,
+                         *this->m_scaler,
+                         this->m_xCoeffs.data(),
+                         cache,
+                         filtered);
+        cache.m_filteredLine[slot] = line;
+    }
+
+    return filtered;
+}
+
+const int16_t *AkVCam::FrameTransformPrivate::filteredComponentLine(const VideoFrame &frame,
+                                                                   const FrameTransformComponent &component,
+                                                                   FrameTransformCache &cache,
+                                                                   int line) const
+{
+    auto &scaler = *component.scaler;
+    auto slot = size_t(line % scaler.yFilter.taps);
+    auto lineSize = size_t(scaler.outputWidth);
+    auto filtered = cache.m_filtered.data() + slot * lineSize;
+
+    if (cache.m_filteredLine[slot] != line) {
+        this->filterLine(componentSource(frame, component, line),
+                         component.step,
+                         1,
+                         component.black,
+                         scaler,
+                         component.coeffs.data(),
+                         cache,
+                         filtered);
+        cache.m_filteredLine[slot] = line;
+    }
+
+    return filtered;
+}
+
+void AkVCam::FrameTransformPrivate::areaLine(const VideoFrame &frame,
+                                             FrameTransformCache &cache,
+                                             int y,
+                                             uint8_t *dstLine) const
+{
+    auto &scaler = *this->m_scaler;
+    auto &sampleY = scaler.yMap[size_t(y)];
+    auto sums = cache.m_sums.data();
+    auto lineSize = cache.m_sums.size();
+
+    // Add the source lines, then average the columns of each pixel.
+    memset(sums, 0, lineSize * sizeof(uint16_t));
+    auto &kernels = Simd::kernels();
+
+    for (int line = sampleY.min; line <= sampleY.max; line++)
+        kernels.accumulateRow(this->sourceLine(frame, cache, line, -1),
+                              sums,
+                              int(lineSize));
+
+    int width = this->m_outputFormat.width();
+
+    switch (this->m_areaFactor) {
+    case 2:
+        reduceArea<2>(sums, dstLine, width);
+
+        return;
+    case 3:
+        reduceArea<3>(sums, dstLine, width);
+
+        return;
+    case 4:
+        reduceArea<4>(sums, dstLine, width);
+
+        return;
+    default:
+        break;
+    }
+
+    int lines = sampleY.max - sampleY.min + 1;
+
+    for (int x = 0; x < width; x++) {
+        auto &sampleX = scaler.xMap[size_t(x)];
+        auto dstPixel = dstLine + 3 * x;
+
+        if (sampleX.min < 0) {
+            dstPixel[0] = 0;
+            dstPixel[1] = 0;
+            dstPixel[2] = 0;
+
+            continue;
+        }
+
+        int sum[3] {0, 0, 0};
+
+        for (int i = sampleX.min; i <= sampleX.max; i++) {
+            auto column = sums + 3 * i;
+            sum[0] += column[0];
+            sum[1] += column[1];
+            sum[2] += column[2];
+        }
+
+        int count = (sampleX.max - sampleX.min + 1) * lines;
+
+        for (int c = 0; c < 3; c++)
+            dstPixel[c] = uint8_t((sum[c] + count / 2) / count);
+    }
+}
+
+void AkVCam::FrameTransformPrivate::transformLine(const VideoFrame &frame,
+                                                  FrameTransformCache &cache,
+                                                  int y,
+                                                  uint8_t *dstLine) const
+{
+    int width = this->m_outputFormat.width();
+    auto &scaler = *this->m_scaler;
+    auto &sampleY = scaler.yMap[size_t(y)];
+    bool postAdjust = !this->m_preScale && this->m_adjust;
+
+    if (sampleY.min < 0) {
+        memset(dstLine, 0, 3 * size_t(width));
+    } else if (scaler.area) {
+        this->areaLine(frame, cache, y, dstLine);
+    } else if (scaler.filter) {
+        auto taps = scaler.yFilter.taps;
+
+        for (int k = 0; k < taps; k++)
+            cache.m_rows[size_t(k)] = this->filteredLine(frame,
+                                                         cache,
+                                                         sampleY.min + k);
+
+        Simd::kernels().filterRows(cache.m_rows.data(),
+                                   scaler.yFilter.coeffs.data()
+                                   + size_t(y) * size_t(taps),
+                                   taps,
+                                   dstLine,
+                                   3 * width);
+    } else if (!scaler.linearX && sampleY.weight == 0) {
+        auto srcLine = this->sourceLine(frame,
+                                        cache,
+                                        sampleY.min,
+                                        sampleY.max);
+
+        if (scaler.identityX) {
+            srcLine += 3 * scaler.xOffset;
+
+            if (postAdjust)
+                this->adjustLine(srcLine, dstLine, width);
+            else
+                memcpy(dstLine, srcLine, 3 * size_t(width));
+
+            return;
+        }
+
+        this->scaleLine(srcLine, cache, dstLine);
+    } else {
+        // Bilinear, scale the lines horizontally and blend them.
+        auto scaledLine0 = this->scaledLine(frame,
+                                            cache,
+                                            sampleY.min,
+                                            sampleY.max);
+
+        if (sampleY.weight == 0) {
+            memcpy(dstLine, scaledLine0, 3 * size_t(width));
+        } else {
+            auto scaledLine1 = this->scaledLine(frame,
+                                                cache,
+                                                sampleY.max,
+                                                sampleY.min);
+            Simd::kernels().blendRows(scaledLine0,
+                                      scaledLine1,
+                                      sampleY.weight,
+                                      dstLine,
+                                      3 * width);
+        }
+    }
+
+    if (postAdjust)
+        this->adjustLine(dstLine, dstLine, width);
+}
+
+void AkVCam::FrameTransformPrivate::adjustLine(const uint8_t *srcLine,
+                                               uint8_t *dstLine,
+                                               int width) const
+{
+    if (!this->m_colorLut) {
+        this->adjustPixels(srcLine, dstLine, width);
+
+        return;
+    }
+
+    auto &kernels = Simd::kernels();
+
+    if (this->m_params.saturation <= 0) {
+        kernels.lut3d(srcLine,
+                      dstLine,
+                      width,
+                      this->m_colorLut->nodes.data(),
+                      this->m_colorLut->axis,
+                      COLOR_LUT_SIZE);
+
+        return;
+    }
+
+    /* The hue of the grays is undefined, raising the saturation gives them
+     * a color that jumps between neighbour grays, and the table can't
+     * interpolate that. The pixels near the gray axis are adjusted one by
+     * one. The source is kept apart since the line can be adjusted in place.
+     */
+    uint8_t pixels[3 * COLOR_LUT_BLOCK];
+
+    for (int x = 0; x < width; x += COLOR_LUT_BLOCK) {
+        int count = std::min(COLOR_LUT_BLOCK, width - x);
+        auto dstPixels = dstLine + 3 * size_t(x);
+        memcpy(pixels, srcLine + 3 * size_t(x), 3 * size_t(count));
+        kernels.lut3d(pixels,
+                      dstPixels,
+                      count,
+                      this->m_colorLut->nodes.data(),
+                      this->m_colorLut->axis,
+                      COLOR_LUT_SIZE);
+
+        for (int i = 0; i < count; i++) {
+            auto pixel = pixels + 3 * i;
+            int max = std::max(pixel[0], std::max(pixel[1], pixel[2]));
+            int min = std::min(pixel[0], std::min(pixel[1], pixel[2]));
+
+            if (max - min < COLOR_LUT_GRAY_CHROMA)
+                this->adjustPixels(pixel, dstPixels + 3 * i, 1);
+        }
+    }
+}
+
+void AkVCam::FrameTransformPrivate::adjustPixels(const uint8_t *srcLine,
+                                                 uint8_t *dstLine,
+                                                 int width) const
+{
+    auto &params = this->m_params;
+
+    for (int x = 0; x < width; x++) {
+        auto srcPixel = srcLine + 3 * x;
+        auto dstPixel = dstLine + 3 * x;
+        int b = srcPixel[0];
+        int g = srcPixel[1];
+        int r = srcPixel[2];
+
+        if (params.swapRgb)
+            std::swap(r, b);
+
+        if (this->m_hsl) {
+            int h;
+            int s;
+            int l;
+            rgbToHsl(r, g, b, &h, &s, &l);
+
+            h = mod(h + params.hue, 360);
+            s = bound(0, s + params.saturation, 255);
+            l = bound(0, l + params.luminance, 255);
+            hslToRgb(h, s, l, &r, &g, &b);
+        }
+
+        if (this->m_useLut) {
+            r = this->m_lut[r];
+            g = this->m_lut[g];
+            b = this->m_lut[b];
+        }
+
+        if (params.gray) {
+            int luma = grayval(r, g, b);
+
+            r = luma;
+            g = luma;
+            b = luma;
+        }
+
+        dstPixel[0] = uint8_t(b);
+        dstPixel[1] = uint8_t(g);
+        dstPixel[2] = uint8_t(r);
+    }
+}
+
+AkVCam::FrameTransformColorLutPtr AkVCam::FrameTransformPrivate::colorLut() const
+{
+    auto &luts = FrameTransformColorLuts::instance();
+    auto &params = this->m_params;
+    auto sameAdjusts = [&params] (const FrameTransformParams &other) {
+        return other.swapRgb == params.swapRgb
+               && other.hue == params.hue
+               && other.saturation == params.saturation
+               && other.luminance == params.luminance
+               && other.gamma == params.gamma
+               && other.contrast == params.contrast
+               && other.gray == params.gray;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(luts.m_mutex);
+
+        for (auto it = luts.m_luts.begin(); it != luts.m_luts.end(); it++)
+            if (sameAdjusts((*it)->params)) {
+                luts.m_luts.splice(luts.m_luts.begin(), luts.m_luts, it);
+
+                return luts.m_luts.front();
+            }
+    }
+
+    auto lut = std::make_shared<FrameTransformColorLut>();
+    lut->params = params;
+
+    // Node below each value, and the distance to it.
+    for (int i = 0; i < 256; i++) {
+        int position = (i * (COLOR_LUT_SIZE - 1) * 256 + 127) / 255;
+        int node = std::min(position >> 8, COLOR_LUT_SIZE - 2);
+        uint32_t distance = uint32_t(position - (node << 8));
+        int stride = 1;
+
+        for (int c = 0; c < 3; c++) {
+            lut->axis[256 * c + i] = uint32_t(node * stride) << SIMD_LUT3D_SHIFT
+                                     | distance;
+            stride *= COLOR_LUT_SIZE;
+        }
+    }
+
+    // Adjust the color of each node as a line of pixels.
+    uint8_t values[COLOR_LUT_SIZE];
+
+    for (int i = 0; i < COLOR_LUT_SIZE; i++)
+        values[i] = uint8_t((255 * i + (COLOR_LUT_SIZE - 1) / 2)
+                            / (COLOR_LUT_SIZE - 1));
+
+    const int nodes = COLOR_LUT_SIZE * COLOR_LUT_SIZE * COLOR_LUT_SIZE;
+    std::vector<uint8_t> colors(3 * size_t(nodes));
+    auto color = colors.data();
+
+    for (int c2 = 0; c2 < COLOR_LUT_SIZE; c2++)
+        for (int c1 = 0; c1 < COLOR_LUT_SIZE; c1++)
+            for (int c0 = 0; c0 < COLOR_LUT_SIZE; c0++) {
+                color[0] = values[c0];
+                color[1] = values[c1];
+                color[2] = values[c2];
+                color += 3;
+            }
+
+    this->adjustPixels(colors.data(), colors.data(), nodes);
+    lut->nodes.resize(size_t(nodes));
+
+    for (int i = 0; i < nodes; i++) {
+        auto pixel = colors.data() + 3 * i;
+        lut->nodes[size_t(i)] = uint32_t(pixel[0])
+                                | uint32_t(pixel[1]) << 8
+                                | uint32_t(pixel[2]) << 16;
+    }
+
+    std::lock_guard<std::mutex> lock(luts.m_mutex);
+    luts.m_luts.push_front(lut);
+
+    if (luts.m_luts.size() > COLOR_LUT_CACHE_SIZE)
+        luts.m_luts.pop_back();
+
+    return lut;
+}
+
+void AkVCam::FrameTransformPrivate::yuvAdjusts()
+{
+    static const double pi = 3.14159265358979323846;
+    auto &params = this->m_params;
+
+    /* The luminance, gamma and contrast are applied to the luma, expanded
+     * from studio range to the full [0, 255] range, as in a gray pixel.
+     */
+    this->m_useYLut = params.luminance != 0 || this->m_useLut;
+
+    for (int i = 0; i < 256; i++) {
+        int value = ((bound(16, i, 235) - 16) * 255 + 109) / 219;
+        value = this->m_lut[bound(0, value + params.luminance, 255)];
+        this->m_yLut[i] = uint8_t((value * 219 + 127) / 255 + 16);
+    }
+
+    /* The hue rotates the (U, V) vector and the saturation scales it, the
+     * grayscale removes it. The contrast is linear around 128, so it scales
+     * the chroma as much as it scales the luma.
+     */
+    int hue = mod(params.hue, 360);
+    int contrast = bound(-255, params.contrast, 255);
+    this->m_useChroma = hue != 0
+                        || params.saturation != 0
+                        || contrast != 0
+                        || params.gray;
+    double gain = params.gray?
+                      0.0:
+                      bound(0, 255 + params.saturation, 510) / 255.0;
+
+    if (contrast != 0)
+        gain *= 259. * (255 + contrast) / (255. * (259 - contrast));
+    double angle = pi * hue / 180.0;
+    double one = 1 << SIMD_CHROMA_SHIFT;
+    auto c = int16_t(std::lround(one * gain * std::cos(angle)));
+    auto s = int16_t(std::lround(one * gain * std::sin(angle)));
+    this->m_chroma[0] = c;
+    this->m_chroma[1] = int16_t(-s);
+    this->m_chroma[2] = s;
+    this->m_chroma[3] = c;
+}
+
+bool AkVCam::FrameTransformPrivate::canAdjust(FourCC fourcc)
+{
+    return fourcc == PixelFormatRGB24 || fourcc == PixelFormatBGR24;
+}
+
+std::vector<int16_t> AkVCam::FrameTransformPrivate::filterCoeffs(const ScalerPlan &plan,
+                                                                 int channels)
+{
+    /* Lay out the coefficients of the horizontal pass as the rows gathered
+     * by filterLine(), one row per tap, repeated for each channel.
+     */
+    auto &filter = plan.xFilter;
+    auto taps = size_t(filter.taps);
+    auto width = plan.xMap.size();
+    std::vector<int16_t> coeffs(taps * width * size_t(channels));
+
+    for (size_t k = 0; k < taps; k++)
+        for (size_t x = 0; x < width; x++)
+            for (int c = 0; c < channels; c++)
+                coeffs[(k * width + x) * size_t(channels) + size_t(c)] =
+                        filter.coeffs[x * taps + k];
+
+    return coeffs;
+}
+
+void AkVCam::FrameTransformPrivate::resizeFilterCache(const ScalerPlan &plan,
+                                                      size_t lineSize,
+                                                      FrameTransformCache &cache)
+{
+    auto taps = size_t(plan.yFilter.taps);
+    cache.m_filtered.resize(taps * lineSize);
+    cache.m_filteredLine.assign(taps, -1);
+    cache.m_rows.resize(taps);
+    cache.m_gather.resize(size_t(plan.xFilter.taps) * lineSize);
+}
+
+bool AkVCam::FrameTransformPrivate::yuvComponents(FourCC fourcc,
+                                                 FrameTransformComponents &components)
+{
+    switch (fourcc) {
+    case PixelFormatUYVY:
+        return FrameTransformLayout<PixelFormatUYVY>::components(components);
+    case PixelFormatYUY2:
+        return FrameTransformLayout<PixelFormatYUY2>::components(components);
+    case PixelFormatNV12:
+        return FrameTransformLayout<PixelFormatNV12>::components(components);
+    case PixelFormatNV21:
+        return FrameTransformLayout<PixelFormatNV21>::components(components);
+    case PixelFormatI420:
+        return FrameTransformLayout<PixelFormatI420>::components(components);
+    case PixelFormatYV12:
+        return FrameTransformLayout<PixelFormatYV12>::components(components);
+    default:
+        break;
+    }
+
+    return false;
+}
+
+AkVCam::FrameTransformAdjustFunc AkVCam::FrameTransformPrivate::yuvAdjuster(FourCC fourcc)
+{
+    switch (fourcc) {
+    case PixelFormatUYVY:
+        return &FrameTransformLayout<PixelFormatUYVY>::adjust;
+    case PixelFormatYUY2:
+        return &FrameTransformLayout<PixelFormatYUY2>::adjust;
+    case PixelFormatNV12:
+        return &FrameTransformLayout<PixelFormatNV12>::adjust;
+    case PixelFormatNV21:
+        return &FrameTransformLayout<PixelFormatNV21>::adjust;
+    case PixelFormatI420:
+        return &FrameTransformLayout<PixelFormatI420>::adjust;
+    case PixelFormatYV12:
+        return &FrameTransformLayout<PixelFormatYV12>::adjust;
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+AkVCam::FrameTransformFlipFunc AkVCam::FrameTransformPrivate::flipper(const VideoFormat &inputFormat,
+                                                                      const VideoFormat &outputFormat,
+                                                                      const FrameTransformParams &params)
+{
+    /* The RGB and BGR formats with the same layout are the same pixels with
+     * the red and blue components swapped.
+     */
+    static const std::map<FourCC, FourCC> swappedFormats {
+        {PixelFormatRGB24, PixelFormatBGR24},
+        {PixelFormatRGB16, PixelFormatBGR16},
+        {PixelFormatRGB15, PixelFormatBGR15},
+        {PixelFormatBGR24, PixelFormatRGB24},
+        {PixelFormatBGR16, PixelFormatRGB16},
+        {PixelFormatBGR15, PixelFormatRGB15},
+    };
+
+    auto fourcc = inputFormat.fourcc();
+    int width = inputFormat.width();
+    int height = inputFormat.height();
+    auto it = swappedFormats.find(fourcc);
+    bool swapped = it != swappedFormats.end()
+                   && it->second == outputFormat.fourcc();
+
+    if ((fourcc != outputFormat.fourcc() && !swapped)
+        || width != outputFormat.width()
+        || height != outputFormat.height())
+        return nullptr;
+
+    // Nothing but mirrors, rotations by 180 degrees and swaps.
+    auto &viewport = params.viewport;
+    bool cropped = viewport.width > 0
+                   && viewport.height > 0
+                   && (viewport.x > 0
+                       || viewport.y > 0
+                       || viewport.width < width
+                       || viewport.height < height);
+    int rotation = mod(params.rotation / 90, 4);
+
+    if (rotation == 1
+        || rotation == 3
+        || cropped
+        || params.zoom > 0
+        || params.hue != 0
+        || params.saturation != 0
+        || params.luminance != 0
+        || params.gamma != 0
+        || params.contrast != 0
+        || params.gray)
+        return nullptr;
+
+    bool swapRgb = params.swapRgb != swapped;
+    bool mirror180 = rotation == 2;
+
+    // Leave the copies to VideoConvert.
+    if (params.horizontalMirror == mirror180
+        && params.verticalMirror == mirror180
+        && !swapRgb)
+        return nullptr;
+
+    switch (fourcc) {
+    case PixelFormatRGB32:
+        return &FrameTransformLayout<PixelFormatRGB32>::flip;
+    case PixelFormatRGB24:
+        return &FrameTransformLayout<PixelFormatRGB24>::flip;
+    case PixelFormatRGB16:
+        return &FrameTransformLayout<PixelFormatRGB16>::flip;
+    case PixelFormatRGB15:
+        return &FrameTransformLayout<PixelFormatRGB15>::flip;
+    case PixelFormatBGR32:
+        return &FrameTransformLayout<PixelFormatBGR32>::flip;
+    case PixelFormatBGR24:
+        return &FrameTransformLayout<PixelFormatBGR24>::flip;
+    case PixelFormatBGR16:
+        return &FrameTransformLayout<PixelFormatBGR16>::flip;
+    case PixelFormatBGR15:
+        return &FrameTransformLayout<PixelFormatBGR15>::flip;
+    default:
+        break;
+    }
+
+    /* YUV frames have no RGB components to swap, and are mirrored in whole
+     * chroma blocks.
+     */
+    if (swapRgb || (width & 1) || (height & 1))
+        return nullptr;
+
+    switch (fourcc) {
+    case PixelFormatUYVY:
+        return &FrameTransformLayout<PixelFormatUYVY>::flip;
+    case PixelFormatYUY2:
+        return &FrameTransformLayout<PixelFormatYUY2>::flip;
+    case PixelFormatNV12:
+        return &FrameTransformLayout<PixelFormatNV12>::flip;
+    case PixelFormatNV21:
+        return &FrameTransformLayout<PixelFormatNV21>::flip;
+    case PixelFormatI420:
+        return &FrameTransformLayout<PixelFormatI420>::flip;
+    case PixelFormatYV12:
+        return &FrameTransformLayout<PixelFormatYV12>::flip;
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+AkVCam::FrameTransformRotateFunc AkVCam::FrameTransformPrivate::rotator(FourCC fourcc)
+{
+    switch (fourcc) {
+    case PixelFormatRGB32:
+        return &FrameTransformLayout<PixelFormatRGB32>::rotate;
+    case PixelFormatRGB24:
+        return &FrameTransformLayout<PixelFormatRGB24>::rotate;
+    case PixelFormatRGB16:
+        return &FrameTransformLayout<PixelFormatRGB16>::rotate;
+    case PixelFormatRGB15:
+        return &FrameTransformLayout<PixelFormatRGB15>::rotate;
+    case PixelFormatBGR32:
+        return &FrameTransformLayout<PixelFormatBGR32>::rotate;
+    case PixelFormatBGR24:
+        return &FrameTransformLayout<PixelFormatBGR24>::rotate;
+    case PixelFormatBGR16:
+        return &FrameTransformLayout<PixelFormatBGR16>::rotate;
+    case PixelFormatBGR15:
+        return &FrameTransformLayout<PixelFormatBGR15>::rotate;
+    case PixelFormatUYVY:
+        return &FrameTransformLayout<PixelFormatUYVY>::rotate;
+    case PixelFormatYUY2:
+        return &FrameTransformLayout<PixelFormatYUY2>::rotate;
+    case PixelFormatNV12:
+        return &FrameTransformLayout<PixelFormatNV12>::rotate;
+    case PixelFormatNV21:
+        return &FrameTransformLayout<PixelFormatNV21>::rotate;
+    case PixelFormatI420:
+        return &FrameTransformLayout<PixelFormatI420>::rotate;
+    case PixelFormatYV12:
+        return &FrameTransformLayout<PixelFormatYV12>::rotate;
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+const uint8_t *AkVCam::FrameTransformPrivate::componentSource(const VideoFrame &frame,
+                                                              const FrameTransformComponent &component,
+                                                              int line)
+{
+    return frame.line(component.plane, size_t(line)) + component.offset;
+}
+
+int AkVCam::FrameTransformPrivate::areaFactor(const ScalerPlan &plan)
+{
+    if (!plan.area || plan.xMap.empty() || plan.yMap.empty())
+        return 0;
+
+    // Every pixel must average a K x K block, in order.
+    int factor = plan.xMap[0].max - plan.xMap[0].min + 1;
+
+    if (factor < 2 || factor > 4)
+        return 0;
+
+    for (auto map: {&plan.xMap, &plan.yMap}) {
+        int min = (*map)[0].min;
+
+        for (size_t i = 0; i < map->size(); i++) {
+            auto &sample = (*map)[i];
+
+            if (sample.min != min + factor * int(i)
+                || sample.max != sample.min + factor - 1)
+                return 0;
+        }
+    }
+
+    return factor;
+}
+
+int AkVCam::FrameTransformPrivate::grayval(int r, int g, int b)
+{
+    return (11 * r + 16 * g + 5 * b) >> 5;
+}
+
+// https://en.wikipedia.org/wiki/HSL_and_HSV
+void AkVCam::FrameTransformPrivate::rgbToHsl(int r, int g, int b,
+                                             int *h, int *s, int *l)
+{
+    int max = std::max(r, std::max(g, b));
+    int min = std::min(r, std::min(g, b));
+    int c = max - min;
+
+    *l = (max + min) / 2;
+
+    if (!c) {
+        *h = 0;
+        *s = 0;
+    } else {
+        if (max == r)
+            *h = mod(g - b, 6 * c);
+        else if (max == g)
+            *h = b - r + 2 * c;
+        else
+            *h = r - g + 4 * c;
+
+        *h = 60 * (*h) / c;
+        *s = 255 * c / (255 - abs(max + min - 255));
+    }
+}
+
+void AkVCam::FrameTransformPrivate::hslToRgb(int h, int s, int l,
+                                             int *r, int *g, int *b)
+{
+    int c = s * (255 - abs(2 * l - 255)) / 255;
+    int x = c * (60 - abs((h % 120) - 60)) / 60;
+
+    if (h >= 0 && h < 60) {
+        *r = c;
+        *g = x;
+        *b = 0;
+    } else if (h >= 60 && h < 120) {
+        *r = x;
+        *g = c;
+        *b = 0;
+    } else if (h >= 120 && h < 180) {
+        *r = 0;
+        *g = c;
+        *b = x;
+    } else if (h >= 180 && h < 240) {
+        *r = 0;
+        *g = x;
+        *b = c;
+    } else if (h >= 240 && h < 300) {
+        *r = x;
+        *g = 0;
+        *b = c;
+    } else if (h >= 300 && h < 360) {
+        *r = c;
+        *g = 0;
+        *b = x;
+    } else {
+        *r = 0;
+        *g = 0;
+        *b = 0;
+    }
+
+    int m = 2 * l - c;
+
+    *r = (2 * (*r) + m) / 2;
+    *g = (2 * (*g) + m) / 2;
+    *b = (2 * (*b) + m) / 2;
+}
+
+uint8_t AkVCam::FrameTransformPrivate::gammaValue(int gamma, int value)
+{
+    double k = gamma > -255? 255. / (gamma + 255): 255;
+
+    return uint8_t(255. * pow(value / 255., k));
+}
+
+uint8_t AkVCam::FrameTransformPrivate::contrastValue(int contrast, int value)
+{
+    double f = 259. * (255 + contrast) / (255. * (259 - contrast));
+    int ic = int(f * (value - 128) + 128.);
+
+    return uint8_t(bound(0, ic, 255));
+}
@@ -0,0 +1,225 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_FRAMETRANSFORM_H
+#define AKVCAMUTILS_FRAMETRANSFORM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "videoformat.h"
+#include "videoframetypes.h"
+
+namespace AkVCam
+{
+    class FrameTransformPrivate;
+    class VideoFrame;
+
+    struct FrameTransformParams
+    {
+        bool horizontalMirror {false};
+        bool verticalMirror {false};
+
+        /* Rotate the input frame clockwise by 90, 180 or 270 degrees, before
+         * the other stages, the viewport is in the rotated frame.
+         */
+        int rotation {0};
+        bool swapRgb {false};
+        Scaling scaling {ScalingFast};
+        AspectRatio aspectRatio {AspectRatioIgnore};
+
+        /* Part of the input frame that is scaled to the output. 'zoom'
+         * magnifies it by (100 + zoom) / 100, 'pan' and 'tilt' move the
+         * zoomed area from one side (-100) to the other (100).
+         */
+        Viewport viewport;
+        int zoom {0};
+        int pan {0};
+        int tilt {0};
+        int hue {0};
+        int saturation {0};
+        int luminance {0};
+        int gamma {0};
+        int contrast {0};
+        bool gray {false};
+
+        bool operator ==(const FrameTransformParams &other) const;
+        bool operator !=(const FrameTransformParams &other) const;
+    };
+
+    /* Rotate, mirror, crop, swap the RGB components, adjust the colors,
+     * scale and convert a frame in a single pass.
+     *
+     * The frame is processed in horizontal stripes small enough to stay in
+     * cache, each stripe goes through all the stages before being written to
+     * the destination. Big frames are split between the threads of
+     * ThreadPool::globalInstance().
+     *
+     * Rotations by 90 or 270 degrees are done first, into an intermediate
+     * frame, with blocked transposes. A rotation by 180 degrees is a mirror
+     * in both axes.
+     *
+     * Frames that are only mirrored, or get their red and blue components
+     * swapped, are flipped line by line by SIMD kernels for each layout, in
+     * place if needed.
+     *
+     * Cropping and zooming only change the source pixels read by the scaler,
+     * the frame is never copied.
+     *
+     * YUV frames going to a YUV format are scaled per component, luma and
+     * chroma at their own resolution, without going through RGB. The color
+     * adjusts are then a table for the luma and a 2x2 matrix for the chroma.
+     * If the output format is another one, the stripes are packed to it at
+     * the end. Swapping the RGB components needs the RGB path.
+     *
+     * Any other frame is unpacked to RGB24 as its lines are read, adjusted
+     * and scaled, and packed to the output format. The color adjusts are done
+     * before scaling if the frame gets bigger, and after if it gets smaller.
+     *
+     * The hue, saturation and luminance adjusts are sampled, together with
+     * the other color adjusts, in a 3D table that is interpolated for each
+     * pixel, and shared by all the transforms with the same adjusts. The
+     * pixels near the gray axis are adjusted exactly when raising the
+     * saturation, the rest stay within 13 levels of the exact adjusts for
+     * saturations up to +100, and 1 or 2 levels on average.
+     *
+     * The conversions, mirroring, swapping the RGB components, fast scaling,
+     * gamma, contrast and grayscale give the same bytes as doing each stage
+     * apart on RGB frames. The other stages are approximations: linear
+     * scaling is within 2 levels of scaling in its own pass, and the HSL
+     * adjusts within the bounds above. YUV frames going to a YUV format are
+     * adjusted and scaled in YUV, so they are close to, but not the same
+     * as, unpacking them to RGB, adjusting, scaling and packing them again.
+     *
+     * A plan is built in configure() and reused until the formats or the
+     * parameters change. The intermediate lines of each thread are allocated
+     * with the plan, so processing frames into a given buffer doesn't
+     * allocate anything.
+     */
+    class FrameTransform
+    {
+        public:
+            FrameTransform();
+            FrameTransform(const FrameTransform &other);
+            FrameTransform &operator =(const FrameTransform &other);
+            ~FrameTransform();
+
+            /* Build the plan for transforming frames of 'inputFormat' into
+             * 'outputFormat'. Returns false if the transform is not supported.
+             */
+            bool configure(const VideoFormat &inputFormat,
+                           const VideoFormat &outputFormat,
+                           const FrameTransformParams &params={});
+            bool isValid() const;
+            VideoFormat inputFormat() const;
+            VideoFormat outputFormat() const;
+            FrameTransformParams params() const;
+
+            // Transform 'frame' into the given destination planes.
+            bool process(const VideoFrame &frame,
+                         uint8_t *const *planes,
+                         const size_t *strides);
+
+            // Transform 'frame' into a contiguous buffer.
+            bool process(const VideoFrame &frame, uint8_t *data, size_t size);
+
+            // Transform 'frame' into a new frame.
+            VideoFrame process(const VideoFrame &frame);
+
+            /* Run several transforms of the same frame in a single pass. The
+             * frame is walked in stripes and each stripe is sent to all the
+             * outputs before moving to the next one, so every source line is
+             * read from memory only once. 'planes' and 'strides' have the
+             * destination of each transform. Returns false, without writing
+             * anything, if any of the transforms can't process 'frame'.
+             */
+            static bool process(const VideoFrame &frame,
+                                const std::vector<FrameTransform *> &transforms,
+                                const std::vector<uint8_t *const *> &planes,
+                                const std::vector<const size_t *> &strides);
+
+            /* Mirror and swap the red and blue components of 'frame' in
+             * place, without allocating anything. Returns false if the format
+             * of 'frame' can't be flipped.
+             */
+            static bool flip(VideoFrame &frame,
+                             bool horizontalMirror,
+                             bool verticalMirror,
+                             bool swapRgb=false);
+
+            /* Estimated time in nanoseconds for transforming a frame of
+             * 'inputFormat' into 'outputFormat', or a negative value if the
+             * transform is not supported.
+             */
+            static double cost(const VideoFormat &inputFormat,
+                               const VideoFormat &outputFormat,
+                               const FrameTransformParams &params={});
+
+            /* Choose the format in 'formats' that is the cheapest to produce
+             * from frames of 'inputFormat', the first one wins on ties. If
+             * 'inputFormat' has no size, the frames are assumed to have the
+             * size of each candidate format.
+             */
+            static VideoFormat negotiate(const VideoFormat &inputFormat,
+                                         const std::vector<VideoFormat> &formats,
+                                         const FrameTransformParams &params={});
+
+            /* Measure the kernels in this host and use the measured times
+             * as costs. It takes a while, don't call it from a thread that
+             * is streaming.
+             */
+            static void calibrate();
+
+        private:
+            FrameTransformPrivate *d;
+    };
+
+    /* Tells when the output of transforming the same frame again is worth
+     * keeping. Static content is sent again and again, so once a frame was
+     * transformed twice into the same format with the same parameters, the
+     * output is kept and sent until the frame changes. Moving video never
+     * gets there, so it doesn't pay for keeping a copy.
+     */
+    class FrameTransformRepeats
+    {
+        public:
+            // The frame changed, the kept output is no longer valid.
+            void reset();
+
+            // Whether the output kept is for 'format', and for 'params'.
+            bool isKept(const VideoFormat &format) const;
+            bool isKept(const VideoFormat &format,
+                        const FrameTransformParams &params) const;
+
+            /* Count a transform of the frame into 'format' with 'params',
+             * returns true if its output must be kept.
+             */
+            bool keep(const VideoFormat &format,
+                      const FrameTransformParams &params);
+
+        private:
+            VideoFormat m_format;
+            FrameTransformParams m_params;
+            int m_repeats {0};
+            bool m_kept {false};
+    };
+}
+
+#endif // AKVCAMUTILS_FRAMETRANSFORM_H
@@ -0,0 +1,165 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_PIXELTRAITS_H
+#define AKVCAMUTILS_PIXELTRAITS_H
+
+#include <cstddef>
+
+#include "videoformattypes.h"
+
+/* Memory layout of each pixel format.
+ *
+ * RGB formats are described by the position and size of each component
+ * inside the little-endian pixel word, padding bits (x) are set to 1 when
+ * writing. Packed 4:2:2 formats are described by the byte offset of each
+ * component inside the 4 bytes macropixel. 4:2:0 formats are described by
+ * the plane and the byte offset of the first U and V samples, and by the
+ * distance in bytes between consecutive samples of the same component.
+ */
+
+namespace AkVCam
+{
+    enum PixelLayout
+    {
+        PixelLayoutRGB,
+        PixelLayoutPacked422,
+        PixelLayoutYuv420
+    };
+
+    template<size_t Bytes,
+             int RShift, int RBits,
+             int GShift, int GBits,
+             int BShift, int BBits,
+             int XShift=0, int XBits=0>
+    struct RgbTraits
+    {
+        static constexpr PixelLayout layout = PixelLayoutRGB;
+        static constexpr size_t planes = 1;
+        static constexpr size_t bytes = Bytes;
+        static constexpr int rShift = RShift;
+        static constexpr int rBits = RBits;
+        static constexpr int gShift = GShift;
+        static constexpr int gBits = GBits;
+        static constexpr int bShift = BShift;
+        static constexpr int bBits = BBits;
+        static constexpr int xShift = XShift;
+        static constexpr int xBits = XBits;
+
+        static constexpr size_t lineSize(size_t, int width)
+        {
+            return Bytes * size_t(width);
+        }
+
+        static constexpr int planeHeight(size_t, int height)
+        {
+            return height;
+        }
+    };
+
+    template<int Y0, int Y1, int U, int V>
+    struct Packed422Traits
+    {
+        static constexpr PixelLayout layout = PixelLayoutPacked422;
+        static constexpr size_t planes = 1;
+        static constexpr int y0 = Y0;
+        static constexpr int y1 = Y1;
+        static constexpr int u = U;
+        static constexpr int v = V;
+
+        static constexpr size_t lineSize(size_t, int width)
+        {
+            return 4 * size_t((width + 1) / 2);
+        }
+
+        static constexpr int planeHeight(size_t, int height)
+        {
+            return height;
+        }
+    };
+
+    template<size_t Planes,
+             size_t UPlane, int UOffset,
+             size_t VPlane, int VOffset,
+             int Step>
+    struct Yuv420Traits
+    {
+        static constexpr PixelLayout layout = PixelLayoutYuv420;
+        static constexpr size_t planes = Planes;
+        static constexpr size_t uPlane = UPlane;
+        static constexpr int uOffset = UOffset;
+        static constexpr size_t vPlane = VPlane;
+        static constexpr int vOffset = VOffset;
+        static constexpr int step = Step;
+
+        static constexpr size_t lineSize(size_t plane, int width)
+        {
+            return plane < 1? size_t(width): size_t(Step * ((width + 1) / 2));
+        }
+
+        static constexpr int planeHeight(size_t plane, int height)
+        {
+            return plane < 1? height: (height + 1) / 2;
+        }
+    };
+
+    // Chroma interleaved in the second plane.
+    template<int U, int V>
+    struct SemiPlanar420Traits: Yuv420Traits<2, 1, U, 1, V, 2>
+    {
+    };
+
+    // Each chroma component in its own plane.
+    template<size_t UPlane, size_t VPlane>
+    struct Planar420Traits: Yuv420Traits<3, UPlane, 0, VPlane, 0, 1>
+    {
+    };
+
+    template<PixelFormat F>
+    struct PixelTraits;
+
+    // RGB formats
+    template<> struct PixelTraits<PixelFormatRGB32>: RgbTraits<4, 24, 8, 16, 8,  8, 8,  0, 8> {};
+    template<> struct PixelTraits<PixelFormatRGB24>: RgbTraits<3, 16, 8,  8, 8,  0, 8> {};
+    template<> struct PixelTraits<PixelFormatRGB16>: RgbTraits<2, 11, 5,  5, 6,  0, 5> {};
+    template<> struct PixelTraits<PixelFormatRGB15>: RgbTraits<2, 10, 5,  5, 5,  0, 5, 15, 1> {};
+
+    // BGR formats
+    template<> struct PixelTraits<PixelFormatBGR32>: RgbTraits<4,  0, 8,  8, 8, 16, 8, 24, 8> {};
+    template<> struct PixelTraits<PixelFormatBGR24>: RgbTraits<3,  0, 8,  8, 8, 16, 8> {};
+    template<> struct PixelTraits<PixelFormatBGR16>: RgbTraits<2,  0, 5,  5, 6, 11, 5> {};
+    template<> struct PixelTraits<PixelFormatBGR15>: RgbTraits<2,  0, 5,  5, 5, 10, 5, 15, 1> {};
+
+    // Luminance+Chrominance formats
+    template<> struct PixelTraits<PixelFormatUYVY>: Packed422Traits<1, 3, 2, 0> {};
+    template<> struct PixelTraits<PixelFormatYUY2>: Packed422Traits<0, 2, 3, 1> {};
+
+    // two planes -- one Y, one Cr + Cb interleaved
+    template<> struct PixelTraits<PixelFormatNV12>: SemiPlanar420Traits<1, 0> {};
+    template<> struct PixelTraits<PixelFormatNV21>: SemiPlanar420Traits<0, 1> {};
+
+    /* three planes -- one Y, one for each chroma component, the chroma
+     * planes are in the same order as the chroma pair of the semi-planar
+     * formats, I420 matches NV12 and YV12 matches NV21.
+     */
+    template<> struct PixelTraits<PixelFormatI420>: Planar420Traits<2, 1> {};
+    template<> struct PixelTraits<PixelFormatYV12>: Planar420Traits<1, 2> {};
+}
+
+#endif // AKVCAMUTILS_PIXELTRAITS_H
@@ -0,0 +1,681 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
+
+#include "scalerplan.h"
+
+// Number of plans kept by ScalerPlan::plan().
+#define SCALER_CACHE_SIZE 16
+
+namespace AkVCam
+{
+    class ScalerPlanCache
+    {
+        public:
+            std::list<ScalerPlanPtr> m_plans;
+            std::mutex m_mutex;
+
+            static ScalerPlanCache &instance();
+    };
+
+    /* Part of the destination covered by the picture, and part of the
+     * source that is visible, in one axis.
+     */
+    struct ScalerWindow
+    {
+        int dstMin;
+        int dstMax;
+        int srcMin;
+        int srcMax;
+    };
+
+    class ScalerPlanPrivate
+    {
+        public:
+            static void buildMaps(ScalerPlan &plan);
+            static void buildAreaMaps(ScalerPlan &plan);
+            static void buildFilterMaps(ScalerPlan &plan);
+            static Viewport clip(const Viewport &viewport,
+                                 int width,
+                                 int height);
+            static Viewport source(const ScalerPlan &plan);
+            static void windows(const ScalerPlan &plan,
+                                ScalerWindow *xWindow,
+                                ScalerWindow *yWindow);
+            static double cubic(double x);
+            static double lanczos(double x);
+            static void updateFlags(ScalerPlan &plan);
+            static void extrapolateUp(int dstCoord,
+                                      int num, int den, int s,
+                                      int *srcCoordMin, int *srcCoordMax,
+                                      int *kNum, int *kDen);
+            static void extrapolateDown(int dstCoord,
+                                        int num, int den, int s,
+                                        int *srcCoordMin, int *srcCoordMax,
+                                        int *kNum, int *kDen);
+
+            template<typename T>
+            static inline T bound(T min, T value, T max)
+            {
+                return value < min? min: value > max? max: value;
+            }
+    };
+}
+
+AkVCam::ScalerPlanPtr AkVCam::ScalerPlan::plan(int inputWidth,
+                                               int inputHeight,
+                                               int outputWidth,
+                                               int outputHeight,
+                                               Scaling scaling,
+                                               AspectRatio aspectRatio,
+                                               const Viewport &viewport,
+                                               int xShift,
+                                               int yShift,
+                                               int xAlign,
+                                               int yAlign)
+{
+    auto &cache = ScalerPlanCache::instance();
+    auto rect = ScalerPlanPrivate::clip(viewport,
+                                        inputWidth << xShift,
+                                        inputHeight << yShift);
+
+    {
+        std::lock_guard<std::mutex> lock(cache.m_mutex);
+
+        for (auto it = cache.m_plans.begin(); it != cache.m_plans.end(); it++) {
+            auto &plan = *it;
+
+            if (plan->inputWidth == inputWidth
+                && plan->inputHeight == inputHeight
+                && plan->outputWidth == outputWidth
+                && plan->outputHeight == outputHeight
+                && plan->scaling == scaling
+                && plan->aspectRatio == aspectRatio
+                && plan->viewport.x == rect.x
+                && plan->viewport.y == rect.y
+                && plan->viewport.width == rect.width
+                && plan->viewport.height == rect.height
+                && plan->xShift == xShift
+                && plan->yShift == yShift
+                && plan->xAlign == xAlign
+                && plan->yAlign == yAlign) {
+                // Keep the most recently used plans at the front.
+                cache.m_plans.splice(cache.m_plans.begin(), cache.m_plans, it);
+
+                return cache.m_plans.front();
+            }
+        }
+    }
+
+    // Build the plan out of the lock, it's the slow part.
+    auto plan = std::make_shared<ScalerPlan>();
+    plan->inputWidth = inputWidth;
+    plan->inputHeight = inputHeight;
+    plan->outputWidth = outputWidth;
+    plan->outputHeight = outputHeight;
+    plan->scaling = scaling;
+    plan->aspectRatio = aspectRatio;
+    plan->viewport = rect;
+    plan->xShift = xShift;
+    plan->yShift = yShift;
+    plan->xAlign = xAlign;
+    plan->yAlign = yAlign;
+
+    if (scaling == ScalingArea)
+        ScalerPlanPrivate::buildAreaMaps(*plan);
+    else if (scaling == ScalingCubic || scaling == ScalingLanczos)
+        ScalerPlanPrivate::buildFilterMaps(*plan);
+    else
+        ScalerPlanPrivate::buildMaps(*plan);
+
+    ScalerPlanPrivate::updateFlags(*plan);
+
+    std::lock_guard<std::mutex> lock(cache.m_mutex);
+    cache.m_plans.push_front(plan);
+
+    if (cache.m_plans.size() > SCALER_CACHE_SIZE)
+        cache.m_plans.pop_back();
+
+    return plan;
+}
+
+AkVCam::ScalerPlanPtr AkVCam::ScalerPlan::mirrored(bool horizontal,
+                                                   bool vertical,
+                                                   bool source) const
+{
+    auto plan = std::make_shared<ScalerPlan>(*this);
+
+    /* Mirroring before scaling flips the source coordinates inside the
+     * viewport, mirroring after scaling flips the destination ones.
+     */
+    auto viewport = ScalerPlanPrivate::source(*this);
+    auto ranges = this->scaling == ScalingArea || this->filter;
+    auto mirrorMap = [source, ranges] (ScalerMap &map,
+                                       ScalerFilter &filter,
+                                       int srcMin,
+                                       int srcSize) {
+        auto taps = size_t(filter.taps);
+        auto coeffs = filter.coeffs.begin();
+
+        if (source) {
+            for (size_t i = 0; i < map.size(); i++) {
+                auto &sample = map[i];
+
+                if (sample.min >= 0) {
+                    sample.min = 2 * srcMin + srcSize - sample.min - 1;
+                    sample.max = 2 * srcMin + srcSize - sample.max - 1;
+
+                    /* The averaged or filtered pixels always go from 'min'
+                     * to 'max'.
+                     */
+                    if (ranges)
+                        std::swap(sample.min, sample.max);
+
+                    if (taps > 0)
+                        std::reverse(coeffs + ptrdiff_t(i * taps),
+                                     coeffs + ptrdiff_t((i + 1) * taps));
+                }
+            }
+        } else {
+            std::reverse(map.begin(), map.end());
+
+            // Reverse the order of the banks, keeping their coefficients.
+            if (taps > 0) {
+                std::reverse(filter.coeffs.begin(), filter.coeffs.end());
+
+                for (size_t i = 0; i < map.size(); i++)
+                    std::reverse(coeffs + ptrdiff_t(i * taps),
+                                 coeffs + ptrdiff_t((i + 1) * taps));
+            }
+        }
+    };
+
+    if (horizontal)
+        mirrorMap(plan->xMap, plan->xFilter, viewport.x, viewport.width);
+
+    if (vertical)
+        mirrorMap(plan->yMap, plan->yFilter, viewport.y, viewport.height);
+
+    ScalerPlanPrivate::updateFlags(*plan);
+
+    return plan;
+}
+
+AkVCam::ScalerPlanCache &AkVCam::ScalerPlanCache::instance()
+{
+    static ScalerPlanCache cache;
+
+    return cache;
+}
+
+void AkVCam::ScalerPlanPrivate::buildMaps(ScalerPlan &plan)
+{
+    // Scale the viewport as if it was the whole source.
+    auto viewport = source(plan);
+    int iWidth = viewport.width;
+    int iHeight = viewport.height;
+    int width = plan.outputWidth;
+    int height = plan.outputHeight;
+    auto mode = plan.scaling;
+    auto aspectRatio = plan.aspectRatio;
+    plan.xMap.resize(size_t(std::max(width, 0)));
+    plan.yMap.resize(size_t(std::max(height, 0)));
+
+    if (iWidth == width && iHeight == height) {
+        for (int x = 0; x < width; x++)
+            plan.xMap[size_t(x)] = {viewport.x + x, viewport.x + x, 0};
+
+        for (int y = 0; y < height; y++)
+            plan.yMap[size_t(y)] = {viewport.y + y, viewport.y + y, 0};
+
+        return;
+    }
+
+    // The source is cropped below, only the black bars are used.
+    ScalerWindow xWindow;
+    ScalerWindow yWindow;
+    windows(plan, &xWindow, &yWindow);
+    int xDstMin = xWindow.dstMin;
+    int yDstMin = yWindow.dstMin;
+    int xDstMax = xWindow.dstMax;
+    int yDstMax = yWindow.dstMax;
+
+    int iw = iWidth - 1;
+    int ih = iHeight - 1;
+    int ow = xDstMax - xDstMin - 1;
+    int oh = yDstMax - yDstMin - 1;
+    int xNum = iw;
+    int xDen = ow;
+    int xs = 0;
+    int yNum = ih;
+    int yDen = oh;
+    int ys = 0;
+
+    if (aspectRatio == AspectRatioExpanding) {
+        if (mode == ScalingLinear) {
+            iw--;
+            ih--;
+            ow--;
+            oh--;
+        }
+
+        if (width * iHeight < iWidth * height) {
+            // Right and left cut
+            xNum = 2 * ih;
+            xDen = 2 * oh;
+            xs = iw * oh - ow * ih;
+        } else if (width * iHeight > iWidth * height) {
+            // Top and bottom cut
+            yNum = 2 * iw;
+            yDen = 2 * ow;
+            ys = ow * ih - iw * oh;
+        }
+    }
+
+    auto extrapolateX = iWidth < width? &extrapolateUp: &extrapolateDown;
+    auto extrapolateY = iHeight < height? &extrapolateUp: &extrapolateDown;
+
+    auto fillMap = [mode] (ScalerMap &map,
+                           int dstMin, int dstMax, int srcOffset, int srcSize,
+                           int num, int den, int s,
+                           decltype(extrapolateX) extrapolate) {
+        for (int i = 0; i < int(map.size()); i++) {
+            auto &sample = map[size_t(i)];
+
+            if (i < dstMin || i >= dstMax) {
+                sample = {-1, -1, 0};
+
+                continue;
+            }
+
+            if (mode == ScalingLinear) {
+                int kNum = 0;
+                int kDen = 1;
+                extrapolate(i - dstMin, num, den, s,
+                            &sample.min, &sample.max,
+                            &kNum, &kDen);
+                sample.weight = bound(0,
+                                      (SCALER_WEIGHT_ONE * kNum + kDen / 2)
+                                      / kDen,
+                                      SCALER_WEIGHT_ONE);
+            } else {
+                sample.min = den? (num * (i - dstMin) + s) / den: 0;
+                sample.max = sample.min;
+                sample.weight = 0;
+            }
+
+            sample.min = srcOffset + bound(0, sample.min, srcSize - 1);
+            sample.max = srcOffset + bound(0, sample.max, srcSize - 1);
+        }
+    };
+
+    fillMap(plan.xMap,
+            xDstMin, xDstMax, viewport.x, iWidth,
+            xNum, xDen, xs,
+            extrapolateX);
+    fillMap(plan.yMap,
+            yDstMin, yDstMax, viewport.y, iHeight,
+            yNum, yDen, ys,
+            extrapolateY);
+}
+
+void AkVCam::ScalerPlanPrivate::buildAreaMaps(ScalerPlan &plan)
+{
+    plan.xMap.resize(size_t(std::max(plan.outputWidth, 0)));
+    plan.yMap.resize(size_t(std::max(plan.outputHeight, 0)));
+    ScalerWindow xWindow;
+    ScalerWindow yWindow;
+    windows(plan, &xWindow, &yWindow);
+
+    /* Each destination pixel averages the source pixels it covers, at
+     * least one.
+     */
+    auto fillMap = [&plan] (ScalerMap &map,
+                            const ScalerWindow &window,
+                            int maxPixels) {
+        int64_t dstSize = std::max(window.dstMax - window.dstMin, 1);
+        int64_t srcSize = window.srcMax - window.srcMin;
+
+        for (int i = 0; i < int(map.size()); i++) {
+            auto &sample = map[size_t(i)];
+
+            if (i < window.dstMin || i >= window.dstMax) {
+                sample = {-1, -1, 0};
+
+                continue;
+            }
+
+            int min = window.srcMin
+                      + int((i - window.dstMin) * srcSize / dstSize);
+            int max = window.srcMin
+                      + int((i - window.dstMin + 1) * srcSize / dstSize) - 1;
+            max = bound(min, max, min + maxPixels - 1);
+            sample = {bound(0, min, window.srcMax - 1),
+                      bound(0, max, window.srcMax - 1),
+                      0};
+
+            if (sample.max > sample.min)
+                plan.area = true;
+        }
+    };
+
+    fillMap(plan.xMap, xWindow, xWindow.srcMax - xWindow.srcMin);
+    fillMap(plan.yMap, yWindow, SCALER_MAX_AREA_LINES);
+}
+
+void AkVCam::ScalerPlanPrivate::buildFilterMaps(ScalerPlan &plan)
+{
+    plan.xMap.resize(size_t(std::max(plan.outputWidth, 0)));
+    plan.yMap.resize(size_t(std::max(plan.outputHeight, 0)));
+    plan.filter = true;
+    ScalerWindow xWindow;
+    ScalerWindow yWindow;
+    windows(plan, &xWindow, &yWindow);
+    auto viewport = source(plan);
+    auto kernel = plan.scaling == ScalingLanczos? &lanczos: &cubic;
+    double radius = plan.scaling == ScalingLanczos? 3.0: 2.0;
+
+    auto fillMap = [kernel, radius] (ScalerMap &map,
+                                     ScalerFilter &filter,
+                                     const ScalerWindow &window,
+                                     int srcOffset,
+                                     int srcSize) {
+        int dstSize = std::max(window.dstMax - window.dstMin, 1);
+        int visibleSize = window.srcMax - window.srcMin;
+        double scale = double(visibleSize) / dstSize;
+
+        /* When downscaling the filter is stretched to cover all the source
+         * pixels, otherwise it would skip some of them.
+         */
+        double filterScale = std::max(scale, 1.0);
+        double support = radius * filterScale;
+        int taps = visibleSize == dstSize?
+                       1:
+                       std::min(int(std::ceil(2.0 * support)), srcSize);
+        filter.taps = taps;
+        filter.coeffs.assign(map.size() * size_t(taps), 0);
+        std::vector<double> weights(static_cast<size_t>(taps));
+
+        for (int i = 0; i < int(map.size()); i++) {
+            auto &sample = map[size_t(i)];
+            auto coeffs = filter.coeffs.data() + size_t(i) * size_t(taps);
+
+            if (i < window.dstMin || i >= window.dstMax) {
+                sample = {-1, -1, 0};
+                coeffs[0] = SCALER_FILTER_ONE;
+
+                continue;
+            }
+
+            double center = window.srcMin
+                            + (i - window.dstMin + 0.5) * scale
+                            - 0.5;
+            int first = taps > 1?
+                            int(std::floor(center - support)) + 1:
+                            int(std::lround(center));
+
+            /* The pixels out of the viewport are replaced by the pixels at
+             * the edges, so move the window inside the viewport and add their
+             * weight to the edges.
+             */
+            int srcMax = srcOffset + srcSize;
+            int start = bound(srcOffset, first, srcMax - taps);
+            std::fill(weights.begin(), weights.end(), 0.0);
+            double sum = 0.0;
+
+            for (int k = 0; k < taps; k++) {
+                double weight = taps > 1?
+                                    kernel((first + k - center) / filterScale):
+                                    1.0;
+                int pixel = bound(srcOffset, first + k, srcMax - 1);
+                weights[size_t(pixel - start)] += weight;
+                sum += weight;
+            }
+
+            // Round the coefficients and give the remainder to the biggest.
+            int total = 0;
+            int biggest = 0;
+
+            for (int k = 0; k < taps; k++) {
+                auto coeff = int(std::lround(SCALER_FILTER_ONE
+                                             * weights[size_t(k)]
+                                             / sum));
+                coeffs[k] = int16_t(coeff);
+                total += coeff;
+
+                if (coeff > coeffs[biggest])
+                    biggest = k;
+            }
+
+            coeffs[biggest] = int16_t(coeffs[biggest]
+                                      + SCALER_FILTER_ONE
+                                      - total);
+            sample = {start, start + taps - 1, 0};
+        }
+    };
+
+    fillMap(plan.xMap, plan.xFilter, xWindow, viewport.x, viewport.width);
+    fillMap(plan.yMap, plan.yFilter, yWindow, viewport.y, viewport.height);
+}
+
+AkVCam::Viewport AkVCam::ScalerPlanPrivate::clip(const Viewport &viewport,
+                                                 int width,
+                                                 int height)
+{
+    Viewport rect;
+
+    if (viewport.width < 1 || viewport.height < 1) {
+        rect.width = width;
+        rect.height = height;
+
+        return rect;
+    }
+
+    rect.x = bound(0, viewport.x, width - 1);
+    rect.y = bound(0, viewport.y, height - 1);
+    rect.width = bound(1, viewport.width, width - rect.x);
+    rect.height = bound(1, viewport.height, height - rect.y);
+
+    return rect;
+}
+
+AkVCam::Viewport AkVCam::ScalerPlanPrivate::source(const ScalerPlan &plan)
+{
+    // The viewport in the coordinates of the subsampled component.
+    auto &viewport = plan.viewport;
+    int xRound = (1 << plan.xShift) - 1;
+    int yRound = (1 << plan.yShift) - 1;
+    Viewport rect;
+    rect.x = viewport.x >> plan.xShift;
+    rect.y = viewport.y >> plan.yShift;
+    rect.width = std::min((viewport.x + viewport.width + xRound) >> plan.xShift,
+                          plan.inputWidth)
+                 - rect.x;
+    rect.height = std::min((viewport.y + viewport.height + yRound) >> plan.yShift,
+                           plan.inputHeight)
+                  - rect.y;
+
+    return rect;
+}
+
+void AkVCam::ScalerPlanPrivate::windows(const ScalerPlan &plan,
+                                        ScalerWindow *xWindow,
+                                        ScalerWindow *yWindow)
+{
+    int iWidth = plan.viewport.width;
+    int iHeight = plan.viewport.height;
+    int width = plan.outputWidth << plan.xShift;
+    int height = plan.outputHeight << plan.yShift;
+    *xWindow = {0, width, 0, iWidth};
+    *yWindow = {0, height, 0, iHeight};
+
+    if (plan.aspectRatio == AspectRatioKeep) {
+        if (width * iHeight > iWidth * height) {
+            // Right and left black bars
+            xWindow->dstMin = (width * iHeight - iWidth * height)
+                              / (2 * iHeight);
+            xWindow->dstMax = (width * iHeight + iWidth * height)
+                              / (2 * iHeight);
+        } else if (width * iHeight < iWidth * height) {
+            // Top and bottom black bars
+            yWindow->dstMin = (iWidth * height - width * iHeight)
+                              / (2 * iWidth);
+            yWindow->dstMax = (iWidth * height + width * iHeight)
+                              / (2 * iWidth);
+        }
+    } else if (plan.aspectRatio == AspectRatioExpanding) {
+        if (width * iHeight < iWidth * height) {
+            // Right and left cut
+            int visibleWidth = std::max(width * iHeight / height, 1);
+            xWindow->srcMin = (iWidth - visibleWidth) / 2;
+            xWindow->srcMax = xWindow->srcMin + visibleWidth;
+        } else if (width * iHeight > iWidth * height) {
+            // Top and bottom cut
+            int visibleHeight = std::max(height * iWidth / width, 1);
+            yWindow->srcMin = (iHeight - visibleHeight) / 2;
+            yWindow->srcMax = yWindow->srcMin + visibleHeight;
+        }
+    }
+
+    xWindow->srcMin += plan.viewport.x;
+    xWindow->srcMax += plan.viewport.x;
+    yWindow->srcMin += plan.viewport.y;
+    yWindow->srcMax += plan.viewport.y;
+
+    /* Grow the picture to whole blocks, so every subsampled pixel is either
+     * fully black or fully visible. A visible subsampled pixel uses the
+     * source pixels of any full size pixel it covers.
+     */
+    auto subsample = [] (ScalerWindow *window,
+                         int shift,
+                         int align,
+                         int srcSize,
+                         int dstSize) {
+        int block = (1 << align) - 1;
+        window->dstMin = (window->dstMin & ~block) >> shift;
+        window->dstMax = std::min(((window->dstMax + block) & ~block) >> shift,
+                                  dstSize);
+        int round = (1 << shift) - 1;
+        window->srcMin = window->srcMin >> shift;
+        window->srcMax = std::min((window->srcMax + round) >> shift, srcSize);
+    };
+
+    subsample(xWindow,
+              plan.xShift,
+              std::max(plan.xShift, plan.xAlign),
+              plan.inputWidth,
+              plan.outputWidth);
+    subsample(yWindow,
+              plan.yShift,
+              std::max(plan.yShift, plan.yAlign),
+              plan.inputHeight,
+              plan.outputHeight);
+}
+
+double AkVCam::ScalerPlanPrivate::cubic(double x)
+{
+    // Catmull-Rom spline, a = -0.5.
+    x = std::fabs(x);
+
+    if (x < 1.0)
+        return (1.5 * x - 2.5) * x * x + 1.0;
+
+    if (x < 2.0)
+        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+
+    return 0.0;
+}
+
+double AkVCam::ScalerPlanPrivate::lanczos(double x)
+{
+    x = std::fabs(x);
+
+    if (x < 1e-8)
+        return 1.0;
+
+    if (x >= 3.0)
+        return 0.0;
+
+    static const double pi = 3.14159265358979323846;
+
+    return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0)
+           / (pi * pi * x * x);
+}
+
+void AkVCam::ScalerPlanPrivate::updateFlags(ScalerPlan &plan)
+{
+    plan.identityX = true;
+    plan.xOffset = plan.xMap.empty()? 0: plan.xMap[0].min;
+    plan.linearX = false;
+
+    for (size_t x = 0; x < plan.xMap.size(); x++) {
+        auto &sample = plan.xMap[x];
+        bool box = (plan.area || plan.filter) && sample.max != sample.min;
+
+        if (sample.min != int(x) + plan.xOffset
+            || sample.min < 0
+            || sample.weight != 0
+            || box)
+            plan.identityX = false;
+
+        if (sample.weight != 0)
+            plan.linearX = true;
+    }
+}
+
+void AkVCam::ScalerPlanPrivate::extrapolateUp(int dstCoord,
+                                              int num, int den, int s,
+                                              int *srcCoordMin, int *srcCoordMax,
+                                              int *kNum, int *kDen)
+{
+    *srcCoordMin = den? (num * dstCoord + s) / den: 0;
+    *srcCoordMax = *srcCoordMin + 1;
+
+    if (num == 0) {
+        *kNum = 0;
+        *kDen = 1;
+
+        return;
+    }
+
+    int dstCoordMin = (den * *srcCoordMin - s) / num;
+    int dstCoordMax = (den * *srcCoordMax - s) / num;
+    *kNum = dstCoord - dstCoordMin;
+    *kDen = dstCoordMax - dstCoordMin;
+
+    if (*kDen < 1) {
+        *kNum = 0;
+        *kDen = 1;
+    }
+}
+
+void AkVCam::ScalerPlanPrivate::extrapolateDown(int dstCoord,
+                                                int num, int den, int s,
+                                                int *srcCoordMin, int *srcCoordMax,
+                                                int *kNum, int *kDen)
+{
+    *srcCoordMin = den? (num * dstCoord + s) / den: 0;
+    *srcCoordMax = *srcCoordMin;
+    *kNum = 0;
+    *kDen = 1;
+}
@@ -0,0 +1,152 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_SCALERPLAN_H
+#define AKVCAMUTILS_SCALERPLAN_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "videoframetypes.h"
+
+// Bits of the fractional part of the interpolation weights.
+#define SCALER_WEIGHT_SHIFT 8
+#define SCALER_WEIGHT_ONE (1 << SCALER_WEIGHT_SHIFT)
+
+/* Maximum number of source lines averaged by ScalingArea, so the sums of
+ * the columns fit in 16 bits.
+ */
+#define SCALER_MAX_AREA_LINES 256
+
+// Bits of the fractional part of the filter coefficients.
+#define SCALER_FILTER_SHIFT 14
+#define SCALER_FILTER_ONE (1 << SCALER_FILTER_SHIFT)
+
+namespace AkVCam
+{
+    /* Source pixels used for each destination pixel, the result is
+     * interpolated from 'min' to 'max' by a factor of
+     * 'weight' / SCALER_WEIGHT_ONE, or with ScalingArea, the average of the
+     * pixels from 'min' to 'max', or with ScalingCubic and ScalingLanczos,
+     * the pixels from 'min' to 'max' weighted by the filter coefficients.
+     * A negative 'min' means the pixel is out of the picture (black bars).
+     */
+    struct ScalerSample
+    {
+        int min;
+        int max;
+        int weight;
+    };
+
+    using ScalerMap = std::vector<ScalerSample>;
+
+    /* Polyphase filter bank of one axis, destination pixel 'i' uses 'taps'
+     * source pixels, with the coefficients from coeffs[i * taps], in units
+     * of 1 / SCALER_FILTER_ONE. The coefficients of each pixel add up to
+     * SCALER_FILTER_ONE.
+     */
+    struct ScalerFilter
+    {
+        int taps {0};
+        std::vector<int16_t> coeffs;
+    };
+
+    struct ScalerPlan;
+    using ScalerPlanPtr = std::shared_ptr<const ScalerPlan>;
+
+    /* Source columns and rows used for each destination column and row when
+     * scaling a frame.
+     *
+     * The plans are immutable and shared, plan() keeps the last used ones,
+     * so the maps are computed once per stream instead of once per frame.
+     */
+    struct ScalerPlan
+    {
+        int inputWidth {0};
+        int inputHeight {0};
+        int outputWidth {0};
+        int outputHeight {0};
+        Scaling scaling {ScalingFast};
+        AspectRatio aspectRatio {AspectRatioIgnore};
+
+        // Visible part of the full size source, the maps point inside it.
+        Viewport viewport;
+        int xShift {0};
+        int yShift {0};
+        int xAlign {0};
+        int yAlign {0};
+        ScalerMap xMap;
+        ScalerMap yMap;
+
+        /* Every column is copied from the source column 'xOffset' columns to
+         * the right, a horizontal crop.
+         */
+        bool identityX {true};
+        int xOffset {0};
+
+        // Some columns are interpolated.
+        bool linearX {false};
+
+        // Some pixels are the average of several source pixels.
+        bool area {false};
+
+        // The pixels are filtered with the banks below.
+        bool filter {false};
+        ScalerFilter xFilter;
+        ScalerFilter yFilter;
+
+        /* Get the plan for the given sizes and modes, building it if needed.
+         * Only the 'viewport' part of the source is scaled, the samples keep
+         * pointing to the whole source, so cropping doesn't need a copy.
+         *
+         * For a component subsampled by 2^xShift x 2^yShift the black bars
+         * and the visible part of the source are computed for the full size
+         * component, with the bars aligned to blocks of 2^xAlign x 2^yAlign
+         * pixels, so they match in all the components of the frame.
+         */
+        static ScalerPlanPtr plan(int inputWidth,
+                                  int inputHeight,
+                                  int outputWidth,
+                                  int outputHeight,
+                                  Scaling scaling,
+                                  AspectRatio aspectRatio,
+                                  const Viewport &viewport=Viewport(),
+                                  int xShift=0,
+                                  int yShift=0,
+                                  int xAlign=0,
+                                  int yAlign=0);
+
+        /* A copy of this plan with the maps mirrored. If 'source' is true
+         * the source coordinates are flipped, as if mirroring before
+         * scaling, otherwise the destination ones are.
+         */
+        ScalerPlanPtr mirrored(bool horizontal,
+                               bool vertical,
+                               bool source) const;
+
+        static inline uint8_t interpolate(int min, int max, int weight)
+        {
+            return uint8_t((weight * (max - min) + (min << SCALER_WEIGHT_SHIFT))
+                           >> SCALER_WEIGHT_SHIFT);
+        }
+    };
+}
+
+#endif // AKVCAMUTILS_SCALERPLAN_H
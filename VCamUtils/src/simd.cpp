@@ -0,0 +1,587 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <cstring>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #include <immintrin.h>
+    #define AKVCAM_CPUID_X86
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+    #define AKVCAM_CPUID_X86
+#endif
+
+#include "simd.h"
+#include "color.h"
+
+namespace AkVCam
+{
+    class SimdPrivate
+    {
+        public:
+            SimdKernels m_kernels[SimdLevelNEON + 1];
+            SimdLevel m_detectedLevel {SimdLevelNone};
+
+            SimdPrivate();
+            static SimdLevel detect();
+            static SimdKernels scalarKernels();
+
+            /* R, G and B are the byte offsets of each component in the 24 bits
+             * source pixel, Y0, Y1, U and V the byte offsets of each
+             * component in the 4:2:2 macropixel.
+             */
+            template<int R, int G, int B,
+                     int Y0, int Y1, int U, int V>
+            static void rgb24ToPacked422(const uint8_t *src,
+                                         uint8_t *dst,
+                                         int width)
+            {
+                int x = 0;
+
+                for (; x + 1 < width; x += 2) {
+                    auto p0 = src + 3 * x;
+                    auto p1 = p0 + 3;
+                    auto yuv = dst + 2 * x;
+
+                    yuv[Y0] = Color::rgbY(p0[R], p0[G], p0[B]);
+                    yuv[Y1] = Color::rgbY(p1[R], p1[G], p1[B]);
+                    yuv[U] = Color::rgbU(p0[R], p0[G], p0[B]);
+                    yuv[V] = Color::rgbV(p0[R], p0[G], p0[B]);
+                }
+
+                // For odd widths repeat the last pixel.
+                if (x < width) {
+                    auto p0 = src + 3 * x;
+                    auto yuv = dst + 2 * x;
+                    auto y = Color::rgbY(p0[R], p0[G], p0[B]);
+
+                    yuv[Y0] = y;
+                    yuv[Y1] = y;
+                    yuv[U] = Color::rgbU(p0[R], p0[G], p0[B]);
+                    yuv[V] = Color::rgbV(p0[R], p0[G], p0[B]);
+                }
+            }
+
+            /* Same as above but for the semi-planar 4:2:0 formats, U and V
+             * are the byte offsets of each component in the chroma pair.
+             */
+            template<int R, int G, int B, int U, int V>
+            static void rgb24ToNv(const uint8_t *src0,
+                                  const uint8_t *src1,
+                                  uint8_t *dstY0,
+                                  uint8_t *dstY1,
+                                  uint8_t *dstUV,
+                                  int width)
+            {
+                for (int x = 0; x < width; x += 2) {
+                    // For odd widths repeat the last pixel.
+                    int x1 = x + 1 < width? x + 1: x;
+                    auto p00 = src0 + 3 * x;
+                    auto p01 = src0 + 3 * x1;
+                    auto p10 = src1 + 3 * x;
+                    auto p11 = src1 + 3 * x1;
+
+                    dstY0[x] = Color::rgbY(p00[R], p00[G], p00[B]);
+                    dstY1[x] = Color::rgbY(p10[R], p10[G], p10[B]);
+
+                    if (x1 != x) {
+                        dstY0[x1] = Color::rgbY(p01[R], p01[G], p01[B]);
+                        dstY1[x1] = Color::rgbY(p11[R], p11[G], p11[B]);
+                    }
+
+                    int r = (p00[R] + p01[R] + p10[R] + p11[R] + 2) >> 2;
+                    int g = (p00[G] + p01[G] + p10[G] + p11[G] + 2) >> 2;
+                    int b = (p00[B] + p01[B] + p10[B] + p11[B] + 2) >> 2;
+
+                    dstUV[x + U] = Color::rgbU(r, g, b);
+                    dstUV[x + V] = Color::rgbV(r, g, b);
+                }
+            }
+
+            static void swapBytes(const uint8_t *src, uint8_t *dst, int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    auto b0 = src[2 * x];
+                    auto b1 = src[2 * x + 1];
+                    dst[2 * x] = b1;
+                    dst[2 * x + 1] = b0;
+                }
+            }
+
+            // Swap the pixels from both ends, so 'src' can be 'dst'.
+            template<int Bytes>
+            static void mirror(const uint8_t *src, uint8_t *dst, int width)
+            {
+                for (int x = 0, y = width - 1; x <= y; x++, y--) {
+                    uint8_t pixel0[Bytes];
+                    uint8_t pixel1[Bytes];
+                    memcpy(pixel0, src + Bytes * x, Bytes);
+                    memcpy(pixel1, src + Bytes * y, Bytes);
+                    memcpy(dst + Bytes * x, pixel1, Bytes);
+                    memcpy(dst + Bytes * y, pixel0, Bytes);
+                }
+            }
+
+            // Macropixels with the lumas in the bytes Y and Y + 2.
+            template<int Y>
+            static void mirrorPacked(const uint8_t *src, uint8_t *dst, int width)
+            {
+                for (int x = 0, y = width - 1; x <= y; x++, y--) {
+                    uint8_t pixel0[4];
+                    uint8_t pixel1[4];
+                    memcpy(pixel0, src + 4 * x, 4);
+                    memcpy(pixel1, src + 4 * y, 4);
+                    std::swap(pixel0[Y], pixel0[Y + 2]);
+                    std::swap(pixel1[Y], pixel1[Y + 2]);
+                    memcpy(dst + 4 * x, pixel1, 4);
+                    memcpy(dst + 4 * y, pixel0, 4);
+                }
+            }
+
+            // 5 bits red and blue components, one of them 'Shift' bits up.
+            template<int Shift>
+            static void swapRgb16Bits(const uint8_t *src, uint8_t *dst, int width)
+            {
+                const uint16_t keep = uint16_t(~(0x1f | (0x1f << Shift)));
+
+                for (int x = 0; x < width; x++) {
+                    uint16_t pixel;
+                    memcpy(&pixel, src + 2 * x, 2);
+                    pixel = uint16_t(((pixel >> Shift) & 0x1f)
+                                     | ((pixel & 0x1f) << Shift)
+                                     | (pixel & keep));
+                    memcpy(dst + 2 * x, &pixel, 2);
+                }
+            }
+
+            static void swapRgb24(const uint8_t *src, uint8_t *dst, int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    auto b0 = src[3 * x];
+                    auto b1 = src[3 * x + 1];
+                    auto b2 = src[3 * x + 2];
+                    dst[3 * x] = b2;
+                    dst[3 * x + 1] = b1;
+                    dst[3 * x + 2] = b0;
+                }
+            }
+
+            // Red and blue in the bytes Offset and Offset + 2.
+            template<int Offset>
+            static void swapRgb32Bytes(const uint8_t *src, uint8_t *dst, int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    uint8_t pixel[4];
+                    memcpy(pixel, src + 4 * x, 4);
+                    std::swap(pixel[Offset], pixel[Offset + 2]);
+                    memcpy(dst + 4 * x, pixel, 4);
+                }
+            }
+
+            static void splitBytes(const uint8_t *src,
+                                   uint8_t *dst0,
+                                   uint8_t *dst1,
+                                   int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    dst0[x] = src[2 * x];
+                    dst1[x] = src[2 * x + 1];
+                }
+            }
+
+            static void mergeBytes(const uint8_t *src0,
+                                   const uint8_t *src1,
+                                   uint8_t *dst,
+                                   int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    dst[2 * x] = src0[x];
+                    dst[2 * x + 1] = src1[x];
+                }
+            }
+
+            static void blendBytes(const uint8_t *src0,
+                                   const uint8_t *src1,
+                                   const uint16_t *weights,
+                                   uint8_t *dst,
+                                   int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    int w = weights[x];
+                    dst[x] = uint8_t((src0[x] * (256 - w) + src1[x] * w) >> 8);
+                }
+            }
+
+            static void blendRows(const uint8_t *src0,
+                                  const uint8_t *src1,
+                                  int weight,
+                                  uint8_t *dst,
+                                  int width)
+            {
+                for (int x = 0; x < width; x++)
+                    dst[x] = uint8_t((src0[x] * (256 - weight)
+                                      + src1[x] * weight) >> 8);
+            }
+
+            static void accumulateRow(const uint8_t *src,
+                                      uint16_t *dst,
+                                      int width)
+            {
+                for (int x = 0; x < width; x++)
+                    dst[x] = uint16_t(dst[x] + src[x]);
+            }
+
+            static void filterBytes(const uint8_t *src,
+                                    const int16_t *coeffs,
+                                    int taps,
+                                    int16_t *dst,
+                                    int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    int32_t sum = 0;
+
+                    for (int k = 0; k < taps; k++)
+                        sum += src[k * width + x] * coeffs[k * width + x];
+
+                    dst[x] = int16_t(bound(-32768, (sum + 128) >> 8, 32767));
+                }
+            }
+
+            static void filterRows(const int16_t *const *src,
+                                   const int16_t *coeffs,
+                                   int taps,
+                                   uint8_t *dst,
+                                   int width)
+            {
+                for (int x = 0; x < width; x++) {
+                    int32_t sum = 0;
+
+                    for (int k = 0; k < taps; k++)
+                        sum += src[k][x] * coeffs[k];
+
+                    dst[x] = uint8_t(bound(0, (sum + (1 << 19)) >> 20, 255));
+                }
+            }
+
+            template<size_t Bytes>
+            static void transpose(const uint8_t *src,
+                                  ptrdiff_t srcStride,
+                                  uint8_t *dst,
+                                  ptrdiff_t dstStride,
+                                  int width,
+                                  int height)
+            {
+                for (int x = 0; x < width; x++) {
+                    auto srcPixel = src + Bytes * size_t(x);
+                    auto dstLine = dst + x * dstStride;
+
+                    for (int y = 0; y < height; y++) {
+                        memcpy(dstLine + Bytes * size_t(y), srcPixel, Bytes);
+                        srcPixel += srcStride;
+                    }
+                }
+            }
+
+            static void lut3d(const uint8_t *src,
+                              uint8_t *dst,
+                              int width,
+                              const uint32_t *lut,
+                              const uint32_t *axis,
+                              int size)
+            {
+                for (int x = 0; x < width; x++) {
+                    int offsets[4];
+                    int weights[4];
+                    Simd::lut3dVertices(src + 3 * x,
+                                        axis,
+                                        size,
+                                        offsets,
+                                        weights);
+
+                    for (int c = 0; c < 3; c++) {
+                        int sum = 128;
+
+                        for (int k = 0; k < 4; k++)
+                            sum += weights[k]
+                                   * int((lut[offsets[k]] >> (8 * c)) & 0xff);
+
+                        dst[3 * x + c] = uint8_t(sum >> 8);
+                    }
+                }
+            }
+
+            static void adjustChroma(const uint8_t *src,
+                                     uint8_t *dst,
+                                     const int16_t *matrix,
+                                     int width)
+            {
+                const int round = 1 << (SIMD_CHROMA_SHIFT - 1);
+
+                for (int x = 0; x < width; x++) {
+                    int a = src[2 * x] - 128;
+                    int b = src[2 * x + 1] - 128;
+                    int ma = (matrix[0] * a + matrix[1] * b + round)
+                             >> SIMD_CHROMA_SHIFT;
+                    int mb = (matrix[2] * a + matrix[3] * b + round)
+                             >> SIMD_CHROMA_SHIFT;
+                    dst[2 * x] = uint8_t(bound(0, ma + 128, 255));
+                    dst[2 * x + 1] = uint8_t(bound(0, mb + 128, 255));
+                }
+            }
+
+            static void hashStripes(const uint8_t *data,
+                                    size_t stripes,
+                                    uint64_t index,
+                                    uint64_t *acc)
+            {
+                for (size_t n = 0; n < stripes; n++) {
+                    auto key = SIMD_HASH_KEY * (8 * (index + n) + 1);
+
+                    for (int i = 0; i < 8; i++) {
+                        auto d = readWord(data + SIMD_HASH_STRIPE * n + 8 * i);
+                        auto dk = d ^ key;
+                        acc[i] += (dk & 0xffffffff) * (dk >> 32);
+                        acc[i ^ 1] += d;
+                        key += SIMD_HASH_KEY;
+                    }
+                }
+            }
+
+            static inline uint64_t readWord(const uint8_t *data)
+            {
+                uint64_t word = 0;
+
+                for (int i = 0; i < 8; i++)
+                    word |= uint64_t(data[i]) << (8 * i);
+
+                return word;
+            }
+
+            // Final mix of MurmurHash3, spreads every bit to all the others.
+            static inline uint64_t avalanche(uint64_t value)
+            {
+                value ^= value >> 33;
+                value *= UINT64_C(0xff51afd7ed558ccd);
+                value ^= value >> 33;
+                value *= UINT64_C(0xc4ceb9fe1a85ec53);
+                value ^= value >> 33;
+
+                return value;
+            }
+
+            template<typename T>
+            static inline T bound(T min, T value, T max)
+            {
+                return value < min? min: value > max? max: value;
+            }
+    };
+
+    inline SimdPrivate *simdPrivate()
+    {
+        static SimdPrivate simd;
+
+        return &simd;
+    }
+}
+
+AkVCam::SimdLevel AkVCam::Simd::detectedLevel()
+{
+    return simdPrivate()->m_detectedLevel;
+}
+
+const AkVCam::SimdKernels &AkVCam::Simd::kernels()
+{
+    auto simd = simdPrivate();
+
+    return simd->m_kernels[simd->m_detectedLevel];
+}
+
+const AkVCam::SimdKernels &AkVCam::Simd::kernels(SimdLevel level)
+{
+    auto simd = simdPrivate();
+
+    if (level == SimdLevelNEON || simd->m_detectedLevel == SimdLevelNEON) {
+        if (level != simd->m_detectedLevel)
+            level = SimdLevelNone;
+    } else if (level > simd->m_detectedLevel) {
+        level = simd->m_detectedLevel;
+    }
+
+    return simd->m_kernels[level];
+}
+
+uint64_t AkVCam::Simd::hash(const void *data, size_t size)
+{
+    auto bytes = reinterpret_cast<const uint8_t *>(data);
+    auto stripes = size / SIMD_HASH_STRIPE;
+    auto &hashStripes = kernels().hashStripes;
+    uint64_t acc[8];
+
+    for (int i = 0; i < 8; i++)
+        acc[i] = SimdPrivate::avalanche(uint64_t(i + 1));
+
+    hashStripes(bytes, stripes, 0, acc);
+    auto left = size % SIMD_HASH_STRIPE;
+
+    // The last incomplete block is padded with zeros.
+    if (left > 0) {
+        uint8_t stripe[SIMD_HASH_STRIPE];
+        memset(stripe, 0, SIMD_HASH_STRIPE);
+        memcpy(stripe, bytes + SIMD_HASH_STRIPE * stripes, left);
+        hashStripes(stripe, 1, stripes, acc);
+    }
+
+    auto hash = SIMD_HASH_KEY * uint64_t(size);
+
+    for (int i = 0; i < 8; i++)
+        hash = SimdPrivate::avalanche(hash ^ acc[i]) + uint64_t(i);
+
+    return hash;
+}
+
+AkVCam::SimdPrivate::SimdPrivate()
+{
+    this->m_detectedLevel = detect();
+    bool isX86 = this->m_detectedLevel == SimdLevelSSE2
+                 || this->m_detectedLevel == SimdLevelAVX2;
+
+    // The x86 levels are incremental, each one adds to the previous one.
+    auto kernels = scalarKernels();
+    this->m_kernels[SimdLevelNone] = kernels;
+
+    if (isX86 && Simd::loadSse2(&kernels))
+        kernels.level = SimdLevelSSE2;
+
+    this->m_kernels[SimdLevelSSE2] = kernels;
+
+    if (this->m_detectedLevel == SimdLevelAVX2 && Simd::loadAvx2(&kernels))
+        kernels.level = SimdLevelAVX2;
+
+    this->m_kernels[SimdLevelAVX2] = kernels;
+
+    kernels = scalarKernels();
+
+    if (this->m_detectedLevel == SimdLevelNEON && Simd::loadNeon(&kernels))
+        kernels.level = SimdLevelNEON;
+
+    this->m_kernels[SimdLevelNEON] = kernels;
+}
+
+AkVCam::SimdLevel AkVCam::SimdPrivate::detect()
+{
+#if defined(AKVCAM_CPUID_X86)
+    uint32_t regs[4] {0, 0, 0, 0};
+#if defined(_MSC_VER)
+    __cpuid(reinterpret_cast<int *>(regs), 0);
+#else
+    __cpuid(0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    auto maxLeaf = regs[0];
+
+    if (maxLeaf < 1)
+        return SimdLevelNone;
+
+#if defined(_MSC_VER)
+    __cpuid(reinterpret_cast<int *>(regs), 1);
+#else
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+
+    bool sse2 = regs[3] & (1 << 26);
+    bool osxsave = regs[2] & (1 << 27);
+    bool avx = regs[2] & (1 << 28);
+
+    if (!sse2)
+        return SimdLevelNone;
+
+    if (!osxsave || !avx || maxLeaf < 7)
+        return SimdLevelSSE2;
+
+    // Check that the OS saves the YMM registers on context switch.
+#if defined(_MSC_VER)
+    auto xcr0 = uint64_t(_xgetbv(0));
+#else
+    uint32_t xcr0Low = 0;
+    uint32_t xcr0High = 0;
+    __asm__ volatile ("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    auto xcr0 = (uint64_t(xcr0High) << 32) | xcr0Low;
+#endif
+
+    if ((xcr0 & 0x6) != 0x6)
+        return SimdLevelSSE2;
+
+#if defined(_MSC_VER)
+    __cpuidex(reinterpret_cast<int *>(regs), 7, 0);
+#else
+    __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+
+    return regs[1] & (1 << 5)? SimdLevelAVX2: SimdLevelSSE2;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return SimdLevelNEON;
+#else
+    return SimdLevelNone;
+#endif
+}
+
+AkVCam::SimdKernels AkVCam::SimdPrivate::scalarKernels()
+{
+    SimdKernels kernels;
+    kernels.level = SimdLevelNone;
+
+    // RGB24 is stored as B G R, and BGR24 as R G B.
+    kernels.rgb24ToYuy2 = rgb24ToPacked422<2, 1, 0, 0, 2, 3, 1>;
+    kernels.rgb24ToUyvy = rgb24ToPacked422<2, 1, 0, 1, 3, 2, 0>;
+    kernels.bgr24ToYuy2 = rgb24ToPacked422<0, 1, 2, 0, 2, 3, 1>;
+    kernels.bgr24ToUyvy = rgb24ToPacked422<0, 1, 2, 1, 3, 2, 0>;
+    kernels.rgb24ToNv12 = rgb24ToNv<2, 1, 0, 1, 0>;
+    kernels.rgb24ToNv21 = rgb24ToNv<2, 1, 0, 0, 1>;
+    kernels.bgr24ToNv12 = rgb24ToNv<0, 1, 2, 1, 0>;
+    kernels.bgr24ToNv21 = rgb24ToNv<0, 1, 2, 0, 1>;
+    kernels.swapBytes = swapBytes;
+    kernels.splitBytes = splitBytes;
+    kernels.mergeBytes = mergeBytes;
+    kernels.blendBytes = blendBytes;
+    kernels.blendRows = blendRows;
+    kernels.accumulateRow = accumulateRow;
+    kernels.filterBytes = filterBytes;
+    kernels.filterRows = filterRows;
+    kernels.transpose8 = transpose<1>;
+    kernels.transpose16 = transpose<2>;
+    kernels.transpose24 = transpose<3>;
+    kernels.transpose32 = transpose<4>;
+    kernels.mirror8 = mirror<1>;
+    kernels.mirror16 = mirror<2>;
+    kernels.mirror24 = mirror<3>;
+    kernels.mirror32 = mirror<4>;
+    kernels.mirrorYuy2 = mirrorPacked<0>;
+    kernels.mirrorUyvy = mirrorPacked<1>;
+    kernels.swapRgb15 = swapRgb16Bits<10>;
+    kernels.swapRgb16 = swapRgb16Bits<11>;
+    kernels.swapRgb24 = swapRgb24;
+    kernels.swapRgb32 = swapRgb32Bytes<1>;
+    kernels.swapBgr32 = swapRgb32Bytes<0>;
+    kernels.lut3d = lut3d;
+    kernels.adjustChroma = adjustChroma;
+    kernels.hashStripes = hashStripes;
+
+    return kernels;
+}
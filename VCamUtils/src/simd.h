@@ -0,0 +1,345 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_SIMD_H
+#define AKVCAMUTILS_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* Row kernels used by VideoFrame.
+ *
+ * Every kernel has a scalar reference implementation in simd.cpp, the
+ * instruction set specific versions live in simd<isa>.cpp and must produce
+ * exactly the same output as the reference. The best set of kernels
+ * supported by the running CPU is selected once, the first time
+ * Simd::kernels() is called.
+ *
+ * Pixel layouts follow the structs defined in videoframe.cpp, in particular
+ * packed 4:2:2 formats store the chroma as:
+ *
+ * YUY2: Y0 V Y1 U
+ * UYVY: V Y0 U Y1
+ *
+ * and semi-planar 4:2:0 formats store the interleaved chroma plane as:
+ *
+ * NV12: V U
+ * NV21: U V
+ *
+ * planar 4:2:0 formats are the semi-planar ones with the chroma split in two
+ * planes, I420 has the same order as NV12 and YV12 the same as NV21.
+ *
+ * 4:2:0 kernels compute the chroma from the average of each 2x2 block.
+ */
+
+/* The entries of the axis of a 3D table have the node index in the upper
+ * bits and the distance to it, from 0 to 256, in the lower ones.
+ */
+#define SIMD_LUT3D_SHIFT 9
+#define SIMD_LUT3D_MASK ((1 << SIMD_LUT3D_SHIFT) - 1)
+
+// Bits of the fractional part of the chroma matrix coefficients.
+#define SIMD_CHROMA_SHIFT 12
+
+// Bytes of each block of the hash kernel, and the multiplier of its keys.
+#define SIMD_HASH_STRIPE 64
+#define SIMD_HASH_KEY UINT64_C(0x9e3779b97f4a7c15)
+
+namespace AkVCam
+{
+    enum SimdLevel
+    {
+        SimdLevelNone,
+        SimdLevelSSE2,
+        SimdLevelAVX2,
+        SimdLevelNEON
+    };
+
+    // Convert a row of 'width' pixels from 'src' to 'dst'.
+    using SimdRowFunc = void (*)(const uint8_t *src, uint8_t *dst, int width);
+
+    /* Convert two rows of 'width' pixels, 'src0' and 'src1', to two luma
+     * rows, 'dstY0' and 'dstY1', and one chroma row 'dstUV'.
+     */
+    using SimdRowPairFunc = void (*)(const uint8_t *src0,
+                                     const uint8_t *src1,
+                                     uint8_t *dstY0,
+                                     uint8_t *dstY1,
+                                     uint8_t *dstUV,
+                                     int width);
+
+    // Split 'width' byte pairs of 'src' in 'dst0' and 'dst1'.
+    using SimdSplitFunc = void (*)(const uint8_t *src,
+                                   uint8_t *dst0,
+                                   uint8_t *dst1,
+                                   int width);
+
+    // Interleave 'width' bytes of 'src0' and 'src1' in 'dst'.
+    using SimdMergeFunc = void (*)(const uint8_t *src0,
+                                   const uint8_t *src1,
+                                   uint8_t *dst,
+                                   int width);
+
+    /* Blend 'width' bytes of 'src0' and 'src1' as
+     * (src0 * (256 - weight) + src1 * weight) >> 8, with a weight in
+     * [0, 256] for each byte.
+     */
+    using SimdBlendFunc = void (*)(const uint8_t *src0,
+                                   const uint8_t *src1,
+                                   const uint16_t *weights,
+                                   uint8_t *dst,
+                                   int width);
+
+    // Same as SimdBlendFunc, with the same weight for all bytes.
+    using SimdBlendRowFunc = void (*)(const uint8_t *src0,
+                                      const uint8_t *src1,
+                                      int weight,
+                                      uint8_t *dst,
+                                      int width);
+
+    // Add 'width' bytes of 'src' to the 16 bits sums in 'dst'.
+    using SimdAccumulateFunc = void (*)(const uint8_t *src,
+                                        uint16_t *dst,
+                                        int width);
+
+    /* Filter 'taps' rows of 'width' bytes, stored one after the other in
+     * 'src', with a coefficient for each byte in 'coeffs', laid out the same
+     * way:
+     *
+     * dst[x] = (sum(src[k * width + x] * coeffs[k * width + x]) + 128) >> 8
+     *
+     * saturated to 16 bits.
+     */
+    using SimdFilterFunc = void (*)(const uint8_t *src,
+                                    const int16_t *coeffs,
+                                    int taps,
+                                    int16_t *dst,
+                                    int width);
+
+    /* Filter 'taps' rows of the output of SimdFilterFunc, with a coefficient
+     * for each row:
+     *
+     * dst[x] = (sum(src[k][x] * coeffs[k]) + (1 << 19)) >> 20
+     *
+     * saturated to [0, 255].
+     */
+    using SimdFilterRowFunc = void (*)(const int16_t *const *src,
+                                       const int16_t *coeffs,
+                                       int taps,
+                                       uint8_t *dst,
+                                       int width);
+
+    /* Transpose a block of 'width' x 'height' elements of N bytes, the
+     * element at column x of line y of 'src' goes to column y of line x of
+     * 'dst'. The strides are in bytes and can be negative, which flips the
+     * block while transposing.
+     */
+    using SimdTransposeFunc = void (*)(const uint8_t *src,
+                                       ptrdiff_t srcStride,
+                                       uint8_t *dst,
+                                       ptrdiff_t dstStride,
+                                       int width,
+                                       int height);
+
+    /* Map 'width' 24 bits pixels through a table of 'size' x 'size' x 'size'
+     * nodes, with tetrahedral interpolation. Each node is a 32 bits word
+     * with the 3 bytes of the pixel in the lower bytes, the first byte of
+     * the pixel is the fastest changing axis of the table. 'axis' has 256
+     * entries for each byte of the pixel, with the offset in 'lut' of the
+     * node below the byte value, shifted by SIMD_LUT3D_SHIFT, and the
+     * distance to it in units of 1 / 256.
+     */
+    using SimdLut3dFunc = void (*)(const uint8_t *src,
+                                   uint8_t *dst,
+                                   int width,
+                                   const uint32_t *lut,
+                                   const uint32_t *axis,
+                                   int size);
+
+    /* Multiply 'width' chroma pairs (a, b), centered at 128, by the 2x2
+     * 'matrix', in units of 1 / 2^SIMD_CHROMA_SHIFT:
+     *
+     * a' = (matrix[0] * (a - 128) + matrix[1] * (b - 128)) + 128
+     * b' = (matrix[2] * (a - 128) + matrix[3] * (b - 128)) + 128
+     *
+     * rounded and saturated to [0, 255].
+     */
+    using SimdChromaFunc = void (*)(const uint8_t *src,
+                                    uint8_t *dst,
+                                    const int16_t *matrix,
+                                    int width);
+
+    /* Accumulate 'stripes' blocks of SIMD_HASH_STRIPE bytes of 'data' in
+     * the 8 lanes of 'acc'. 'index' is the number of the first block in the
+     * hashed buffer. Each 64 bits little endian word 'd', of the lane 'i' of
+     * the block 'n', does:
+     *
+     * k = SIMD_HASH_KEY * (8 * n + i + 1)
+     * acc[i] += lo32(d ^ k) * hi32(d ^ k)
+     * acc[i ^ 1] += d
+     *
+     * so the keys, and the hash, depend on the position of each word.
+     */
+    using SimdHashFunc = void (*)(const uint8_t *data,
+                                  size_t stripes,
+                                  uint64_t index,
+                                  uint64_t *acc);
+
+    struct SimdKernels
+    {
+        SimdLevel level;
+
+        // RGB to Luminance+Chrominance formats
+        SimdRowFunc rgb24ToYuy2;
+        SimdRowFunc rgb24ToUyvy;
+        SimdRowFunc bgr24ToYuy2;
+        SimdRowFunc bgr24ToUyvy;
+
+        // RGB to two planes -- one Y, one Cr + Cb interleaved
+        SimdRowPairFunc rgb24ToNv12;
+        SimdRowPairFunc rgb24ToNv21;
+        SimdRowPairFunc bgr24ToNv12;
+        SimdRowPairFunc bgr24ToNv21;
+
+        /* Swap the bytes of each pair, 'width' is the number of pairs.
+         * Repacks YUY2 <-> UYVY and the chroma plane of NV12 <-> NV21.
+         */
+        SimdRowFunc swapBytes;
+
+        /* Split the interleaved chroma plane of NV12/NV21 in the planes of
+         * I420/YV12, and back.
+         */
+        SimdSplitFunc splitBytes;
+        SimdMergeFunc mergeBytes;
+
+        /* Linear interpolation, the horizontal and vertical passes of the
+         * bilinear scaler.
+         */
+        SimdBlendFunc blendBytes;
+        SimdBlendRowFunc blendRows;
+
+        // Vertical pass of the area scaler.
+        SimdAccumulateFunc accumulateRow;
+
+        // Horizontal and vertical passes of the polyphase scaler.
+        SimdFilterFunc filterBytes;
+        SimdFilterRowFunc filterRows;
+
+        /* Transposes of 8, 16, 24 and 32 bits elements, used for rotating
+         * the planes of a frame.
+         */
+        SimdTransposeFunc transpose8;
+        SimdTransposeFunc transpose16;
+        SimdTransposeFunc transpose24;
+        SimdTransposeFunc transpose32;
+
+        /* Reverse the order of 'width' pixels of 8, 16, 24 and 32 bits, and
+         * of 'width' YUY2 and UYVY macropixels, swapping their lumas. 'src'
+         * and 'dst' can be the same line.
+         */
+        SimdRowFunc mirror8;
+        SimdRowFunc mirror16;
+        SimdRowFunc mirror24;
+        SimdRowFunc mirror32;
+        SimdRowFunc mirrorYuy2;
+        SimdRowFunc mirrorUyvy;
+
+        /* Swap the red and blue components of 'width' pixels, RGB15/BGR15,
+         * RGB16/BGR16, RGB24/BGR24, RGB32 and BGR32 respectively. 'src' and
+         * 'dst' can be the same line.
+         */
+        SimdRowFunc swapRgb15;
+        SimdRowFunc swapRgb16;
+        SimdRowFunc swapRgb24;
+        SimdRowFunc swapRgb32;
+        SimdRowFunc swapBgr32;
+
+        // Color adjusts folded in a 3D table.
+        SimdLut3dFunc lut3d;
+
+        // Hue and saturation of YUV frames.
+        SimdChromaFunc adjustChroma;
+
+        SimdHashFunc hashStripes;
+    };
+
+    namespace Simd
+    {
+        // Best instruction set supported by the CPU.
+        SimdLevel detectedLevel();
+
+        // Kernels for the best instruction set supported by the CPU.
+        const SimdKernels &kernels();
+
+        /* Kernels for the given instruction set, the kernels not available
+         * for it are taken from the scalar reference implementation.
+         */
+        const SimdKernels &kernels(SimdLevel level);
+
+        /* Fast, non cryptographic, hash of 'size' bytes of 'data'. It runs
+         * at about the speed of reading the memory, good for telling if a
+         * frame changed without keeping a copy of it.
+         */
+        uint64_t hash(const void *data, size_t size);
+
+        /* Nodes of the tetrahedron of 'lut' that encloses 'pixel', and their
+         * weights, that add up to 256. From the node below the pixel, the
+         * tetrahedron walks the axes from the nearest to the farthest one.
+         */
+        inline void lut3dVertices(const uint8_t *pixel,
+                                  const uint32_t *axis,
+                                  int size,
+                                  int *offsets,
+                                  int *weights)
+        {
+            auto a0 = axis[pixel[0]];
+            auto a1 = axis[256 + pixel[1]];
+            auto a2 = axis[512 + pixel[2]];
+            int f0 = int(a0 & SIMD_LUT3D_MASK);
+            int f1 = int(a1 & SIMD_LUT3D_MASK);
+            int f2 = int(a2 & SIMD_LUT3D_MASK);
+            int hi = f0 > f1? (f0 > f2? f0: f2): (f1 > f2? f1: f2);
+            int lo = f0 < f1? (f0 < f2? f0: f2): (f1 < f2? f1: f2);
+            int mid = f0 + f1 + f2 - hi - lo;
+            int s0 = 1;
+            int s1 = size;
+            int s2 = size * size;
+            int sHi = f0 == hi? s0: f1 == hi? s1: s2;
+            int sLo = f0 == lo? s0: f1 == lo? s1: s2;
+
+            offsets[0] = int((a0 >> SIMD_LUT3D_SHIFT)
+                             + (a1 >> SIMD_LUT3D_SHIFT)
+                             + (a2 >> SIMD_LUT3D_SHIFT));
+            offsets[1] = offsets[0] + sHi;
+            offsets[3] = offsets[0] + s0 + s1 + s2;
+            offsets[2] = offsets[3] - sLo;
+            weights[0] = 256 - hi;
+            weights[1] = hi - mid;
+            weights[2] = mid - lo;
+            weights[3] = lo;
+        }
+
+        // Replace the kernels implemented for each instruction set.
+        bool loadSse2(SimdKernels *kernels);
+        bool loadAvx2(SimdKernels *kernels);
+        bool loadNeon(SimdKernels *kernels);
+    }
+}
+
+#endif // AKVCAMUTILS_SIMD_H
@@ -0,0 +1,530 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include "simd.h"
+
+/* This file is built with AVX2 code generation enabled, so nothing here can
+ * be called unless the CPU supports it.
+ */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace AkVCam
+{
+    namespace Avx2
+    {
+        /* Split 16 packed 24 bits pixels into its components.
+         *
+         * 'p' points to the 48 bytes of pixel data, the components are
+         * returned in c0, c1 and c2 by byte order.
+         */
+        inline void deinterleave3(const uint8_t *p,
+                                  __m128i *c0, __m128i *c1, __m128i *c2)
+        {
+            auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+            auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32));
+
+            *c0 = _mm_or_si128(_mm_or_si128(
+                      _mm_shuffle_epi8(a, _mm_setr_epi8( 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                      _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1))),
+                      _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13)));
+            *c1 = _mm_or_si128(_mm_or_si128(
+                      _mm_shuffle_epi8(a, _mm_setr_epi8( 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                      _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1))),
+                      _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14)));
+            *c2 = _mm_or_si128(_mm_or_si128(
+                      _mm_shuffle_epi8(a, _mm_setr_epi8( 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                      _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1))),
+                      _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15)));
+        }
+
+        inline __m256i weightedSum(__m256i r, __m256i g, __m256i b,
+                                   short kr, short kg, short kb)
+        {
+            auto sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(kr)),
+                                        _mm256_mullo_epi16(g, _mm256_set1_epi16(kg)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(kb)));
+
+            return _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+        }
+
+        inline __m256i rgbY(__m256i r, __m256i g, __m256i b)
+        {
+            auto y = _mm256_srli_epi16(weightedSum(r, g, b, 66, 129, 25), 8);
+
+            return _mm256_add_epi16(y, _mm256_set1_epi16(16));
+        }
+
+        inline __m256i rgbChroma(__m256i r, __m256i g, __m256i b,
+                                 short kr, short kg, short kb)
+        {
+            auto c = _mm256_srai_epi16(weightedSum(r, g, b, kr, kg, kb), 8);
+
+            return _mm256_add_epi16(c, _mm256_set1_epi16(128));
+        }
+
+        // Same as Sse2::rgbToPacked422 but for 16 pixels.
+        template<bool YFirst>
+        inline __m256i rgbToPacked422(__m256i r, __m256i g, __m256i b)
+        {
+            auto y = rgbY(r, g, b);
+            auto u = rgbChroma(r, g, b, -38, -74, 112);
+            auto v = rgbChroma(r, g, b, 112, -94, -18);
+            auto c = _mm256_blend_epi16(v, _mm256_slli_epi32(u, 16), 0xaa);
+
+            if (YFirst)
+                return _mm256_or_si256(y, _mm256_slli_epi16(c, 8));
+
+            return _mm256_or_si256(c, _mm256_slli_epi16(y, 8));
+        }
+
+        // Same as Sse2::average2x2 but for 16 components.
+        inline __m256i average2x2(__m256i row0, __m256i row1)
+        {
+            auto sum = _mm256_add_epi16(row0, row1);
+            sum = _mm256_add_epi16(sum, _mm256_srli_epi32(sum, 16));
+            sum = _mm256_blend_epi16(sum, _mm256_setzero_si256(), 0xaa);
+
+            return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(2)), 2);
+        }
+
+        // Pack the even words of v into 8 bytes.
+        inline __m128i packEven(__m256i v)
+        {
+            v = _mm256_blend_epi16(v, _mm256_setzero_si256(), 0xaa);
+            auto words = _mm_packs_epi32(_mm256_castsi256_si128(v),
+                                         _mm256_extracti128_si256(v, 1));
+
+            return _mm_packus_epi16(words, words);
+        }
+
+        template<bool Bgr, bool YFirst>
+        void rgb24ToPacked422(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                __m128i c0;
+                __m128i c1;
+                __m128i c2;
+                deinterleave3(src + 3 * x, &c0, &c1, &c2);
+                auto r = _mm256_cvtepu8_epi16(Bgr? c0: c2);
+                auto g = _mm256_cvtepu8_epi16(c1);
+                auto b = _mm256_cvtepu8_epi16(Bgr? c2: c0);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * x),
+                                    rgbToPacked422<YFirst>(r, g, b));
+            }
+
+            if (x < width) {
+                auto tail = Bgr?
+                                YFirst? reference.bgr24ToYuy2: reference.bgr24ToUyvy:
+                                YFirst? reference.rgb24ToYuy2: reference.rgb24ToUyvy;
+                tail(src + 3 * x, dst + 2 * x, width - x);
+            }
+        }
+
+        template<bool Bgr, bool VFirst>
+        void rgb24ToNv(const uint8_t *src0,
+                       const uint8_t *src1,
+                       uint8_t *dstY0,
+                       uint8_t *dstY1,
+                       uint8_t *dstUV,
+                       int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                __m256i r[2];
+                __m256i g[2];
+                __m256i b[2];
+                const uint8_t *src[] {src0, src1};
+                uint8_t *dstY[] {dstY0, dstY1};
+
+                for (int i = 0; i < 2; i++) {
+                    __m128i c0;
+                    __m128i c1;
+                    __m128i c2;
+                    deinterleave3(src[i] + 3 * x, &c0, &c1, &c2);
+                    r[i] = _mm256_cvtepu8_epi16(Bgr? c0: c2);
+                    g[i] = _mm256_cvtepu8_epi16(c1);
+                    b[i] = _mm256_cvtepu8_epi16(Bgr? c2: c0);
+                    auto y = rgbY(r[i], g[i], b[i]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dstY[i] + x),
+                                     _mm_packus_epi16(_mm256_castsi256_si128(y),
+                                                      _mm256_extracti128_si256(y, 1)));
+                }
+
+                auto ra = average2x2(r[0], r[1]);
+                auto ga = average2x2(g[0], g[1]);
+                auto ba = average2x2(b[0], b[1]);
+                auto u = packEven(rgbChroma(ra, ga, ba, -38, -74, 112));
+                auto v = packEven(rgbChroma(ra, ga, ba, 112, -94, -18));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dstUV + x),
+                                 VFirst?
+                                    _mm_unpacklo_epi8(v, u):
+                                    _mm_unpacklo_epi8(u, v));
+            }
+
+            if (x < width) {
+                auto tail = Bgr?
+                                VFirst? reference.bgr24ToNv12: reference.bgr24ToNv21:
+                                VFirst? reference.rgb24ToNv12: reference.rgb24ToNv21;
+                tail(src0 + 3 * x,
+                     src1 + 3 * x,
+                     dstY0 + x,
+                     dstY1 + x,
+                     dstUV + x,
+                     width - x);
+            }
+        }
+
+        void swapBytes(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * x));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * x),
+                                    _mm256_or_si256(_mm256_slli_epi16(v, 8),
+                                                    _mm256_srli_epi16(v, 8)));
+            }
+
+            if (x < width)
+                reference.swapBytes(src + 2 * x, dst + 2 * x, width - x);
+        }
+
+        void splitBytes(const uint8_t *src,
+                        uint8_t *dst0,
+                        uint8_t *dst1,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = _mm256_set1_epi16(0xff);
+            int x = 0;
+
+            // The packs work per 128 bits lane, the permute restores the order.
+            for (; x + 32 <= width; x += 32) {
+                auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * x));
+                auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * x + 32));
+                auto even = _mm256_packus_epi16(_mm256_and_si256(v0, mask),
+                                                _mm256_and_si256(v1, mask));
+                auto odd = _mm256_packus_epi16(_mm256_srli_epi16(v0, 8),
+                                               _mm256_srli_epi16(v1, 8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst0 + x),
+                                    _mm256_permute4x64_epi64(even, 0xd8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst1 + x),
+                                    _mm256_permute4x64_epi64(odd, 0xd8));
+            }
+
+            if (x < width)
+                reference.splitBytes(src + 2 * x, dst0 + x, dst1 + x, width - x);
+        }
+
+        void mergeBytes(const uint8_t *src0,
+                        const uint8_t *src1,
+                        uint8_t *dst,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32) {
+                auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src0 + x));
+                auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src1 + x));
+                auto lo = _mm256_unpacklo_epi8(v0, v1);
+                auto hi = _mm256_unpackhi_epi8(v0, v1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * x),
+                                    _mm256_permute2x128_si256(lo, hi, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * x + 32),
+                                    _mm256_permute2x128_si256(lo, hi, 0x31));
+            }
+
+            if (x < width)
+                reference.mergeBytes(src0 + x, src1 + x, dst + 2 * x, width - x);
+        }
+
+        // (a * w0 + b * w1) >> 8 for 16 values in 16 bits.
+        inline __m256i blend(__m256i a, __m256i b, __m256i w0, __m256i w1)
+        {
+            return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, w0),
+                                                      _mm256_mullo_epi16(b, w1)), 8);
+        }
+
+        inline __m256i loadWide(const uint8_t *src)
+        {
+            return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+        }
+
+        // The pack works per 128 bits lane, the permute restores the order.
+        inline void storeNarrow(uint8_t *dst, __m256i lo, __m256i hi)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst),
+                                _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi),
+                                                         0xd8));
+        }
+
+        void blendBytes(const uint8_t *src0,
+                        const uint8_t *src1,
+                        const uint16_t *weights,
+                        uint8_t *dst,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto one = _mm256_set1_epi16(256);
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32) {
+                auto w1lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + x));
+                auto w1hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + x + 16));
+                auto lo = blend(loadWide(src0 + x),
+                                loadWide(src1 + x),
+                                _mm256_sub_epi16(one, w1lo),
+                                w1lo);
+                auto hi = blend(loadWide(src0 + x + 16),
+                                loadWide(src1 + x + 16),
+                                _mm256_sub_epi16(one, w1hi),
+                                w1hi);
+                storeNarrow(dst + x, lo, hi);
+            }
+
+            if (x < width)
+                reference.blendBytes(src0 + x,
+                                     src1 + x,
+                                     weights + x,
+                                     dst + x,
+                                     width - x);
+        }
+
+        void blendRows(const uint8_t *src0,
+                       const uint8_t *src1,
+                       int weight,
+                       uint8_t *dst,
+                       int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto w0 = _mm256_set1_epi16(short(256 - weight));
+            auto w1 = _mm256_set1_epi16(short(weight));
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32) {
+                auto lo = blend(loadWide(src0 + x), loadWide(src1 + x), w0, w1);
+                auto hi = blend(loadWide(src0 + x + 16),
+                                loadWide(src1 + x + 16),
+                                w0,
+                                w1);
+                storeNarrow(dst + x, lo, hi);
+            }
+
+            if (x < width)
+                reference.blendRows(src0 + x, src1 + x, weight, dst + x, width - x);
+        }
+
+        void accumulateRow(const uint8_t *src, uint16_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32) {
+                auto lo = reinterpret_cast<__m256i *>(dst + x);
+                auto hi = reinterpret_cast<__m256i *>(dst + x + 16);
+                _mm256_storeu_si256(lo, _mm256_add_epi16(_mm256_loadu_si256(lo),
+                                                         loadWide(src + x)));
+                _mm256_storeu_si256(hi, _mm256_add_epi16(_mm256_loadu_si256(hi),
+                                                         loadWide(src + x + 16)));
+            }
+
+            if (x < width)
+                reference.accumulateRow(src + x, dst + x, width - x);
+        }
+
+        /* Multiply and add two taps of 16 values in 16 bits, the values and
+         * the coefficients of both taps are interleaved so each pair is
+         * added in 32 bits. The unpack works per 128 bits lane, packing 'lo'
+         * and 'hi' restores the order.
+         */
+        inline void multiplyAdd(__m256i a, __m256i b,
+                                __m256i ca, __m256i cb,
+                                __m256i *lo, __m256i *hi)
+        {
+            *lo = _mm256_add_epi32(*lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b),
+                                                          _mm256_unpacklo_epi16(ca, cb)));
+            *hi = _mm256_add_epi32(*hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b),
+                                                          _mm256_unpackhi_epi16(ca, cb)));
+        }
+
+        // Filter 16 values, from 'x'.
+        inline void filterBytesBlock(const uint8_t *src,
+                                     const int16_t *coeffs,
+                                     int taps,
+                                     int16_t *dst,
+                                     int width,
+                                     int x)
+        {
+            auto zero = _mm256_setzero_si256();
+            auto lo = _mm256_set1_epi32(128);
+            auto hi = lo;
+
+            for (int k = 0; k < taps; k += 2) {
+                auto a = loadWide(src + k * width + x);
+                auto ca = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(coeffs + k * width + x));
+                auto b = zero;
+                auto cb = zero;
+
+                if (k + 1 < taps) {
+                    b = loadWide(src + (k + 1) * width + x);
+                    cb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(coeffs + (k + 1) * width + x));
+                }
+
+                multiplyAdd(a, b, ca, cb, &lo, &hi);
+            }
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                                _mm256_packs_epi32(_mm256_srai_epi32(lo, 8),
+                                                   _mm256_srai_epi32(hi, 8)));
+        }
+
+        /* The rows are 'width' values apart, so the last values can't be
+         * passed to the reference, the last block overlaps the previous one
+         * instead.
+         */
+        void filterBytes(const uint8_t *src,
+                         const int16_t *coeffs,
+                         int taps,
+                         int16_t *dst,
+                         int width)
+        {
+            if (width < 16) {
+                Simd::kernels(SimdLevelNone).filterBytes(src,
+                                                         coeffs,
+                                                         taps,
+                                                         dst,
+                                                         width);
+
+                return;
+            }
+
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16)
+                filterBytesBlock(src, coeffs, taps, dst, width, x);
+
+            if (x < width)
+                filterBytesBlock(src, coeffs, taps, dst, width, width - 16);
+        }
+
+        // Filter 32 values, from 'x'.
+        inline void filterRowsBlock(const int16_t *const *src,
+                                    const int16_t *coeffs,
+                                    int taps,
+                                    uint8_t *dst,
+                                    int x)
+        {
+            auto zero = _mm256_setzero_si256();
+            auto round = _mm256_set1_epi32(1 << 19);
+            __m256i sums[4] {round, round, round, round};
+
+            for (int k = 0; k < taps; k += 2) {
+                auto ca = _mm256_set1_epi16(coeffs[k]);
+                auto cb = zero;
+
+                if (k + 1 < taps)
+                    cb = _mm256_set1_epi16(coeffs[k + 1]);
+
+                for (int i = 0; i < 2; i++) {
+                    auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src[k] + x + 16 * i));
+                    auto b = zero;
+
+                    if (k + 1 < taps)
+                        b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src[k + 1] + x + 16 * i));
+
+                    multiplyAdd(a, b, ca, cb, sums + 2 * i, sums + 2 * i + 1);
+                }
+            }
+
+            storeNarrow(dst + x,
+                        _mm256_packs_epi32(_mm256_srai_epi32(sums[0], 20),
+                                           _mm256_srai_epi32(sums[1], 20)),
+                        _mm256_packs_epi32(_mm256_srai_epi32(sums[2], 20),
+                                           _mm256_srai_epi32(sums[3], 20)));
+        }
+
+        void filterRows(const int16_t *const *src,
+                        const int16_t *coeffs,
+                        int taps,
+                        uint8_t *dst,
+                        int width)
+        {
+            if (width < 32) {
+                Simd::kernels(SimdLevelNone).filterRows(src,
+                                                        coeffs,
+                                                        taps,
+                                                        dst,
+                                                        width);
+
+                return;
+            }
+
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32)
+                filterRowsBlock(src, coeffs, taps, dst, x);
+
+            if (x < width)
+                filterRowsBlock(src, coeffs, taps, dst, width - 32);
+        }
+    }
+}
+
+bool AkVCam::Simd::loadAvx2(SimdKernels *kernels)
+{
+    kernels->rgb24ToYuy2 = Avx2::rgb24ToPacked422<false, true>;
+    kernels->rgb24ToUyvy = Avx2::rgb24ToPacked422<false, false>;
+    kernels->bgr24ToYuy2 = Avx2::rgb24ToPacked422<true, true>;
+    kernels->bgr24ToUyvy = Avx2::rgb24ToPacked422<true, false>;
+    kernels->rgb24ToNv12 = Avx2::rgb24ToNv<false, true>;
+    kernels->rgb24ToNv21 = Avx2::rgb24ToNv<false, false>;
+    kernels->bgr24ToNv12 = Avx2::rgb24ToNv<true, true>;
+    kernels->bgr24ToNv21 = Avx2::rgb24ToNv<true, false>;
+    kernels->swapBytes = Avx2::swapBytes;
+    kernels->splitBytes = Avx2::splitBytes;
+    kernels->mergeBytes = Avx2::mergeBytes;
+    kernels->blendBytes = Avx2::blendBytes;
+    kernels->blendRows = Avx2::blendRows;
+    kernels->accumulateRow = Avx2::accumulateRow;
+    kernels->filterBytes = Avx2::filterBytes;
+    kernels->filterRows = Avx2::filterRows;
+
+    return true;
+}
+
+#else
+
+bool AkVCam::Simd::loadAvx2(SimdKernels *kernels)
+{
+    (void) kernels;
+
+    return false;
+}
+
+#endif
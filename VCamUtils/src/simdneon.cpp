@@ -0,0 +1,877 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <cstring>
+
+#include "simd.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+namespace AkVCam
+{
+    namespace Neon
+    {
+        inline uint8x8_t rgbY(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+        {
+            auto sum = vmull_u8(r, vdup_n_u8(66));
+            sum = vmlal_u8(sum, g, vdup_n_u8(129));
+            sum = vmlal_u8(sum, b, vdup_n_u8(25));
+            sum = vaddq_u16(sum, vdupq_n_u16(128));
+
+            return vadd_u8(vshrn_n_u16(sum, 8), vdup_n_u8(16));
+        }
+
+        inline uint8x8_t rgbChroma(uint8x8_t r, uint8x8_t g, uint8x8_t b,
+                                   int16_t kr, int16_t kg, int16_t kb)
+        {
+            auto r16 = vreinterpretq_s16_u16(vmovl_u8(r));
+            auto g16 = vreinterpretq_s16_u16(vmovl_u8(g));
+            auto b16 = vreinterpretq_s16_u16(vmovl_u8(b));
+            auto sum = vmulq_n_s16(r16, kr);
+            sum = vmlaq_n_s16(sum, g16, kg);
+            sum = vmlaq_n_s16(sum, b16, kb);
+            sum = vshrq_n_s16(vaddq_s16(sum, vdupq_n_s16(128)), 8);
+            sum = vaddq_s16(sum, vdupq_n_s16(128));
+
+            return vmovn_u16(vreinterpretq_u16_s16(sum));
+        }
+
+        template<bool Bgr, bool YFirst>
+        void rgb24ToPacked422(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto pixels = vld3q_u8(src + 3 * x);
+                auto r = Bgr? pixels.val[0]: pixels.val[2];
+                auto g = pixels.val[1];
+                auto b = Bgr? pixels.val[2]: pixels.val[0];
+
+                auto y = vcombine_u8(rgbY(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)),
+                                     rgbY(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+                auto u = vcombine_u8(rgbChroma(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b), -38, -74, 112),
+                                     rgbChroma(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b), -38, -74, 112));
+                auto v = vcombine_u8(rgbChroma(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b), 112, -94, -18),
+                                     rgbChroma(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b), 112, -94, -18));
+
+                // V0 U0 V2 U2 ... the chroma of the even pixels.
+                auto c = vtrnq_u8(v, u).val[0];
+                uint8x16x2_t packed;
+                packed.val[0] = YFirst? y: c;
+                packed.val[1] = YFirst? c: y;
+                vst2q_u8(dst + 2 * x, packed);
+            }
+
+            if (x < width) {
+                auto tail = Bgr?
+                                YFirst? reference.bgr24ToYuy2: reference.bgr24ToUyvy:
+                                YFirst? reference.rgb24ToYuy2: reference.rgb24ToUyvy;
+                tail(src + 3 * x, dst + 2 * x, width - x);
+            }
+        }
+
+        // Rounded average of each 2x2 block.
+        inline uint8x8_t average2x2(uint8x16_t row0, uint8x16_t row1)
+        {
+            auto sum = vaddq_u16(vpaddlq_u8(row0), vpaddlq_u8(row1));
+
+            return vmovn_u16(vrshrq_n_u16(sum, 2));
+        }
+
+        template<bool Bgr, bool VFirst>
+        void rgb24ToNv(const uint8_t *src0,
+                       const uint8_t *src1,
+                       uint8_t *dstY0,
+                       uint8_t *dstY1,
+                       uint8_t *dstUV,
+                       int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto pixels0 = vld3q_u8(src0 + 3 * x);
+                auto pixels1 = vld3q_u8(src1 + 3 * x);
+                uint8x16_t r[] {pixels0.val[Bgr? 0: 2], pixels1.val[Bgr? 0: 2]};
+                uint8x16_t g[] {pixels0.val[1], pixels1.val[1]};
+                uint8x16_t b[] {pixels0.val[Bgr? 2: 0], pixels1.val[Bgr? 2: 0]};
+                uint8_t *dstY[] {dstY0, dstY1};
+
+                for (int i = 0; i < 2; i++)
+                    vst1q_u8(dstY[i] + x,
+                             vcombine_u8(rgbY(vget_low_u8(r[i]), vget_low_u8(g[i]), vget_low_u8(b[i])),
+                                         rgbY(vget_high_u8(r[i]), vget_high_u8(g[i]), vget_high_u8(b[i]))));
+
+                auto ra = average2x2(r[0], r[1]);
+                auto ga = average2x2(g[0], g[1]);
+                auto ba = average2x2(b[0], b[1]);
+                auto u = rgbChroma(ra, ga, ba, -38, -74, 112);
+                auto v = rgbChroma(ra, ga, ba, 112, -94, -18);
+                uint8x8x2_t chroma;
+                chroma.val[0] = VFirst? v: u;
+                chroma.val[1] = VFirst? u: v;
+                vst2_u8(dstUV + x, chroma);
+            }
+
+            if (x < width) {
+                auto tail = Bgr?
+                                VFirst? reference.bgr24ToNv12: reference.bgr24ToNv21:
+                                VFirst? reference.rgb24ToNv12: reference.rgb24ToNv21;
+                tail(src0 + 3 * x,
+                     src1 + 3 * x,
+                     dstY0 + x,
+                     dstY1 + x,
+                     dstUV + x,
+                     width - x);
+            }
+        }
+
+        void swapBytes(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8)
+                vst1q_u8(dst + 2 * x, vrev16q_u8(vld1q_u8(src + 2 * x)));
+
+            if (x < width)
+                reference.swapBytes(src + 2 * x, dst + 2 * x, width - x);
+        }
+
+        void splitBytes(const uint8_t *src,
+                        uint8_t *dst0,
+                        uint8_t *dst1,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v = vld2q_u8(src + 2 * x);
+                vst1q_u8(dst0 + x, v.val[0]);
+                vst1q_u8(dst1 + x, v.val[1]);
+            }
+
+            if (x < width)
+                reference.splitBytes(src + 2 * x, dst0 + x, dst1 + x, width - x);
+        }
+
+        void mergeBytes(const uint8_t *src0,
+                        const uint8_t *src1,
+                        uint8_t *dst,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                uint8x16x2_t v;
+                v.val[0] = vld1q_u8(src0 + x);
+                v.val[1] = vld1q_u8(src1 + x);
+                vst2q_u8(dst + 2 * x, v);
+            }
+
+            if (x < width)
+                reference.mergeBytes(src0 + x, src1 + x, dst + 2 * x, width - x);
+        }
+
+        // (a * w0 + b * w1) >> 8 for 8 values.
+        inline uint8x8_t blend(uint8x8_t a, uint8x8_t b,
+                               uint16x8_t w0, uint16x8_t w1)
+        {
+            auto sum = vmulq_u16(vmovl_u8(a), w0);
+            sum = vmlaq_u16(sum, vmovl_u8(b), w1);
+
+            return vshrn_n_u16(sum, 8);
+        }
+
+        void blendBytes(const uint8_t *src0,
+                        const uint8_t *src1,
+                        const uint16_t *weights,
+                        uint8_t *dst,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto one = vdupq_n_u16(256);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto a = vld1q_u8(src0 + x);
+                auto b = vld1q_u8(src1 + x);
+                auto w1lo = vld1q_u16(weights + x);
+                auto w1hi = vld1q_u16(weights + x + 8);
+                auto lo = blend(vget_low_u8(a),
+                                vget_low_u8(b),
+                                vsubq_u16(one, w1lo),
+                                w1lo);
+                auto hi = blend(vget_high_u8(a),
+                                vget_high_u8(b),
+                                vsubq_u16(one, w1hi),
+                                w1hi);
+                vst1q_u8(dst + x, vcombine_u8(lo, hi));
+            }
+
+            if (x < width)
+                reference.blendBytes(src0 + x,
+                                     src1 + x,
+                                     weights + x,
+                                     dst + x,
+                                     width - x);
+        }
+
+        void blendRows(const uint8_t *src0,
+                       const uint8_t *src1,
+                       int weight,
+                       uint8_t *dst,
+                       int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto w0 = vdupq_n_u16(uint16_t(256 - weight));
+            auto w1 = vdupq_n_u16(uint16_t(weight));
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto a = vld1q_u8(src0 + x);
+                auto b = vld1q_u8(src1 + x);
+                auto lo = blend(vget_low_u8(a), vget_low_u8(b), w0, w1);
+                auto hi = blend(vget_high_u8(a), vget_high_u8(b), w0, w1);
+                vst1q_u8(dst + x, vcombine_u8(lo, hi));
+            }
+
+            if (x < width)
+                reference.blendRows(src0 + x, src1 + x, weight, dst + x, width - x);
+        }
+
+        void accumulateRow(const uint8_t *src, uint16_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v = vld1q_u8(src + x);
+                vst1q_u16(dst + x, vaddw_u8(vld1q_u16(dst + x), vget_low_u8(v)));
+                vst1q_u16(dst + x + 8,
+                          vaddw_u8(vld1q_u16(dst + x + 8), vget_high_u8(v)));
+            }
+
+            if (x < width)
+                reference.accumulateRow(src + x, dst + x, width - x);
+        }
+
+        // Filter 8 values, from 'x'.
+        inline void filterBytesBlock(const uint8_t *src,
+                                     const int16_t *coeffs,
+                                     int taps,
+                                     int16_t *dst,
+                                     int width,
+                                     int x)
+        {
+            auto lo = vdupq_n_s32(0);
+            auto hi = vdupq_n_s32(0);
+
+            for (int k = 0; k < taps; k++) {
+                auto a = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src + k * width + x)));
+                auto c = vld1q_s16(coeffs + k * width + x);
+                lo = vmlal_s16(lo, vget_low_s16(a), vget_low_s16(c));
+                hi = vmlal_s16(hi, vget_high_s16(a), vget_high_s16(c));
+            }
+
+            vst1q_s16(dst + x, vcombine_s16(vqmovn_s32(vrshrq_n_s32(lo, 8)),
+                                            vqmovn_s32(vrshrq_n_s32(hi, 8))));
+        }
+
+        /* The rows are 'width' values apart, so the last values can't be
+         * passed to the reference, the last block overlaps the previous one
+         * instead.
+         */
+        void filterBytes(const uint8_t *src,
+                         const int16_t *coeffs,
+                         int taps,
+                         int16_t *dst,
+                         int width)
+        {
+            if (width < 8) {
+                Simd::kernels(SimdLevelNone).filterBytes(src,
+                                                         coeffs,
+                                                         taps,
+                                                         dst,
+                                                         width);
+
+                return;
+            }
+
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8)
+                filterBytesBlock(src, coeffs, taps, dst, width, x);
+
+            if (x < width)
+                filterBytesBlock(src, coeffs, taps, dst, width, width - 8);
+        }
+
+        // Filter 16 values, from 'x'.
+        inline void filterRowsBlock(const int16_t *const *src,
+                                    const int16_t *coeffs,
+                                    int taps,
+                                    uint8_t *dst,
+                                    int x)
+        {
+            int32x4_t sums[4];
+
+            for (auto &sum: sums)
+                sum = vdupq_n_s32(0);
+
+            for (int k = 0; k < taps; k++)
+                for (int i = 0; i < 2; i++) {
+                    auto a = vld1q_s16(src[k] + x + 8 * i);
+                    sums[2 * i] = vmlal_n_s16(sums[2 * i], vget_low_s16(a), coeffs[k]);
+                    sums[2 * i + 1] = vmlal_n_s16(sums[2 * i + 1], vget_high_s16(a), coeffs[k]);
+                }
+
+            uint8x8_t narrow[2];
+
+            for (int i = 0; i < 2; i++)
+                narrow[i] = vqmovun_s16(vcombine_s16(vqmovn_s32(vrshrq_n_s32(sums[2 * i], 20)),
+                                                     vqmovn_s32(vrshrq_n_s32(sums[2 * i + 1], 20))));
+
+            vst1q_u8(dst + x, vcombine_u8(narrow[0], narrow[1]));
+        }
+
+        void filterRows(const int16_t *const *src,
+                        const int16_t *coeffs,
+                        int taps,
+                        uint8_t *dst,
+                        int width)
+        {
+            if (width < 16) {
+                Simd::kernels(SimdLevelNone).filterRows(src,
+                                                        coeffs,
+                                                        taps,
+                                                        dst,
+                                                        width);
+
+                return;
+            }
+
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16)
+                filterRowsBlock(src, coeffs, taps, dst, x);
+
+            if (x < width)
+                filterRowsBlock(src, coeffs, taps, dst, width - 16);
+        }
+        // Interleave the low and the high halves of 'a' and 'b'.
+        template<int Bytes>
+        inline void unpack(uint8x16_t a, uint8x16_t b, uint8x16_t *lo, uint8x16_t *hi);
+
+        template<>
+        inline void unpack<1>(uint8x16_t a, uint8x16_t b, uint8x16_t *lo, uint8x16_t *hi)
+        {
+            auto zip = vzipq_u8(a, b);
+            *lo = zip.val[0];
+            *hi = zip.val[1];
+        }
+
+        template<>
+        inline void unpack<2>(uint8x16_t a, uint8x16_t b, uint8x16_t *lo, uint8x16_t *hi)
+        {
+            auto zip = vzipq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b));
+            *lo = vreinterpretq_u8_u16(zip.val[0]);
+            *hi = vreinterpretq_u8_u16(zip.val[1]);
+        }
+
+        template<>
+        inline void unpack<4>(uint8x16_t a, uint8x16_t b, uint8x16_t *lo, uint8x16_t *hi)
+        {
+            auto zip = vzipq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b));
+            *lo = vreinterpretq_u8_u32(zip.val[0]);
+            *hi = vreinterpretq_u8_u32(zip.val[1]);
+        }
+
+        /* Transpose a tile of N x N elements, N = 16 / Bytes, in registers.
+         *
+         * Each pass interleaves the first half of the lines with the second
+         * half, after log2(N) passes line i holds column i.
+         */
+        template<int Bytes>
+        inline void transposeTile(const uint8_t *src,
+                                  ptrdiff_t srcStride,
+                                  uint8_t *dst,
+                                  ptrdiff_t dstStride)
+        {
+            const int n = 16 / Bytes;
+            uint8x16_t v[n];
+            uint8x16_t t[n];
+
+            for (int i = 0; i < n; i++)
+                v[i] = vld1q_u8(src + i * srcStride);
+
+            for (int pass = n; pass > 1; pass /= 2) {
+                for (int i = 0; i < n / 2; i++)
+                    unpack<Bytes>(v[i], v[i + n / 2], t + 2 * i, t + 2 * i + 1);
+
+                for (int i = 0; i < n; i++)
+                    v[i] = t[i];
+            }
+
+            for (int i = 0; i < n; i++)
+                vst1q_u8(dst + i * dstStride, v[i]);
+        }
+
+        template<int Bytes>
+        void transpose(const uint8_t *src,
+                       ptrdiff_t srcStride,
+                       uint8_t *dst,
+                       ptrdiff_t dstStride,
+                       int width,
+                       int height)
+        {
+            const int n = 16 / Bytes;
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto tail = Bytes == 1? reference.transpose8:
+                        Bytes == 2? reference.transpose16:
+                                    reference.transpose32;
+            int x = 0;
+
+            for (; x + n <= width; x += n) {
+                auto srcColumn = src + Bytes * x;
+                auto dstLine = dst + x * dstStride;
+                int y = 0;
+
+                for (; y + n <= height; y += n)
+                    transposeTile<Bytes>(srcColumn + y * srcStride,
+                                         srcStride,
+                                         dstLine + Bytes * y,
+                                         dstStride);
+
+                if (y < height)
+                    tail(srcColumn + y * srcStride,
+                         srcStride,
+                         dstLine + Bytes * y,
+                         dstStride,
+                         n,
+                         height - y);
+            }
+
+            if (x < width)
+                tail(src + Bytes * x,
+                     srcStride,
+                     dst + x * dstStride,
+                     dstStride,
+                     width - x,
+                     height);
+        }
+
+        inline uint8x16_t reverse8(uint8x16_t v)
+        {
+            v = vrev64q_u8(v);
+
+            return vcombine_u8(vget_high_u8(v), vget_low_u8(v));
+        }
+
+        inline uint8x16_t reverse16(uint8x16_t v)
+        {
+            v = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(v)));
+
+            return vcombine_u8(vget_high_u8(v), vget_low_u8(v));
+        }
+
+        inline uint8x16_t reverse32(uint8x16_t v)
+        {
+            v = vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(v)));
+
+            return vcombine_u8(vget_high_u8(v), vget_low_u8(v));
+        }
+
+        /* Swap the bytes selected by 'mask', which must be one of each pair
+         * of bytes, with the ones 2 bytes apart in the same 32 bits element.
+         */
+        inline uint8x16_t swapHalves(uint8x16_t v, uint8x16_t mask)
+        {
+            auto swapped =
+                    vreinterpretq_u8_u16(vrev32q_u16(vreinterpretq_u16_u8(v)));
+
+            return vbslq_u8(mask, swapped, v);
+        }
+
+        // Mask of the bytes Offset and Offset + 2 of each 32 bits element.
+        template<int Offset>
+        inline uint8x16_t halvesMask()
+        {
+            return vreinterpretq_u8_u32(vdupq_n_u32(0xff00ffu << (8 * Offset)));
+        }
+
+        /* Reverse the blocks of 16 bytes from both ends of a line of 'size'
+         * bytes towards the middle, loading both blocks before storing them,
+         * so 'src' can be 'dst'. 'reverse' reverses the pixels of a block.
+         * Returns the number of bytes done at each end, the middle is left
+         * for the reference kernel.
+         */
+        template<typename Reverse>
+        inline int mirrorEnds(const uint8_t *src,
+                              uint8_t *dst,
+                              int size,
+                              Reverse reverse)
+        {
+            int done = 0;
+
+            for (; size - 2 * done >= 32; done += 16) {
+                auto left = vld1q_u8(src + done);
+                auto right = vld1q_u8(src + size - done - 16);
+                vst1q_u8(dst + done, reverse(right));
+                vst1q_u8(dst + size - done - 16, reverse(left));
+            }
+
+            return done;
+        }
+
+        void mirror8(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = mirrorEnds(src, dst, width, reverse8);
+            Simd::kernels(SimdLevelNone).mirror8(src + done,
+                                                 dst + done,
+                                                 width - 2 * done);
+        }
+
+        void mirror16(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = mirrorEnds(src, dst, 2 * width, reverse16) / 2;
+            Simd::kernels(SimdLevelNone).mirror16(src + 2 * done,
+                                                  dst + 2 * done,
+                                                  width - 2 * done);
+        }
+
+        void mirror32(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = mirrorEnds(src, dst, 4 * width, reverse32) / 4;
+            Simd::kernels(SimdLevelNone).mirror32(src + 4 * done,
+                                                  dst + 4 * done,
+                                                  width - 2 * done);
+        }
+
+        // The components are deinterleaved and reversed apart.
+        void mirror24(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = 0;
+
+            for (; width - 2 * done >= 32; done += 16) {
+                auto left = vld3q_u8(src + 3 * done);
+                auto right = vld3q_u8(src + 3 * (width - done - 16));
+
+                for (int c = 0; c < 3; c++) {
+                    auto pixels = left.val[c];
+                    left.val[c] = reverse8(right.val[c]);
+                    right.val[c] = reverse8(pixels);
+                }
+
+                vst3q_u8(dst + 3 * done, left);
+                vst3q_u8(dst + 3 * (width - done - 16), right);
+            }
+
+            Simd::kernels(SimdLevelNone).mirror24(src + 3 * done,
+                                                  dst + 3 * done,
+                                                  width - 2 * done);
+        }
+
+        template<int Y>
+        void mirrorPacked(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = halvesMask<Y>();
+            int done = mirrorEnds(src, dst, 4 * width, [mask] (uint8x16_t v) {
+                return swapHalves(reverse32(v), mask);
+            }) / 4;
+            auto mirror = Y == 0? reference.mirrorYuy2: reference.mirrorUyvy;
+            mirror(src + 4 * done, dst + 4 * done, width - 2 * done);
+        }
+
+        template<int Shift>
+        void swapRgb16Bits(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto low = vdupq_n_u16(0x1f);
+            auto keep = vdupq_n_u16(uint16_t(~(0x1f | (0x1f << Shift))));
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8) {
+                auto v = vreinterpretq_u16_u8(vld1q_u8(src + 2 * x));
+                auto swapped = vorrq_u16(vandq_u16(vshrq_n_u16(v, Shift), low),
+                                         vorrq_u16(vshlq_n_u16(vandq_u16(v, low), Shift),
+                                                   vandq_u16(v, keep)));
+                vst1q_u8(dst + 2 * x, vreinterpretq_u8_u16(swapped));
+            }
+
+            if (x < width) {
+                auto swap = Shift == 10? reference.swapRgb15: reference.swapRgb16;
+                swap(src + 2 * x, dst + 2 * x, width - x);
+            }
+        }
+
+        void swapRgb24(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v = vld3q_u8(src + 3 * x);
+                auto red = v.val[0];
+                v.val[0] = v.val[2];
+                v.val[2] = red;
+                vst3q_u8(dst + 3 * x, v);
+            }
+
+            if (x < width)
+                reference.swapRgb24(src + 3 * x, dst + 3 * x, width - x);
+        }
+
+        template<int Offset>
+        void swapRgb32Bytes(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = halvesMask<Offset>();
+            int x = 0;
+
+            for (; x + 4 <= width; x += 4)
+                vst1q_u8(dst + 4 * x, swapHalves(vld1q_u8(src + 4 * x), mask));
+
+            if (x < width) {
+                auto swap = Offset == 0? reference.swapBgr32: reference.swapRgb32;
+                swap(src + 4 * x, dst + 4 * x, width - x);
+            }
+        }
+
+        void adjustChroma(const uint8_t *src,
+                          uint8_t *dst,
+                          const int16_t *matrix,
+                          int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8) {
+                auto pairs = vld2_u8(src + 2 * x);
+                auto center = vdupq_n_s16(128);
+                auto a = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[0])),
+                                   center);
+                auto b = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[1])),
+                                   center);
+                int16x8_t result[2];
+
+                for (int row = 0; row < 2; row++) {
+                    auto m0 = matrix[2 * row];
+                    auto m1 = matrix[2 * row + 1];
+                    auto lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(a), m0),
+                                          vget_low_s16(b),
+                                          m1);
+                    auto hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(a), m0),
+                                          vget_high_s16(b),
+                                          m1);
+                    result[row] =
+                            vaddq_s16(vcombine_s16(vrshrn_n_s32(lo, SIMD_CHROMA_SHIFT),
+                                                   vrshrn_n_s32(hi, SIMD_CHROMA_SHIFT)),
+                                      center);
+                }
+
+                uint8x8x2_t adjusted;
+                adjusted.val[0] = vqmovun_s16(result[0]);
+                adjusted.val[1] = vqmovun_s16(result[1]);
+                vst2_u8(dst + 2 * x, adjusted);
+            }
+
+            if (x < width)
+                reference.adjustChroma(src + 2 * x,
+                                       dst + 2 * x,
+                                       matrix,
+                                       width - x);
+        }
+
+        // Accumulate the 2 words of 'words' in the 2 lanes of 'sum'.
+        inline uint64x2_t hashWords(uint64x2_t sum,
+                                    const uint8_t *words,
+                                    uint64x2_t key)
+        {
+            auto data = vreinterpretq_u64_u8(vld1q_u8(words));
+            auto dk = veorq_u64(data, key);
+            auto product = vmull_u32(vmovn_u64(dk), vshrn_n_u64(dk, 32));
+
+            return vaddq_u64(sum, vaddq_u64(product, vextq_u64(data, data, 1)));
+        }
+
+        inline uint64x2_t hashKeys(uint64_t key)
+        {
+            return vcombine_u64(vcreate_u64(key),
+                                vcreate_u64(key + SIMD_HASH_KEY));
+        }
+
+        void hashStripes(const uint8_t *data,
+                         size_t stripes,
+                         uint64_t index,
+                         uint64_t *acc)
+        {
+            /* Each register has 2 lanes, the products of the 32 bits halves
+             * of the words go to their own lane and the words to the other
+             * one. The 4 registers are kept apart, so the compiler doesn't
+             * spill them to memory.
+             */
+            auto sum0 = vld1q_u64(acc);
+            auto sum1 = vld1q_u64(acc + 2);
+            auto sum2 = vld1q_u64(acc + 4);
+            auto sum3 = vld1q_u64(acc + 6);
+            auto first = SIMD_HASH_KEY * (8 * index + 1);
+            auto key0 = hashKeys(first);
+            auto key1 = hashKeys(first + 2 * SIMD_HASH_KEY);
+            auto key2 = hashKeys(first + 4 * SIMD_HASH_KEY);
+            auto key3 = hashKeys(first + 6 * SIMD_HASH_KEY);
+            auto keyStep = vdupq_n_u64(8 * SIMD_HASH_KEY);
+
+            for (size_t n = 0; n < stripes; n++) {
+                auto words = data + SIMD_HASH_STRIPE * n;
+                sum0 = hashWords(sum0, words, key0);
+                sum1 = hashWords(sum1, words + 16, key1);
+                sum2 = hashWords(sum2, words + 32, key2);
+                sum3 = hashWords(sum3, words + 48, key3);
+                key0 = vaddq_u64(key0, keyStep);
+                key1 = vaddq_u64(key1, keyStep);
+                key2 = vaddq_u64(key2, keyStep);
+                key3 = vaddq_u64(key3, keyStep);
+            }
+
+            vst1q_u64(acc, sum0);
+            vst1q_u64(acc + 2, sum1);
+            vst1q_u64(acc + 4, sum2);
+            vst1q_u64(acc + 6, sum3);
+        }
+
+        /* Interpolate two pixels, the 4 nodes of each one are widened to 16
+         * bits and added with their weights, the result is
+         *
+         * B0 G0 R0 0 B1 G1 R1 0
+         *
+         * the weights add up to 256, so the sums fit in 16 bits.
+         */
+        inline uint8x8_t lut3dPair(const uint8_t *src,
+                                   const uint32_t *lut,
+                                   const uint32_t *axis,
+                                   int size)
+        {
+            int offsets0[4];
+            int weights0[4];
+            int offsets1[4];
+            int weights1[4];
+            Simd::lut3dVertices(src, axis, size, offsets0, weights0);
+            Simd::lut3dVertices(src + 3, axis, size, offsets1, weights1);
+            auto sum = vdupq_n_u16(128);
+
+            for (int k = 0; k < 4; k++) {
+                uint32_t nodes[2] {lut[offsets0[k]], lut[offsets1[k]]};
+                auto weights = vcombine_u16(vdup_n_u16(uint16_t(weights0[k])),
+                                            vdup_n_u16(uint16_t(weights1[k])));
+                sum = vmlaq_u16(sum,
+                                vmovl_u8(vreinterpret_u8_u32(vld1_u32(nodes))),
+                                weights);
+            }
+
+            return vmovn_u16(vshrq_n_u16(sum, 8));
+        }
+
+        void lut3d(const uint8_t *src,
+                   uint8_t *dst,
+                   int width,
+                   const uint32_t *lut,
+                   const uint32_t *axis,
+                   int size)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 4 <= width; x += 4) {
+                auto pixels = src + 3 * x;
+                auto lo = lut3dPair(pixels, lut, axis, size);
+                auto hi = lut3dPair(pixels + 6, lut, axis, size);
+                uint8_t result[16];
+                vst1q_u8(result, vcombine_u8(lo, hi));
+
+                for (int i = 0; i < 4; i++)
+                    memcpy(dst + 3 * (x + i), result + 4 * i, 3);
+            }
+
+            if (x < width)
+                reference.lut3d(src + 3 * x,
+                                dst + 3 * x,
+                                width - x,
+                                lut,
+                                axis,
+                                size);
+        }
+    }
+}
+
+bool AkVCam::Simd::loadNeon(SimdKernels *kernels)
+{
+    kernels->rgb24ToYuy2 = Neon::rgb24ToPacked422<false, true>;
+    kernels->rgb24ToUyvy = Neon::rgb24ToPacked422<false, false>;
+    kernels->bgr24ToYuy2 = Neon::rgb24ToPacked422<true, true>;
+    kernels->bgr24ToUyvy = Neon::rgb24ToPacked422<true, false>;
+    kernels->rgb24ToNv12 = Neon::rgb24ToNv<false, true>;
+    kernels->rgb24ToNv21 = Neon::rgb24ToNv<false, false>;
+    kernels->bgr24ToNv12 = Neon::rgb24ToNv<true, true>;
+    kernels->bgr24ToNv21 = Neon::rgb24ToNv<true, false>;
+    kernels->swapBytes = Neon::swapBytes;
+    kernels->splitBytes = Neon::splitBytes;
+    kernels->mergeBytes = Neon::mergeBytes;
+    kernels->blendBytes = Neon::blendBytes;
+    kernels->blendRows = Neon::blendRows;
+    kernels->accumulateRow = Neon::accumulateRow;
+    kernels->filterBytes = Neon::filterBytes;
+    kernels->filterRows = Neon::filterRows;
+    kernels->transpose8 = Neon::transpose<1>;
+    kernels->transpose16 = Neon::transpose<2>;
+    kernels->transpose32 = Neon::transpose<4>;
+    kernels->mirror8 = Neon::mirror8;
+    kernels->mirror16 = Neon::mirror16;
+    kernels->mirror24 = Neon::mirror24;
+    kernels->mirror32 = Neon::mirror32;
+    kernels->mirrorYuy2 = Neon::mirrorPacked<0>;
+    kernels->mirrorUyvy = Neon::mirrorPacked<1>;
+    kernels->swapRgb15 = Neon::swapRgb16Bits<10>;
+    kernels->swapRgb16 = Neon::swapRgb16Bits<11>;
+    kernels->swapRgb24 = Neon::swapRgb24;
+    kernels->swapRgb32 = Neon::swapRgb32Bytes<1>;
+    kernels->swapBgr32 = Neon::swapRgb32Bytes<0>;
+    kernels->lut3d = Neon::lut3d;
+    kernels->adjustChroma = Neon::adjustChroma;
+    kernels->hashStripes = Neon::hashStripes;
+
+    return true;
+}
+
+#else
+
+bool AkVCam::Simd::loadNeon(SimdKernels *kernels)
+{
+    (void) kernels;
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,1152 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <cstring>
+
+#include "simd.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+namespace AkVCam
+{
+    namespace Sse2
+    {
+        /* Split 32 packed 24 bits pixels into its components.
+         *
+         * Each pass interleaves the first half of the registers with the
+         * second half, after 5 passes v[0], v[1] holds the first component,
+         * v[2], v[3] the second one, and v[4], v[5] the third one.
+         */
+        inline void deinterleave3(__m128i *v)
+        {
+            for (int i = 0; i < 5; i++) {
+                auto t0 = _mm_unpacklo_epi8(v[0], v[3]);
+                auto t1 = _mm_unpackhi_epi8(v[0], v[3]);
+                auto t2 = _mm_unpacklo_epi8(v[1], v[4]);
+                auto t3 = _mm_unpackhi_epi8(v[1], v[4]);
+                auto t4 = _mm_unpacklo_epi8(v[2], v[5]);
+                auto t5 = _mm_unpackhi_epi8(v[2], v[5]);
+
+                v[0] = t0;
+                v[1] = t1;
+                v[2] = t2;
+                v[3] = t3;
+                v[4] = t4;
+                v[5] = t5;
+            }
+        }
+
+        inline __m128i weightedSum(__m128i r, __m128i g, __m128i b,
+                                   short kr, short kg, short kb)
+        {
+            auto sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kr)),
+                                     _mm_mullo_epi16(g, _mm_set1_epi16(kg)));
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+
+            return _mm_add_epi16(sum, _mm_set1_epi16(128));
+        }
+
+        inline __m128i widen(__m128i v, bool high)
+        {
+            auto zero = _mm_setzero_si128();
+
+            return high? _mm_unpackhi_epi8(v, zero): _mm_unpacklo_epi8(v, zero);
+        }
+
+        // Same formula as Color::rgbY.
+        inline __m128i rgbY(__m128i r, __m128i g, __m128i b)
+        {
+            // The Y sum is always positive and fits in 16 bits unsigned.
+            auto y = _mm_srli_epi16(weightedSum(r, g, b, 66, 129, 25), 8);
+
+            return _mm_add_epi16(y, _mm_set1_epi16(16));
+        }
+
+        // Same formula as Color::rgbU and Color::rgbV.
+        inline __m128i rgbChroma(__m128i r, __m128i g, __m128i b,
+                                 short kr, short kg, short kb)
+        {
+            auto c = _mm_srai_epi16(weightedSum(r, g, b, kr, kg, kb), 8);
+
+            return _mm_add_epi16(c, _mm_set1_epi16(128));
+        }
+
+        /* Convert 8 pixels with 16 bits components to 8 packed 4:2:2 pixels,
+         * same formulas as Color::rgbY, Color::rgbU and Color::rgbV.
+         */
+        template<bool YFirst>
+        inline __m128i rgbToPacked422(__m128i r, __m128i g, __m128i b)
+        {
+            auto y = rgbY(r, g, b);
+            auto u = rgbChroma(r, g, b, -38, -74, 112);
+            auto v = rgbChroma(r, g, b, 112, -94, -18);
+
+            // V of the even pixels goes to the even words, U to the odd ones.
+            auto c = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0xffff)),
+                                  _mm_slli_epi32(u, 16));
+
+            if (YFirst)
+                return _mm_or_si128(y, _mm_slli_epi16(c, 8));
+
+            return _mm_or_si128(c, _mm_slli_epi16(y, 8));
+        }
+
+        /* Rounded average of each 2x2 block of two rows of 8 components,
+         * the result goes to the even words, the odd ones are set to 0.
+         */
+        inline __m128i average2x2(__m128i row0, __m128i row1)
+        {
+            auto sum = _mm_add_epi16(row0, row1);
+            sum = _mm_add_epi16(sum, _mm_srli_epi32(sum, 16));
+            sum = _mm_and_si128(sum, _mm_set1_epi32(0xffff));
+
+            return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+        }
+
+        // Write the luma of 32 deinterleaved pixels.
+        template<bool Bgr>
+        inline void storeLuma(const __m128i *v, uint8_t *dst)
+        {
+            auto rv = Bgr? v: v + 4;
+            auto bv = Bgr? v + 4: v;
+
+            for (int i = 0; i < 2; i++) {
+                auto y0 = rgbY(widen(rv[i], false),
+                               widen(v[2 + i], false),
+                               widen(bv[i], false));
+                auto y1 = rgbY(widen(rv[i], true),
+                               widen(v[2 + i], true),
+                               widen(bv[i], true));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16 * i),
+                                 _mm_packus_epi16(y0, y1));
+            }
+        }
+
+        template<bool Bgr, bool YFirst>
+        void rgb24ToPacked422(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32) {
+                __m128i v[6];
+
+                for (int i = 0; i < 6; i++)
+                    v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * x + 16 * i));
+
+                deinterleave3(v);
+                auto rv = Bgr? v: v + 4;
+                auto bv = Bgr? v + 4: v;
+
+                for (int i = 0; i < 2; i++)
+                    for (int j = 0; j < 2; j++) {
+                        auto r = widen(rv[i], j);
+                        auto g = widen(v[2 + i], j);
+                        auto b = widen(bv[i], j);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * x + 32 * i + 16 * j),
+                                         rgbToPacked422<YFirst>(r, g, b));
+                    }
+            }
+
+            if (x < width) {
+                auto tail = Bgr?
+                                YFirst? reference.bgr24ToYuy2: reference.bgr24ToUyvy:
+                                YFirst? reference.rgb24ToYuy2: reference.rgb24ToUyvy;
+                tail(src + 3 * x, dst + 2 * x, width - x);
+            }
+        }
+
+        template<bool Bgr, bool VFirst>
+        void rgb24ToNv(const uint8_t *src0,
+                       const uint8_t *src1,
+                       uint8_t *dstY0,
+                       uint8_t *dstY1,
+                       uint8_t *dstUV,
+                       int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = _mm_set1_epi32(0xffff);
+            int x = 0;
+
+            for (; x + 32 <= width; x += 32) {
+                __m128i v0[6];
+                __m128i v1[6];
+
+                for (int i = 0; i < 6; i++) {
+                    v0[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0 + 3 * x + 16 * i));
+                    v1[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + 3 * x + 16 * i));
+                }
+
+                deinterleave3(v0);
+                deinterleave3(v1);
+                storeLuma<Bgr>(v0, dstY0 + x);
+                storeLuma<Bgr>(v1, dstY1 + x);
+
+                const int ri = Bgr? 0: 4;
+                const int bi = Bgr? 4: 0;
+                __m128i u[4];
+                __m128i v[4];
+
+                // Each iteration gives the chroma of 4 blocks in the even words.
+                for (int i = 0; i < 4; i++) {
+                    auto r = average2x2(widen(v0[ri + i / 2], i & 1),
+                                        widen(v1[ri + i / 2], i & 1));
+                    auto g = average2x2(widen(v0[2 + i / 2], i & 1),
+                                        widen(v1[2 + i / 2], i & 1));
+                    auto b = average2x2(widen(v0[bi + i / 2], i & 1),
+                                        widen(v1[bi + i / 2], i & 1));
+                    u[i] = _mm_and_si128(rgbChroma(r, g, b, -38, -74, 112), mask);
+                    v[i] = _mm_and_si128(rgbChroma(r, g, b, 112, -94, -18), mask);
+                }
+
+                auto u8 = _mm_packus_epi16(_mm_packs_epi32(u[0], u[1]),
+                                           _mm_packs_epi32(u[2], u[3]));
+                auto v8 = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]),
+                                           _mm_packs_epi32(v[2], v[3]));
+                auto c0 = VFirst? v8: u8;
+                auto c1 = VFirst? u8: v8;
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dstUV + x),
+                                 _mm_unpacklo_epi8(c0, c1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dstUV + x + 16),
+                                 _mm_unpackhi_epi8(c0, c1));
+            }
+
+            if (x < width) {
+                auto tail = Bgr?
+                                VFirst? reference.bgr24ToNv12: reference.bgr24ToNv21:
+                                VFirst? reference.rgb24ToNv12: reference.rgb24ToNv21;
+                tail(src0 + 3 * x,
+                     src1 + 3 * x,
+                     dstY0 + x,
+                     dstY1 + x,
+                     dstUV + x,
+                     width - x);
+            }
+        }
+
+        void swapBytes(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8) {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * x),
+                                 _mm_or_si128(_mm_slli_epi16(v, 8),
+                                              _mm_srli_epi16(v, 8)));
+            }
+
+            if (x < width)
+                reference.swapBytes(src + 2 * x, dst + 2 * x, width - x);
+        }
+
+        void splitBytes(const uint8_t *src,
+                        uint8_t *dst0,
+                        uint8_t *dst1,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = _mm_set1_epi16(0xff);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x));
+                auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x + 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst0 + x),
+                                 _mm_packus_epi16(_mm_and_si128(v0, mask),
+                                                  _mm_and_si128(v1, mask)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst1 + x),
+                                 _mm_packus_epi16(_mm_srli_epi16(v0, 8),
+                                                  _mm_srli_epi16(v1, 8)));
+            }
+
+            if (x < width)
+                reference.splitBytes(src + 2 * x, dst0 + x, dst1 + x, width - x);
+        }
+
+        void mergeBytes(const uint8_t *src0,
+                        const uint8_t *src1,
+                        uint8_t *dst,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0 + x));
+                auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + x));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * x),
+                                 _mm_unpacklo_epi8(v0, v1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * x + 16),
+                                 _mm_unpackhi_epi8(v0, v1));
+            }
+
+            if (x < width)
+                reference.mergeBytes(src0 + x, src1 + x, dst + 2 * x, width - x);
+        }
+
+        // (a * w0 + b * w1) >> 8 for 8 values in 16 bits.
+        inline __m128i blend(__m128i a, __m128i b, __m128i w0, __m128i w1)
+        {
+            return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, w0),
+                                                _mm_mullo_epi16(b, w1)), 8);
+        }
+
+        void blendBytes(const uint8_t *src0,
+                        const uint8_t *src1,
+                        const uint16_t *weights,
+                        uint8_t *dst,
+                        int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto zero = _mm_setzero_si128();
+            auto one = _mm_set1_epi16(256);
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0 + x));
+                auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + x));
+                auto w1lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + x));
+                auto w1hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + x + 8));
+                auto lo = blend(_mm_unpacklo_epi8(a, zero),
+                                _mm_unpacklo_epi8(b, zero),
+                                _mm_sub_epi16(one, w1lo),
+                                w1lo);
+                auto hi = blend(_mm_unpackhi_epi8(a, zero),
+                                _mm_unpackhi_epi8(b, zero),
+                                _mm_sub_epi16(one, w1hi),
+                                w1hi);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                                 _mm_packus_epi16(lo, hi));
+            }
+
+            if (x < width)
+                reference.blendBytes(src0 + x,
+                                     src1 + x,
+                                     weights + x,
+                                     dst + x,
+                                     width - x);
+        }
+
+        void blendRows(const uint8_t *src0,
+                       const uint8_t *src1,
+                       int weight,
+                       uint8_t *dst,
+                       int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto zero = _mm_setzero_si128();
+            auto w0 = _mm_set1_epi16(short(256 - weight));
+            auto w1 = _mm_set1_epi16(short(weight));
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0 + x));
+                auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + x));
+                auto lo = blend(_mm_unpacklo_epi8(a, zero),
+                                _mm_unpacklo_epi8(b, zero),
+                                w0,
+                                w1);
+                auto hi = blend(_mm_unpackhi_epi8(a, zero),
+                                _mm_unpackhi_epi8(b, zero),
+                                w0,
+                                w1);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                                 _mm_packus_epi16(lo, hi));
+            }
+
+            if (x < width)
+                reference.blendRows(src0 + x, src1 + x, weight, dst + x, width - x);
+        }
+
+        void accumulateRow(const uint8_t *src, uint16_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto zero = _mm_setzero_si128();
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+                auto lo = reinterpret_cast<__m128i *>(dst + x);
+                auto hi = reinterpret_cast<__m128i *>(dst + x + 8);
+                _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo),
+                                                   _mm_unpacklo_epi8(v, zero)));
+                _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi),
+                                                   _mm_unpackhi_epi8(v, zero)));
+            }
+
+            if (x < width)
+                reference.accumulateRow(src + x, dst + x, width - x);
+        }
+
+        /* Multiply and add two taps of 8 values in 16 bits, the values and
+         * the coefficients of both taps are interleaved so each pair is
+         * added in 32 bits.
+         */
+        inline void multiplyAdd(__m128i a, __m128i b,
+                                __m128i ca, __m128i cb,
+                                __m128i *lo, __m128i *hi)
+        {
+            *lo = _mm_add_epi32(*lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b),
+                                                    _mm_unpacklo_epi16(ca, cb)));
+            *hi = _mm_add_epi32(*hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b),
+                                                    _mm_unpackhi_epi16(ca, cb)));
+        }
+
+        // Filter 8 values, from 'x'.
+        inline void filterBytesBlock(const uint8_t *src,
+                                     const int16_t *coeffs,
+                                     int taps,
+                                     int16_t *dst,
+                                     int width,
+                                     int x)
+        {
+            auto zero = _mm_setzero_si128();
+            auto lo = _mm_set1_epi32(128);
+            auto hi = lo;
+
+            for (int k = 0; k < taps; k += 2) {
+                auto a = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + k * width + x));
+                auto ca = _mm_loadu_si128(reinterpret_cast<const __m128i *>(coeffs + k * width + x));
+                auto b = zero;
+                auto cb = zero;
+
+                if (k + 1 < taps) {
+                    b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + (k + 1) * width + x));
+                    cb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(coeffs + (k + 1) * width + x));
+                }
+
+                multiplyAdd(_mm_unpacklo_epi8(a, zero),
+                            _mm_unpacklo_epi8(b, zero),
+                            ca, cb,
+                            &lo, &hi);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                             _mm_packs_epi32(_mm_srai_epi32(lo, 8),
+                                             _mm_srai_epi32(hi, 8)));
+        }
+
+        /* The rows are 'width' values apart, so the last values can't be
+         * passed to the reference, the last block overlaps the previous one
+         * instead.
+         */
+        void filterBytes(const uint8_t *src,
+                         const int16_t *coeffs,
+                         int taps,
+                         int16_t *dst,
+                         int width)
+        {
+            if (width < 8) {
+                Simd::kernels(SimdLevelNone).filterBytes(src,
+                                                         coeffs,
+                                                         taps,
+                                                         dst,
+                                                         width);
+
+                return;
+            }
+
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8)
+                filterBytesBlock(src, coeffs, taps, dst, width, x);
+
+            if (x < width)
+                filterBytesBlock(src, coeffs, taps, dst, width, width - 8);
+        }
+
+        // Filter 16 values, from 'x'.
+        inline void filterRowsBlock(const int16_t *const *src,
+                                    const int16_t *coeffs,
+                                    int taps,
+                                    uint8_t *dst,
+                                    int x)
+        {
+            auto zero = _mm_setzero_si128();
+            auto round = _mm_set1_epi32(1 << 19);
+            __m128i sums[4] {round, round, round, round};
+
+            for (int k = 0; k < taps; k += 2) {
+                auto ca = _mm_set1_epi16(coeffs[k]);
+                auto cb = zero;
+
+                if (k + 1 < taps)
+                    cb = _mm_set1_epi16(coeffs[k + 1]);
+
+                for (int i = 0; i < 2; i++) {
+                    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[k] + x + 8 * i));
+                    auto b = zero;
+
+                    if (k + 1 < taps)
+                        b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[k + 1] + x + 8 * i));
+
+                    multiplyAdd(a, b, ca, cb, sums + 2 * i, sums + 2 * i + 1);
+                }
+            }
+
+            auto lo = _mm_packs_epi32(_mm_srai_epi32(sums[0], 20),
+                                      _mm_srai_epi32(sums[1], 20));
+            auto hi = _mm_packs_epi32(_mm_srai_epi32(sums[2], 20),
+                                      _mm_srai_epi32(sums[3], 20));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                             _mm_packus_epi16(lo, hi));
+        }
+
+        void filterRows(const int16_t *const *src,
+                        const int16_t *coeffs,
+                        int taps,
+                        uint8_t *dst,
+                        int width)
+        {
+            if (width < 16) {
+                Simd::kernels(SimdLevelNone).filterRows(src,
+                                                        coeffs,
+                                                        taps,
+                                                        dst,
+                                                        width);
+
+                return;
+            }
+
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16)
+                filterRowsBlock(src, coeffs, taps, dst, x);
+
+            if (x < width)
+                filterRowsBlock(src, coeffs, taps, dst, width - 16);
+        }
+        // Interleave the low and the high halves of 'a' and 'b'.
+        template<int Bytes>
+        inline void unpack(__m128i a, __m128i b, __m128i *lo, __m128i *hi);
+
+        template<>
+        inline void unpack<1>(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+        {
+            *lo = _mm_unpacklo_epi8(a, b);
+            *hi = _mm_unpackhi_epi8(a, b);
+        }
+
+        template<>
+        inline void unpack<2>(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+        {
+            *lo = _mm_unpacklo_epi16(a, b);
+            *hi = _mm_unpackhi_epi16(a, b);
+        }
+
+        template<>
+        inline void unpack<4>(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+        {
+            *lo = _mm_unpacklo_epi32(a, b);
+            *hi = _mm_unpackhi_epi32(a, b);
+        }
+
+        /* Transpose a tile of N x N elements, N = 16 / Bytes, in registers.
+         *
+         * Each pass interleaves the first half of the lines with the second
+         * half, after log2(N) passes line i holds column i.
+         */
+        template<int Bytes>
+        inline void transposeTile(const uint8_t *src,
+                                  ptrdiff_t srcStride,
+                                  uint8_t *dst,
+                                  ptrdiff_t dstStride)
+        {
+            const int n = 16 / Bytes;
+            __m128i v[n];
+            __m128i t[n];
+
+            for (int i = 0; i < n; i++)
+                v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * srcStride));
+
+            for (int pass = n; pass > 1; pass /= 2) {
+                for (int i = 0; i < n / 2; i++)
+                    unpack<Bytes>(v[i], v[i + n / 2], t + 2 * i, t + 2 * i + 1);
+
+                for (int i = 0; i < n; i++)
+                    v[i] = t[i];
+            }
+
+            for (int i = 0; i < n; i++)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * dstStride), v[i]);
+        }
+
+        template<int Bytes>
+        void transpose(const uint8_t *src,
+                       ptrdiff_t srcStride,
+                       uint8_t *dst,
+                       ptrdiff_t dstStride,
+                       int width,
+                       int height)
+        {
+            const int n = 16 / Bytes;
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto tail = Bytes == 1? reference.transpose8:
+                        Bytes == 2? reference.transpose16:
+                                    reference.transpose32;
+            int x = 0;
+
+            for (; x + n <= width; x += n) {
+                auto srcColumn = src + Bytes * x;
+                auto dstLine = dst + x * dstStride;
+                int y = 0;
+
+                for (; y + n <= height; y += n)
+                    transposeTile<Bytes>(srcColumn + y * srcStride,
+                                         srcStride,
+                                         dstLine + Bytes * y,
+                                         dstStride);
+
+                if (y < height)
+                    tail(srcColumn + y * srcStride,
+                         srcStride,
+                         dstLine + Bytes * y,
+                         dstStride,
+                         n,
+                         height - y);
+            }
+
+            if (x < width)
+                tail(src + Bytes * x,
+                     srcStride,
+                     dst + x * dstStride,
+                     dstStride,
+                     width - x,
+                     height);
+        }
+
+        /* Reverse the blocks of 16 bytes from both ends of a line of 'size'
+         * bytes towards the middle, loading both blocks before storing them,
+         * so 'src' can be 'dst'. 'reverse' reverses the pixels of a block.
+         * Returns the number of bytes done at each end, the middle is left
+         * for the reference kernel.
+         */
+        template<typename Reverse>
+        inline int mirrorEnds(const uint8_t *src,
+                              uint8_t *dst,
+                              int size,
+                              Reverse reverse)
+        {
+            int done = 0;
+
+            for (; size - 2 * done >= 32; done += 16) {
+                auto left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+                auto right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + size - done - 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done),
+                                 reverse(right));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + size - done - 16),
+                                 reverse(left));
+            }
+
+            return done;
+        }
+
+        inline __m128i reverse32(__m128i v)
+        {
+            return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+
+        inline __m128i reverse16(__m128i v)
+        {
+            v = reverse32(v);
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+
+            return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+
+        inline __m128i reverse8(__m128i v)
+        {
+            v = reverse16(v);
+
+            return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        }
+
+        /* Swap the bytes selected by 'mask', which must be one of each pair
+         * of bytes, with the ones 2 bytes apart in the same 32 bits element.
+         */
+        inline __m128i swapHalves(__m128i v, __m128i mask)
+        {
+            auto swapped = _mm_and_si128(v, mask);
+            swapped = _mm_shufflelo_epi16(swapped, _MM_SHUFFLE(2, 3, 0, 1));
+            swapped = _mm_shufflehi_epi16(swapped, _MM_SHUFFLE(2, 3, 0, 1));
+
+            return _mm_or_si128(swapped, _mm_andnot_si128(mask, v));
+        }
+
+        // Mask of the bytes Offset and Offset + 2 of each 32 bits element.
+        template<int Offset>
+        inline __m128i halvesMask()
+        {
+            return _mm_set1_epi32(int(0xff00ffu << (8 * Offset)));
+        }
+
+        void mirror8(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = mirrorEnds(src, dst, width, reverse8);
+            Simd::kernels(SimdLevelNone).mirror8(src + done,
+                                                 dst + done,
+                                                 width - 2 * done);
+        }
+
+        void mirror16(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = mirrorEnds(src, dst, 2 * width, reverse16) / 2;
+            Simd::kernels(SimdLevelNone).mirror16(src + 2 * done,
+                                                  dst + 2 * done,
+                                                  width - 2 * done);
+        }
+
+        void mirror32(const uint8_t *src, uint8_t *dst, int width)
+        {
+            int done = mirrorEnds(src, dst, 4 * width, reverse32) / 4;
+            Simd::kernels(SimdLevelNone).mirror32(src + 4 * done,
+                                                  dst + 4 * done,
+                                                  width - 2 * done);
+        }
+
+        template<int Y>
+        void mirrorPacked(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = halvesMask<Y>();
+            int done = mirrorEnds(src, dst, 4 * width, [mask] (__m128i v) {
+                return swapHalves(reverse32(v), mask);
+            }) / 4;
+            auto mirror = Y == 0? reference.mirrorYuy2: reference.mirrorUyvy;
+            mirror(src + 4 * done, dst + 4 * done, width - 2 * done);
+        }
+
+        /* Mask of the bytes of the register 'k' of a block of 48 bytes, whose
+         * position modulo 3 is 'phase'.
+         */
+        inline __m128i phaseMask(int k, int phase)
+        {
+            alignas(16) int8_t mask[16];
+
+            for (int i = 0; i < 16; i++)
+                mask[i] = (16 * k + i) % 3 == phase? -1: 0;
+
+            return _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+        }
+
+        /* The red and blue are swapped in blocks of 16 pixels, each byte
+         * takes the one 2 bytes after or before it, from the same register
+         * or from the one next to it. Loading whole blocks avoids reading
+         * back partially stored registers when working in place.
+         */
+        void swapRgb24(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            __m128i red[3];
+            __m128i green[3];
+            __m128i blue[3];
+
+            for (int k = 0; k < 3; k++) {
+                red[k] = phaseMask(k, 0);
+                green[k] = phaseMask(k, 1);
+                blue[k] = phaseMask(k, 2);
+            }
+
+            int x = 0;
+
+            for (; x + 16 <= width; x += 16) {
+                __m128i v[3];
+
+                for (int k = 0; k < 3; k++)
+                    v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * x + 16 * k));
+
+                __m128i next[3] = {
+                    _mm_or_si128(_mm_srli_si128(v[0], 2), _mm_slli_si128(v[1], 14)),
+                    _mm_or_si128(_mm_srli_si128(v[1], 2), _mm_slli_si128(v[2], 14)),
+                    _mm_srli_si128(v[2], 2),
+                };
+                __m128i previous[3] = {
+                    _mm_slli_si128(v[0], 2),
+                    _mm_or_si128(_mm_slli_si128(v[1], 2), _mm_srli_si128(v[0], 14)),
+                    _mm_or_si128(_mm_slli_si128(v[2], 2), _mm_srli_si128(v[1], 14)),
+                };
+
+                for (int k = 0; k < 3; k++) {
+                    auto swapped =
+                            _mm_or_si128(_mm_and_si128(v[k], green[k]),
+                                         _mm_or_si128(_mm_and_si128(next[k], red[k]),
+                                                      _mm_and_si128(previous[k], blue[k])));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * x + 16 * k),
+                                     swapped);
+                }
+            }
+
+            if (x < width)
+                reference.swapRgb24(src + 3 * x, dst + 3 * x, width - x);
+        }
+
+        /* Reversing the bytes of the pixels and swapping back the red and
+         * blue components puts them in order again.
+         */
+        void mirror24(const uint8_t *src, uint8_t *dst, int width)
+        {
+            mirror8(src, dst, 3 * width);
+            swapRgb24(dst, dst, width);
+        }
+
+        template<int Shift>
+        void swapRgb16Bits(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto low = _mm_set1_epi16(0x1f);
+            auto keep = _mm_set1_epi16(short(~(0x1f | (0x1f << Shift))));
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8) {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x));
+                auto swapped =
+                        _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, Shift), low),
+                                     _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, low), Shift),
+                                                  _mm_and_si128(v, keep)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * x),
+                                 swapped);
+            }
+
+            if (x < width) {
+                auto swap = Shift == 10? reference.swapRgb15: reference.swapRgb16;
+                swap(src + 2 * x, dst + 2 * x, width - x);
+            }
+        }
+
+        template<int Offset>
+        void swapRgb32Bytes(const uint8_t *src, uint8_t *dst, int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = halvesMask<Offset>();
+            int x = 0;
+
+            for (; x + 4 <= width; x += 4) {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * x));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * x),
+                                 swapHalves(v, mask));
+            }
+
+            if (x < width) {
+                auto swap = Offset == 0? reference.swapBgr32: reference.swapRgb32;
+                swap(src + 4 * x, dst + 4 * x, width - x);
+            }
+        }
+
+        /* Multiply 4 chroma pairs, widened to 16 bits and centered at 0, by
+         * the matrix rows 'row0' and 'row1', and interleave the results
+         * again.
+         */
+        inline __m128i adjustChromaPairs(__m128i pairs,
+                                         __m128i row0,
+                                         __m128i row1)
+        {
+            auto round = _mm_set1_epi32(1 << (SIMD_CHROMA_SHIFT - 1));
+            auto a = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, row0),
+                                                  round),
+                                    SIMD_CHROMA_SHIFT);
+            auto b = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, row1),
+                                                  round),
+                                    SIMD_CHROMA_SHIFT);
+
+            return _mm_packs_epi32(_mm_unpacklo_epi32(a, b),
+                                   _mm_unpackhi_epi32(a, b));
+        }
+
+        void adjustChroma(const uint8_t *src,
+                          uint8_t *dst,
+                          const int16_t *matrix,
+                          int width)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto zero = _mm_setzero_si128();
+            auto center = _mm_set1_epi16(128);
+            auto row0 = _mm_set_epi16(matrix[1], matrix[0],
+                                      matrix[1], matrix[0],
+                                      matrix[1], matrix[0],
+                                      matrix[1], matrix[0]);
+            auto row1 = _mm_set_epi16(matrix[3], matrix[2],
+                                      matrix[3], matrix[2],
+                                      matrix[3], matrix[2],
+                                      matrix[3], matrix[2]);
+            int x = 0;
+
+            for (; x + 8 <= width; x += 8) {
+                auto pairs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * x));
+                auto lo = _mm_sub_epi16(_mm_unpacklo_epi8(pairs, zero), center);
+                auto hi = _mm_sub_epi16(_mm_unpackhi_epi8(pairs, zero), center);
+                lo = _mm_add_epi16(adjustChromaPairs(lo, row0, row1), center);
+                hi = _mm_add_epi16(adjustChromaPairs(hi, row0, row1), center);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * x),
+                                 _mm_packus_epi16(lo, hi));
+            }
+
+            if (x < width)
+                reference.adjustChroma(src + 2 * x,
+                                       dst + 2 * x,
+                                       matrix,
+                                       width - x);
+        }
+
+        // Select 'a' where 'mask' is set and 'b' elsewhere.
+        inline __m128i select(__m128i mask, __m128i a, __m128i b)
+        {
+            return _mm_or_si128(_mm_and_si128(mask, a),
+                                _mm_andnot_si128(mask, b));
+        }
+
+        /* Add the 4 nodes of 2 pixels, widened to 16 bits, with their
+         * weights, the weights add up to 256 so the sums fit in 16 bits.
+         * The result is:
+         *
+         * B0 G0 R0 0 B1 G1 R1 0
+         */
+        inline __m128i lut3dPair(const uint32_t *lut,
+                                 const int32_t (*offsets)[4],
+                                 const __m128i *weights,
+                                 int pixel)
+        {
+            auto zero = _mm_setzero_si128();
+            auto sum = _mm_set1_epi16(128);
+
+            for (int k = 0; k < 4; k++) {
+                auto nodes = _mm_set_epi32(0,
+                                           0,
+                                           int(lut[offsets[k][pixel + 1]]),
+                                           int(lut[offsets[k][pixel]]));
+                sum = _mm_add_epi16(sum,
+                                    _mm_mullo_epi16(_mm_unpacklo_epi8(nodes, zero),
+                                                    weights[k]));
+            }
+
+            return _mm_srli_epi16(sum, 8);
+        }
+
+        /* The tetrahedron of 4 pixels is computed in parallel, as in
+         * Simd::lut3dVertices(), only the table reads are done one by one.
+         */
+        void lut3d(const uint8_t *src,
+                   uint8_t *dst,
+                   int width,
+                   const uint32_t *lut,
+                   const uint32_t *axis,
+                   int size)
+        {
+            auto &reference = Simd::kernels(SimdLevelNone);
+            auto mask = _mm_set1_epi32(SIMD_LUT3D_MASK);
+            auto s0 = _mm_set1_epi32(1);
+            auto s1 = _mm_set1_epi32(size);
+            auto s2 = _mm_set1_epi32(size * size);
+            auto sAll = _mm_set1_epi32(1 + size + size * size);
+            auto one = _mm_set1_epi32(256);
+            int x = 0;
+
+            for (; x + 4 <= width; x += 4) {
+                auto p = src + 3 * x;
+                auto a0 = _mm_set_epi32(int(axis[p[9]]),
+                                        int(axis[p[6]]),
+                                        int(axis[p[3]]),
+                                        int(axis[p[0]]));
+                auto a1 = _mm_set_epi32(int(axis[256 + p[10]]),
+                                        int(axis[256 + p[7]]),
+                                        int(axis[256 + p[4]]),
+                                        int(axis[256 + p[1]]));
+                auto a2 = _mm_set_epi32(int(axis[512 + p[11]]),
+                                        int(axis[512 + p[8]]),
+                                        int(axis[512 + p[5]]),
+                                        int(axis[512 + p[2]]));
+                auto f0 = _mm_and_si128(a0, mask);
+                auto f1 = _mm_and_si128(a1, mask);
+                auto f2 = _mm_and_si128(a2, mask);
+
+                // The distances fit in 16 bits, so the 16 bits min/max work.
+                auto hi = _mm_max_epi16(f0, _mm_max_epi16(f1, f2));
+                auto lo = _mm_min_epi16(f0, _mm_min_epi16(f1, f2));
+                auto mid = _mm_sub_epi32(_mm_add_epi32(f0, _mm_add_epi32(f1, f2)),
+                                         _mm_add_epi32(hi, lo));
+                auto sHi = select(_mm_cmpeq_epi32(f0, hi),
+                                  s0,
+                                  select(_mm_cmpeq_epi32(f1, hi), s1, s2));
+                auto sLo = select(_mm_cmpeq_epi32(f0, lo),
+                                  s0,
+                                  select(_mm_cmpeq_epi32(f1, lo), s1, s2));
+                auto base = _mm_add_epi32(_mm_srli_epi32(a0, SIMD_LUT3D_SHIFT),
+                                          _mm_add_epi32(_mm_srli_epi32(a1, SIMD_LUT3D_SHIFT),
+                                                        _mm_srli_epi32(a2, SIMD_LUT3D_SHIFT)));
+                auto last = _mm_add_epi32(base, sAll);
+
+                int32_t offsets[4][4];
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(offsets[0]), base);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(offsets[1]),
+                                 _mm_add_epi32(base, sHi));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(offsets[2]),
+                                 _mm_sub_epi32(last, sLo));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(offsets[3]), last);
+
+                /* Spread the weight of each pixel to the 4 bytes of its node,
+                 * for the pixels 0 and 1, and for the pixels 2 and 3.
+                 */
+                __m128i weights[4] {
+                    _mm_sub_epi32(one, hi),
+                    _mm_sub_epi32(hi, mid),
+                    _mm_sub_epi32(mid, lo),
+                    lo
+                };
+                __m128i weights01[4];
+                __m128i weights23[4];
+
+                for (int k = 0; k < 4; k++) {
+                    auto w = _mm_packs_epi32(weights[k], weights[k]);
+                    w = _mm_unpacklo_epi16(w, w);
+                    weights01[k] = _mm_unpacklo_epi32(w, w);
+                    weights23[k] = _mm_unpackhi_epi32(w, w);
+                }
+
+                auto lo01 = lut3dPair(lut, offsets, weights01, 0);
+                auto hi23 = lut3dPair(lut, offsets, weights23, 2);
+                uint8_t result[16];
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(result),
+                                 _mm_packus_epi16(lo01, hi23));
+
+                for (int i = 0; i < 4; i++)
+                    memcpy(dst + 3 * (x + i), result + 4 * i, 3);
+            }
+
+            if (x < width)
+                reference.lut3d(src + 3 * x,
+                                dst + 3 * x,
+                                width - x,
+                                lut,
+                                axis,
+                                size);
+        }
+
+        // Accumulate the 2 words of 'words' in the 2 lanes of 'sum'.
+        inline __m128i hashWords(__m128i sum, __m128i words, __m128i key)
+        {
+            auto dk = _mm_xor_si128(words, key);
+            auto product = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+            auto swapped = _mm_shuffle_epi32(words, _MM_SHUFFLE(1, 0, 3, 2));
+
+            return _mm_add_epi64(sum, _mm_add_epi64(product, swapped));
+        }
+
+        inline __m128i hashKeys(uint64_t key)
+        {
+            auto next = key + SIMD_HASH_KEY;
+
+            return _mm_set_epi32(int(next >> 32), int(next),
+                                 int(key >> 32), int(key));
+        }
+
+        void hashStripes(const uint8_t *data,
+                         size_t stripes,
+                         uint64_t index,
+                         uint64_t *acc)
+        {
+            /* Each register has 2 lanes, the products of the 32 bits halves
+             * of the words go to their own lane and the words to the other
+             * one. The 4 registers are kept apart, so the compiler doesn't
+             * spill them to memory.
+             */
+            auto lanes = reinterpret_cast<__m128i *>(acc);
+            auto sum0 = _mm_loadu_si128(lanes);
+            auto sum1 = _mm_loadu_si128(lanes + 1);
+            auto sum2 = _mm_loadu_si128(lanes + 2);
+            auto sum3 = _mm_loadu_si128(lanes + 3);
+            auto first = SIMD_HASH_KEY * (8 * index + 1);
+            auto key0 = hashKeys(first);
+            auto key1 = hashKeys(first + 2 * SIMD_HASH_KEY);
+            auto key2 = hashKeys(first + 4 * SIMD_HASH_KEY);
+            auto key3 = hashKeys(first + 6 * SIMD_HASH_KEY);
+            auto step = 8 * SIMD_HASH_KEY;
+            auto keyStep = _mm_set_epi32(int(step >> 32), int(step),
+                                         int(step >> 32), int(step));
+
+            for (size_t n = 0; n < stripes; n++) {
+                auto words = reinterpret_cast<const __m128i *>(data + SIMD_HASH_STRIPE * n);
+                sum0 = hashWords(sum0, _mm_loadu_si128(words), key0);
+                sum1 = hashWords(sum1, _mm_loadu_si128(words + 1), key1);
+                sum2 = hashWords(sum2, _mm_loadu_si128(words + 2), key2);
+                sum3 = hashWords(sum3, _mm_loadu_si128(words + 3), key3);
+                key0 = _mm_add_epi64(key0, keyStep);
+                key1 = _mm_add_epi64(key1, keyStep);
+                key2 = _mm_add_epi64(key2, keyStep);
+                key3 = _mm_add_epi64(key3, keyStep);
+            }
+
+            _mm_storeu_si128(lanes, sum0);
+            _mm_storeu_si128(lanes + 1, sum1);
+            _mm_storeu_si128(lanes + 2, sum2);
+            _mm_storeu_si128(lanes + 3, sum3);
+        }
+    }
+}
+
+bool AkVCam::Simd::loadSse2(SimdKernels *kernels)
+{
+    kernels->rgb24ToYuy2 = Sse2::rgb24ToPacked422<false, true>;
+    kernels->rgb24ToUyvy = Sse2::rgb24ToPacked422<false, false>;
+    kernels->bgr24ToYuy2 = Sse2::rgb24ToPacked422<true, true>;
+    kernels->bgr24ToUyvy = Sse2::rgb24ToPacked422<true, false>;
+    kernels->rgb24ToNv12 = Sse2::rgb24ToNv<false, true>;
+    kernels->rgb24ToNv21 = Sse2::rgb24ToNv<false, false>;
+    kernels->bgr24ToNv12 = Sse2::rgb24ToNv<true, true>;
+    kernels->bgr24ToNv21 = Sse2::rgb24ToNv<true, false>;
+    kernels->swapBytes = Sse2::swapBytes;
+    kernels->splitBytes = Sse2::splitBytes;
+    kernels->mergeBytes = Sse2::mergeBytes;
+    kernels->blendBytes = Sse2::blendBytes;
+    kernels->blendRows = Sse2::blendRows;
+    kernels->accumulateRow = Sse2::accumulateRow;
+    kernels->filterBytes = Sse2::filterBytes;
+    kernels->filterRows = Sse2::filterRows;
+    kernels->transpose8 = Sse2::transpose<1>;
+    kernels->transpose16 = Sse2::transpose<2>;
+    kernels->transpose32 = Sse2::transpose<4>;
+    kernels->mirror8 = Sse2::mirror8;
+    kernels->mirror16 = Sse2::mirror16;
+    kernels->mirror24 = Sse2::mirror24;
+    kernels->mirror32 = Sse2::mirror32;
+    kernels->mirrorYuy2 = Sse2::mirrorPacked<0>;
+    kernels->mirrorUyvy = Sse2::mirrorPacked<1>;
+    kernels->swapRgb15 = Sse2::swapRgb16Bits<10>;
+    kernels->swapRgb16 = Sse2::swapRgb16Bits<11>;
+    kernels->swapRgb24 = Sse2::swapRgb24;
+    kernels->swapRgb32 = Sse2::swapRgb32Bytes<1>;
+    kernels->swapBgr32 = Sse2::swapRgb32Bytes<0>;
+    kernels->lut3d = Sse2::lut3d;
+    kernels->adjustChroma = Sse2::adjustChroma;
+    kernels->hashStripes = Sse2::hashStripes;
+
+    return true;
+}
+
+#else
+
+bool AkVCam::Simd::loadSse2(SimdKernels *kernels)
+{
+    (void) kernels;
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,395 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+
+// Number of stripes per thread, smaller stripes balance the load better.
+#define STRIPES_PER_THREAD 4
+
+namespace AkVCam
+{
+    struct ThreadPoolWorker
+    {
+        std::deque<ThreadPoolTask> m_tasks;
+        std::mutex m_mutex;
+        std::thread m_thread;
+    };
+
+    using ThreadPoolWorkerPtr = std::unique_ptr<ThreadPoolWorker>;
+
+    /* A job split in stripes. It lives in the stack of the thread that
+     * started it, and is linked in the list of the pool while the workers can
+     * join it, so starting a job doesn't allocate anything.
+     */
+    struct ThreadPoolStripes
+    {
+        const ThreadPoolStripeTask *m_task {nullptr};
+        int m_lines {0};
+        int m_stripes {0};
+        int m_stripeLines {0};
+        std::atomic<int> m_next {0};
+
+        /* Workers that can still join the job, and workers running it,
+         * guarded by the mutex of the pool.
+         */
+        int m_helpers {0};
+        int m_running {0};
+        ThreadPoolStripes *m_nextJob {nullptr};
+
+        void run();
+    };
+
+    class ThreadPoolPrivate
+    {
+        public:
+            std::vector<ThreadPoolWorkerPtr> m_workers;
+            std::mutex m_mutex;
+            std::mutex m_workersMutex;
+            std::condition_variable m_taskAvailable;
+            std::condition_variable m_done;
+            std::condition_variable m_stripesDone;
+            ThreadPoolStripes *m_stripes {nullptr};
+            std::atomic<int> m_queued {0};
+            std::atomic<int> m_pending {0};
+            std::atomic<size_t> m_next {0};
+            std::atomic<int> m_maxThreadCount {0};
+            bool m_stop {false};
+
+            void startWorkers();
+            void stopWorkers();
+            void run(size_t index);
+            bool takeTask(size_t index, ThreadPoolTask &task);
+            ThreadPoolStripes *takeStripes();
+            void taskDone();
+            static int defaultThreadCount();
+    };
+
+    // Worker running in the current thread, if any.
+    static thread_local ThreadPoolPrivate *currentPool = nullptr;
+    static thread_local size_t currentWorker = 0;
+}
+
+AkVCam::ThreadPool::ThreadPool()
+{
+    this->d = new ThreadPoolPrivate;
+    this->d->m_maxThreadCount = ThreadPoolPrivate::defaultThreadCount();
+}
+
+AkVCam::ThreadPool::~ThreadPool()
+{
+    this->d->stopWorkers();
+    delete this->d;
+}
+
+int AkVCam::ThreadPool::maxThreadCount() const
+{
+    return this->d->m_maxThreadCount;
+}
+
+void AkVCam::ThreadPool::setMaxThreadCount(int maxThreadCount)
+{
+    if (maxThreadCount < 1)
+        maxThreadCount = ThreadPoolPrivate::defaultThreadCount();
+
+    if (this->d->m_maxThreadCount == maxThreadCount)
+        return;
+
+    // The workers are created again with the new count when needed.
+    this->d->stopWorkers();
+    this->d->m_maxThreadCount = maxThreadCount;
+}
+
+void AkVCam::ThreadPool::start(const ThreadPoolTask &task)
+{
+    if (this->d->m_maxThreadCount < 2) {
+        task();
+
+        return;
+    }
+
+    this->d->startWorkers();
+    std::unique_lock<std::mutex> workersLock(this->d->m_workersMutex);
+    auto nWorkers = this->d->m_workers.size();
+
+    if (nWorkers < 1) {
+        workersLock.unlock();
+        task();
+
+        return;
+    }
+
+    // Tasks started from a worker go to its own queue.
+    auto index = currentPool == this->d?
+                     currentWorker:
+                     this->d->m_next++ % nWorkers;
+    auto &worker = this->d->m_workers[index];
+    this->d->m_pending++;
+
+    worker->m_mutex.lock();
+    worker->m_tasks.push_back(task);
+    worker->m_mutex.unlock();
+    workersLock.unlock();
+
+    this->d->m_queued++;
+    this->d->m_mutex.lock();
+    this->d->m_taskAvailable.notify_one();
+    this->d->m_mutex.unlock();
+}
+
+void AkVCam::ThreadPool::waitForDone()
+{
+    std::unique_lock<std::mutex> lock(this->d->m_mutex);
+    this->d->m_done.wait(lock, [this] () {
+        return this->d->m_pending < 1;
+    });
+}
+
+void AkVCam::ThreadPool::stop()
+{
+    this->d->stopWorkers();
+}
+
+void AkVCam::ThreadPool::runStripes(int lines,
+                                    int minLines,
+                                    int align,
+                                    const ThreadPoolStripeTask &task)
+{
+    if (lines < 1)
+        return;
+
+    minLines = std::max(minLines, 1);
+    align = std::max(align, 1);
+    int threads = this->d->m_maxThreadCount;
+    int stripes = std::min(lines / minLines, STRIPES_PER_THREAD * threads);
+
+    if (threads < 2 || stripes < 2) {
+        task(0, lines);
+
+        return;
+    }
+
+    int stripeLines = (lines + stripes - 1) / stripes;
+    stripeLines = align * ((stripeLines + align - 1) / align);
+    stripes = (lines + stripeLines - 1) / stripeLines;
+
+    ThreadPoolStripes job;
+    job.m_task = &task;
+    job.m_lines = lines;
+    job.m_stripes = stripes;
+    job.m_stripeLines = stripeLines;
+    job.m_helpers = std::min(threads, stripes) - 1;
+
+    this->d->startWorkers();
+    this->d->m_mutex.lock();
+    job.m_nextJob = this->d->m_stripes;
+    this->d->m_stripes = &job;
+
+    for (int i = 0; i < job.m_helpers; i++)
+        this->d->m_taskAvailable.notify_one();
+
+    this->d->m_mutex.unlock();
+
+    /* The calling thread also takes stripes, so the job is done even if no
+     * worker joins it.
+     */
+    job.run();
+
+    std::unique_lock<std::mutex> lock(this->d->m_mutex);
+
+    for (auto next = &this->d->m_stripes; *next; next = &(*next)->m_nextJob)
+        if (*next == &job) {
+            *next = job.m_nextJob;
+
+            break;
+        }
+
+    this->d->m_stripesDone.wait(lock, [&job] () {
+        return job.m_running < 1;
+    });
+}
+
+AkVCam::ThreadPool *AkVCam::ThreadPool::globalInstance()
+{
+    /* Never destroyed, the worker threads can't be joined while the module
+     * is being unloaded, stop() them before that.
+     */
+    static auto threadPool = new ThreadPool;
+
+    return threadPool;
+}
+
+void AkVCam::ThreadPoolPrivate::startWorkers()
+{
+    std::lock_guard<std::mutex> lock(this->m_workersMutex);
+
+    if (!this->m_workers.empty())
+        return;
+
+    this->m_stop = false;
+    auto nWorkers = size_t(this->m_maxThreadCount - 1);
+
+    for (size_t i = 0; i < nWorkers; i++)
+        this->m_workers.push_back(ThreadPoolWorkerPtr(new ThreadPoolWorker));
+
+    for (size_t i = 0; i < nWorkers; i++)
+        this->m_workers[i]->m_thread =
+                std::thread(&ThreadPoolPrivate::run, this, i);
+}
+
+void AkVCam::ThreadPoolPrivate::stopWorkers()
+{
+    std::lock_guard<std::mutex> lock(this->m_workersMutex);
+
+    if (this->m_workers.empty())
+        return;
+
+    // The workers finish the queued tasks before leaving.
+    this->m_mutex.lock();
+    this->m_stop = true;
+    this->m_taskAvailable.notify_all();
+    this->m_mutex.unlock();
+
+    for (auto &worker: this->m_workers)
+        worker->m_thread.join();
+
+    this->m_workers.clear();
+}
+
+void AkVCam::ThreadPoolPrivate::run(size_t index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    for (;;) {
+        ThreadPoolTask task;
+
+        if (this->takeTask(index, task)) {
+            task();
+            this->taskDone();
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->m_mutex);
+        ThreadPoolStripes *stripes = nullptr;
+        this->m_taskAvailable.wait(lock, [this, &stripes] () {
+            stripes = this->takeStripes();
+
+            return stripes || this->m_stop || this->m_queued > 0;
+        });
+
+        if (stripes) {
+            lock.unlock();
+            stripes->run();
+            lock.lock();
+
+            if (--stripes->m_running < 1)
+                this->m_stripesDone.notify_all();
+
+            continue;
+        }
+
+        if (this->m_stop && this->m_queued < 1)
+            break;
+    }
+
+    currentPool = nullptr;
+}
+
+bool AkVCam::ThreadPoolPrivate::takeTask(size_t index, ThreadPoolTask &task)
+{
+    auto nWorkers = this->m_workers.size();
+
+    /* Take the newest task from the own queue, or steal the oldest one from
+     * another worker.
+     */
+    for (size_t i = 0; i < nWorkers; i++) {
+        auto &worker = this->m_workers[(index + i) % nWorkers];
+        std::lock_guard<std::mutex> lock(worker->m_mutex);
+
+        if (worker->m_tasks.empty())
+            continue;
+
+        if (i == 0) {
+            task = std::move(worker->m_tasks.back());
+            worker->m_tasks.pop_back();
+        } else {
+            task = std::move(worker->m_tasks.front());
+            worker->m_tasks.pop_front();
+        }
+
+        this->m_queued--;
+
+        return true;
+    }
+
+    return false;
+}
+
+AkVCam::ThreadPoolStripes *AkVCam::ThreadPoolPrivate::takeStripes()
+{
+    // Called with m_mutex locked.
+    for (auto stripes = this->m_stripes; stripes; stripes = stripes->m_nextJob)
+        if (stripes->m_helpers > 0 && stripes->m_next < stripes->m_stripes) {
+            stripes->m_helpers--;
+            stripes->m_running++;
+
+            return stripes;
+        }
+
+    return nullptr;
+}
+
+void AkVCam::ThreadPoolPrivate::taskDone()
+{
+    if (--this->m_pending > 0)
+        return;
+
+    this->m_mutex.lock();
+    this->m_done.notify_all();
+    this->m_mutex.unlock();
+}
+
+void AkVCam::ThreadPoolStripes::run()
+{
+    for (;;) {
+        int stripe = this->m_next++;
+
+        if (stripe >= this->m_stripes)
+            break;
+
+        int first = stripe * this->m_stripeLines;
+        (*this->m_task)(first, std::min(this->m_stripeLines,
+                                        this->m_lines - first));
+    }
+}
+
+int AkVCam::ThreadPoolPrivate::defaultThreadCount()
+{
+    return std::max(int(std::thread::hardware_concurrency()), 1);
+}
@@ -0,0 +1,97 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_THREADPOOL_H
+#define AKVCAMUTILS_THREADPOOL_H
+
+#include <functional>
+
+namespace AkVCam
+{
+    class ThreadPoolPrivate;
+    using ThreadPoolTask = std::function<void ()>;
+    using ThreadPoolStripeTask = std::function<void (int first, int count)>;
+
+    /* Work-stealing thread pool.
+     *
+     * Each worker has its own queue of tasks, workers with nothing to do take
+     * tasks from the other queues. The worker threads are created the first
+     * time a task is started.
+     */
+    class ThreadPool
+    {
+        public:
+            ThreadPool();
+            ThreadPool(const ThreadPool &other) = delete;
+            ThreadPool &operator =(const ThreadPool &other) = delete;
+            ~ThreadPool();
+
+            /* Maximum number of threads working in a parallel job, including
+             * the thread that started it. A value of 1 runs everything in the
+             * calling thread, a value < 1 uses one thread per core.
+             */
+            int maxThreadCount() const;
+            void setMaxThreadCount(int maxThreadCount);
+
+            // Run 'task' in a worker thread.
+            void start(const ThreadPoolTask &task);
+
+            // Wait until all started tasks are finished.
+            void waitForDone();
+
+            /* Stop the worker threads once they finish the queued tasks, they
+             * are started again when needed.
+             */
+            void stop();
+
+            /* Split 'lines' lines in stripes and run 'task' for each of them,
+             * returns when all stripes are done. Stripes start at a multiple
+             * of 'align' and have at least 'minLines' lines, so small images
+             * are processed in the calling thread. Nothing is allocated, the
+             * idle workers join the job directly.
+             */
+            void runStripes(int lines,
+                            int minLines,
+                            int align,
+                            const ThreadPoolStripeTask &task);
+
+            /* Same as above for any callable, 'task' is wrapped by reference
+             * so lambdas with many captures don't allocate a
+             * std::function on every call.
+             */
+            template<typename Task>
+            inline void runStripes(int lines,
+                                   int minLines,
+                                   int align,
+                                   const Task &task)
+            {
+                this->runStripes(lines,
+                                 minLines,
+                                 align,
+                                 ThreadPoolStripeTask(std::cref(task)));
+            }
+
+            static ThreadPool *globalInstance();
+
+        private:
+            ThreadPoolPrivate *d;
+    };
+}
+
+#endif // AKVCAMUTILS_THREADPOOL_H
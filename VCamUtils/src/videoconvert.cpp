@@ -0,0 +1,908 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "videoconvert.h"
+#include "color.h"
+#include "pixeltraits.h"
+#include "simd.h"
+
+/* The converters are generated from the PixelTraits of both formats, one
+ * template for each pair of pixel layouts. The conversions that have a SIMD
+ * kernel are declared with AKVCAM_SIMD_CONVERT.
+ */
+
+// Size of the image used for measuring the converters.
+#define CALIBRATION_WIDTH 320
+#define CALIBRATION_HEIGHT 240
+#define CALIBRATION_RUNS 3
+
+namespace AkVCam
+{
+    // Load and store the little-endian word of an RGB pixel.
+
+    template<size_t Bytes>
+    inline uint32_t loadWord(const uint8_t *pixel)
+    {
+        uint32_t word = 0;
+
+        for (size_t i = 0; i < Bytes; i++)
+            word |= uint32_t(pixel[i]) << (8 * i);
+
+        return word;
+    }
+
+    template<size_t Bytes>
+    inline void storeWord(uint8_t *pixel, uint32_t word)
+    {
+        for (size_t i = 0; i < Bytes; i++)
+            pixel[i] = uint8_t(word >> (8 * i));
+    }
+
+    // Scale a component of 'Bits' bits to 8 bits and back.
+
+    template<int Bits>
+    inline uint8_t expand(uint32_t component)
+    {
+        return uint8_t((component << (8 - Bits))
+                       | (component >> (2 * Bits - 8)));
+    }
+
+    template<int Bits>
+    inline uint32_t reduce(uint8_t component)
+    {
+        return uint32_t(component) >> (8 - Bits);
+    }
+
+    template<int Shift, int Bits>
+    inline uint8_t readComponent(uint32_t word)
+    {
+        return expand<Bits>((word >> Shift) & ((1u << Bits) - 1));
+    }
+
+    template<typename T>
+    inline void readRgb(const uint8_t *pixel, uint8_t *r, uint8_t *g, uint8_t *b)
+    {
+        auto word = loadWord<T::bytes>(pixel);
+        *r = readComponent<T::rShift, T::rBits>(word);
+        *g = readComponent<T::gShift, T::gBits>(word);
+        *b = readComponent<T::bShift, T::bBits>(word);
+    }
+
+    template<typename T>
+    inline void writeRgb(uint8_t *pixel, uint8_t r, uint8_t g, uint8_t b)
+    {
+        storeWord<T::bytes>(pixel,
+                            (reduce<T::rBits>(r) << T::rShift)
+                            | (reduce<T::gBits>(g) << T::gShift)
+                            | (reduce<T::bBits>(b) << T::bShift)
+                            | (((1u << T::xBits) - 1) << T::xShift));
+    }
+
+    // First U and V samples of the chroma line 'y' of 4:2:0 formats.
+    template<typename T, typename P>
+    inline P *lineU(P *const *planes, const size_t *strides, int y)
+    {
+        return planes[T::uPlane] + size_t(y) * strides[T::uPlane] + T::uOffset;
+    }
+
+    template<typename T, typename P>
+    inline P *lineV(P *const *planes, const size_t *strides, int y)
+    {
+        return planes[T::vPlane] + size_t(y) * strides[T::vPlane] + T::vOffset;
+    }
+
+    // SIMD kernels for each conversion, if any.
+    template<PixelFormat From, PixelFormat To>
+    struct SimdConvert
+    {
+        static constexpr SimdRowFunc SimdKernels::*row()
+        {
+            return nullptr;
+        }
+
+        static constexpr SimdRowPairFunc SimdKernels::*rowPair()
+        {
+            return nullptr;
+        }
+    };
+
+#define AKVCAM_SIMD_CONVERT(from, to, rowKernel, rowPairKernel) \
+    template<> \
+    struct SimdConvert<from, to> \
+    { \
+        static constexpr SimdRowFunc SimdKernels::*row() \
+        { \
+            return rowKernel; \
+        } \
+        \
+        static constexpr SimdRowPairFunc SimdKernels::*rowPair() \
+        { \
+            return rowPairKernel; \
+        } \
+    };
+
+    AKVCAM_SIMD_CONVERT(PixelFormatRGB24, PixelFormatUYVY, &SimdKernels::rgb24ToUyvy, nullptr)
+    AKVCAM_SIMD_CONVERT(PixelFormatRGB24, PixelFormatYUY2, &SimdKernels::rgb24ToYuy2, nullptr)
+    AKVCAM_SIMD_CONVERT(PixelFormatBGR24, PixelFormatUYVY, &SimdKernels::bgr24ToUyvy, nullptr)
+    AKVCAM_SIMD_CONVERT(PixelFormatBGR24, PixelFormatYUY2, &SimdKernels::bgr24ToYuy2, nullptr)
+    AKVCAM_SIMD_CONVERT(PixelFormatRGB24, PixelFormatNV12, nullptr, &SimdKernels::rgb24ToNv12)
+    AKVCAM_SIMD_CONVERT(PixelFormatRGB24, PixelFormatNV21, nullptr, &SimdKernels::rgb24ToNv21)
+    AKVCAM_SIMD_CONVERT(PixelFormatBGR24, PixelFormatNV12, nullptr, &SimdKernels::bgr24ToNv12)
+    AKVCAM_SIMD_CONVERT(PixelFormatBGR24, PixelFormatNV21, nullptr, &SimdKernels::bgr24ToNv21)
+
+    /* The planar formats use the kernel of the semi-planar format with the
+     * same chroma order, the chroma pairs are split in the two planes.
+     */
+    AKVCAM_SIMD_CONVERT(PixelFormatRGB24, PixelFormatI420, nullptr, &SimdKernels::rgb24ToNv12)
+    AKVCAM_SIMD_CONVERT(PixelFormatRGB24, PixelFormatYV12, nullptr, &SimdKernels::rgb24ToNv21)
+    AKVCAM_SIMD_CONVERT(PixelFormatBGR24, PixelFormatI420, nullptr, &SimdKernels::bgr24ToNv12)
+    AKVCAM_SIMD_CONVERT(PixelFormatBGR24, PixelFormatYV12, nullptr, &SimdKernels::bgr24ToNv21)
+
+    template<PixelFormat From,
+             PixelFormat To,
+             PixelLayout FromLayout=PixelTraits<From>::layout,
+             PixelLayout ToLayout=PixelTraits<To>::layout>
+    struct VideoConverter;
+
+    // RGB to RGB formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutRGB, PixelLayoutRGB>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (int y = 0; y < height; y++) {
+                auto srcLine = src[0] + size_t(y) * srcStride[0];
+                auto dstLine = dst[0] + size_t(y) * dstStride[0];
+
+                for (int x = 0; x < width; x++) {
+                    uint8_t r;
+                    uint8_t g;
+                    uint8_t b;
+                    readRgb<FT>(srcLine + FT::bytes * size_t(x), &r, &g, &b);
+                    writeRgb<TT>(dstLine + TT::bytes * size_t(x), r, g, b);
+                }
+            }
+        }
+    };
+
+    // RGB to Luminance+Chrominance formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutRGB, PixelLayoutPacked422>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            auto kernel = SimdConvert<From, To>::row();
+
+            if (kernel) {
+                auto convert = Simd::kernels().*kernel;
+
+                for (int y = 0; y < height; y++)
+                    convert(src[0] + size_t(y) * srcStride[0],
+                            dst[0] + size_t(y) * dstStride[0],
+                            width);
+
+                return;
+            }
+
+            for (int y = 0; y < height; y++) {
+                auto srcLine = src[0] + size_t(y) * srcStride[0];
+                auto dstLine = dst[0] + size_t(y) * dstStride[0];
+
+                for (int x = 0; x < width; x += 2) {
+                    // For odd widths repeat the last pixel.
+                    auto x1 = x + 1 < width? x + 1: x;
+                    uint8_t r0;
+                    uint8_t g0;
+                    uint8_t b0;
+                    readRgb<FT>(srcLine + FT::bytes * size_t(x), &r0, &g0, &b0);
+                    uint8_t r1;
+                    uint8_t g1;
+                    uint8_t b1;
+                    readRgb<FT>(srcLine + FT::bytes * size_t(x1), &r1, &g1, &b1);
+
+                    auto pixel = dstLine + 2 * size_t(x);
+                    pixel[TT::y0] = Color::rgbY(r0, g0, b0);
+                    pixel[TT::y1] = Color::rgbY(r1, g1, b1);
+                    pixel[TT::u] = Color::rgbU(r0, g0, b0);
+                    pixel[TT::v] = Color::rgbV(r0, g0, b0);
+                }
+            }
+        }
+    };
+
+    // RGB to 4:2:0 formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutRGB, PixelLayoutYuv420>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            auto kernel = SimdConvert<From, To>::rowPair();
+            auto convert = kernel? Simd::kernels().*kernel: nullptr;
+            auto split = Simd::kernels().splitBytes;
+            auto pairs = (width + 1) / 2;
+
+            // The kernels write interleaved chroma, the planar formats split it.
+            std::vector<uint8_t> chroma(convert && TT::step < 2?
+                                            2 * size_t(pairs): 0);
+
+            // Each chroma line is shared by two luma lines.
+            for (int y = 0; y < height; y += 2) {
+                // For odd sizes repeat the last line and column.
+                auto y1 = y + 1 < height? y + 1: y;
+                const uint8_t *srcLines[] {
+                    src[0] + size_t(y) * srcStride[0],
+                    src[0] + size_t(y1) * srcStride[0]
+                };
+                uint8_t *dstLinesY[] {
+                    dst[0] + size_t(y) * dstStride[0],
+                    dst[0] + size_t(y1) * dstStride[0]
+                };
+                auto dstLineU = lineU<TT>(dst, dstStride, y / 2);
+                auto dstLineV = lineV<TT>(dst, dstStride, y / 2);
+
+                if (convert) {
+                    if (TT::step > 1) {
+                        convert(srcLines[0],
+                                srcLines[1],
+                                dstLinesY[0],
+                                dstLinesY[1],
+                                std::min(dstLineU, dstLineV),
+                                width);
+                    } else {
+                        convert(srcLines[0],
+                                srcLines[1],
+                                dstLinesY[0],
+                                dstLinesY[1],
+                                chroma.data(),
+                                width);
+
+                        if (TT::uPlane < TT::vPlane)
+                            split(chroma.data(), dstLineU, dstLineV, pairs);
+                        else
+                            split(chroma.data(), dstLineV, dstLineU, pairs);
+                    }
+
+                    continue;
+                }
+
+                for (int x = 0; x < width; x += 2) {
+                    int xs[] {x, x + 1 < width? x + 1: x};
+                    int r = 0;
+                    int g = 0;
+                    int b = 0;
+
+                    for (int j = 0; j < 2; j++)
+                        for (int i = 0; i < 2; i++) {
+                            uint8_t pr;
+                            uint8_t pg;
+                            uint8_t pb;
+                            readRgb<FT>(srcLines[j] + FT::bytes * size_t(xs[i]),
+                                        &pr, &pg, &pb);
+                            dstLinesY[j][xs[i]] = Color::rgbY(pr, pg, pb);
+                            r += pr;
+                            g += pg;
+                            b += pb;
+                        }
+
+                    r = (r + 2) >> 2;
+                    g = (g + 2) >> 2;
+                    b = (b + 2) >> 2;
+                    auto c = size_t(x / 2 * TT::step);
+                    dstLineU[c] = Color::rgbU(r, g, b);
+                    dstLineV[c] = Color::rgbV(r, g, b);
+                }
+            }
+        }
+    };
+
+    // Luminance+Chrominance to RGB formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutPacked422, PixelLayoutRGB>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (int y = 0; y < height; y++) {
+                auto srcLine = src[0] + size_t(y) * srcStride[0];
+                auto dstLine = dst[0] + size_t(y) * dstStride[0];
+
+                for (int x = 0; x < width; x++) {
+                    auto pixel = srcLine + 4 * size_t(x / 2);
+                    int yp = pixel[x & 0x1? FT::y1: FT::y0];
+                    int u = pixel[FT::u];
+                    int v = pixel[FT::v];
+                    writeRgb<TT>(dstLine + TT::bytes * size_t(x),
+                                 Color::yuvR(yp, u, v),
+                                 Color::yuvG(yp, u, v),
+                                 Color::yuvB(yp, u, v));
+                }
+            }
+        }
+    };
+
+    // Luminance+Chrominance to Luminance+Chrominance formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutPacked422, PixelLayoutPacked422>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            // Formats that only differ in the order of the bytes of each pair.
+            bool swapPairs = FT::y0 == (TT::y0 ^ 1)
+                             && FT::y1 == (TT::y1 ^ 1)
+                             && FT::u == (TT::u ^ 1)
+                             && FT::v == (TT::v ^ 1);
+            auto macroPixels = (width + 1) / 2;
+            auto swap = Simd::kernels().swapBytes;
+
+            for (int y = 0; y < height; y++) {
+                auto srcLine = src[0] + size_t(y) * srcStride[0];
+                auto dstLine = dst[0] + size_t(y) * dstStride[0];
+
+                if (swapPairs) {
+                    swap(srcLine, dstLine, 2 * macroPixels);
+
+                    continue;
+                }
+
+                for (int x = 0; x < macroPixels; x++) {
+                    auto srcPixel = srcLine + 4 * size_t(x);
+                    auto dstPixel = dstLine + 4 * size_t(x);
+                    dstPixel[TT::y0] = srcPixel[FT::y0];
+                    dstPixel[TT::y1] = srcPixel[FT::y1];
+                    dstPixel[TT::u] = srcPixel[FT::u];
+                    dstPixel[TT::v] = srcPixel[FT::v];
+                }
+            }
+        }
+    };
+
+    // Luminance+Chrominance to 4:2:0 formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutPacked422, PixelLayoutYuv420>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (int y = 0; y < height; y += 2) {
+                auto y1 = y + 1 < height? y + 1: y;
+                auto srcLine0 = src[0] + size_t(y) * srcStride[0];
+                auto srcLine1 = src[0] + size_t(y1) * srcStride[0];
+                auto dstLineY0 = dst[0] + size_t(y) * dstStride[0];
+                auto dstLineY1 = dst[0] + size_t(y1) * dstStride[0];
+                auto dstLineU = lineU<TT>(dst, dstStride, y / 2);
+                auto dstLineV = lineV<TT>(dst, dstStride, y / 2);
+
+                for (int x = 0; x < width; x += 2) {
+                    auto pixel0 = srcLine0 + 2 * size_t(x);
+                    auto pixel1 = srcLine1 + 2 * size_t(x);
+                    dstLineY0[x] = pixel0[FT::y0];
+                    dstLineY1[x] = pixel1[FT::y0];
+
+                    if (x + 1 < width) {
+                        dstLineY0[x + 1] = pixel0[FT::y1];
+                        dstLineY1[x + 1] = pixel1[FT::y1];
+                    }
+
+                    // The chroma is already subsampled horizontally.
+                    auto c = size_t(x / 2 * TT::step);
+                    dstLineU[c] =
+                            uint8_t((pixel0[FT::u] + pixel1[FT::u] + 1) >> 1);
+                    dstLineV[c] =
+                            uint8_t((pixel0[FT::v] + pixel1[FT::v] + 1) >> 1);
+                }
+            }
+        }
+    };
+
+    // 4:2:0 to RGB formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutYuv420, PixelLayoutRGB>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (int y = 0; y < height; y++) {
+                auto srcLineY = src[0] + size_t(y) * srcStride[0];
+                auto srcLineU = lineU<FT>(src, srcStride, y / 2);
+                auto srcLineV = lineV<FT>(src, srcStride, y / 2);
+                auto dstLine = dst[0] + size_t(y) * dstStride[0];
+
+                for (int x = 0; x < width; x++) {
+                    int yp = srcLineY[x];
+                    auto c = size_t(x / 2 * FT::step);
+                    int u = srcLineU[c];
+                    int v = srcLineV[c];
+                    writeRgb<TT>(dstLine + TT::bytes * size_t(x),
+                                 Color::yuvR(yp, u, v),
+                                 Color::yuvG(yp, u, v),
+                                 Color::yuvB(yp, u, v));
+                }
+            }
+        }
+    };
+
+    // 4:2:0 to Luminance+Chrominance formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutYuv420, PixelLayoutPacked422>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (int y = 0; y < height; y++) {
+                auto srcLineY = src[0] + size_t(y) * srcStride[0];
+                auto srcLineU = lineU<FT>(src, srcStride, y / 2);
+                auto srcLineV = lineV<FT>(src, srcStride, y / 2);
+                auto dstLine = dst[0] + size_t(y) * dstStride[0];
+
+                for (int x = 0; x < width; x += 2) {
+                    auto pixel = dstLine + 2 * size_t(x);
+                    auto c = size_t(x / 2 * FT::step);
+                    pixel[TT::y0] = srcLineY[x];
+                    pixel[TT::y1] = srcLineY[x + 1 < width? x + 1: x];
+                    pixel[TT::u] = srcLineU[c];
+                    pixel[TT::v] = srcLineV[c];
+                }
+            }
+        }
+    };
+
+    // 4:2:0 to 4:2:0 formats
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConverter<From, To, PixelLayoutYuv420, PixelLayoutYuv420>
+    {
+        using FT = PixelTraits<From>;
+        using TT = PixelTraits<To>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (int y = 0; y < height; y++)
+                memcpy(dst[0] + size_t(y) * dstStride[0],
+                       src[0] + size_t(y) * srcStride[0],
+                       size_t(width));
+
+            // Only the placement of the chroma samples can differ.
+            auto pairs = (width + 1) / 2;
+            auto &kernels = Simd::kernels();
+
+            for (int y = 0; y < (height + 1) / 2; y++) {
+                auto srcLineU = lineU<FT>(src, srcStride, y);
+                auto srcLineV = lineV<FT>(src, srcStride, y);
+                auto dstLineU = lineU<TT>(dst, dstStride, y);
+                auto dstLineV = lineV<TT>(dst, dstStride, y);
+
+                if (FT::step > 1 && TT::step > 1) {
+                    auto srcLine = std::min(srcLineU, srcLineV);
+                    auto dstLine = std::min(dstLineU, dstLineV);
+
+                    if (FT::uOffset == TT::uOffset)
+                        memcpy(dstLine, srcLine, 2 * size_t(pairs));
+                    else
+                        kernels.swapBytes(srcLine, dstLine, pairs);
+                } else if (FT::step > 1) {
+                    auto srcLine = std::min(srcLineU, srcLineV);
+
+                    if (FT::uOffset < FT::vOffset)
+                        kernels.splitBytes(srcLine, dstLineU, dstLineV, pairs);
+                    else
+                        kernels.splitBytes(srcLine, dstLineV, dstLineU, pairs);
+                } else if (TT::step > 1) {
+                    auto dstLine = std::min(dstLineU, dstLineV);
+
+                    if (TT::uOffset < TT::vOffset)
+                        kernels.mergeBytes(srcLineU, srcLineV, dstLine, pairs);
+                    else
+                        kernels.mergeBytes(srcLineV, srcLineU, dstLine, pairs);
+                } else {
+                    memcpy(dstLineU, srcLineU, size_t(pairs));
+                    memcpy(dstLineV, srcLineV, size_t(pairs));
+                }
+            }
+        }
+    };
+
+    // Same format in both sides, copy the planes line by line.
+    template<PixelFormat F>
+    struct VideoCopy
+    {
+        using T = PixelTraits<F>;
+
+        static void convert(const uint8_t *const *src,
+                            const size_t *srcStride,
+                            uint8_t *const *dst,
+                            const size_t *dstStride,
+                            int width,
+                            int height)
+        {
+            for (size_t plane = 0; plane < T::planes; plane++) {
+                auto lineSize = T::lineSize(plane, width);
+
+                for (int y = 0; y < T::planeHeight(plane, height); y++)
+                    memcpy(dst[plane] + size_t(y) * dstStride[plane],
+                           src[plane] + size_t(y) * srcStride[plane],
+                           lineSize);
+            }
+        }
+    };
+
+    template<PixelFormat From, PixelFormat To, bool Copy=From == To>
+    struct VideoConvertEntry
+    {
+        static constexpr VideoConvertFunction function()
+        {
+            return &VideoConverter<From, To>::convert;
+        }
+
+        /* Rough cost in nanoseconds per pixel, the SIMD kernels and the
+         * shuffles between formats of the same layout are the cheapest ones,
+         * changing the color space pixel by pixel is the most expensive.
+         */
+        static constexpr double cost()
+        {
+            return SimdConvert<From, To>::row() != nullptr
+                   || SimdConvert<From, To>::rowPair() != nullptr?
+                        0.5:
+                   PixelTraits<From>::layout == PixelTraits<To>::layout
+                   && PixelTraits<From>::layout != PixelLayoutRGB?
+                        0.5:
+                   (PixelTraits<From>::layout == PixelLayoutRGB)
+                   != (PixelTraits<To>::layout == PixelLayoutRGB)?
+                        8.0:
+                   PixelTraits<From>::layout == PixelLayoutRGB?
+                        6.0:
+                        3.0;
+        }
+    };
+
+    template<PixelFormat From, PixelFormat To>
+    struct VideoConvertEntry<From, To, true>
+    {
+        static constexpr VideoConvertFunction function()
+        {
+            return &VideoCopy<From>::convert;
+        }
+
+        static constexpr double cost()
+        {
+            return 0.1;
+        }
+    };
+
+    // The order of the rows and columns must match formatIndex().
+#define AKVCAM_CONVERT_ROW(from, value) \
+    { \
+        VideoConvertEntry<from, PixelFormatRGB32>::value(), \
+        VideoConvertEntry<from, PixelFormatRGB24>::value(), \
+        VideoConvertEntry<from, PixelFormatRGB16>::value(), \
+        VideoConvertEntry<from, PixelFormatRGB15>::value(), \
+        VideoConvertEntry<from, PixelFormatBGR32>::value(), \
+        VideoConvertEntry<from, PixelFormatBGR24>::value(), \
+        VideoConvertEntry<from, PixelFormatBGR16>::value(), \
+        VideoConvertEntry<from, PixelFormatBGR15>::value(), \
+        VideoConvertEntry<from, PixelFormatUYVY >::value(), \
+        VideoConvertEntry<from, PixelFormatYUY2 >::value(), \
+        VideoConvertEntry<from, PixelFormatNV12 >::value(), \
+        VideoConvertEntry<from, PixelFormatNV21 >::value(), \
+        VideoConvertEntry<from, PixelFormatI420 >::value(), \
+        VideoConvertEntry<from, PixelFormatYV12 >::value()  \
+    }
+
+    static constexpr VideoConvertFunction videoConvertTable[][14] {
+        AKVCAM_CONVERT_ROW(PixelFormatRGB32, function),
+        AKVCAM_CONVERT_ROW(PixelFormatRGB24, function),
+        AKVCAM_CONVERT_ROW(PixelFormatRGB16, function),
+        AKVCAM_CONVERT_ROW(PixelFormatRGB15, function),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR32, function),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR24, function),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR16, function),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR15, function),
+        AKVCAM_CONVERT_ROW(PixelFormatUYVY, function),
+        AKVCAM_CONVERT_ROW(PixelFormatYUY2, function),
+        AKVCAM_CONVERT_ROW(PixelFormatNV12, function),
+        AKVCAM_CONVERT_ROW(PixelFormatNV21, function),
+        AKVCAM_CONVERT_ROW(PixelFormatI420, function),
+        AKVCAM_CONVERT_ROW(PixelFormatYV12, function)
+    };
+
+    // Used until calibrated, see VideoConvert::cost().
+    static constexpr double defaultCostTable[][14] {
+        AKVCAM_CONVERT_ROW(PixelFormatRGB32, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatRGB24, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatRGB16, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatRGB15, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR32, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR24, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR16, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatBGR15, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatUYVY, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatYUY2, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatNV12, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatNV21, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatI420, cost),
+        AKVCAM_CONVERT_ROW(PixelFormatYV12, cost)
+    };
+
+    using PlaneHeightFunction = int (*)(size_t plane, int height);
+
+    // Indexed by formatIndex().
+    static constexpr PlaneHeightFunction planeHeightTable[] {
+        &PixelTraits<PixelFormatRGB32>::planeHeight,
+        &PixelTraits<PixelFormatRGB24>::planeHeight,
+        &PixelTraits<PixelFormatRGB16>::planeHeight,
+        &PixelTraits<PixelFormatRGB15>::planeHeight,
+        &PixelTraits<PixelFormatBGR32>::planeHeight,
+        &PixelTraits<PixelFormatBGR24>::planeHeight,
+        &PixelTraits<PixelFormatBGR16>::planeHeight,
+        &PixelTraits<PixelFormatBGR15>::planeHeight,
+        &PixelTraits<PixelFormatUYVY>::planeHeight,
+        &PixelTraits<PixelFormatYUY2>::planeHeight,
+        &PixelTraits<PixelFormatNV12>::planeHeight,
+        &PixelTraits<PixelFormatNV21>::planeHeight,
+        &PixelTraits<PixelFormatI420>::planeHeight,
+        &PixelTraits<PixelFormatYV12>::planeHeight
+    };
+
+    class VideoConvertCosts
+    {
+        public:
+            double m_costs[14][14];
+            std::mutex m_mutex;
+
+            VideoConvertCosts();
+            static VideoConvertCosts &instance();
+    };
+
+    inline int formatIndex(FourCC fourcc)
+    {
+        switch (fourcc) {
+        case PixelFormatRGB32:
+            return 0;
+        case PixelFormatRGB24:
+            return 1;
+        case PixelFormatRGB16:
+            return 2;
+        case PixelFormatRGB15:
+            return 3;
+        case PixelFormatBGR32:
+            return 4;
+        case PixelFormatBGR24:
+            return 5;
+        case PixelFormatBGR16:
+            return 6;
+        case PixelFormatBGR15:
+            return 7;
+        case PixelFormatUYVY:
+            return 8;
+        case PixelFormatYUY2:
+            return 9;
+        case PixelFormatNV12:
+            return 10;
+        case PixelFormatNV21:
+            return 11;
+        case PixelFormatI420:
+            return 12;
+        case PixelFormatYV12:
+            return 13;
+        default:
+            break;
+        }
+
+        return -1;
+    }
+}
+
+AkVCam::VideoConvertFunction AkVCam::VideoConvert::converter(FourCC from,
+                                                             FourCC to)
+{
+    auto fromIndex = formatIndex(from);
+    auto toIndex = formatIndex(to);
+
+    if (fromIndex < 0 || toIndex < 0)
+        return nullptr;
+
+    return videoConvertTable[fromIndex][toIndex];
+}
+
+int AkVCam::VideoConvert::planeHeight(FourCC fourcc, size_t plane, int height)
+{
+    auto index = formatIndex(fourcc);
+
+    if (index < 0)
+        return 0;
+
+    return planeHeightTable[index](plane, height);
+}
+
+double AkVCam::VideoConvert::cost(FourCC from, FourCC to)
+{
+    auto fromIndex = formatIndex(from);
+    auto toIndex = formatIndex(to);
+
+    if (fromIndex < 0 || toIndex < 0)
+        return -1.0;
+
+    auto &costs = VideoConvertCosts::instance();
+    std::lock_guard<std::mutex> lock(costs.m_mutex);
+
+    return costs.m_costs[fromIndex][toIndex];
+}
+
+void AkVCam::VideoConvert::setCost(FourCC from, FourCC to, double cost)
+{
+    auto fromIndex = formatIndex(from);
+    auto toIndex = formatIndex(to);
+
+    if (fromIndex < 0 || toIndex < 0 || cost < 0.0)
+        return;
+
+    auto &costs = VideoConvertCosts::instance();
+    std::lock_guard<std::mutex> lock(costs.m_mutex);
+    costs.m_costs[fromIndex][toIndex] = cost;
+}
+
+void AkVCam::VideoConvert::calibrate()
+{
+    static const FourCC formats[] {
+        PixelFormatRGB32,
+        PixelFormatRGB24,
+        PixelFormatRGB16,
+        PixelFormatRGB15,
+        PixelFormatBGR32,
+        PixelFormatBGR24,
+        PixelFormatBGR16,
+        PixelFormatBGR15,
+        PixelFormatUYVY,
+        PixelFormatYUY2,
+        PixelFormatNV12,
+        PixelFormatNV21,
+        PixelFormatI420,
+        PixelFormatYV12
+    };
+
+    /* Every plane is given 4 bytes per pixel, that's enough for any of the
+     * supported formats.
+     */
+    const size_t stride = 4 * CALIBRATION_WIDTH;
+    const size_t planeSize = stride * CALIBRATION_HEIGHT;
+    std::vector<uint8_t> src(3 * planeSize, 0x80);
+    std::vector<uint8_t> dst(3 * planeSize);
+    const uint8_t *srcPlanes[] {
+        src.data(),
+        src.data() + planeSize,
+        src.data() + 2 * planeSize
+    };
+    uint8_t *dstPlanes[] {
+        dst.data(),
+        dst.data() + planeSize,
+        dst.data() + 2 * planeSize
+    };
+    const size_t strides[] {stride, stride, stride};
+    const double pixels = double(CALIBRATION_WIDTH) * CALIBRATION_HEIGHT;
+
+    for (auto &from: formats)
+        for (auto &to: formats) {
+            auto convert = converter(from, to);
+
+            if (!convert)
+                continue;
+
+            // Warm up the caches, then keep the fastest run.
+            convert(srcPlanes, strides,
+                    dstPlanes, strides,
+                    CALIBRATION_WIDTH, CALIBRATION_HEIGHT);
+            double best = 0.0;
+
+            for (int i = 0; i < CALIBRATION_RUNS; i++) {
+                auto t0 = std::chrono::steady_clock::now();
+                convert(srcPlanes, strides,
+                        dstPlanes, strides,
+                        CALIBRATION_WIDTH, CALIBRATION_HEIGHT);
+                auto t1 = std::chrono::steady_clock::now();
+                double ns =
+                        std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+                if (i == 0 || ns < best)
+                    best = ns;
+            }
+
+            setCost(from, to, best / pixels);
+        }
+}
+
+AkVCam::VideoConvertCosts::VideoConvertCosts()
+{
+    memcpy(this->m_costs, defaultCostTable, sizeof(this->m_costs));
+}
+
+AkVCam::VideoConvertCosts &AkVCam::VideoConvertCosts::instance()
+{
+    static VideoConvertCosts costs;
+
+    return costs;
+}
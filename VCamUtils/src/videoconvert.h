@@ -0,0 +1,66 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKVCAMUTILS_VIDEOCONVERT_H
+#define AKVCAMUTILS_VIDEOCONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "videoformattypes.h"
+
+namespace AkVCam
+{
+    /* Convert a 'width' x 'height' image from the planes in 'src' to the
+     * planes in 'dst', the lines of each plane are 'srcStride' and
+     * 'dstStride' bytes apart.
+     */
+    using VideoConvertFunction = void (*)(const uint8_t *const *src,
+                                          const size_t *srcStride,
+                                          uint8_t *const *dst,
+                                          const size_t *dstStride,
+                                          int width,
+                                          int height);
+
+    namespace VideoConvert
+    {
+        /* Converter from 'from' to 'to', or nullptr if the conversion is not
+         * supported. If both formats are the same the planes are copied.
+         */
+        VideoConvertFunction converter(FourCC from, FourCC to);
+
+        /* Number of lines of 'plane' for an image of 'height' lines, it can
+         * also be used to locate the first line of a horizontal stripe of an
+         * image if the stripe starts at an even line.
+         */
+        int planeHeight(FourCC fourcc, size_t plane, int height);
+
+        /* Estimated time in nanoseconds for converting a pixel from 'from'
+         * to 'to', or a negative value if the conversion is not supported.
+         * The default values are rough estimates, good enough for ranking
+         * the formats, calibrate() replaces them with the times measured in
+         * this host.
+         */
+        double cost(FourCC from, FourCC to);
+        void setCost(FourCC from, FourCC to, double cost);
+        void calibrate();
+    }
+}
+
+#endif // AKVCAMUTILS_VIDEOCONVERT_H
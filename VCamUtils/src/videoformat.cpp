@@ -27,23 +27,11 @@
 
 namespace AkVCam
 {
-    class VideoFormatPrivate
-    {
-        public:
-            FourCC m_fourcc {0};
-            int m_width {0};
-            int m_height {0};
-            std::vector<Fraction> m_frameRates;
-
-            VideoFormatPrivate() = default;
-            VideoFormatPrivate(FourCC fourcc,
-                               int width,
-                               int height,
-                               const std::vector<Fraction> &frameRates);
-    };
-
-    using PlaneOffsetFunc = size_t (*)(size_t plane, size_t width, size_t height);
-    using ByplFunc = size_t (*)(size_t plane, size_t width);
+    using PlaneOffsetFunc = size_t (*)(size_t plane,
+                                       size_t width,
+                                       size_t height,
+                                       size_t align);
+    using ByplFunc = size_t (*)(size_t plane, size_t width, size_t align);
 
     class VideoFormatGlobals
     {
@@ -58,8 +46,22 @@ namespace AkVCam
             inline static const std::vector<VideoFormatGlobals> &formats();
             static inline const VideoFormatGlobals *byPixelFormat(PixelFormat pixelFormat);
             static inline const VideoFormatGlobals *byStr(const std::string &str);
-            static size_t offsetNV(size_t plane, size_t width, size_t height);
-            static size_t byplNV(size_t plane, size_t width);
+            static size_t offsetNV(size_t plane,
+                                   size_t width,
+                                   size_t height,
+                                   size_t align);
+            static size_t byplNV(size_t plane, size_t width, size_t align);
+            static size_t offsetPlanar(size_t plane,
+                                       size_t width,
+                                       size_t height,
+                                       size_t align);
+            static size_t byplPlanar(size_t plane, size_t width, size_t align);
+            static inline size_t byplPacked(size_t width,
+                                            size_t bpp,
+                                            size_t align);
+
+            // The line alignment rounded up to a power of 2.
+            static inline size_t lineAlign(size_t align);
 
             template<typename T>
             static inline T alignUp(const T &value, const T &align)
@@ -75,58 +77,33 @@ namespace AkVCam
     };
 }
 
-AkVCam::VideoFormat::VideoFormat()
-{
-    this->d = new VideoFormatPrivate;
-}
-
 AkVCam::VideoFormat::VideoFormat(FourCC fourcc,
                                  int width,
                                  int height,
-                                 const std::vector<Fraction> &frameRates)
-{
-    this->d = new VideoFormatPrivate(fourcc, width, height, frameRates);
-}
-
-AkVCam::VideoFormat::VideoFormat(const VideoFormat &other)
-{
-    this->d = new VideoFormatPrivate(other.d->m_fourcc,
-                                     other.d->m_width,
-                                     other.d->m_height,
-                                     other.d->m_frameRates);
-}
-
-AkVCam::VideoFormat::~VideoFormat()
-{
-    delete this->d;
-}
-
-AkVCam::VideoFormat &AkVCam::VideoFormat::operator =(const VideoFormat &other)
+                                 const std::vector<Fraction> &frameRates):
+    m_fourcc(fourcc),
+    m_width(width),
+    m_height(height),
+    m_frameRates(frameRates)
 {
-    if (this != &other) {
-        this->d->m_fourcc = other.d->m_fourcc;
-        this->d->m_width = other.d->m_width;
-        this->d->m_height = other.d->m_height;
-        this->d->m_frameRates = other.d->m_frameRates;
-    }
-
-    return *this;
 }
 
 bool AkVCam::VideoFormat::operator ==(const AkVCam::VideoFormat &other) const
 {
-    return this->d->m_fourcc == other.d->m_fourcc
-           && this->d->m_width == other.d->m_width
-           && this->d->m_height == other.d->m_height
-           && this->d->m_frameRates == other.d->m_frameRates;
+    return this->m_fourcc == other.m_fourcc
+           && this->m_width == other.m_width
+           && this->m_height == other.m_height
+           && this->m_frameRates == other.m_frameRates
+           && this->m_align == other.m_align;
 }
 
 bool AkVCam::VideoFormat::operator !=(const AkVCam::VideoFormat &other) const
 {
-    return this->d->m_fourcc != other.d->m_fourcc
-           || this->d->m_width != other.d->m_width
-           || this->d->m_height != other.d->m_height
-           || this->d->m_frameRates != other.d->m_frameRates;
+    return this->m_fourcc != other.m_fourcc
+           || this->m_width != other.m_width
+           || this->m_height != other.m_height
+           || this->m_frameRates != other.m_frameRates
+           || this->m_align != other.m_align;
 }
 
 AkVCam::VideoFormat::operator bool() const
@@ -134,55 +111,15 @@ AkVCam::VideoFormat::operator bool() const
     return this->isValid();
 }
 
-AkVCam::FourCC AkVCam::VideoFormat::fourcc() const
-{
-    return this->d->m_fourcc;
-}
-
-AkVCam::FourCC &AkVCam::VideoFormat::fourcc()
-{
-    return this->d->m_fourcc;
-}
-
-int AkVCam::VideoFormat::width() const
-{
-    return this->d->m_width;
-}
-
-int &AkVCam::VideoFormat::width()
-{
-    return this->d->m_width;
-}
-
-int AkVCam::VideoFormat::height() const
-{
-    return this->d->m_height;
-}
-
-int &AkVCam::VideoFormat::height()
-{
-    return this->d->m_height;
-}
-
-std::vector<AkVCam::Fraction> AkVCam::VideoFormat::frameRates() const
-{
-    return this->d->m_frameRates;
-}
-
-std::vector<AkVCam::Fraction> &AkVCam::VideoFormat::frameRates()
-{
-    return this->d->m_frameRates;
-}
-
 std::vector<AkVCam::FractionRange> AkVCam::VideoFormat::frameRateRanges() const
 {
     std::vector<FractionRange> ranges;
 
-    if (!this->d->m_frameRates.empty()) {
-        auto min = *std::min_element(this->d->m_frameRates.begin(),
-                                     this->d->m_frameRates.end());
-        auto max = *std::max_element(this->d->m_frameRates.begin(),
-                                     this->d->m_frameRates.end());
+    if (!this->m_frameRates.empty()) {
+        auto min = *std::min_element(this->m_frameRates.begin(),
+                                     this->m_frameRates.end());
+        auto max = *std::max_element(this->m_frameRates.begin(),
+                                     this->m_frameRates.end());
         ranges.emplace_back(FractionRange {min, max});
     }
 
@@ -191,75 +128,128 @@ std::vector<AkVCam::FractionRange> AkVCam::VideoFormat::frameRateRanges() const
 
 AkVCam::Fraction AkVCam::VideoFormat::minimumFrameRate() const
 {
-    if (this->d->m_frameRates.empty())
+    if (this->m_frameRates.empty())
         return {0, 0};
 
-    return *std::min_element(this->d->m_frameRates.begin(),
-                             this->d->m_frameRates.end());
+    return *std::min_element(this->m_frameRates.begin(),
+                             this->m_frameRates.end());
 }
 
 size_t AkVCam::VideoFormat::bpp() const
 {
-    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->d->m_fourcc));
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
 
     return vf? vf->bpp: 0;
 }
 
 size_t AkVCam::VideoFormat::bypl(size_t plane) const
 {
-    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->d->m_fourcc));
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
 
     if (!vf)
         return 0;
 
+    auto align = VideoFormatGlobals::lineAlign(this->m_align);
+
     if (vf->bypl)
-        return vf->bypl(plane, size_t(this->d->m_width));
+        return vf->bypl(plane, size_t(this->m_width), align);
 
-    return VideoFormatGlobals::align32(size_t(this->d->m_width) * vf->bpp) / 8;
+    return VideoFormatGlobals::byplPacked(size_t(this->m_width),
+                                          vf->bpp,
+                                          align);
+}
+
+size_t AkVCam::VideoFormat::lineSize(size_t plane) const
+{
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
+
+    if (!vf || plane >= vf->planes)
+        return 0;
+
+    auto width = size_t(this->m_width);
+
+    switch (vf->format) {
+    // The last macropixel is complete even for odd widths.
+    case PixelFormatUYVY:
+    case PixelFormatYUY2:
+        return 4 * ((width + 1) / 2);
+    case PixelFormatNV12:
+    case PixelFormatNV21:
+        return plane < 1? width: 2 * ((width + 1) / 2);
+    case PixelFormatI420:
+    case PixelFormatYV12:
+        return plane < 1? width: (width + 1) / 2;
+    default:
+        break;
+    }
+
+    return (width * vf->bpp + 7) / 8;
 }
 
 size_t AkVCam::VideoFormat::size() const
 {
-    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->d->m_fourcc));
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
 
     if (!vf)
         return 0;
 
+    auto align = VideoFormatGlobals::lineAlign(this->m_align);
+
     if (vf->planeOffset)
         return vf->planeOffset(vf->planes,
-                               size_t(this->d->m_width),
-                               size_t(this->d->m_height));
+                               size_t(this->m_width),
+                               size_t(this->m_height),
+                               align);
 
-    return size_t(this->d->m_height)
-           * VideoFormatGlobals::align32(size_t(this->d->m_width)
-                                         * vf->bpp) / 8;
+    return size_t(this->m_height)
+           * VideoFormatGlobals::byplPacked(size_t(this->m_width),
+                                            vf->bpp,
+                                            align);
 }
 
 size_t AkVCam::VideoFormat::planes() const
 {
-    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->d->m_fourcc));
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
 
     return vf? vf->planes: 0;
 }
 
 size_t AkVCam::VideoFormat::offset(size_t plane) const
 {
-    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->d->m_fourcc));
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
 
     if (!vf)
         return 0;
 
+    auto align = VideoFormatGlobals::lineAlign(this->m_align);
+
     if (vf->planeOffset)
         return vf->planeOffset(plane,
-                               size_t(this->d->m_width),
-                               size_t(this->d->m_height));
+                               size_t(this->m_width),
+                               size_t(this->m_height),
+                               align);
 
     return 0;
 }
 
 size_t AkVCam::VideoFormat::planeSize(size_t plane) const
 {
-    return size_t(this->d->m_height) * this->bypl(plane);
+    auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
+
+    auto align = VideoFormatGlobals::lineAlign(this->m_align);
+
+    // The chroma planes of the multiplanar formats have less lines.
+    if (vf && vf->planeOffset && plane < vf->planes)
+        return vf->planeOffset(plane + 1,
+                               size_t(this->m_width),
+                               size_t(this->m_height),
+                               align)
+               - vf->planeOffset(plane,
+                                 size_t(this->m_width),
+                                 size_t(this->m_height),
+                                 align);
+
+    return size_t(this->m_height) * this->bypl(plane);
 }
 
 bool AkVCam::VideoFormat::isValid() const
@@ -267,10 +257,14 @@ bool AkVCam::VideoFormat::isValid() const
     if (this->size() < 1)
         return false;
 
-    if (this->d->m_frameRates.empty())
+    // The alignment must be a power of 2.
+    if (this->m_align & (this->m_align - 1))
+        return false;
+
+    if (this->m_frameRates.empty())
         return false;
 
-    for (auto &fps: this->d->m_frameRates)
+    for (auto &fps: this->m_frameRates)
         if (fps.num() < 1 || fps.den() < 1)
             return false;
 
@@ -279,31 +273,39 @@ bool AkVCam::VideoFormat::isValid() const
 
 void AkVCam::VideoFormat::clear()
 {
-    this->d->m_fourcc = 0;
-    this->d->m_width = 0;
-    this->d->m_height = 0;
-    this->d->m_frameRates.clear();
+    this->m_fourcc = 0;
+    this->m_width = 0;
+    this->m_height = 0;
+    this->m_frameRates.clear();
+    this->m_align = 0;
 }
 
 AkVCam::VideoFormat AkVCam::VideoFormat::nearest(const std::vector<VideoFormat> &formats) const
 {
     VideoFormat nearestFormat;
     auto q = std::numeric_limits<uint64_t>::max();
-    auto svf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->d->m_fourcc));
+    auto svf = VideoFormatGlobals::byPixelFormat(PixelFormat(this->m_fourcc));
+    int64_t sbpp = svf? int64_t(svf->bpp): 0;
+    int64_t splanes = svf? int64_t(svf->planes): 0;
 
     for (auto &format: formats) {
-        auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(format.d->m_fourcc));
-        uint64_t diffFourcc = format.d->m_fourcc == this->d->m_fourcc? 0: 1;
-        auto diffWidth = format.d->m_width - this->d->m_width;
-        auto diffHeight = format.d->m_height - this->d->m_height;
-        auto diffBpp = vf->bpp - svf->bpp;
-        auto diffPlanes = vf->planes - svf->planes;
+        auto vf = VideoFormatGlobals::byPixelFormat(PixelFormat(format.m_fourcc));
+
+        // Unknown formats can't be produced.
+        if (!vf)
+            continue;
+
+        uint64_t diffFourcc = format.m_fourcc == this->m_fourcc? 0: 1;
+        auto diffWidth = int64_t(format.m_width) - this->m_width;
+        auto diffHeight = int64_t(format.m_height) - this->m_height;
+        auto diffBpp = int64_t(vf->bpp) - sbpp;
+        auto diffPlanes = int64_t(vf->planes) - splanes;
 
         uint64_t k = diffFourcc
                    + uint64_t(diffWidth * diffWidth)
                    + uint64_t(diffHeight * diffHeight)
-                   + diffBpp * diffBpp
-                   + diffPlanes * diffPlanes;
+                   + uint64_t(diffBpp * diffBpp)
+                   + uint64_t(diffPlanes * diffPlanes);
 
         if (k < q) {
             nearestFormat = format;
@@ -357,17 +359,6 @@ std::string AkVCam::VideoFormat::stringFromFourcc(AkVCam::FourCC fourcc)
     return vf? vf->str: std::string();
 }
 
-AkVCam::VideoFormatPrivate::VideoFormatPrivate(FourCC fourcc,
-                                               int width,
-                                               int height,
-                                               const std::vector<Fraction> &frameRates):
-    m_fourcc(fourcc),
-    m_width(width),
-    m_height(height),
-    m_frameRates(frameRates)
-{
-}
-
 const std::vector<AkVCam::VideoFormatGlobals> &AkVCam::VideoFormatGlobals::formats()
 {
     static const std::vector<VideoFormatGlobals> formats {
@@ -382,7 +373,9 @@ const std::vector<AkVCam::VideoFormatGlobals> &AkVCam::VideoFormatGlobals::forma
         {PixelFormatUYVY , 16, 1,  nullptr, nullptr,  "UYVY"},
         {PixelFormatYUY2 , 16, 1,  nullptr, nullptr,  "YUY2"},
         {PixelFormatNV12 , 12, 2, offsetNV,  byplNV,  "NV12"},
-        {PixelFormatNV21 , 12, 2, offsetNV,  byplNV,  "NV21"}
+        {PixelFormatNV21 , 12, 2, offsetNV,  byplNV,  "NV21"},
+        {PixelFormatI420 , 12, 3, offsetPlanar, byplPlanar, "I420"},
+        {PixelFormatYV12 , 12, 3, offsetPlanar, byplPlanar, "YV12"}
     };
 
     return formats;
@@ -406,22 +399,79 @@ const AkVCam::VideoFormatGlobals *AkVCam::VideoFormatGlobals::byStr(const std::s
     return nullptr;
 }
 
-size_t AkVCam::VideoFormatGlobals::offsetNV(size_t plane, size_t width, size_t height)
+size_t AkVCam::VideoFormatGlobals::offsetNV(size_t plane,
+                                            size_t width,
+                                            size_t height,
+                                            size_t align)
 {
+    auto bypl = byplNV(0, width, align);
     size_t offset[] = {
         0,
-        align32(size_t(width)) * height,
-        5 * align32(size_t(width)) * height / 4
+        bypl * height,
+        bypl * (height + (height + 1) / 2)
     };
 
     return offset[plane];
 }
 
-size_t AkVCam::VideoFormatGlobals::byplNV(size_t plane, size_t width)
+size_t AkVCam::VideoFormatGlobals::byplNV(size_t plane,
+                                          size_t width,
+                                          size_t align)
 {
     UNUSED(plane);
 
-    return align32(size_t(width));
+    return align? alignUp(width, align): align32(width);
+}
+
+size_t AkVCam::VideoFormatGlobals::offsetPlanar(size_t plane,
+                                                size_t width,
+                                                size_t height,
+                                                size_t align)
+{
+    auto lumaSize = byplPlanar(0, width, align) * height;
+    auto chromaSize = byplPlanar(1, width, align) * ((height + 1) / 2);
+    size_t offset[] = {
+        0,
+        lumaSize,
+        lumaSize + chromaSize,
+        lumaSize + 2 * chromaSize
+    };
+
+    return offset[plane];
+}
+
+size_t AkVCam::VideoFormatGlobals::byplPlanar(size_t plane,
+                                              size_t width,
+                                              size_t align)
+{
+    if (!align)
+        return plane < 1? align32(width): align32(width) / 2;
+
+    return plane < 1? alignUp(width, align): alignUp((width + 1) / 2, align);
+}
+
+size_t AkVCam::VideoFormatGlobals::lineAlign(size_t align)
+{
+    if (!align)
+        return 0;
+
+    size_t power = 1;
+
+    while (power < align)
+        power <<= 1;
+
+    return power;
+}
+
+size_t AkVCam::VideoFormatGlobals::byplPacked(size_t width,
+                                              size_t bpp,
+                                              size_t align)
+{
+    // By default the lines are aligned to 32 bits.
+    if (!align)
+        return align32(width * bpp) / 8;
+
+    return alignUp((width * bpp + 7) / 8, align);
 }
 
 std::ostream &operator <<(std::ostream &os, const AkVCam::VideoFormat &format)
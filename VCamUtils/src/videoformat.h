@@ -29,36 +29,88 @@
 namespace AkVCam
 {
     class VideoFormat;
-    class VideoFormatPrivate;
     using VideoFormats = std::vector<VideoFormat>;
 
+    /* A plain value, copying or moving a format without frame rates doesn't
+     * allocate, so it can be passed around freely in the streaming paths.
+     */
     class VideoFormat
     {
         public:
-            VideoFormat();
+            VideoFormat() = default;
             VideoFormat(FourCC fourcc,
                         int width,
                         int height,
                         const std::vector<Fraction> &frameRates={});
-            VideoFormat(const VideoFormat &other);
-            ~VideoFormat();
-            VideoFormat &operator =(const VideoFormat &other);
             bool operator ==(const VideoFormat &other) const;
             bool operator !=(const VideoFormat &other) const;
             operator bool() const;
 
-            FourCC fourcc() const;
-            FourCC &fourcc();
-            int width() const;
-            int &width();
-            int height() const;
-            int &height();
-            std::vector<Fraction> frameRates() const;
-            std::vector<Fraction> &frameRates();
+            inline FourCC fourcc() const
+            {
+                return this->m_fourcc;
+            }
+
+            inline FourCC &fourcc()
+            {
+                return this->m_fourcc;
+            }
+
+            inline int width() const
+            {
+                return this->m_width;
+            }
+
+            inline int &width()
+            {
+                return this->m_width;
+            }
+
+            inline int height() const
+            {
+                return this->m_height;
+            }
+
+            inline int &height()
+            {
+                return this->m_height;
+            }
+
+            inline const std::vector<Fraction> &frameRates() const
+            {
+                return this->m_frameRates;
+            }
+
+            inline std::vector<Fraction> &frameRates()
+            {
+                return this->m_frameRates;
+            }
+
+            /* Alignment in bytes of the lines of every plane, must be a power
+             * of 2, other values are rounded up to the next one and make
+             * isValid() fail. 0 keeps the default layout of the pixel format.
+             * The frames are allocated aligned to FRAMEBUFFER_ALIGNMENT, so up
+             * to that value every line of a frame starts aligned in memory.
+             */
+            inline size_t align() const
+            {
+                return this->m_align;
+            }
+
+            inline size_t &align()
+            {
+                return this->m_align;
+            }
+
             std::vector<FractionRange> frameRateRanges() const;
             Fraction minimumFrameRate() const;
             size_t bpp() const;
             size_t bypl(size_t plane) const;
+
+            /* Bytes of each line of 'plane' holding pixels, the rest of the
+             * line up to bypl() is padding.
+             */
+            size_t lineSize(size_t plane) const;
             size_t size() const;
             size_t planes() const;
             size_t offset(size_t plane) const;
@@ -74,7 +126,11 @@ namespace AkVCam
             static std::string stringFromFourcc(FourCC fourcc);
 
         private:
-            VideoFormatPrivate *d;
+            FourCC m_fourcc {0};
+            int m_width {0};
+            int m_height {0};
+            std::vector<Fraction> m_frameRates;
+            size_t m_align {0};
     };
 }
 
@@ -52,7 +52,11 @@ namespace AkVCam
 
         // two planes -- one Y, one Cr + Cb interleaved
         PixelFormatNV12 = MKFOURCC('N', 'V', '1', '2'),
-        PixelFormatNV21 = MKFOURCC('N', 'V', '2', '1')
+        PixelFormatNV21 = MKFOURCC('N', 'V', '2', '1'),
+
+        // three planes -- one Y, one for each chroma component
+        PixelFormatI420 = MKFOURCC('I', '4', '2', '0'),
+        PixelFormatYV12 = MKFOURCC('Y', 'V', '1', '2')
     };
 }
 
@@ -21,8 +21,13 @@
 #include <cmath>
 #include <cstring>
 #include <fstream>
+#include <utility>
 
 #include "videoframe.h"
+#include "frametransform.h"
+#include "pixeltraits.h"
+#include "simd.h"
+#include "videoconvert.h"
 #include "videoformat.h"
 #include "utils.h"
 
@@ -43,21 +48,6 @@ namespace AkVCam
         uint8_t r;
     };
 
-    struct RGB16
-    {
-        uint16_t b: 5;
-        uint16_t g: 6;
-        uint16_t r: 5;
-    };
-
-    struct RGB15
-    {
-        uint16_t b: 5;
-        uint16_t g: 5;
-        uint16_t r: 5;
-        uint16_t x: 1;
-    };
-
     struct BGR32
     {
         uint8_t r;
@@ -73,200 +63,26 @@ namespace AkVCam
         uint8_t b;
     };
 
-    struct BGR16
-    {
-        uint16_t r: 5;
-        uint16_t g: 6;
-        uint16_t b: 5;
-    };
-
-    struct BGR15
-    {
-        uint16_t r: 5;
-        uint16_t g: 5;
-        uint16_t b: 5;
-        uint16_t x: 1;
-    };
-
-    struct UYVY
-    {
-        uint8_t v0;
-        uint8_t y0;
-        uint8_t u0;
-        uint8_t y1;
-    };
-
-    struct YUY2
-    {
-        uint8_t y0;
-        uint8_t v0;
-        uint8_t y1;
-        uint8_t u0;
-    };
-
-    struct UV
-    {
-        uint8_t u;
-        uint8_t v;
-    };
-
-    struct VU
-    {
-        uint8_t v;
-        uint8_t u;
-    };
-
-    using VideoConvertFuntion = VideoFrame (*)(const VideoFrame *src);
-
-    struct VideoConvert
-    {
-        FourCC from;
-        FourCC to;
-        VideoConvertFuntion convert;
-    };
-
     class VideoFramePrivate
     {
         public:
-            VideoFrame *self;
-            VideoFormat m_format;
-            VideoData m_data;
-            std::vector<VideoConvert> m_convert;
-            std::vector<PixelFormat> m_adjustFormats;
-
-            explicit VideoFramePrivate(VideoFrame *self):
-                self(self)
-            {
-                this->m_convert = {
-                    {PixelFormatBGR24, PixelFormatRGB32, bgr24_to_rgb32},
-                    {PixelFormatBGR24, PixelFormatRGB24, bgr24_to_rgb24},
-                    {PixelFormatBGR24, PixelFormatRGB16, bgr24_to_rgb16},
-                    {PixelFormatBGR24, PixelFormatRGB15, bgr24_to_rgb15},
-                    {PixelFormatBGR24, PixelFormatBGR32, bgr24_to_bgr32},
-                    {PixelFormatBGR24, PixelFormatBGR16, bgr24_to_bgr16},
-                    {PixelFormatBGR24, PixelFormatBGR15, bgr24_to_bgr15},
-                    {PixelFormatBGR24, PixelFormatUYVY , bgr24_to_uyvy },
-                    {PixelFormatBGR24, PixelFormatYUY2 , bgr24_to_yuy2 },
-                    {PixelFormatBGR24, PixelFormatNV12 , bgr24_to_nv12 },
-                    {PixelFormatBGR24, PixelFormatNV21 , bgr24_to_nv21 },
-
-                    {PixelFormatRGB24, PixelFormatRGB32, rgb24_to_rgb32},
-                    {PixelFormatRGB24, PixelFormatRGB16, rgb24_to_rgb16},
-                    {PixelFormatRGB24, PixelFormatRGB15, rgb24_to_rgb15},
-                    {PixelFormatRGB24, PixelFormatBGR32, rgb24_to_bgr32},
-                    {PixelFormatRGB24, PixelFormatBGR24, rgb24_to_bgr24},
-                    {PixelFormatRGB24, PixelFormatBGR16, rgb24_to_bgr16},
-                    {PixelFormatRGB24, PixelFormatBGR15, rgb24_to_bgr15},
-                    {PixelFormatRGB24, PixelFormatUYVY , rgb24_to_uyvy },
-                    {PixelFormatRGB24, PixelFormatYUY2 , rgb24_to_yuy2 },
-                    {PixelFormatRGB24, PixelFormatNV12 , rgb24_to_nv12 },
-                    {PixelFormatRGB24, PixelFormatNV21 , rgb24_to_nv21 }
-                };
-
-                this->m_adjustFormats = {
-                    PixelFormatBGR24,
-                    PixelFormatRGB24
-                };
-            }
+            static inline const VideoData &data(const VideoFrame &frame);
 
-            template<typename T>
-            static inline T bound(T min, T value, T max)
-            {
-                return value < min? min: value > max? max: value;
-            }
+            // Get a buffer only owned by 'frame', copying it if needed.
+            static inline VideoData &detach(VideoFrame &frame);
 
-            template<typename T>
-            inline T mod(T value, T mod)
-            {
-                return (value % mod + mod) % mod;
-            }
+            /* Zero the bytes of a new buffer that the pixels don't cover, the
+             * line padding and the luma of the missing pixel of the last
+             * macropixel of packed 4:2:2 frames with odd widths. The buffers
+             * are recycled, so they could have any content.
+             */
+            static void clearPadding(VideoFrame &frame);
 
-            inline int grayval(int r, int g, int b);
-
-            // YUV utility functions
-            inline static uint8_t rgb_y(int r, int g, int b);
-            inline static uint8_t rgb_u(int r, int g, int b);
-            inline static uint8_t rgb_v(int r, int g, int b);
-            inline static uint8_t yuv_r(int y, int u, int v);
-            inline static uint8_t yuv_g(int y, int u, int v);
-            inline static uint8_t yuv_b(int y, int u, int v);
-
-            // BGR to RGB formats
-            static VideoFrame bgr24_to_rgb32(const VideoFrame *src);
-            static VideoFrame bgr24_to_rgb24(const VideoFrame *src);
-            static VideoFrame bgr24_to_rgb16(const VideoFrame *src);
-            static VideoFrame bgr24_to_rgb15(const VideoFrame *src);
-
-            // BGR to BGR formats
-            static VideoFrame bgr24_to_bgr32(const VideoFrame *src);
-            static VideoFrame bgr24_to_bgr16(const VideoFrame *src);
-            static VideoFrame bgr24_to_bgr15(const VideoFrame *src);
-
-            // BGR to Luminance+Chrominance formats
-            static VideoFrame bgr24_to_uyvy(const VideoFrame *src);
-            static VideoFrame bgr24_to_yuy2(const VideoFrame *src);
-
-            // BGR to two planes -- one Y, one Cr + Cb interleaved
-            static VideoFrame bgr24_to_nv12(const VideoFrame *src);
-            static VideoFrame bgr24_to_nv21(const VideoFrame *src);
-
-            // RGB to RGB formats
-            static VideoFrame rgb24_to_rgb32(const VideoFrame *src);
-            static VideoFrame rgb24_to_rgb16(const VideoFrame *src);
-            static VideoFrame rgb24_to_rgb15(const VideoFrame *src);
-
-            // RGB to BGR formats
-            static VideoFrame rgb24_to_bgr32(const VideoFrame *src);
-            static VideoFrame rgb24_to_bgr24(const VideoFrame *src);
-            static VideoFrame rgb24_to_bgr16(const VideoFrame *src);
-            static VideoFrame rgb24_to_bgr15(const VideoFrame *src);
-
-            // RGB to Luminance+Chrominance formats
-            static VideoFrame rgb24_to_uyvy(const VideoFrame *src);
-            static VideoFrame rgb24_to_yuy2(const VideoFrame *src);
-
-            // RGB to two planes -- one Y, one Cr + Cb interleaved
-            static VideoFrame rgb24_to_nv12(const VideoFrame *src);
-            static VideoFrame rgb24_to_nv21(const VideoFrame *src);
-
-            inline static void extrapolateUp(int dstCoord,
-                                             int num, int den, int s,
-                                             int *srcCoordMin, int *srcCoordMax,
-                                             int *kNum, int *kDen);
-            inline static void extrapolateDown(int dstCoord,
-                                               int num, int den, int s,
-                                               int *srcCoordMin, int *srcCoordMax,
-                                               int *kNum, int *kDen);
-            inline uint8_t extrapolateComponent(uint8_t min, uint8_t max,
-                                               int kNum, int kDen) const;
-            inline RGB24 extrapolateColor(const RGB24 &colorMin,
-                                          const RGB24 &colorMax,
-                                          int kNum,
-                                          int kDen) const;
-            inline RGB24 extrapolateColor(int xMin, int xMax,
-                                          int kNumX, int kDenX,
-                                          int yMin, int yMax,
-                                          int kNumY, int kDenY) const;
-            inline void rgbToHsl(int r, int g, int b, int *h, int *s, int *l);
-            inline void hslToRgb(int h, int s, int l, int *r, int *g, int *b);
+            static inline VideoFrame transform(const VideoFrame &frame,
+                                               const VideoFormat &format,
+                                               const FrameTransformParams &params);
     };
 
-    std::vector<uint8_t> initGammaTable();
-
-    inline std::vector<uint8_t> *gammaTable() {
-        static auto gammaTable = initGammaTable();
-
-        return &gammaTable;
-    }
-
-    std::vector<uint8_t> initContrastTable();
-
-    inline std::vector<uint8_t> *contrastTable() {
-        static auto contrastTable = initContrastTable();
-
-        return &contrastTable;
-    }
-
     struct BmpHeader
     {
         uint32_t size;
@@ -291,48 +107,39 @@ namespace AkVCam
     };
 }
 
-AkVCam::VideoFrame::VideoFrame()
-{
-    this->d = new VideoFramePrivate(this);
-}
-
 AkVCam::VideoFrame::VideoFrame(const std::string &fileName)
 {
-    this->d = new VideoFramePrivate(this);
     this->load(fileName);
 }
 
-AkVCam::VideoFrame::VideoFrame(const AkVCam::VideoFormat &format)
+AkVCam::VideoFrame::VideoFrame(const AkVCam::VideoFormat &format):
+    m_format(format)
 {
-    this->d = new VideoFramePrivate(this);
-    this->d->m_format = format;
-
-    if (format.size() > 0)
-        this->d->m_data.resize(format.size());
+    if (format.size() > 0) {
+        this->m_data =
+                FrameBufferPool::globalInstance()->buffer(format.size());
+        VideoFramePrivate::clearPadding(*this);
+    }
 }
 
-AkVCam::VideoFrame::VideoFrame(const AkVCam::VideoFrame &other)
+AkVCam::VideoFrame::VideoFrame(VideoFrame &&other):
+    m_format(std::move(other.m_format)),
+    m_data(std::move(other.m_data))
 {
-    this->d = new VideoFramePrivate(this);
-    this->d->m_format = other.d->m_format;
-    this->d->m_data = other.d->m_data;
+    other.m_format.clear();
 }
 
-AkVCam::VideoFrame &AkVCam::VideoFrame::operator =(const AkVCam::VideoFrame &other)
+AkVCam::VideoFrame &AkVCam::VideoFrame::operator =(VideoFrame &&other)
 {
     if (this != &other) {
-        this->d->m_format = other.d->m_format;
-        this->d->m_data = other.d->m_data;
+        this->m_format = std::move(other.m_format);
+        this->m_data = std::move(other.m_data);
+        other.m_format.clear();
     }
 
     return *this;
 }
 
-AkVCam::VideoFrame::~VideoFrame()
-{
-    delete this->d;
-}
-
 // http://www.dragonwins.com/domains/getteched/bmp/bmpfileformat.htm
 bool AkVCam::VideoFrame::load(const std::string &fileName)
 {
@@ -363,8 +170,9 @@ bool AkVCam::VideoFrame::load(const std::string &fileName)
         return false;
 
     stream.seekg(header.offBits, std::ios_base::beg);
-    this->d->m_format = format;
-    this->d->m_data.resize(format.size());
+    this->m_format = format;
+    this->m_data = FrameBufferPool::globalInstance()->buffer(format.size());
+    VideoFramePrivate::clearPadding(*this);
 
     VideoData data(imageHeader.sizeImage);
     stream.read(reinterpret_cast<char *>(data.data()),
@@ -414,8 +222,8 @@ bool AkVCam::VideoFrame::load(const std::string &fileName)
     }
 
     default:
-        this->d->m_format.clear();
-        this->d->m_data.clear();
+        this->m_format.clear();
+        this->m_data.reset();
 
         return false;
     }
@@ -425,35 +233,88 @@ bool AkVCam::VideoFrame::load(const std::string &fileName)
 
 AkVCam::VideoFormat AkVCam::VideoFrame::format() const
 {
-    return this->d->m_format;
+    return this->m_format;
 }
 
 AkVCam::VideoFormat &AkVCam::VideoFrame::format()
 {
-    return this->d->m_format;
+    return this->m_format;
 }
 
-AkVCam::VideoData AkVCam::VideoFrame::data() const
+const AkVCam::VideoData &AkVCam::VideoFrame::data() const
 {
-    return this->d->m_data;
+    return VideoFramePrivate::data(*this);
 }
 
 AkVCam::VideoData &AkVCam::VideoFrame::data()
 {
-    return this->d->m_data;
+    return VideoFramePrivate::detach(*this);
 }
 
-uint8_t *AkVCam::VideoFrame::line(size_t plane, size_t y) const
+const uint8_t *AkVCam::VideoFrame::line(size_t plane, size_t y) const
 {
-    return this->d->m_data.data()
-            + this->d->m_format.offset(plane)
-            + y * this->d->m_format.bypl(plane);
+    return this->constLine(plane, y);
+}
+
+uint8_t *AkVCam::VideoFrame::line(size_t plane, size_t y)
+{
+    return VideoFramePrivate::detach(*this).data()
+            + this->m_format.offset(plane)
+            + y * this->m_format.bypl(plane);
+}
+
+const uint8_t *AkVCam::VideoFrame::constLine(size_t plane, size_t y) const
+{
+    return VideoFramePrivate::data(*this).data()
+            + this->m_format.offset(plane)
+            + y * this->m_format.bypl(plane);
+}
+
+bool AkVCam::VideoFrame::isCopyOf(const VideoFrame &other) const
+{
+    return this->m_data
+           && this->m_data == other.m_data
+           && this->m_format == other.m_format;
 }
 
 void AkVCam::VideoFrame::clear()
 {
-    this->d->m_format.clear();
-    this->d->m_data.clear();
+    this->m_format.clear();
+    this->m_data.reset();
+}
+
+uint64_t AkVCam::VideoFrame::hash() const
+{
+    uint32_t header[] {
+        this->m_format.fourcc(),
+        uint32_t(this->m_format.width()),
+        uint32_t(this->m_format.height())
+    };
+
+    auto &data = VideoFramePrivate::data(*this);
+    auto hash = Simd::hash(header, sizeof(header));
+    bool padded = false;
+
+    for (size_t plane = 0; plane < this->m_format.planes(); plane++)
+        if (this->m_format.lineSize(plane) < this->m_format.bypl(plane))
+            padded = true;
+
+    if (!padded || data.size() < this->m_format.size())
+        return hash ^ Simd::hash(data.data(), data.size());
+
+    // The padding can have anything, only hash the pixels of each line.
+    for (size_t plane = 0; plane < this->m_format.planes(); plane++) {
+        auto bypl = this->m_format.bypl(plane);
+        auto lineSize = this->m_format.lineSize(plane);
+        auto lines = this->m_format.planeSize(plane) / bypl;
+        auto planeData = data.data() + this->m_format.offset(plane);
+
+        for (size_t y = 0; y < lines; y++)
+            hash = hash * SIMD_HASH_KEY
+                   + Simd::hash(planeData + y * bypl, lineSize);
+    }
+
+    return hash;
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::mirror(bool horizontalMirror,
@@ -462,185 +323,55 @@ AkVCam::VideoFrame AkVCam::VideoFrame::mirror(bool horizontalMirror,
     if (!horizontalMirror && !verticalMirror)
         return *this;
 
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
+    FrameTransformParams params;
+    params.horizontalMirror = horizontalMirror;
+    params.verticalMirror = verticalMirror;
 
-    if (it == this->d->m_adjustFormats.end())
-        return {};
+    return VideoFramePrivate::transform(*this, this->m_format, params);
+}
 
-    VideoFrame dst(this->d->m_format);
-    int width = this->d->m_format.width();
-    int height = this->d->m_format.height();
+AkVCam::VideoFrame AkVCam::VideoFrame::rotate(int angle) const
+{
+    int rotation = (angle / 90 % 4 + 4) % 4 * 90;
 
-    if (horizontalMirror && verticalMirror) {
-        for (int y = 0; y < height; y++) {
-            auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(height - y - 1)));
-            auto dstLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
+    if (rotation == 0)
+        return *this;
 
-            for (int x = 0; x < width; x++)
-                dstLine[x] = srcLine[width - x - 1];
-        }
-    } else if (horizontalMirror) {
-        for (int y = 0; y < height; y++) {
-            auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-            auto dstLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
+    auto format = this->m_format;
 
-            for (int x = 0; x < width; x++)
-                dstLine[x] = srcLine[width - x - 1];
-        }
-    } else if (verticalMirror) {
-        for (int y = 0; y < height; y++) {
-            auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(height - y - 1)));
-            auto dstLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-            memcpy(dstLine, srcLine, size_t(width) * sizeof(RGB24));
-        }
+    if (rotation != 180) {
+        format.width() = this->m_format.height();
+        format.height() = this->m_format.width();
     }
 
-    return dst;
+    FrameTransformParams params;
+    params.rotation = rotation;
+
+    return VideoFramePrivate::transform(*this, format, params);
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::scaled(int width,
                                               int height,
                                               Scaling mode,
-                                              AspectRatio aspectRatio) const
+                                              AspectRatio aspectRatio,
+                                              const Viewport &viewport) const
 {
-    if (this->d->m_format.width() == width
-        && this->d->m_format.height() == height)
-        return *this;
-
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
-
-    if (it == this->d->m_adjustFormats.end())
-        return {};
-
-    int xDstMin = 0;
-    int yDstMin = 0;
-    int xDstMax = width;
-    int yDstMax = height;
-
-    if (aspectRatio == AspectRatioKeep) {
-        if (width * this->d->m_format.height()
-            > this->d->m_format.width() * height) {
-            // Right and left black bars
-            xDstMin = (width * this->d->m_format.height()
-                       - this->d->m_format.width() * height)
-                       / (2 * this->d->m_format.height());
-            xDstMax = (width * this->d->m_format.height()
-                       + this->d->m_format.width() * height)
-                       / (2 * this->d->m_format.height());
-        } else if (width * this->d->m_format.height()
-                   < this->d->m_format.width() * height) {
-            // Top and bottom black bars
-            yDstMin = (this->d->m_format.width() * height
-                       - width * this->d->m_format.height())
-                       / (2 * this->d->m_format.width());
-            yDstMax = (this->d->m_format.width() * height
-                       + width * this->d->m_format.height())
-                       / (2 * this->d->m_format.width());
-        }
-    }
-
-    int iWidth = this->d->m_format.width() - 1;
-    int iHeight = this->d->m_format.height() - 1;
-    int oWidth = xDstMax - xDstMin - 1;
-    int oHeight = yDstMax - yDstMin - 1;
-    int xNum = iWidth;
-    int xDen = oWidth;
-    int xs = 0;
-    int yNum = iHeight;
-    int yDen = oHeight;
-    int ys = 0;
-
-    if (aspectRatio == AspectRatioExpanding) {
-        if (mode == ScalingLinear) {
-            iWidth--;
-            iHeight--;
-            oWidth--;
-            oHeight--;
-        }
+    bool cropped = viewport.width > 0 && viewport.height > 0;
 
-        if (width * this->d->m_format.height()
-            < this->d->m_format.width() * height) {
-            // Right and left cut
-            xNum = 2 * iHeight;
-            xDen = 2 * oHeight;
-            xs = iWidth * oHeight - oWidth * iHeight;
-        } else if (width * this->d->m_format.height()
-                   > this->d->m_format.width() * height) {
-            // Top and bottom cut
-            yNum = 2 * iWidth;
-            yDen = 2 * oWidth;
-            ys = oWidth * iHeight - iWidth * oHeight;
-        }
-    }
+    if (this->m_format.width() == width
+        && this->m_format.height() == height
+        && !cropped)
+        return *this;
 
-    auto format = this->d->m_format;
+    auto format = this->m_format;
     format.width() = width;
     format.height() = height;
-    VideoFrame dst(format);
-
-    switch (mode) {
-        case ScalingFast:
-            for (int y = yDstMin; y < yDstMax; y++) {
-                auto srcY = (yNum * (y - yDstMin) + ys) / yDen;
-                auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(srcY)));
-                auto dstLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-
-                for (int x = xDstMin; x < xDstMax; x++) {
-                    auto srcX = (xNum * (x - xDstMin) + xs) / xDen;
-                    dstLine[x] = srcLine[srcX];
-                }
-            }
-
-            return dst;
-
-        case ScalingLinear: {
-            auto extrapolateX =
-                    this->d->m_format.width() < width?
-                        &VideoFramePrivate::extrapolateUp:
-                        &VideoFramePrivate::extrapolateDown;
-            auto extrapolateY =
-                    this->d->m_format.height() < height?
-                        &VideoFramePrivate::extrapolateUp:
-                        &VideoFramePrivate::extrapolateDown;
-
-            for (int y = yDstMin; y < yDstMax; y++) {
-                auto dstLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-                int yMin;
-                int yMax;
-                int kNumY;
-                int kDenY;
-                extrapolateY(y - yDstMin,
-                             yNum, yDen, ys,
-                             &yMin, &yMax,
-                             &kNumY, &kDenY);
-
-                for (int x = xDstMin; x < xDstMax; x++) {
-                    int xMin;
-                    int xMax;
-                    int kNumX;
-                    int kDenX;
-                    extrapolateX(x - xDstMin,
-                                 xNum, xDen, xs,
-                                 &xMin, &xMax,
-                                 &kNumX, &kDenX);
-
-                    dstLine[x] =
-                            this->d->extrapolateColor(xMin, xMax,
-                                                      kNumX, kDenX,
-                                                      yMin, yMax,
-                                                      kNumY, kDenY);
-                }
-            }
+    FrameTransformParams params;
+    params.scaling = mode;
+    params.aspectRatio = aspectRatio;
+    params.viewport = viewport;
 
-            return dst;
-        }
-    }
-
-    return dst;
+    return VideoFramePrivate::transform(*this, format, params);
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::scaled(size_t maxArea,
@@ -648,11 +379,11 @@ AkVCam::VideoFrame AkVCam::VideoFrame::scaled(size_t maxArea,
                                               int align) const
 {
     auto width = int(sqrt(double(maxArea)
-                          * double(this->d->m_format.width())
-                          / double(this->d->m_format.height())));
+                          * double(this->m_format.width())
+                          / double(this->m_format.height())));
     auto height = int(sqrt(double(maxArea)
-                           * double(this->d->m_format.height())
-                           / double(this->d->m_format.width())));
+                           * double(this->m_format.height())
+                           / double(this->m_format.width())));
     int owidth = align * int(width / align);
     int oheight = height * owidth / width;
 
@@ -669,138 +400,156 @@ AkVCam::VideoFrame AkVCam::VideoFrame::swapRgb(bool swap) const
 
 AkVCam::VideoFrame AkVCam::VideoFrame::swapRgb() const
 {
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
-
-    if (it == this->d->m_adjustFormats.end())
-        return {};
+    FrameTransformParams params;
+    params.swapRgb = true;
 
-    VideoFrame dst(this->d->m_format);
-
-    for (int y = 0; y < this->d->m_format.height(); y++) {
-        auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-        auto destLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
+    return VideoFramePrivate::transform(*this, this->m_format, params);
+}
 
-        for (int x = 0; x < this->d->m_format.width(); x++) {
-            destLine[x].r = srcLine[x].b;
-            destLine[x].g = srcLine[x].g;
-            destLine[x].b = srcLine[x].r;
-        }
-    }
+bool AkVCam::VideoFrame::mirrorInPlace(bool horizontalMirror,
+                                       bool verticalMirror)
+{
+    return FrameTransform::flip(*this, horizontalMirror, verticalMirror);
+}
 
-    return dst;
+bool AkVCam::VideoFrame::swapRgbInPlace()
+{
+    return FrameTransform::flip(*this, false, false, true);
 }
 
 bool AkVCam::VideoFrame::canConvert(FourCC input, FourCC output) const
 {
-    if (input == output)
-        return true;
-
-    for (auto &convert: this->d->m_convert)
-        if (convert.from == input
-            && convert.to == output) {
-            return true;
-        }
-
-    return false;
+    return VideoConvert::converter(input, output) != nullptr;
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::convert(AkVCam::FourCC fourcc) const
 {
-    if (this->d->m_format.fourcc() == fourcc)
+    if (this->m_format.fourcc() == fourcc)
         return *this;
 
-    VideoConvert *converter = nullptr;
+    auto format = this->m_format;
+    format.fourcc() = fourcc;
 
-    for (auto &convert: this->d->m_convert)
-        if (convert.from == this->d->m_format.fourcc()
-            && convert.to == fourcc) {
-            converter = &convert;
+    return VideoFramePrivate::transform(*this, format, {});
+}
 
-            break;
-        }
+bool AkVCam::VideoFrame::convert(const VideoFormat &format,
+                                 uint8_t *const *planes,
+                                 const size_t *strides,
+                                 bool horizontalMirror,
+                                 bool verticalMirror,
+                                 Scaling mode,
+                                 AspectRatio aspectRatio) const
+{
+    FrameTransformParams params;
+    params.horizontalMirror = horizontalMirror;
+    params.verticalMirror = verticalMirror;
+    params.scaling = mode;
+    params.aspectRatio = aspectRatio;
+    FrameTransform transform;
 
-    if (!converter)
-        return {};
+    if (!transform.configure(this->m_format, format, params))
+        return false;
 
-    return converter->convert(this);
+    return transform.process(*this, planes, strides);
 }
 
-AkVCam::VideoFrame AkVCam::VideoFrame::adjustHsl(int hue,
-                                                 int saturation,
-                                                 int luminance)
+bool AkVCam::VideoFrame::convert(const VideoFormat &format,
+                                 uint8_t *data,
+                                 size_t size,
+                                 bool horizontalMirror,
+                                 bool verticalMirror,
+                                 Scaling mode,
+                                 AspectRatio aspectRatio) const
 {
-    if (hue == 0 && saturation == 0 && luminance == 0)
-        return *this;
+    if (!data || size < format.size())
+        return false;
 
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
+    uint8_t *planes[4];
+    size_t strides[4];
 
-    if (it == this->d->m_adjustFormats.end())
-        return {};
+    for (size_t plane = 0; plane < format.planes(); plane++) {
+        planes[plane] = data + format.offset(plane);
+        strides[plane] = format.bypl(plane);
+    }
 
-    VideoFrame dst(this->d->m_format);
+    return this->convert(format,
+                         planes,
+                         strides,
+                         horizontalMirror,
+                         verticalMirror,
+                         mode,
+                         aspectRatio);
+}
 
-    for (int y = 0; y < this->d->m_format.height(); y++) {
-        auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-        auto destLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
+std::vector<AkVCam::VideoFrame> AkVCam::VideoFrame::convert(const std::vector<VideoFormat> &formats,
+                                                            Scaling mode,
+                                                            AspectRatio aspectRatio) const
+{
+    FrameTransformParams params;
+    params.scaling = mode;
+    params.aspectRatio = aspectRatio;
+    std::vector<VideoFrame> frames(formats.size());
+    std::vector<FrameTransform> transforms(formats.size());
+    std::vector<FrameTransform *> validTransforms;
+    std::vector<std::vector<uint8_t *>> planes;
+    std::vector<std::vector<size_t>> strides;
 
-        for (int x = 0; x < this->d->m_format.width(); x++) {
-            int h;
-            int s;
-            int l;
-            this->d->rgbToHsl(srcLine[x].r, srcLine[x].g, srcLine[x].b,
-                              &h, &s, &l);
+    for (size_t i = 0; i < formats.size(); i++) {
+        auto &format = formats[i];
 
-            h = this->d->mod(h + hue, 360);
-            s = VideoFramePrivate::bound(0, s + saturation, 255);
-            l = VideoFramePrivate::bound(0, l + luminance, 255);
+        if (!transforms[i].configure(this->m_format, format, params))
+            continue;
 
-            int r;
-            int g;
-            int b;
-            this->d->hslToRgb(h, s, l, &r, &g, &b);
+        frames[i] = VideoFrame(format);
+        validTransforms.push_back(&transforms[i]);
+        planes.push_back({});
+        strides.push_back({});
 
-            destLine[x].r = uint8_t(r);
-            destLine[x].g = uint8_t(g);
-            destLine[x].b = uint8_t(b);
+        for (size_t plane = 0; plane < format.planes(); plane++) {
+            planes.back().push_back(frames[i].data().data()
+                                    + format.offset(plane));
+            strides.back().push_back(format.bypl(plane));
         }
     }
 
-    return dst;
+    std::vector<uint8_t *const *> planePtrs;
+    std::vector<const size_t *> stridePtrs;
+
+    for (size_t i = 0; i < validTransforms.size(); i++) {
+        planePtrs.push_back(planes[i].data());
+        stridePtrs.push_back(strides[i].data());
+    }
+
+    FrameTransform::process(*this, validTransforms, planePtrs, stridePtrs);
+
+    return frames;
 }
 
-AkVCam::VideoFrame AkVCam::VideoFrame::adjustGamma(int gamma)
+AkVCam::VideoFrame AkVCam::VideoFrame::adjustHsl(int hue,
+                                                 int saturation,
+                                                 int luminance)
 {
-    if (gamma == 0)
+    if (hue == 0 && saturation == 0 && luminance == 0)
         return *this;
 
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
+    FrameTransformParams params;
+    params.hue = hue;
+    params.saturation = saturation;
+    params.luminance = luminance;
 
-    if (it == this->d->m_adjustFormats.end())
-        return {};
+    return VideoFramePrivate::transform(*this, this->m_format, params);
+}
 
-    VideoFrame dst(this->d->m_format);
-    auto dataGt = gammaTable()->data();
-    gamma = VideoFramePrivate::bound(-255, gamma, 255);
-    size_t gammaOffset = size_t(gamma + 255) << 8;
+AkVCam::VideoFrame AkVCam::VideoFrame::adjustGamma(int gamma)
+{
+    if (gamma == 0)
+        return *this;
 
-    for (int y = 0; y < this->d->m_format.height(); y++) {
-        auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-        auto destLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
+    FrameTransformParams params;
+    params.gamma = gamma;
 
-        for (int x = 0; x < this->d->m_format.width(); x++) {
-            destLine[x].r = dataGt[gammaOffset | srcLine[x].r];
-            destLine[x].g = dataGt[gammaOffset | srcLine[x].g];
-            destLine[x].b = dataGt[gammaOffset | srcLine[x].b];
-        }
-    }
-
-    return dst;
+    return VideoFramePrivate::transform(*this, this->m_format, params);
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::adjustContrast(int contrast)
@@ -808,59 +557,18 @@ AkVCam::VideoFrame AkVCam::VideoFrame::adjustContrast(int contrast)
     if (contrast == 0)
         return *this;
 
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
-
-    if (it == this->d->m_adjustFormats.end())
-        return {};
-
-    VideoFrame dst(this->d->m_format);
-    auto dataCt = contrastTable()->data();
-    contrast = VideoFramePrivate::bound(-255, contrast, 255);
-    size_t contrastOffset = size_t(contrast + 255) << 8;
+    FrameTransformParams params;
+    params.contrast = contrast;
 
-    for (int y = 0; y < this->d->m_format.height(); y++) {
-        auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-        auto destLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < this->d->m_format.width(); x++) {
-            destLine[x].r = dataCt[contrastOffset | srcLine[x].r];
-            destLine[x].g = dataCt[contrastOffset | srcLine[x].g];
-            destLine[x].b = dataCt[contrastOffset | srcLine[x].b];
-        }
-    }
-
-    return dst;
+    return VideoFramePrivate::transform(*this, this->m_format, params);
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::toGrayScale()
 {
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
-
-    if (it == this->d->m_adjustFormats.end())
-        return {};
-
-    VideoFrame dst(this->d->m_format);
-
-    for (int y = 0; y < this->d->m_format.height(); y++) {
-        auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-        auto destLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < this->d->m_format.width(); x++) {
-            int luma = this->d->grayval(srcLine[x].r,
-                                        srcLine[x].g,
-                                        srcLine[x].b);
-
-            destLine[x].r = uint8_t(luma);
-            destLine[x].g = uint8_t(luma);
-            destLine[x].b = uint8_t(luma);
-        }
-    }
+    FrameTransformParams params;
+    params.gray = true;
 
-    return dst;
+    return VideoFramePrivate::transform(*this, this->m_format, params);
 }
 
 AkVCam::VideoFrame AkVCam::VideoFrame::adjust(int hue,
@@ -878,847 +586,77 @@ AkVCam::VideoFrame AkVCam::VideoFrame::adjust(int hue,
         && !gray)
         return *this;
 
-    auto it = std::find(this->d->m_adjustFormats.begin(),
-                        this->d->m_adjustFormats.end(),
-                        this->d->m_format.fourcc());
-
-    if (it == this->d->m_adjustFormats.end())
-        return {};
-
-    VideoFrame dst(this->d->m_format);
-    auto dataGt = gammaTable()->data();
-    auto dataCt = contrastTable()->data();
-
-    gamma = VideoFramePrivate::bound(-255, gamma, 255);
-    size_t gammaOffset = size_t(gamma + 255) << 8;
-
-    contrast = VideoFramePrivate::bound(-255, contrast, 255);
-    size_t contrastOffset = size_t(contrast + 255) << 8;
-
-    for (int y = 0; y < this->d->m_format.height(); y++) {
-        auto srcLine = reinterpret_cast<RGB24 *>(this->line(0, size_t(y)));
-        auto destLine = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < this->d->m_format.width(); x++) {
-            int r = srcLine[x].r;
-            int g = srcLine[x].g;
-            int b = srcLine[x].b;
-
-            if (hue != 0 || saturation != 0 ||  luminance != 0) {
-                int h;
-                int s;
-                int l;
-                this->d->rgbToHsl(r, g, b, &h, &s, &l);
-
-                h = this->d->mod(h + hue, 360);
-                s = VideoFramePrivate::bound(0, s + saturation, 255);
-                l = VideoFramePrivate::bound(0, l + luminance, 255);
-                this->d->hslToRgb(h, s, l, &r, &g, &b);
-            }
-
-            if (gamma != 0) {
-                r = dataGt[gammaOffset | size_t(r)];
-                g = dataGt[gammaOffset | size_t(g)];
-                b = dataGt[gammaOffset | size_t(b)];
-            }
-
-            if (contrast != 0) {
-                r = dataCt[contrastOffset | size_t(r)];
-                g = dataCt[contrastOffset | size_t(g)];
-                b = dataCt[contrastOffset | size_t(b)];
-            }
-
-            if (gray) {
-                int luma = this->d->grayval(r, g, b);
-
-                r = luma;
-                g = luma;
-                b = luma;
-            }
-
-            destLine[x].r = uint8_t(r);
-            destLine[x].g = uint8_t(g);
-            destLine[x].b = uint8_t(b);
-        }
-    }
-
-    return dst;
-}
-
-int AkVCam::VideoFramePrivate::grayval(int r, int g, int b)
-{
-    return (11 * r + 16 * g + 5 * b) >> 5;
-}
-
-uint8_t AkVCam::VideoFramePrivate::rgb_y(int r, int g, int b)
-{
-    return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
-}
-
-uint8_t AkVCam::VideoFramePrivate::rgb_u(int r, int g, int b)
-{
-    return uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
-}
-
-uint8_t AkVCam::VideoFramePrivate::rgb_v(int r, int g, int b)
-{
-    return uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
-}
-
-uint8_t AkVCam::VideoFramePrivate::yuv_r(int y, int u, int v)
-{
-    UNUSED(u);
-    int r = (298 * (y - 16) + 409 * (v - 128) + 128) >> 8;
-
-    return uint8_t(bound(0, r, 255));
-}
-
-uint8_t AkVCam::VideoFramePrivate::yuv_g(int y, int u, int v)
-{
-    int g = (298 * (y - 16) - 100 * (u - 128) - 208 * (v - 128) + 128) >> 8;
-
-    return uint8_t(bound(0, g, 255));
-}
-
-uint8_t AkVCam::VideoFramePrivate::yuv_b(int y, int u, int v)
-{
-    UNUSED(v);
-    int b = (298 * (y - 16) + 516 * (u - 128) + 128) >> 8;
-
-    return uint8_t(bound(0, b, 255));
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_rgb32(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB32;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB32 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 255;
-            dst_line[x].r = src_line[x].r;
-            dst_line[x].g = src_line[x].g;
-            dst_line[x].b = src_line[x].b;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_rgb24(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB24;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB24 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].r = src_line[x].r;
-            dst_line[x].g = src_line[x].g;
-            dst_line[x].b = src_line[x].b;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_rgb16(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB16;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB16 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 2;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_rgb15(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB15;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB15 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 1;
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 3;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_bgr32(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR32;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR32 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 255;
-            dst_line[x].r = src_line[x].r;
-            dst_line[x].g = src_line[x].g;
-            dst_line[x].b = src_line[x].b;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_bgr16(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR16;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR16 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 2;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
+    FrameTransformParams params;
+    params.hue = hue;
+    params.saturation = saturation;
+    params.luminance = luminance;
+    params.gamma = gamma;
+    params.contrast = contrast;
+    params.gray = gray;
 
-    return dst;
+    return VideoFramePrivate::transform(*this, this->m_format, params);
 }
 
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_bgr15(const VideoFrame *src)
+AkVCam::VideoFrame AkVCam::VideoFramePrivate::transform(const VideoFrame &frame,
+                                                        const VideoFormat &format,
+                                                        const FrameTransformParams &params)
 {
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR15;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR15 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 1;
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 3;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
+    FrameTransform transform;
 
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_uyvy(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatUYVY;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<UYVY *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            auto x_yuv = x / 2;
-
-            auto r0 = src_line[x].r;
-            auto g0 = src_line[x].g;
-            auto b0 = src_line[x].b;
-
-            x++;
-
-            int r1 = src_line[x].r;
-            int g1 = src_line[x].g;
-            int b1 = src_line[x].b;
-
-            dst_line[x_yuv].u0 = rgb_u(r0, g0, b0);
-            dst_line[x_yuv].y0 = rgb_y(r0, g0, b0);
-            dst_line[x_yuv].v0 = rgb_v(r0, g0, b0);
-            dst_line[x_yuv].y1 = rgb_y(r1, g1, b1);
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_yuy2(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatYUY2;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<YUY2 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            auto x_yuv = x / 2;
-
-            auto r0 = src_line[x].r;
-            auto g0 = src_line[x].g;
-            auto b0 = src_line[x].b;
-
-            x++;
-
-            auto r1 = src_line[x].r;
-            auto g1 = src_line[x].g;
-            auto b1 = src_line[x].b;
-
-            dst_line[x_yuv].y0 = rgb_y(r0, g0, b0);
-            dst_line[x_yuv].u0 = rgb_u(r0, g0, b0);
-            dst_line[x_yuv].y1 = rgb_y(r1, g1, b1);
-            dst_line[x_yuv].v0 = rgb_v(r0, g0, b0);
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_nv12(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatNV12;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line_y = dst.line(0, size_t(y));
-        auto dst_line_vu = reinterpret_cast<VU *>(dst.line(1, size_t(y) / 2));
-
-        for (int x = 0; x < width; x++) {
-            auto r = src_line[x].r;
-            auto g = src_line[x].g;
-            auto b = src_line[x].b;
-
-            dst_line_y[y] = rgb_y(r, g, b);
-
-            if (!(x & 0x1) && !(y & 0x1)) {
-                dst_line_vu[x / 2].v = rgb_v(r, g, b);
-                dst_line_vu[x / 2].u = rgb_u(r, g, b);
-            }
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::bgr24_to_nv21(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatNV21;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const BGR24 *>(src->line(0, size_t(y)));
-        auto dst_line_y = dst.line(0, size_t(y));
-        auto dst_line_vu = reinterpret_cast<UV *>(dst.line(1, size_t(y) / 2));
-
-        for (int x = 0; x < width; x++) {
-            auto r = src_line[x].r;
-            auto g = src_line[x].g;
-            auto b = src_line[x].b;
-
-            dst_line_y[y] = rgb_y(r, g, b);
-
-            if (!(x & 0x1) && !(y & 0x1)) {
-                dst_line_vu[x / 2].v = rgb_v(r, g, b);
-                dst_line_vu[x / 2].u = rgb_u(r, g, b);
-            }
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_rgb32(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB32;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB32 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 255;
-            dst_line[x].r = src_line[x].r;
-            dst_line[x].g = src_line[x].g;
-            dst_line[x].b = src_line[x].b;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_rgb16(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB16;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB16 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 2;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_rgb15(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatRGB15;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<RGB15 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 1;
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 3;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_bgr32(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR32;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR32 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 255;
-            dst_line[x].r = src_line[x].r;
-            dst_line[x].g = src_line[x].g;
-            dst_line[x].b = src_line[x].b;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_bgr24(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR24;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR24 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].r = src_line[x].r;
-            dst_line[x].g = src_line[x].g;
-            dst_line[x].b = src_line[x].b;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_bgr16(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR16;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR16 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 2;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_bgr15(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatBGR15;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<BGR15 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            dst_line[x].x = 1;
-            dst_line[x].r = src_line[x].r >> 3;
-            dst_line[x].g = src_line[x].g >> 3;
-            dst_line[x].b = src_line[x].b >> 3;
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_uyvy(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatUYVY;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<UYVY *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            auto x_yuv = x / 2;
-
-            auto r0 = src_line[x].r;
-            auto g0 = src_line[x].g;
-            auto b0 = src_line[x].b;
-
-            x++;
-
-            int r1 = src_line[x].r;
-            int g1 = src_line[x].g;
-            int b1 = src_line[x].b;
-
-            dst_line[x_yuv].u0 = rgb_u(r0, g0, b0);
-            dst_line[x_yuv].y0 = rgb_y(r0, g0, b0);
-            dst_line[x_yuv].v0 = rgb_v(r0, g0, b0);
-            dst_line[x_yuv].y1 = rgb_y(r1, g1, b1);
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_yuy2(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatYUY2;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line = reinterpret_cast<YUY2 *>(dst.line(0, size_t(y)));
-
-        for (int x = 0; x < width; x++) {
-            auto x_yuv = x / 2;
-
-            auto r0 = src_line[x].r;
-            auto g0 = src_line[x].g;
-            auto b0 = src_line[x].b;
-
-            x++;
-
-            auto r1 = src_line[x].r;
-            auto g1 = src_line[x].g;
-            auto b1 = src_line[x].b;
-
-            dst_line[x_yuv].y0 = rgb_y(r0, g0, b0);
-            dst_line[x_yuv].u0 = rgb_u(r0, g0, b0);
-            dst_line[x_yuv].y1 = rgb_y(r1, g1, b1);
-            dst_line[x_yuv].v0 = rgb_v(r0, g0, b0);
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_nv12(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatNV12;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line_y = dst.line(0, size_t(y));
-        auto dst_line_vu = reinterpret_cast<VU *>(dst.line(1, size_t(y) / 2));
-
-        for (int x = 0; x < width; x++) {
-            auto r = src_line[x].r;
-            auto g = src_line[x].g;
-            auto b = src_line[x].b;
-
-            dst_line_y[y] = rgb_y(r, g, b);
-
-            if (!(x & 0x1) && !(y & 0x1)) {
-                dst_line_vu[x / 2].v = rgb_v(r, g, b);
-                dst_line_vu[x / 2].u = rgb_u(r, g, b);
-            }
-        }
-    }
-
-    return dst;
-}
-
-AkVCam::VideoFrame AkVCam::VideoFramePrivate::rgb24_to_nv21(const VideoFrame *src)
-{
-    auto format = src->format();
-    format.fourcc() = PixelFormatNV21;
-    VideoFrame dst(format);
-    auto width = src->format().width();
-    auto height = src->format().height();
-
-    for (int y = 0; y < height; y++) {
-        auto src_line = reinterpret_cast<const RGB24 *>(src->line(0, size_t(y)));
-        auto dst_line_y = dst.line(0, size_t(y));
-        auto dst_line_vu = reinterpret_cast<UV *>(dst.line(1, size_t(y) / 2));
-
-        for (int x = 0; x < width; x++) {
-            auto r = src_line[x].r;
-            auto g = src_line[x].g;
-            auto b = src_line[x].b;
-
-            dst_line_y[y] = rgb_y(r, g, b);
-
-            if (!(x & 0x1) && !(y & 0x1)) {
-                dst_line_vu[x / 2].v = rgb_v(r, g, b);
-                dst_line_vu[x / 2].u = rgb_u(r, g, b);
-            }
-        }
-    }
-
-    return dst;
-}
-
-void AkVCam::VideoFramePrivate::extrapolateUp(int dstCoord,
-                                              int num, int den, int s,
-                                              int *srcCoordMin, int *srcCoordMax,
-                                              int *kNum, int *kDen)
-{
-    *srcCoordMin = (num * dstCoord + s) / den;
-    *srcCoordMax = *srcCoordMin + 1;
-    int dstCoordMin = (den * *srcCoordMin - s) / num;
-    int dstCoordMax = (den * *srcCoordMax - s) / num;
-    *kNum = dstCoord - dstCoordMin;
-    *kDen = dstCoordMax - dstCoordMin;
-}
+    if (!transform.configure(frame.m_format, format, params))
+        return {};
 
-void AkVCam::VideoFramePrivate::extrapolateDown(int dstCoord,
-                                                int num, int den, int s,
-                                                int *srcCoordMin, int *srcCoordMax,
-                                                int *kNum, int *kDen)
-{
-    *srcCoordMin = (num * dstCoord + s) / den;
-    *srcCoordMax = *srcCoordMin;
-    *kNum = 0;
-    *kDen = 1;
+    return transform.process(frame);
 }
 
-uint8_t AkVCam::VideoFramePrivate::extrapolateComponent(uint8_t min, uint8_t max,
-                                                        int kNum, int kDen) const
+const AkVCam::VideoData &AkVCam::VideoFramePrivate::data(const VideoFrame &frame)
 {
-    return uint8_t((kNum * (max - min) + kDen * min) / kDen);
-}
+    static const VideoData empty;
 
-AkVCam::RGB24 AkVCam::VideoFramePrivate::extrapolateColor(const RGB24 &colorMin,
-                                                          const RGB24 &colorMax,
-                                                          int kNum,
-                                                          int kDen) const
-{
-    return RGB24 {
-        extrapolateComponent(colorMin.b, colorMax.b, kNum, kDen),
-        extrapolateComponent(colorMin.g, colorMax.g, kNum, kDen),
-        extrapolateComponent(colorMin.r, colorMax.r, kNum, kDen)
-    };
+    return frame.m_data? *frame.m_data: empty;
 }
 
-AkVCam::RGB24 AkVCam::VideoFramePrivate::extrapolateColor(int xMin, int xMax,
-                                                          int kNumX, int kDenX,
-                                                          int yMin, int yMax,
-                                                          int kNumY, int kDenY) const
+AkVCam::VideoData &AkVCam::VideoFramePrivate::detach(VideoFrame &frame)
 {
-    auto minLine = reinterpret_cast<RGB24 *>(this->self->line(0, size_t(yMin)));
-    auto maxLine = reinterpret_cast<RGB24 *>(this->self->line(0, size_t(yMax)));
-    auto colorMin = extrapolateColor(minLine[xMin], minLine[xMax], kNumX, kDenX);
-    auto colorMax = extrapolateColor(maxLine[xMin], maxLine[xMax], kNumX, kDenX);
+    if (!frame.m_data)
+        frame.m_data = FrameBufferPool::globalInstance()->buffer(0);
+    else if (frame.m_data.useCount() > 1)
+        frame.m_data = FrameBufferPool::globalInstance()->copy(*frame.m_data);
 
-    return extrapolateColor(colorMin, colorMax, kNumY, kDenY);
+    return *frame.m_data;
 }
 
-// https://en.wikipedia.org/wiki/HSL_and_HSV
-void AkVCam::VideoFramePrivate::rgbToHsl(int r, int g, int b, int *h, int *s, int *l)
+void AkVCam::VideoFramePrivate::clearPadding(VideoFrame &frame)
 {
-    int max = std::max(r, std::max(g, b));
-    int min = std::min(r, std::min(g, b));
-    int c = max - min;
-
-    *l = (max + min) / 2;
-
-    if (!c) {
-        *h = 0;
-        *s = 0;
-    } else {
-        if (max == r)
-            *h = this->mod(g - b, 6 * c);
-        else if (max == g)
-            *h = b - r + 2 * c;
-        else
-            *h = r - g + 4 * c;
-
-        *h = 60 * (*h) / c;
-        *s = 255 * c / (255 - abs(max + min - 255));
-    }
-}
+    auto &format = frame.m_format;
+    auto data = frame.m_data->data();
+    int y1 = -1;
 
-void AkVCam::VideoFramePrivate::hslToRgb(int h, int s, int l, int *r, int *g, int *b)
-{
-    int c = s * (255 - abs(2 * l - 255)) / 255;
-    int x = c * (60 - abs((h % 120) - 60)) / 60;
-
-    if (h >= 0 && h < 60) {
-        *r = c;
-        *g = x;
-        *b = 0;
-    } else if (h >= 60 && h < 120) {
-        *r = x;
-        *g = c;
-        *b = 0;
-    } else if (h >= 120 && h < 180) {
-        *r = 0;
-        *g = c;
-        *b = x;
-    } else if (h >= 180 && h < 240) {
-        *r = 0;
-        *g = x;
-        *b = c;
-    } else if (h >= 240 && h < 300) {
-        *r = x;
-        *g = 0;
-        *b = c;
-    } else if (h >= 300 && h < 360) {
-        *r = c;
-        *g = 0;
-        *b = x;
-    } else {
-        *r = 0;
-        *g = 0;
-        *b = 0;
+    if (format.width() & 0x1) {
+        if (format.fourcc() == PixelFormatUYVY)
+            y1 = PixelTraits<PixelFormatUYVY>::y1;
+        else if (format.fourcc() == PixelFormatYUY2)
+            y1 = PixelTraits<PixelFormatYUY2>::y1;
     }
 
-    int m = 2 * l - c;
+    for (size_t plane = 0; plane < format.planes(); plane++) {
+        auto bypl = format.bypl(plane);
+        auto lineSize = format.lineSize(plane);
 
-    *r = (2 * (*r) + m) / 2;
-    *g = (2 * (*g) + m) / 2;
-    *b = (2 * (*b) + m) / 2;
-}
+        if (bypl < 1 || (lineSize >= bypl && y1 < 0))
+            continue;
 
-std::vector<uint8_t> AkVCam::initGammaTable()
-{
-    std::vector<uint8_t> gammaTable;
+        auto lines = format.planeSize(plane) / bypl;
+        auto planeData = data + format.offset(plane);
 
-    for (int i = 0; i < 256; i++) {
-        auto ig = uint8_t(255. * pow(i / 255., 255));
-        gammaTable.push_back(ig);
-    }
+        for (size_t y = 0; y < lines; y++) {
+            auto line = planeData + y * bypl;
 
-    for (int gamma = -254; gamma < 256; gamma++) {
-        double k = 255. / (gamma + 255);
+            if (lineSize < bypl)
+                memset(line + lineSize, 0, bypl - lineSize);
 
-        for (int i = 0; i < 256; i++) {
-            auto ig = uint8_t(255. * pow(i / 255., k));
-            gammaTable.push_back(ig);
+            if (y1 >= 0)
+                line[lineSize - 4 + size_t(y1)] = 0;
         }
     }
-
-    return gammaTable;
-}
-
-std::vector<uint8_t> AkVCam::initContrastTable()
-{
-    std::vector<uint8_t> contrastTable;
-
-    for (int contrast = -255; contrast < 256; contrast++) {
-        double f = 259. * (255 + contrast) / (255. * (259 - contrast));
-
-        for (int i = 0; i < 256; i++) {
-            int ic = int(f * (i - 128) + 128.);
-            contrastTable.push_back(uint8_t(VideoFramePrivate::bound(0, ic, 255)));
-        }
-    }
-
-    return contrastTable;
 }
@@ -24,45 +24,113 @@
 #include <memory>
 #include <vector>
 
+#include "framebufferpool.h"
+#include "videoformat.h"
 #include "videoframetypes.h"
 #include "videoformattypes.h"
 
 namespace AkVCam
 {
     class VideoFramePrivate;
-    class VideoFormat;
-    using VideoData = std::vector<uint8_t>;
 
     class VideoFrame
     {
         public:
-            VideoFrame();
+            VideoFrame() = default;
             VideoFrame(const std::string &fileName);
+
+            /* The pixels are taken from FrameBufferPool::globalInstance() and
+             * are not initialized, only the padding bytes are zeroed.
+             */
             VideoFrame(const VideoFormat &format);
-            VideoFrame(const VideoFrame &other);
-            VideoFrame &operator =(const VideoFrame &other);
-            ~VideoFrame();
+            VideoFrame(const VideoFrame &other) = default;
+            VideoFrame(VideoFrame &&other);
+            VideoFrame &operator =(const VideoFrame &other) = default;
+            VideoFrame &operator =(VideoFrame &&other);
 
             bool load(const std::string &fileName);
             VideoFormat format() const;
             VideoFormat &format();
-            VideoData data() const;
+
+            /* The copies of a frame share the pixels until one of them is
+             * modified. The non-const data() and line() give a buffer only
+             * owned by this frame, copying it first if it's shared, use
+             * constLine() for reading without copying.
+             */
+            const VideoData &data() const;
             VideoData &data();
-            uint8_t *line(size_t plane, size_t y) const;
+            const uint8_t *line(size_t plane, size_t y) const;
+            uint8_t *line(size_t plane, size_t y);
+            const uint8_t *constLine(size_t plane, size_t y) const;
+
+            /* Returns true if this frame and 'other' are copies of each other
+             * that were not modified, it doesn't compare the pixels.
+             */
+            bool isCopyOf(const VideoFrame &other) const;
             void clear();
 
+            /* Hash of the format and the pixels of the frame. Frames with the
+             * same hash can be taken as equal, so repeated frames are found
+             * without keeping a copy of the previous one.
+             */
+            uint64_t hash() const;
+
             VideoFrame mirror(bool horizontalMirror, bool verticalMirror) const;
+
+            // Rotate the frame clockwise by a multiple of 90 degrees.
+            VideoFrame rotate(int angle) const;
+
+            /* Scale the frame, or only the 'viewport' part of it if not
+             * empty, without copying the cropped part first.
+             */
             VideoFrame scaled(int width,
                               int height,
                               Scaling mode=ScalingFast,
-                              AspectRatio aspectRatio=AspectRatioIgnore) const;
+                              AspectRatio aspectRatio=AspectRatioIgnore,
+                              const Viewport &viewport=Viewport()) const;
             VideoFrame scaled(size_t maxArea,
                               Scaling mode=ScalingFast,
                               int align=32) const;
             VideoFrame swapRgb(bool swap) const;
             VideoFrame swapRgb() const;
+
+            /* Mirror the frame, or swap its red and blue components, in place
+             * without allocating a new frame. Returns false if the format is
+             * not supported.
+             */
+            bool mirrorInPlace(bool horizontalMirror, bool verticalMirror);
+            bool swapRgbInPlace();
             bool canConvert(FourCC input, FourCC output) const;
             VideoFrame convert(FourCC fourcc) const;
+
+            /* Scale, mirror and convert the frame straight into a caller
+             * provided buffer with the given format, 'planes' and 'strides'
+             * must have an entry for each plane of 'format'.
+             */
+            bool convert(const VideoFormat &format,
+                         uint8_t *const *planes,
+                         const size_t *strides,
+                         bool horizontalMirror=false,
+                         bool verticalMirror=false,
+                         Scaling mode=ScalingFast,
+                         AspectRatio aspectRatio=AspectRatioIgnore) const;
+
+            // Same as above for a contiguous buffer laid out as 'format'.
+            bool convert(const VideoFormat &format,
+                         uint8_t *data,
+                         size_t size,
+                         bool horizontalMirror=false,
+                         bool verticalMirror=false,
+                         Scaling mode=ScalingFast,
+                         AspectRatio aspectRatio=AspectRatioIgnore) const;
+
+            /* Convert the frame to several formats, reading the frame only
+             * once. Returns a frame for each format, the formats that can't be
+             * produced give an empty frame.
+             */
+            std::vector<VideoFrame> convert(const std::vector<VideoFormat> &formats,
+                                            Scaling mode=ScalingFast,
+                                            AspectRatio aspectRatio=AspectRatioIgnore) const;
             VideoFrame adjustHsl(int hue, int saturation, int luminance);
             VideoFrame adjustGamma(int gamma);
             VideoFrame adjustContrast(int contrast);
@@ -75,7 +143,14 @@ namespace AkVCam
                               bool gray);
 
         private:
-            VideoFramePrivate *d;
+            VideoFormat m_format;
+
+            /* The pixels are shared by all the copies of the frame until one
+             * of them writes to it, so copying a frame is O(1).
+             */
+            FrameBuffer m_data;
+
+        friend class VideoFramePrivate;
     };
 }
 
@@ -25,7 +25,10 @@ namespace AkVCam
     enum Scaling
     {
         ScalingFast,
-        ScalingLinear
+        ScalingLinear,
+        ScalingArea,
+        ScalingCubic,
+        ScalingLanczos
     };
 
     enum AspectRatio
@@ -34,6 +37,17 @@ namespace AkVCam
         AspectRatioKeep,
         AspectRatioExpanding
     };
+
+    /* Rectangle of the source frame that is scaled to the output, an empty
+     * viewport is the whole frame.
+     */
+    struct Viewport
+    {
+        int x {0};
+        int y {0};
+        int width {0};
+        int height {0};
+    };
 }
 
 #endif // VIDEOFRAMETYPES_H
@@ -0,0 +1,227 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+/* Checks that FrameTransform doesn't allocate anything while streaming: once
+ * a few frames went through a transform, processing more frames into a
+ * buffer of the caller must not touch the heap, in any thread, with one and
+ * with several threads.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "VCamUtils/src/frametransform.h"
+#include "VCamUtils/src/threadpool.h"
+#include "VCamUtils/src/videoformat.h"
+#include "VCamUtils/src/videoframe.h"
+
+#define WARMUP_FRAMES 3
+#define TEST_FRAMES 10
+
+// Allocations done by any thread since the program started.
+static std::atomic<size_t> allocations {0};
+
+void *operator new(size_t size)
+{
+    allocations++;
+
+    if (auto data = malloc(size? size: 1))
+        return data;
+
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *data) noexcept
+{
+    free(data);
+}
+
+void operator delete[](void *data) noexcept
+{
+    free(data);
+}
+
+void operator delete(void *data, size_t) noexcept
+{
+    free(data);
+}
+
+void operator delete[](void *data, size_t) noexcept
+{
+    free(data);
+}
+
+namespace AkVCam
+{
+    class AllocTest
+    {
+        public:
+            int m_failures {0};
+
+            void testTransform(const char *name,
+                               const VideoFormat &inputFormat,
+                               const VideoFormat &outputFormat,
+                               const FrameTransformParams &params={});
+            void testMultiple();
+
+        private:
+            void check(const char *name, size_t count);
+            static VideoFrame frame(const VideoFormat &format);
+    };
+}
+
+void AkVCam::AllocTest::testTransform(const char *name,
+                                      const VideoFormat &inputFormat,
+                                      const VideoFormat &outputFormat,
+                                      const FrameTransformParams &params)
+{
+    auto input = frame(inputFormat);
+    std::vector<uint8_t> output(outputFormat.size());
+    FrameTransform transform;
+
+    if (!transform.configure(inputFormat, outputFormat, params)) {
+        fprintf(stderr, "%s: can't be configured\n", name);
+        this->m_failures++;
+
+        return;
+    }
+
+    for (int i = 0; i < WARMUP_FRAMES; i++)
+        transform.process(input, output.data(), output.size());
+
+    size_t count = allocations;
+
+    for (int i = 0; i < TEST_FRAMES; i++)
+        transform.process(input, output.data(), output.size());
+
+    this->check(name, allocations - count);
+}
+
+void AkVCam::AllocTest::testMultiple()
+{
+    VideoFormat inputFormat(PixelFormatRGB24, 1280, 720);
+    VideoFormat preview(PixelFormatRGB24, 640, 360);
+    VideoFormat output(PixelFormatNV12, 1280, 720);
+    auto input = frame(inputFormat);
+    auto previewFrame = frame(preview);
+    auto outputFrame = frame(output);
+    FrameTransform previewTransform;
+    FrameTransform outputTransform;
+    previewTransform.configure(inputFormat, preview);
+    outputTransform.configure(inputFormat, output);
+
+    uint8_t *previewPlanes[] = {previewFrame.line(0, 0)};
+    size_t previewStrides[] = {preview.bypl(0)};
+    uint8_t *outputPlanes[] = {outputFrame.line(0, 0), outputFrame.line(1, 0)};
+    size_t outputStrides[] = {output.bypl(0), output.bypl(1)};
+    std::vector<FrameTransform *> transforms {&previewTransform,
+                                              &outputTransform};
+    std::vector<uint8_t *const *> planes {previewPlanes, outputPlanes};
+    std::vector<const size_t *> strides {previewStrides, outputStrides};
+
+    for (int i = 0; i < WARMUP_FRAMES; i++)
+        FrameTransform::process(input, transforms, planes, strides);
+
+    size_t count = allocations;
+
+    for (int i = 0; i < TEST_FRAMES; i++)
+        FrameTransform::process(input, transforms, planes, strides);
+
+    this->check("multiple outputs", allocations - count);
+}
+
+void AkVCam::AllocTest::check(const char *name, size_t count)
+{
+    if (count < 1)
+        return;
+
+    fprintf(stderr,
+            "%s: %zu allocations in %d frames with %d threads\n",
+            name,
+            count,
+            TEST_FRAMES,
+            ThreadPool::globalInstance()->maxThreadCount());
+    this->m_failures++;
+}
+
+AkVCam::VideoFrame AkVCam::AllocTest::frame(const VideoFormat &format)
+{
+    VideoFrame frame(format);
+    auto &data = frame.data();
+
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * 7);
+
+    return frame;
+}
+
+int main()
+{
+    using namespace AkVCam;
+
+    AllocTest test;
+    VideoFormat rgb(PixelFormatRGB24, 1280, 720);
+    VideoFormat smallRgb(PixelFormatRGB24, 640, 360);
+    VideoFormat nv12(PixelFormatNV12, 1280, 720);
+    VideoFormat smallNv12(PixelFormatNV12, 640, 360);
+    VideoFormat smallYuy2(PixelFormatYUY2, 640, 360);
+
+    for (auto threads: {1, 4}) {
+        ThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+        FrameTransformParams mirror;
+        mirror.horizontalMirror = true;
+        FrameTransformParams linear;
+        linear.scaling = ScalingLinear;
+        linear.gamma = 40;
+        FrameTransformParams lanczos;
+        lanczos.scaling = ScalingLanczos;
+        lanczos.hue = 30;
+        FrameTransformParams area;
+        area.scaling = ScalingArea;
+        area.contrast = 20;
+        FrameTransformParams rotate;
+        rotate.rotation = 90;
+
+        test.testTransform("convert",
+                           rgb,
+                           VideoFormat(PixelFormatYUY2, 1280, 720));
+        test.testTransform("mirror", rgb, rgb, mirror);
+        test.testTransform("fast scaling", rgb, smallRgb);
+        test.testTransform("linear scaling", rgb, smallRgb, linear);
+        test.testTransform("lanczos scaling", smallRgb, rgb, lanczos);
+        test.testTransform("area scaling", rgb, smallNv12, area);
+        test.testTransform("rotation", rgb, rgb, rotate);
+        test.testTransform("yuv scaling", nv12, smallNv12, linear);
+        test.testTransform("yuv packing", nv12, smallYuy2, area);
+        test.testMultiple();
+    }
+
+    printf("%d failures\n", test.m_failures);
+
+    return test.m_failures > 0? 1: 0;
+}
@@ -0,0 +1,362 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+/* Checks the RGB24/BGR24 to NV12/NV21 encoders, at every instruction set,
+ * against a plain per pixel implementation: the luma of each pixel, and the
+ * chroma of the rounded average of each 2x2 block, with the last column and
+ * line repeated for odd sizes. Also checks the layout of the NV formats, a
+ * full luma plane followed by a chroma plane of half the lines.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "VCamUtils/src/color.h"
+#include "VCamUtils/src/simd.h"
+#include "VCamUtils/src/videoformat.h"
+#include "VCamUtils/src/videoframe.h"
+
+#define MAX_SIZE 24
+
+namespace AkVCam
+{
+    using Bytes = std::vector<uint8_t>;
+
+    class NvTest
+    {
+        public:
+            uint32_t m_seed {1};
+            int m_failures {0};
+
+            void testLayout(FourCC fourcc, int width, int height);
+            void testKernel(const char *kernel,
+                            SimdRowPairFunc func,
+                            bool bgr,
+                            bool nv21,
+                            int width,
+                            int height);
+            void testFrame(FourCC input, FourCC output, int width, int height);
+
+        private:
+            uint32_t random();
+            void check(bool ok,
+                       const char *what,
+                       int width,
+                       int height,
+                       int x=-1,
+                       int y=-1);
+
+            /* Expected luma and chroma planes for a 24 bits frame, 'r', 'g'
+             * and 'b' are the byte offsets of each component in a pixel.
+             */
+            static void reference(const Bytes &src,
+                                  int width,
+                                  int height,
+                                  int r,
+                                  int g,
+                                  int b,
+                                  bool nv21,
+                                  Bytes &luma,
+                                  Bytes &chroma);
+    };
+}
+
+void AkVCam::NvTest::testLayout(FourCC fourcc, int width, int height)
+{
+    VideoFormat format(fourcc, width, height);
+    auto bypl = format.bypl(0);
+    auto chromaLines = size_t(height + 1) / 2;
+    bool ok = format.planes() == 2
+              && format.bypl(1) == bypl
+              && bypl >= size_t(width)
+              && format.offset(0) == 0
+              && format.offset(1) == bypl * size_t(height)
+              && format.planeSize(0) == bypl * size_t(height)
+              && format.planeSize(1) == bypl * chromaLines
+              && format.size() == bypl * (size_t(height) + chromaLines);
+    this->check(ok, "layout", width, height);
+}
+
+void AkVCam::NvTest::testKernel(const char *kernel,
+                                SimdRowPairFunc func,
+                                bool bgr,
+                                bool nv21,
+                                int width,
+                                int height)
+{
+    Bytes src(3 * size_t(width) * size_t(height));
+
+    for (auto &byte: src)
+        byte = uint8_t(this->random());
+
+    Bytes luma;
+    Bytes chroma;
+    reference(src,
+              width,
+              height,
+              bgr? 0: 2,
+              1,
+              bgr? 2: 0,
+              nv21,
+              luma,
+              chroma);
+
+    // The chroma row covers the last odd column too.
+    auto chromaWidth = size_t(width + 1) & ~size_t(1);
+    Bytes dstLuma(size_t(width) * size_t(height));
+    Bytes dstChroma(chromaWidth * size_t(height + 1) / 2);
+    auto lineSize = 3 * size_t(width);
+
+    for (int y = 0; y < height; y += 2) {
+        // For odd heights the last line is repeated.
+        int y1 = std::min(y + 1, height - 1);
+        Bytes lumaLine1(size_t(width), 0);
+        func(src.data() + size_t(y) * lineSize,
+             src.data() + size_t(y1) * lineSize,
+             dstLuma.data() + size_t(y) * size_t(width),
+             y1 != y? dstLuma.data() + size_t(y1) * size_t(width):
+                      lumaLine1.data(),
+             dstChroma.data() + size_t(y / 2) * chromaWidth,
+             width);
+    }
+
+    this->check(dstLuma == luma, kernel, width, height);
+    this->check(dstChroma == chroma, kernel, width, height);
+}
+
+void AkVCam::NvTest::testFrame(FourCC input,
+                               FourCC output,
+                               int width,
+                               int height)
+{
+    VideoFrame frame(VideoFormat(input, width, height));
+
+    for (int y = 0; y < height; y++) {
+        auto line = frame.line(0, size_t(y));
+
+        for (int x = 0; x < 3 * width; x++)
+            line[x] = uint8_t(this->random());
+    }
+
+    Bytes src;
+
+    for (int y = 0; y < height; y++) {
+        auto line = frame.constLine(0, size_t(y));
+        src.insert(src.end(), line, line + 3 * width);
+    }
+
+    bool bgr = input == PixelFormatBGR24;
+    bool nv21 = output == PixelFormatNV21;
+    Bytes luma;
+    Bytes chroma;
+    reference(src,
+              width,
+              height,
+              bgr? 0: 2,
+              1,
+              bgr? 2: 0,
+              nv21,
+              luma,
+              chroma);
+    auto nv = frame.convert(output);
+    this->check(nv.format().fourcc() == output
+                && nv.data().size() == nv.format().size(),
+                "convert",
+                width,
+                height);
+
+    if (nv.format().fourcc() != output)
+        return;
+
+    auto chromaWidth = size_t(width + 1) & ~size_t(1);
+
+    for (int y = 0; y < height; y++) {
+        auto line = nv.constLine(0, size_t(y));
+
+        for (int x = 0; x < width; x++)
+            if (line[x] != luma[size_t(y * width + x)]) {
+                this->check(false, "convert luma", width, height, x, y);
+
+                return;
+            }
+    }
+
+    for (int y = 0; y < (height + 1) / 2; y++) {
+        auto line = nv.constLine(1, size_t(y));
+
+        for (size_t x = 0; x < chromaWidth; x++)
+            if (line[x] != chroma[size_t(y) * chromaWidth + x]) {
+                this->check(false,
+                            "convert chroma",
+                            width,
+                            height,
+                            int(x),
+                            y);
+
+                return;
+            }
+    }
+}
+
+uint32_t AkVCam::NvTest::random()
+{
+    // xorshift32, the same sequence on every run.
+    this->m_seed ^= this->m_seed << 13;
+    this->m_seed ^= this->m_seed >> 17;
+    this->m_seed ^= this->m_seed << 5;
+
+    return this->m_seed;
+}
+
+void AkVCam::NvTest::check(bool ok,
+                           const char *what,
+                           int width,
+                           int height,
+                           int x,
+                           int y)
+{
+    if (ok)
+        return;
+
+    if (x < 0)
+        fprintf(stderr, "%s: wrong for %dx%d\n", what, width, height);
+    else
+        fprintf(stderr,
+                "%s: wrong for %dx%d at (%d, %d)\n",
+                what,
+                width,
+                height,
+                x,
+                y);
+
+    this->m_failures++;
+}
+
+void AkVCam::NvTest::reference(const Bytes &src,
+                               int width,
+                               int height,
+                               int r,
+                               int g,
+                               int b,
+                               bool nv21,
+                               Bytes &luma,
+                               Bytes &chroma)
+{
+    auto pixel = [&src, width, height] (int x, int y) {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+
+        return src.data() + 3 * size_t(y * width + x);
+    };
+
+    luma.resize(size_t(width) * size_t(height));
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            auto p = pixel(x, y);
+            luma[size_t(y * width + x)] = Color::rgbY(p[r], p[g], p[b]);
+        }
+
+    auto chromaWidth = size_t(width + 1) & ~size_t(1);
+    chroma.resize(chromaWidth * size_t(height + 1) / 2);
+
+    for (int y = 0; y < height; y += 2)
+        for (int x = 0; x < width; x += 2) {
+            int sum[3] {0, 0, 0};
+
+            for (int j = 0; j < 2; j++)
+                for (int i = 0; i < 2; i++) {
+                    auto p = pixel(x + i, y + j);
+
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += p[c];
+                }
+
+            int avgR = (sum[r] + 2) >> 2;
+            int avgG = (sum[g] + 2) >> 2;
+            int avgB = (sum[b] + 2) >> 2;
+            auto uv = chroma.data() + size_t(y / 2) * chromaWidth + size_t(x);
+
+            // NV12 stores the chroma as V U, and NV21 as U V.
+            uv[nv21? 0: 1] = Color::rgbU(avgR, avgG, avgB);
+            uv[nv21? 1: 0] = Color::rgbV(avgR, avgG, avgB);
+        }
+}
+
+int main()
+{
+    using namespace AkVCam;
+
+    NvTest test;
+
+    for (int height = 1; height <= MAX_SIZE; height++)
+        for (int width = 1; width <= MAX_SIZE; width++) {
+            test.testLayout(PixelFormatNV12, width, height);
+            test.testLayout(PixelFormatNV21, width, height);
+        }
+
+    for (auto level: {SimdLevelNone,
+                      SimdLevelSSE2,
+                      SimdLevelAVX2,
+                      SimdLevelNEON}) {
+        auto &kernels = Simd::kernels(level);
+
+        if (kernels.level != level)
+            continue;
+
+        for (int height = 1; height <= MAX_SIZE; height++)
+            for (int width = 1; width <= 3 * MAX_SIZE; width++) {
+                test.testKernel("rgb24ToNv12",
+                                kernels.rgb24ToNv12,
+                                false,
+                                false,
+                                width,
+                                height);
+                test.testKernel("rgb24ToNv21",
+                                kernels.rgb24ToNv21,
+                                false,
+                                true,
+                                width,
+                                height);
+                test.testKernel("bgr24ToNv12",
+                                kernels.bgr24ToNv12,
+                                true,
+                                false,
+                                width,
+                                height);
+                test.testKernel("bgr24ToNv21",
+                                kernels.bgr24ToNv21,
+                                true,
+                                true,
+                                width,
+                                height);
+            }
+    }
+
+    for (int height = 1; height <= MAX_SIZE; height++)
+        for (int width = 1; width <= MAX_SIZE; width++)
+            for (auto input: {PixelFormatRGB24, PixelFormatBGR24})
+                for (auto output: {PixelFormatNV12, PixelFormatNV21})
+                    test.testFrame(input, output, width, height);
+
+    printf("%d failures\n", test.m_failures);
+
+    return test.m_failures > 0? 1: 0;
+}
@@ -0,0 +1,519 @@
+/* akvirtualcamera, virtual camera for Mac and Windows.
+ * Copyright (C) 2021  Gonzalo Exequiel Pedone
+ *
+ * akvirtualcamera is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * akvirtualcamera is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with akvirtualcamera. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+/* Checks that the SIMD kernels of every instruction set supported by the CPU
+ * give exactly the same output as the scalar reference, for every width from
+ * 1 to MAX_WIDTH. The destination buffers are filled with a guard value, so
+ * writing past the end of the row is also caught.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "VCamUtils/src/simd.h"
+
+#define MAX_WIDTH 160
+#define MAX_TAPS 8
+#define GUARD 0xcd
+
+namespace AkVCam
+{
+    using Bytes = std::vector<uint8_t>;
+
+    class SimdTest
+    {
+        public:
+            const SimdKernels &m_ref;
+            const SimdKernels &m_simd;
+            std::string m_level;
+            uint32_t m_seed {1};
+            int m_failures {0};
+
+            SimdTest(SimdLevel level);
+            void run();
+
+        private:
+            uint32_t random();
+            Bytes randomBytes(size_t size);
+            std::vector<int16_t> randomWords(size_t size, int min, int max);
+            void check(bool ok, const char *kernel, int width, int height=0);
+            void testRow(const char *kernel,
+                         SimdRowFunc ref,
+                         SimdRowFunc simd,
+                         size_t srcBpp,
+                         size_t dstBpp,
+                         bool inPlace=false);
+            void testRowPair(const char *kernel,
+                             SimdRowPairFunc ref,
+                             SimdRowPairFunc simd);
+            void testSplitMerge();
+            void testBlend();
+            void testAccumulate();
+            void testFilter();
+            void testTranspose(const char *kernel,
+                               SimdTransposeFunc ref,
+                               SimdTransposeFunc simd,
+                               size_t bpp);
+            void testLut3d();
+            void testChroma();
+            void testHash();
+    };
+}
+
+AkVCam::SimdTest::SimdTest(SimdLevel level):
+    m_ref(Simd::kernels(SimdLevelNone)),
+    m_simd(Simd::kernels(level))
+{
+    static const char *names[] = {"None", "SSE2", "AVX2", "NEON"};
+    this->m_level = names[level];
+}
+
+void AkVCam::SimdTest::run()
+{
+    auto &r = this->m_ref;
+    auto &s = this->m_simd;
+
+    this->testRow("rgb24ToYuy2", r.rgb24ToYuy2, s.rgb24ToYuy2, 3, 2);
+    this->testRow("rgb24ToUyvy", r.rgb24ToUyvy, s.rgb24ToUyvy, 3, 2);
+    this->testRow("bgr24ToYuy2", r.bgr24ToYuy2, s.bgr24ToYuy2, 3, 2);
+    this->testRow("bgr24ToUyvy", r.bgr24ToUyvy, s.bgr24ToUyvy, 3, 2);
+    this->testRowPair("rgb24ToNv12", r.rgb24ToNv12, s.rgb24ToNv12);
+    this->testRowPair("rgb24ToNv21", r.rgb24ToNv21, s.rgb24ToNv21);
+    this->testRowPair("bgr24ToNv12", r.bgr24ToNv12, s.bgr24ToNv12);
+    this->testRowPair("bgr24ToNv21", r.bgr24ToNv21, s.bgr24ToNv21);
+    this->testRow("swapBytes", r.swapBytes, s.swapBytes, 2, 2);
+    this->testSplitMerge();
+    this->testBlend();
+    this->testAccumulate();
+    this->testFilter();
+    this->testTranspose("transpose8", r.transpose8, s.transpose8, 1);
+    this->testTranspose("transpose16", r.transpose16, s.transpose16, 2);
+    this->testTranspose("transpose24", r.transpose24, s.transpose24, 3);
+    this->testTranspose("transpose32", r.transpose32, s.transpose32, 4);
+
+    for (auto inPlace: {false, true}) {
+        this->testRow("mirror8", r.mirror8, s.mirror8, 1, 1, inPlace);
+        this->testRow("mirror16", r.mirror16, s.mirror16, 2, 2, inPlace);
+        this->testRow("mirror24", r.mirror24, s.mirror24, 3, 3, inPlace);
+        this->testRow("mirror32", r.mirror32, s.mirror32, 4, 4, inPlace);
+        this->testRow("mirrorYuy2", r.mirrorYuy2, s.mirrorYuy2, 4, 4, inPlace);
+        this->testRow("mirrorUyvy", r.mirrorUyvy, s.mirrorUyvy, 4, 4, inPlace);
+        this->testRow("swapRgb15", r.swapRgb15, s.swapRgb15, 2, 2, inPlace);
+        this->testRow("swapRgb16", r.swapRgb16, s.swapRgb16, 2, 2, inPlace);
+        this->testRow("swapRgb24", r.swapRgb24, s.swapRgb24, 3, 3, inPlace);
+        this->testRow("swapRgb32", r.swapRgb32, s.swapRgb32, 4, 4, inPlace);
+        this->testRow("swapBgr32", r.swapBgr32, s.swapBgr32, 4, 4, inPlace);
+    }
+
+    this->testLut3d();
+    this->testChroma();
+    this->testHash();
+}
+
+uint32_t AkVCam::SimdTest::random()
+{
+    // xorshift32, the same sequence on every run.
+    this->m_seed ^= this->m_seed << 13;
+    this->m_seed ^= this->m_seed >> 17;
+    this->m_seed ^= this->m_seed << 5;
+
+    return this->m_seed;
+}
+
+AkVCam::Bytes AkVCam::SimdTest::randomBytes(size_t size)
+{
+    Bytes bytes(size);
+
+    for (auto &byte: bytes)
+        byte = uint8_t(this->random());
+
+    return bytes;
+}
+
+std::vector<int16_t> AkVCam::SimdTest::randomWords(size_t size,
+                                                   int min,
+                                                   int max)
+{
+    std::vector<int16_t> words(size);
+
+    for (auto &word: words)
+        word = int16_t(min + int(this->random() % uint32_t(max - min + 1)));
+
+    return words;
+}
+
+void AkVCam::SimdTest::check(bool ok,
+                             const char *kernel,
+                             int width,
+                             int height)
+{
+    if (ok)
+        return;
+
+    if (height > 0)
+        fprintf(stderr,
+                "%s: %s differs from the reference for %dx%d\n",
+                this->m_level.c_str(),
+                kernel,
+                width,
+                height);
+    else
+        fprintf(stderr,
+                "%s: %s differs from the reference for width %d\n",
+                this->m_level.c_str(),
+                kernel,
+                width);
+
+    this->m_failures++;
+}
+
+void AkVCam::SimdTest::testRow(const char *kernel,
+                               SimdRowFunc ref,
+                               SimdRowFunc simd,
+                               size_t srcBpp,
+                               size_t dstBpp,
+                               bool inPlace)
+{
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        // Odd widths of the packed formats write a whole macropixel.
+        auto srcSize = srcBpp * size_t(width + 1);
+        auto dstSize = dstBpp * size_t(width + 1) + 64;
+        auto src = this->randomBytes(srcSize);
+        Bytes dstRef(dstSize, GUARD);
+        Bytes dstSimd(dstSize, GUARD);
+
+        if (inPlace) {
+            memcpy(dstRef.data(), src.data(), srcSize);
+            memcpy(dstSimd.data(), src.data(), srcSize);
+            ref(dstRef.data(), dstRef.data(), width);
+            simd(dstSimd.data(), dstSimd.data(), width);
+        } else {
+            ref(src.data(), dstRef.data(), width);
+            simd(src.data(), dstSimd.data(), width);
+        }
+
+        this->check(dstRef == dstSimd,
+                    inPlace? (std::string(kernel) + " in place").c_str():
+                             kernel,
+                    width);
+    }
+}
+
+void AkVCam::SimdTest::testRowPair(const char *kernel,
+                                   SimdRowPairFunc ref,
+                                   SimdRowPairFunc simd)
+{
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        auto src0 = this->randomBytes(3 * size_t(width));
+        auto src1 = this->randomBytes(3 * size_t(width));
+        auto size = size_t(width) + 65;
+        std::vector<Bytes> dstRef(3, Bytes(size, GUARD));
+        std::vector<Bytes> dstSimd(3, Bytes(size, GUARD));
+        ref(src0.data(),
+            src1.data(),
+            dstRef[0].data(),
+            dstRef[1].data(),
+            dstRef[2].data(),
+            width);
+        simd(src0.data(),
+             src1.data(),
+             dstSimd[0].data(),
+             dstSimd[1].data(),
+             dstSimd[2].data(),
+             width);
+        this->check(dstRef == dstSimd, kernel, width);
+    }
+}
+
+void AkVCam::SimdTest::testSplitMerge()
+{
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        auto src = this->randomBytes(2 * size_t(width));
+        auto size = size_t(width) + 64;
+        Bytes ref0(size, GUARD);
+        Bytes ref1(size, GUARD);
+        Bytes simd0(size, GUARD);
+        Bytes simd1(size, GUARD);
+        this->m_ref.splitBytes(src.data(), ref0.data(), ref1.data(), width);
+        this->m_simd.splitBytes(src.data(), simd0.data(), simd1.data(), width);
+        this->check(ref0 == simd0 && ref1 == simd1, "splitBytes", width);
+
+        Bytes mergeRef(2 * size, GUARD);
+        Bytes mergeSimd(2 * size, GUARD);
+        this->m_ref.mergeBytes(ref0.data(), ref1.data(), mergeRef.data(), width);
+        this->m_simd.mergeBytes(ref0.data(),
+                                ref1.data(),
+                                mergeSimd.data(),
+                                width);
+        this->check(mergeRef == mergeSimd, "mergeBytes", width);
+    }
+}
+
+void AkVCam::SimdTest::testBlend()
+{
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        auto src0 = this->randomBytes(size_t(width));
+        auto src1 = this->randomBytes(size_t(width));
+        std::vector<uint16_t> weights(size_t(width), 0);
+
+        for (auto &weight: weights)
+            weight = uint16_t(this->random() % 257);
+
+        auto size = size_t(width) + 64;
+        Bytes dstRef(size, GUARD);
+        Bytes dstSimd(size, GUARD);
+        this->m_ref.blendBytes(src0.data(),
+                               src1.data(),
+                               weights.data(),
+                               dstRef.data(),
+                               width);
+        this->m_simd.blendBytes(src0.data(),
+                                src1.data(),
+                                weights.data(),
+                                dstSimd.data(),
+                                width);
+        this->check(dstRef == dstSimd, "blendBytes", width);
+
+        for (int weight: {0, 1, 128, 255, 256}) {
+            Bytes rowRef(size, GUARD);
+            Bytes rowSimd(size, GUARD);
+            this->m_ref.blendRows(src0.data(),
+                                  src1.data(),
+                                  weight,
+                                  rowRef.data(),
+                                  width);
+            this->m_simd.blendRows(src0.data(),
+                                   src1.data(),
+                                   weight,
+                                   rowSimd.data(),
+                                   width);
+            this->check(rowRef == rowSimd, "blendRows", width);
+        }
+    }
+}
+
+void AkVCam::SimdTest::testAccumulate()
+{
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        auto src = this->randomBytes(size_t(width));
+        std::vector<uint16_t> dstRef(size_t(width) + 32);
+
+        for (auto &sum: dstRef)
+            sum = uint16_t(this->random());
+
+        auto dstSimd = dstRef;
+        this->m_ref.accumulateRow(src.data(), dstRef.data(), width);
+        this->m_simd.accumulateRow(src.data(), dstSimd.data(), width);
+        this->check(dstRef == dstSimd, "accumulateRow", width);
+    }
+}
+
+void AkVCam::SimdTest::testFilter()
+{
+    for (int taps = 1; taps <= MAX_TAPS; taps++)
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            auto size = size_t(taps) * size_t(width);
+            auto src = this->randomBytes(size);
+
+            // Wide enough to exercise the saturation.
+            auto coeffs = this->randomWords(size, -512, 1024);
+            std::vector<int16_t> dstRef(size_t(width) + 32, -1);
+            auto dstSimd = dstRef;
+            this->m_ref.filterBytes(src.data(),
+                                    coeffs.data(),
+                                    taps,
+                                    dstRef.data(),
+                                    width);
+            this->m_simd.filterBytes(src.data(),
+                                     coeffs.data(),
+                                     taps,
+                                     dstSimd.data(),
+                                     width);
+            this->check(dstRef == dstSimd, "filterBytes", width, taps);
+
+            std::vector<std::vector<int16_t>> rows;
+            std::vector<const int16_t *> rowPtrs;
+
+            for (int k = 0; k < taps; k++)
+                rows.push_back(this->randomWords(size_t(width), -8192, 24576));
+
+            for (auto &row: rows)
+                rowPtrs.push_back(row.data());
+
+            auto rowCoeffs = this->randomWords(size_t(taps), -2048, 8192);
+            Bytes rowRef(size_t(width) + 64, GUARD);
+            Bytes rowSimd(size_t(width) + 64, GUARD);
+            this->m_ref.filterRows(rowPtrs.data(),
+                                   rowCoeffs.data(),
+                                   taps,
+                                   rowRef.data(),
+                                   width);
+            this->m_simd.filterRows(rowPtrs.data(),
+                                    rowCoeffs.data(),
+                                    taps,
+                                    rowSimd.data(),
+                                    width);
+            this->check(rowRef == rowSimd, "filterRows", width, taps);
+        }
+}
+
+void AkVCam::SimdTest::testTranspose(const char *kernel,
+                                     SimdTransposeFunc ref,
+                                     SimdTransposeFunc simd,
+                                     size_t bpp)
+{
+    for (int width = 1; width <= 48; width++)
+        for (int height = 1; height <= 48; height++)
+            for (auto flip: {false, true}) {
+                auto srcStride = ptrdiff_t(bpp) * width + 3;
+                auto dstStride = ptrdiff_t(bpp) * height + 5;
+                auto src = this->randomBytes(size_t(srcStride * height));
+                Bytes dstRef(size_t(dstStride * width), GUARD);
+                Bytes dstSimd(size_t(dstStride * width), GUARD);
+
+                // A negative source stride flips the block vertically.
+                auto srcStart = src.data()
+                                + (flip? srcStride * (height - 1): 0);
+                auto stride = flip? -srcStride: srcStride;
+                ref(srcStart, stride, dstRef.data(), dstStride, width, height);
+                simd(srcStart,
+                     stride,
+                     dstSimd.data(),
+                     dstStride,
+                     width,
+                     height);
+                this->check(dstRef == dstSimd, kernel, width, height);
+            }
+}
+
+void AkVCam::SimdTest::testLut3d()
+{
+    for (int size: {2, 17, 33}) {
+        std::vector<uint32_t> lut(size_t(size * size * size));
+
+        for (auto &node: lut)
+            node = this->random() & 0xffffff;
+
+        // Spread the 256 values of each byte evenly over the nodes.
+        std::vector<uint32_t> axis(3 * 256);
+        int strides[] = {1, size, size * size};
+
+        for (int c = 0; c < 3; c++)
+            for (int v = 0; v < 256; v++) {
+                int pos = v * 256 * (size - 1) / 255;
+                int node = pos >> 8;
+                int frac = pos & 0xff;
+
+                if (node >= size - 1) {
+                    node = size - 2;
+                    frac = 256;
+                }
+
+                axis[size_t(256 * c + v)] =
+                        uint32_t(node * strides[c]) << SIMD_LUT3D_SHIFT
+                        | uint32_t(frac);
+            }
+
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            auto src = this->randomBytes(3 * size_t(width));
+            Bytes dstRef(3 * size_t(width) + 64, GUARD);
+            Bytes dstSimd(3 * size_t(width) + 64, GUARD);
+            this->m_ref.lut3d(src.data(),
+                              dstRef.data(),
+                              width,
+                              lut.data(),
+                              axis.data(),
+                              size);
+            this->m_simd.lut3d(src.data(),
+                               dstSimd.data(),
+                               width,
+                               lut.data(),
+                               axis.data(),
+                               size);
+            this->check(dstRef == dstSimd, "lut3d", width, size);
+        }
+    }
+}
+
+void AkVCam::SimdTest::testChroma()
+{
+    for (int width = 1; width <= MAX_WIDTH; width++) {
+        auto src = this->randomBytes(2 * size_t(width));
+        auto matrix = this->randomWords(4,
+                                        -(2 << SIMD_CHROMA_SHIFT),
+                                        2 << SIMD_CHROMA_SHIFT);
+        Bytes dstRef(2 * size_t(width) + 64, GUARD);
+        Bytes dstSimd(2 * size_t(width) + 64, GUARD);
+        this->m_ref.adjustChroma(src.data(),
+                                 dstRef.data(),
+                                 matrix.data(),
+                                 width);
+        this->m_simd.adjustChroma(src.data(),
+                                  dstSimd.data(),
+                                  matrix.data(),
+                                  width);
+        this->check(dstRef == dstSimd, "adjustChroma", width);
+    }
+}
+
+void AkVCam::SimdTest::testHash()
+{
+    for (int stripes = 1; stripes <= 32; stripes++) {
+        auto data = this->randomBytes(SIMD_HASH_STRIPE * size_t(stripes));
+        uint64_t accRef[8];
+
+        for (auto &acc: accRef)
+            acc = uint64_t(this->random()) << 32 | this->random();
+
+        uint64_t accSimd[8];
+        memcpy(accSimd, accRef, sizeof(accRef));
+        uint64_t index = this->random() % 1024;
+        this->m_ref.hashStripes(data.data(), size_t(stripes), index, accRef);
+        this->m_simd.hashStripes(data.data(), size_t(stripes), index, accSimd);
+        this->check(memcmp(accRef, accSimd, sizeof(accRef)) == 0,
+                    "hashStripes",
+                    stripes);
+    }
+}
+
+int main()
+{
+    using namespace AkVCam;
+
+    int failures = 0;
+
+    for (auto level: {SimdLevelSSE2, SimdLevelAVX2, SimdLevelNEON}) {
+        // Simd::kernels() falls back to a lower level if not supported.
+        if (Simd::kernels(level).level != level) {
+            printf("Skipping the level %d, not supported by the CPU\n",
+                   int(level));
+
+            continue;
+        }
+
+        SimdTest test(level);
+        test.run();
+        printf("%s: %d failures\n", test.m_level.c_str(), test.m_failures);
+        failures += test.m_failures;
+    }
+
+    return failures > 0? 1: 0;
+}
@@ -653,3 +653,14 @@ void AkVCam::Preferences::setLogLevel(int logLevel)
     write("loglevel", logLevel);
     sync();
 }
+
+int AkVCam::Preferences::maxThreads()
+{
+    return readInt("maxthreads", 0);
+}
+
+void AkVCam::Preferences::setMaxThreads(int maxThreads)
+{
+    write("maxthreads", maxThreads);
+    sync();
+}
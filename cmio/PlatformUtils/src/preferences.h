@@ -86,6 +86,8 @@ namespace AkVCam
         void setPicture(const std::string &picture);
         int logLevel();
         void setLogLevel(int logLevel);
+        int maxThreads();
+        void setMaxThreads(int maxThreads);
     }
 }
 
@@ -54,7 +54,8 @@ namespace AkVCam {
                 {AkVCam::PixelFormatRGB16, kCMPixelFormat_16LE565        },
                 {AkVCam::PixelFormatRGB15, kCMPixelFormat_16LE555        },
                 {AkVCam::PixelFormatUYVY , kCMPixelFormat_422YpCbCr8     },
-                {AkVCam::PixelFormatYUY2 , kCMPixelFormat_422YpCbCr8_yuvs}
+                {AkVCam::PixelFormatYUY2 , kCMPixelFormat_422YpCbCr8_yuvs},
+                {AkVCam::PixelFormatI420 , kCVPixelFormatType_420YpCbCr8Planar}
             };
 
             return &formatsTable;
@@ -50,6 +50,19 @@
 
 namespace AkVCam
 {
+    // Last frame sent or received for a device, and its hash.
+    struct SentFrame
+    {
+        uint64_t hash;
+        IOSurfaceRef surface;
+    };
+
+    struct ReceivedFrame
+    {
+        uint64_t hash;
+        VideoFrame frame;
+    };
+
     class Hack
     {
         public:
@@ -80,6 +93,8 @@ namespace AkVCam
             xpc_connection_t m_serverMessagePort;
             std::map<int64_t, XpcMessage> m_messageHandlers;
             std::vector<std::string> m_broadcasting;
+            std::map<std::string, SentFrame> m_sentFrames;
+            std::map<std::string, ReceivedFrame> m_receivedFrames;
 
             IpcBridgePrivate(IpcBridge *self=nullptr);
             ~IpcBridgePrivate();
@@ -378,7 +393,8 @@ std::vector<AkVCam::PixelFormat> AkVCam::IpcBridge::supportedPixelFormats(Stream
         PixelFormatRGB32,
         PixelFormatRGB24,
         PixelFormatUYVY,
-        PixelFormatYUY2
+        PixelFormatYUY2,
+        PixelFormatI420
     };
 }
 
@@ -682,6 +698,14 @@ void AkVCam::IpcBridge::deviceStop(const std::string &deviceId)
     xpc_release(dictionary);
 
     this->d->m_broadcasting.erase(it);
+    auto sent = this->d->m_sentFrames.find(deviceId);
+
+    if (sent != this->d->m_sentFrames.end()) {
+        if (sent->second.surface)
+            CFRelease(sent->second.surface);
+
+        this->d->m_sentFrames.erase(sent);
+    }
 }
 
 bool AkVCam::IpcBridge::write(const std::string &deviceId,
@@ -699,53 +723,74 @@ bool AkVCam::IpcBridge::write(const std::string &deviceId,
     if (it == this->d->m_broadcasting.end())
         return false;
 
-    std::vector<CFStringRef> keys {
-        kIOSurfacePixelFormat,
-        kIOSurfaceWidth,
-        kIOSurfaceHeight,
-        kIOSurfaceAllocSize
-    };
+    auto hash = frame.hash();
+    auto &sent = this->d->m_sentFrames[deviceId];
+    IOSurfaceRef surface = nullptr;
 
-    auto fourcc = frame.format().fourcc();
-    auto width = frame.format().width();
-    auto height = frame.format().height();
-    auto dataSize = int64_t(frame.data().size());
+    if (sent.surface && sent.hash == hash) {
+        /* Static content, like slides or a screen share, sends the same
+         * frame over and over, in that case send the last surface again.
+         */
+        surface = sent.surface;
+        CFRetain(surface);
+    } else {
+        std::vector<CFStringRef> keys {
+            kIOSurfacePixelFormat,
+            kIOSurfaceWidth,
+            kIOSurfaceHeight,
+            kIOSurfaceAllocSize
+        };
+
+        auto fourcc = frame.format().fourcc();
+        auto width = frame.format().width();
+        auto height = frame.format().height();
+        auto dataSize = int64_t(frame.format().size());
+
+        std::vector<CFNumberRef> values {
+            CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &fourcc),
+            CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &width),
+            CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &height),
+            CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt64Type, &dataSize)
+        };
+
+        auto surfaceProperties =
+                CFDictionaryCreate(kCFAllocatorDefault,
+                                   reinterpret_cast<const void **>(keys.data()),
+                                   reinterpret_cast<const void **>(values.data()),
+                                   CFIndex(values.size()),
+                                   nullptr,
+                                   nullptr);
+        surface = IOSurfaceCreate(surfaceProperties);
 
-    std::vector<CFNumberRef> values {
-        CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &fourcc),
-        CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &width),
-        CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &height),
-        CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt64Type, &dataSize)
-    };
+        for (auto &value: values)
+            CFRelease(value);
 
-    auto surfaceProperties =
-            CFDictionaryCreate(kCFAllocatorDefault,
-                               reinterpret_cast<const void **>(keys.data()),
-                               reinterpret_cast<const void **>(values.data()),
-                               CFIndex(values.size()),
-                               nullptr,
-                               nullptr);
-    auto surface = IOSurfaceCreate(surfaceProperties);
+        CFRelease(surfaceProperties);
 
-    for (auto &value: values)
-        CFRelease(value);
+        if (!surface)
+            return false;
 
-    CFRelease(surfaceProperties);
+        uint32_t surfaceSeed = 0;
+        IOSurfaceLock(surface, 0, &surfaceSeed);
+        auto data = IOSurfaceGetBaseAddress(surface);
+        memcpy(data, frame.line(0, 0), frame.format().size());
+        IOSurfaceUnlock(surface, 0, &surfaceSeed);
 
-    if (!surface)
-        return false;
+        if (sent.surface)
+            CFRelease(sent.surface);
+
+        sent.hash = hash;
+        sent.surface = surface;
+        CFRetain(surface);
+    }
 
-    uint32_t surfaceSeed = 0;
-    IOSurfaceLock(surface, 0, &surfaceSeed);
-    auto data = IOSurfaceGetBaseAddress(surface);
-    memcpy(data, frame.data().data(), frame.data().size());
-    IOSurfaceUnlock(surface, 0, &surfaceSeed);
     auto surfaceObj = IOSurfaceCreateXPCObject(surface);
 
     auto dictionary = xpc_dictionary_create(nullptr, nullptr, 0);
     xpc_dictionary_set_int64(dictionary, "message", AKVCAM_ASSISTANT_MSG_FRAME_READY);
     xpc_dictionary_set_string(dictionary, "device", deviceId.c_str());
     xpc_dictionary_set_value(dictionary, "frame", surfaceObj);
+    xpc_dictionary_set_uint64(dictionary, "hash", hash);
     auto reply = xpc_connection_send_message_with_reply_sync(this->d->m_serverMessagePort,
                                                              dictionary);
     xpc_release(dictionary);
@@ -906,7 +951,9 @@ AkVCam::IpcBridgePrivate::IpcBridgePrivate(IpcBridge *self):
 
 AkVCam::IpcBridgePrivate::~IpcBridgePrivate()
 {
-
+    for (auto &frame: this->m_sentFrames)
+        if (frame.second.surface)
+            CFRelease(frame.second.surface);
 }
 
 void AkVCam::IpcBridgePrivate::add(IpcBridge *bridge)
@@ -933,22 +980,36 @@ const std::vector<AkVCam::DeviceControl> &AkVCam::IpcBridgePrivate::controls() c
 {
     static const std::vector<std::string> scalingMenu {
         "Fast",
-        "Linear"
+        "Linear",
+        "Area",
+        "Cubic",
+        "Lanczos"
     };
     static const std::vector<std::string> aspectRatioMenu {
         "Ignore",
         "Keep",
         "Expanding"
     };
+    static const std::vector<std::string> rotationMenu {
+        "0",
+        "90",
+        "180",
+        "270"
+    };
     static const auto scalingMax = int(scalingMenu.size()) - 1;
     static const auto aspectRatioMax = int(aspectRatioMenu.size()) - 1;
+    static const auto rotationMax = int(rotationMenu.size()) - 1;
 
     static const std::vector<DeviceControl> controls {
-        {"hflip"       , "Horizontal Mirror", ControlTypeBoolean, 0, 1             , 1, 0, 0, {}             },
-        {"vflip"       , "Vertical Mirror"  , ControlTypeBoolean, 0, 1             , 1, 0, 0, {}             },
-        {"scaling"     , "Scaling"          , ControlTypeMenu   , 0, scalingMax    , 1, 0, 0, scalingMenu    },
-        {"aspect_ratio", "Aspect Ratio"     , ControlTypeMenu   , 0, aspectRatioMax, 1, 0, 0, aspectRatioMenu},
-        {"swap_rgb"    , "Swap RGB"         , ControlTypeBoolean, 0, 1             , 1, 0, 0, {}             },
+        {"hflip"       , "Horizontal Mirror", ControlTypeBoolean, 0   , 1             , 1, 0, 0, {}             },
+        {"vflip"       , "Vertical Mirror"  , ControlTypeBoolean, 0   , 1             , 1, 0, 0, {}             },
+        {"rotation"    , "Rotation"         , ControlTypeMenu   , 0   , rotationMax   , 1, 0, 0, rotationMenu   },
+        {"scaling"     , "Scaling"          , ControlTypeMenu   , 0   , scalingMax    , 1, 0, 0, scalingMenu    },
+        {"aspect_ratio", "Aspect Ratio"     , ControlTypeMenu   , 0   , aspectRatioMax, 1, 0, 0, aspectRatioMenu},
+        {"zoom"        , "Zoom"             , ControlTypeInteger, 0   , 300           , 1, 0, 0, {}             },
+        {"pan"         , "Pan"              , ControlTypeInteger, -100, 100           , 1, 0, 0, {}             },
+        {"tilt"        , "Tilt"             , ControlTypeInteger, -100, 100           , 1, 0, 0, {}             },
+        {"swap_rgb"    , "Swap RGB"         , ControlTypeBoolean, 0   , 1             , 1, 0, 0, {}             },
     };
 
     return controls;
@@ -1014,29 +1075,42 @@ void AkVCam::IpcBridgePrivate::frameReady(xpc_connection_t client,
 
     std::string deviceId =
             xpc_dictionary_get_string(event, "device");
-    auto frame = xpc_dictionary_get_value(event, "frame");
-    auto surface = IOSurfaceLookupFromXPCObject(frame);
-
-    if (surface) {
-        uint32_t surfaceSeed = 0;
-        IOSurfaceLock(surface, kIOSurfaceLockReadOnly, &surfaceSeed);
-        FourCC fourcc = IOSurfaceGetPixelFormat(surface);
-        int width = int(IOSurfaceGetWidth(surface));
-        int height = int(IOSurfaceGetHeight(surface));
-        size_t size = IOSurfaceGetAllocSize(surface);
-        auto data = reinterpret_cast<uint8_t *>(IOSurfaceGetBaseAddress(surface));
-        VideoFormat videoFormat(fourcc, width, height);
-        VideoFrame videoFrame(videoFormat);
-        memcpy(videoFrame.data().data(), data, size);
-        IOSurfaceUnlock(surface, kIOSurfaceLockReadOnly, &surfaceSeed);
-        CFRelease(surface);
+    auto hash = xpc_dictionary_get_uint64(event, "hash");
+    auto &received = this->m_receivedFrames[deviceId];
+    bool ok = true;
+
+    // Only copy the frame if it's not the one received last time.
+    if (received.frame.format().size() < 1 || received.hash != hash) {
+        auto frame = xpc_dictionary_get_value(event, "frame");
+        auto surface = IOSurfaceLookupFromXPCObject(frame);
+
+        if (surface) {
+            uint32_t surfaceSeed = 0;
+            IOSurfaceLock(surface, kIOSurfaceLockReadOnly, &surfaceSeed);
+            FourCC fourcc = IOSurfaceGetPixelFormat(surface);
+            int width = int(IOSurfaceGetWidth(surface));
+            int height = int(IOSurfaceGetHeight(surface));
+            size_t size = IOSurfaceGetAllocSize(surface);
+            auto data = reinterpret_cast<uint8_t *>(IOSurfaceGetBaseAddress(surface));
+            VideoFormat videoFormat(fourcc, width, height);
+            received.frame = VideoFrame(videoFormat);
+            received.hash = hash;
+            memcpy(received.frame.data().data(),
+                   data,
+                   std::min(size, received.frame.data().size()));
+            IOSurfaceUnlock(surface, kIOSurfaceLockReadOnly, &surfaceSeed);
+            CFRelease(surface);
+        } else {
+            ok = false;
+        }
+    }
 
+    if (ok)
         for (auto bridge: this->m_bridges)
-            AKVCAM_EMIT(bridge, FrameReady, deviceId, videoFrame)
-    }
+            AKVCAM_EMIT(bridge, FrameReady, deviceId, received.frame)
 
     auto reply = xpc_dictionary_create_reply(event);
-    xpc_dictionary_set_bool(reply, "status", surface? true: false);
+    xpc_dictionary_set_bool(reply, "status", ok);
     xpc_connection_send_message(client, reply);
     xpc_release(reply);
 }
@@ -1063,6 +1137,7 @@ void AkVCam::IpcBridgePrivate::setBroadcasting(xpc_connection_t client,
             xpc_dictionary_get_string(event, "device");
     std::string broadcaster =
             xpc_dictionary_get_string(event, "broadcaster");
+    this->m_receivedFrames.erase(deviceId);
 
     for (auto bridge: this->m_bridges)
         AKVCAM_EMIT(bridge, BroadcastingChanged, deviceId, broadcaster)
@@ -230,6 +230,12 @@ void AkVCam::Device::setVerticalMirror(bool verticalMirror)
         stream.second->setVerticalMirror(verticalMirror);
 }
 
+void AkVCam::Device::setRotation(int rotation)
+{
+    for (auto &stream: this->m_streams)
+        stream.second->setRotation(rotation);
+}
+
 void AkVCam::Device::setScaling(Scaling scaling)
 {
     for (auto &stream: this->m_streams)
@@ -242,6 +248,24 @@ void AkVCam::Device::setAspectRatio(AspectRatio aspectRatio)
         stream.second->setAspectRatio(aspectRatio);
 }
 
+void AkVCam::Device::setZoom(int zoom)
+{
+    for (auto &stream: this->m_streams)
+        stream.second->setZoom(zoom);
+}
+
+void AkVCam::Device::setPan(int pan)
+{
+    for (auto &stream: this->m_streams)
+        stream.second->setPan(pan);
+}
+
+void AkVCam::Device::setTilt(int tilt)
+{
+    for (auto &stream: this->m_streams)
+        stream.second->setTilt(tilt);
+}
+
 void AkVCam::Device::setSwapRgb(bool swap)
 {
     for (auto &stream: this->m_streams)
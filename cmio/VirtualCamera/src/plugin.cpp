@@ -22,6 +22,7 @@
 #include "PlatformUtils/src/utils.h"
 #include "VCamUtils/src/ipcbridge.h"
 #include "VCamUtils/src/logger.h"
+#include "VCamUtils/src/threadpool.h"
 
 extern "C" void *akPluginMain(CFAllocatorRef allocator,
                               CFUUIDRef requestedTypeUUID)
@@ -41,6 +42,9 @@ extern "C" void *akPluginMain(CFAllocatorRef allocator,
                                             "/tmp/" CMIO_PLUGIN_NAME ".log");
     AkVCam::Logger::setLogFile(logFile);
 
+    // Hosts sensitive to latency can limit the threads used per frame.
+    AkVCam::ThreadPool::globalInstance()->setMaxThreadCount(AkVCam::Preferences::maxThreads());
+
     if (!CFEqual(requestedTypeUUID, kCMIOHardwarePlugInTypeID))
         return nullptr;
 
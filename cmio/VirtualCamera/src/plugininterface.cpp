@@ -345,12 +345,24 @@ void AkVCam::PluginInterface::controlsChanged(void *userData,
             if (controls.count("vflip"))
                 device->setVerticalMirror(controls.at("vflip"));
 
+            if (controls.count("rotation"))
+                device->setRotation(90 * controls.at("rotation"));
+
             if (controls.count("scaling"))
                 device->setScaling(Scaling(controls.at("scaling")));
 
             if (controls.count("aspect_ratio"))
                 device->setAspectRatio(AspectRatio(controls.at("aspect_ratio")));
 
+            if (controls.count("zoom"))
+                device->setZoom(controls.at("zoom"));
+
+            if (controls.count("pan"))
+                device->setPan(controls.at("pan"));
+
+            if (controls.count("tilt"))
+                device->setTilt(controls.at("tilt"));
+
             if (controls.count("swap_rgb"))
                 device->setSwapRgb(controls.at("swap_rgb"));
         }
@@ -390,8 +402,12 @@ bool AkVCam::PluginInterface::createDevice(const std::string &deviceId,
     auto cameraIndex = Preferences::cameraFromId(deviceId);
     auto hflip = Preferences::cameraControlValue(cameraIndex, "hflip");
     auto vflip = Preferences::cameraControlValue(cameraIndex, "vflip");
+    auto rotation = Preferences::cameraControlValue(cameraIndex, "rotation");
     auto scaling = Preferences::cameraControlValue(cameraIndex, "scaling");
     auto aspectRatio = Preferences::cameraControlValue(cameraIndex, "aspect_ratio");
+    auto zoom = Preferences::cameraControlValue(cameraIndex, "zoom");
+    auto pan = Preferences::cameraControlValue(cameraIndex, "pan");
+    auto tilt = Preferences::cameraControlValue(cameraIndex, "tilt");
     auto swapRgb = Preferences::cameraControlValue(cameraIndex, "swap_rgb");
 
     // Define device properties.
@@ -455,8 +471,12 @@ bool AkVCam::PluginInterface::createDevice(const std::string &deviceId,
     device->setBroadcasting(this->d->m_ipcBridge.broadcaster(deviceId));
     device->setHorizontalMirror(hflip);
     device->setVerticalMirror(vflip);
+    device->setRotation(90 * rotation);
     device->setScaling(Scaling(scaling));
     device->setAspectRatio(AspectRatio(aspectRatio));
+    device->setZoom(zoom);
+    device->setPan(pan);
+    device->setTilt(tilt);
     device->setSwapRgb(swapRgb);
 
     return true;
@@ -496,13 +516,21 @@ void AkVCam::PluginInterfacePrivate::updateDevices()
         auto cameraIndex = Preferences::cameraFromId(device->deviceId());
         auto hflip = Preferences::cameraControlValue(cameraIndex, "hflip");
         auto vflip = Preferences::cameraControlValue(cameraIndex, "vflip");
+        auto rotation = Preferences::cameraControlValue(cameraIndex, "rotation");
         auto scaling = Preferences::cameraControlValue(cameraIndex, "scaling");
         auto aspectRatio = Preferences::cameraControlValue(cameraIndex, "aspect_ratio");
+        auto zoom = Preferences::cameraControlValue(cameraIndex, "zoom");
+        auto pan = Preferences::cameraControlValue(cameraIndex, "pan");
+        auto tilt = Preferences::cameraControlValue(cameraIndex, "tilt");
         auto swapRgb = Preferences::cameraControlValue(cameraIndex, "swap_rgb");
         device->setHorizontalMirror(hflip);
         device->setVerticalMirror(vflip);
+        device->setRotation(90 * rotation);
         device->setScaling(Scaling(scaling));
         device->setAspectRatio(AspectRatio(aspectRatio));
+        device->setZoom(zoom);
+        device->setPan(pan);
+        device->setTilt(tilt);
         device->setSwapRgb(swapRgb);
     }
 }
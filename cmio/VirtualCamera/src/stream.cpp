@@ -29,6 +29,7 @@
 #include "clock.h"
 #include "PlatformUtils/src/preferences.h"
 #include "PlatformUtils/src/utils.h"
+#include "VCamUtils/src/frametransform.h"
 #include "VCamUtils/src/videoformat.h"
 #include "VCamUtils/src/videoframe.h"
 #include "VCamUtils/src/logger.h"
@@ -47,25 +48,25 @@ namespace AkVCam
             CMIODeviceStreamQueueAlteredProc m_queueAltered {nullptr};
             VideoFrame m_currentFrame;
             VideoFrame m_testFrame;
-            VideoFrame m_testFrameAdapted;
             void *m_queueAlteredRefCon {nullptr};
             CFRunLoopTimerRef m_timer {nullptr};
             std::string m_broadcaster;
             std::mutex m_mutex;
-            Scaling m_scaling {ScalingFast};
-            AspectRatio m_aspectRatio {AspectRatioIgnore};
+            FrameTransform m_transform;
+            FrameTransformParams m_transformParams;
             bool m_running {false};
-            bool m_horizontalMirror {false};
-            bool m_verticalMirror {false};
-            bool m_swapRgb {false};
+
+            // Pixel buffer kept for the current frame.
+            CVImageBufferRef m_imageBuffer {nullptr};
+            FrameTransformRepeats m_imageRepeats;
 
             explicit StreamPrivate(Stream *self);
+            ~StreamPrivate();
+            void setCurrentFrame(const VideoFrame &frame);
             bool startTimer();
             void stopTimer();
             static void streamLoop(CFRunLoopTimerRef timer, void *info);
-            void sendFrame(const VideoFrame &frame);
-            void updateTestFrame();
-            VideoFrame applyAdjusts(const VideoFrame &frame);
+            void sendFrame(const VideoFrame &frame, bool isCurrentFrame);
             VideoFrame randomFrame();
     };
 }
@@ -164,11 +165,10 @@ void AkVCam::Stream::setPicture(const std::string &picture)
     AkLogFunction();
     AkLogDebug() << "Picture: " << picture;
     this->d->m_testFrame = loadPicture(picture);
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
 
     if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+        this->d->setCurrentFrame(this->d->m_testFrame);
 
     this->d->m_mutex.unlock();
 }
@@ -210,7 +210,20 @@ void AkVCam::Stream::setFormats(const std::vector<VideoFormat> &formats)
 
     this->m_properties.setProperty(kCMIOStreamPropertyFormatDescriptions,
                                    formatsAdjusted);
-    this->setFormat(formatsAdjusted[0]);
+
+    /* Start with the format that is the cheapest to produce, the frames are
+     * RGB24, and until a broadcaster appears they have the size of the
+     * output.
+     */
+    this->d->m_mutex.lock();
+    auto inputFormat = this->d->m_currentFrame.format();
+    this->d->m_mutex.unlock();
+
+    if (inputFormat.size() < 1)
+        inputFormat = {PixelFormatRGB24, 0, 0};
+
+    auto format = FrameTransform::negotiate(inputFormat, formatsAdjusted);
+    this->setFormat(format.size() > 0? format: formatsAdjusted[0]);
 }
 
 void AkVCam::Stream::setFormat(const VideoFormat &format)
@@ -242,8 +255,7 @@ bool AkVCam::Stream::start()
     if (this->d->m_running)
         return false;
 
-    this->d->updateTestFrame();
-    this->d->m_currentFrame = this->d->m_testFrameAdapted;
+    this->d->setCurrentFrame(this->d->m_testFrame);
     this->d->m_sequence = 0;
     memset(&this->d->m_pts, 0, sizeof(CMTime));
     this->d->m_running = this->d->startTimer();
@@ -261,8 +273,7 @@ void AkVCam::Stream::stop()
 
     this->d->m_running = false;
     this->d->stopTimer();
-    this->d->m_currentFrame.clear();
-    this->d->m_testFrameAdapted.clear();
+    this->d->setCurrentFrame({});
 }
 
 bool AkVCam::Stream::running()
@@ -276,15 +287,9 @@ void AkVCam::Stream::serverStateChanged(IpcBridge::ServerState state)
 
     if (state == IpcBridge::ServerStateGone) {
         this->d->m_broadcaster.clear();
-        this->d->m_horizontalMirror = false;
-        this->d->m_verticalMirror = false;
-        this->d->m_scaling = ScalingFast;
-        this->d->m_aspectRatio = AspectRatioIgnore;
-        this->d->m_swapRgb = false;
-        this->d->updateTestFrame();
-
         this->d->m_mutex.lock();
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+        this->d->m_transformParams = {};
+        this->d->setCurrentFrame(this->d->m_testFrame);
         this->d->m_mutex.unlock();
     }
 }
@@ -300,8 +305,12 @@ void AkVCam::Stream::frameReady(const AkVCam::VideoFrame &frame)
 
     this->d->m_mutex.lock();
 
-    if (!this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->applyAdjusts(frame);
+    /* The bridge sends the same frame again when its content doesn't
+     * change, keep the pixel buffer of the current frame in that case.
+     */
+    if (!this->d->m_broadcaster.empty()
+        && !frame.isCopyOf(this->d->m_currentFrame))
+        this->d->setCurrentFrame(frame);
 
     this->d->m_mutex.unlock();
 }
@@ -318,7 +327,7 @@ void AkVCam::Stream::setBroadcasting(const std::string &broadcaster)
     this->d->m_broadcaster = broadcaster;
 
     if (broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+        this->d->setCurrentFrame(this->d->m_testFrame);
 
     this->d->m_mutex.unlock();
 }
@@ -328,16 +337,8 @@ void AkVCam::Stream::setHorizontalMirror(bool horizontalMirror)
     AkLogFunction();
     AkLogDebug() << "Mirror: " << horizontalMirror << std::endl;
 
-    if (this->d->m_horizontalMirror == horizontalMirror)
-        return;
-
-    this->d->m_horizontalMirror = horizontalMirror;
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
-
-    if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
-
+    this->d->m_transformParams.horizontalMirror = horizontalMirror;
     this->d->m_mutex.unlock();
 }
 
@@ -346,16 +347,18 @@ void AkVCam::Stream::setVerticalMirror(bool verticalMirror)
     AkLogFunction();
     AkLogDebug() << "Mirror: " << verticalMirror << std::endl;
 
-    if (this->d->m_verticalMirror == verticalMirror)
-        return;
-
-    this->d->m_verticalMirror = verticalMirror;
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
+    this->d->m_transformParams.verticalMirror = verticalMirror;
+    this->d->m_mutex.unlock();
+}
 
-    if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+void AkVCam::Stream::setRotation(int rotation)
+{
+    AkLogFunction();
+    AkLogDebug() << "Rotation: " << rotation << std::endl;
 
+    this->d->m_mutex.lock();
+    this->d->m_transformParams.rotation = rotation;
     this->d->m_mutex.unlock();
 }
 
@@ -364,16 +367,8 @@ void AkVCam::Stream::setScaling(Scaling scaling)
     AkLogFunction();
     AkLogDebug() << "Scaling: " << scaling << std::endl;
 
-    if (this->d->m_scaling == scaling)
-        return;
-
-    this->d->m_scaling = scaling;
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
-
-    if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
-
+    this->d->m_transformParams.scaling = scaling;
     this->d->m_mutex.unlock();
 }
 
@@ -382,34 +377,48 @@ void AkVCam::Stream::setAspectRatio(AspectRatio aspectRatio)
     AkLogFunction();
     AkLogDebug() << "Aspect ratio: " << aspectRatio << std::endl;
 
-    if (this->d->m_aspectRatio == aspectRatio)
-        return;
-
-    this->d->m_aspectRatio = aspectRatio;
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
+    this->d->m_transformParams.aspectRatio = aspectRatio;
+    this->d->m_mutex.unlock();
+}
 
-    if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+void AkVCam::Stream::setZoom(int zoom)
+{
+    AkLogFunction();
+    AkLogDebug() << "Zoom: " << zoom << std::endl;
 
+    this->d->m_mutex.lock();
+    this->d->m_transformParams.zoom = zoom;
     this->d->m_mutex.unlock();
 }
 
-void AkVCam::Stream::setSwapRgb(bool swap)
+void AkVCam::Stream::setPan(int pan)
 {
     AkLogFunction();
-    AkLogDebug() << "Swap: " << swap << std::endl;
+    AkLogDebug() << "Pan: " << pan << std::endl;
 
-    if (this->d->m_swapRgb == swap)
-        return;
+    this->d->m_mutex.lock();
+    this->d->m_transformParams.pan = pan;
+    this->d->m_mutex.unlock();
+}
+
+void AkVCam::Stream::setTilt(int tilt)
+{
+    AkLogFunction();
+    AkLogDebug() << "Tilt: " << tilt << std::endl;
 
-    this->d->m_swapRgb = swap;
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
+    this->d->m_transformParams.tilt = tilt;
+    this->d->m_mutex.unlock();
+}
 
-    if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+void AkVCam::Stream::setSwapRgb(bool swap)
+{
+    AkLogFunction();
+    AkLogDebug() << "Swap: " << swap << std::endl;
 
+    this->d->m_mutex.lock();
+    this->d->m_transformParams.swapRgb = swap;
     this->d->m_mutex.unlock();
 }
 
@@ -469,6 +478,23 @@ AkVCam::StreamPrivate::StreamPrivate(AkVCam::Stream *self):
 {
 }
 
+AkVCam::StreamPrivate::~StreamPrivate()
+{
+    if (this->m_imageBuffer)
+        CFRelease(this->m_imageBuffer);
+}
+
+void AkVCam::StreamPrivate::setCurrentFrame(const VideoFrame &frame)
+{
+    this->m_currentFrame = frame;
+    this->m_imageRepeats.reset();
+
+    if (this->m_imageBuffer) {
+        CFRelease(this->m_imageBuffer);
+        this->m_imageBuffer = nullptr;
+    }
+}
+
 bool AkVCam::StreamPrivate::startTimer()
 {
     AkLogFunction();
@@ -529,23 +555,27 @@ void AkVCam::StreamPrivate::streamLoop(CFRunLoopTimerRef timer, void *info)
     self->m_mutex.lock();
 
     if (self->m_currentFrame.format().size() < 1)
-        self->sendFrame(self->randomFrame());
+        self->sendFrame(self->randomFrame(), false);
     else
-        self->sendFrame(self->m_currentFrame);
+        self->sendFrame(self->m_currentFrame, true);
 
     self->m_mutex.unlock();
 }
 
-void AkVCam::StreamPrivate::sendFrame(const VideoFrame &frame)
+void AkVCam::StreamPrivate::sendFrame(const VideoFrame &frame,
+                                      bool isCurrentFrame)
 {
     AkLogFunction();
 
     if (this->m_queue->fullness() >= 1.0f)
         return;
 
-    FourCC fourcc = frame.format().fourcc();
-    int width = frame.format().width();
-    int height = frame.format().height();
+    VideoFormat videoFormat;
+    this->self->m_properties.getProperty(kCMIOStreamPropertyFormatDescription,
+                                         &videoFormat);
+    FourCC fourcc = videoFormat.fourcc();
+    int width = videoFormat.width();
+    int height = videoFormat.height();
 
     AkLogInfo() << "Sending Frame: "
                 << enumToString(fourcc)
@@ -579,20 +609,95 @@ void AkVCam::StreamPrivate::sendFrame(const VideoFrame &frame)
                                    this->m_clock->ref());
 
     CVImageBufferRef imageBuffer = nullptr;
-    CVPixelBufferCreate(kCFAllocatorDefault,
-                        size_t(width),
-                        size_t(height),
-                        formatToCM(PixelFormat(fourcc)),
-                        nullptr,
-                        &imageBuffer);
-
-    if (!imageBuffer)
-        return;
 
-    CVPixelBufferLockBaseAddress(imageBuffer, 0);
-    auto data = CVPixelBufferGetBaseAddress(imageBuffer);
-    memcpy(data, frame.data().data(), frame.data().size());
-    CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+    if (isCurrentFrame
+        && this->m_imageBuffer
+        && this->m_imageRepeats.isKept(videoFormat,
+                                       this->m_transformParams)) {
+        // The frame didn't change, send the last pixel buffer again.
+        imageBuffer = this->m_imageBuffer;
+        CFRetain(imageBuffer);
+    } else {
+        CVPixelBufferCreate(kCFAllocatorDefault,
+                            size_t(width),
+                            size_t(height),
+                            formatToCM(PixelFormat(fourcc)),
+                            nullptr,
+                            &imageBuffer);
+
+        if (!imageBuffer)
+            return;
+
+        /* Mirror, scale and convert the frame in a single pass straight into
+         * the pixel buffer planes.
+         */
+        CVPixelBufferLockBaseAddress(imageBuffer, 0);
+        uint8_t *planes[4];
+        size_t strides[4];
+
+        if (CVPixelBufferIsPlanar(imageBuffer)) {
+            auto planeCount =
+                    std::min(CVPixelBufferGetPlaneCount(imageBuffer), size_t(4));
+
+            for (size_t plane = 0; plane < planeCount; plane++) {
+                planes[plane] =
+                        reinterpret_cast<uint8_t *>(CVPixelBufferGetBaseAddressOfPlane(imageBuffer,
+                                                                                       plane));
+                strides[plane] = CVPixelBufferGetBytesPerRowOfPlane(imageBuffer,
+                                                                    plane);
+            }
+        } else {
+            planes[0] =
+                    reinterpret_cast<uint8_t *>(CVPixelBufferGetBaseAddress(imageBuffer));
+            strides[0] = CVPixelBufferGetBytesPerRow(imageBuffer);
+        }
+
+        bool converted =
+                this->m_transform.configure(frame.format(),
+                                            videoFormat,
+                                            this->m_transformParams)
+                && this->m_transform.process(frame, planes, strides);
+        bool fallback = false;
+
+        // Send the test frame instead.
+        if (!converted && this->m_testFrame.format().size() > 0) {
+            AkLogWarning() << "Can't transform the frame, "
+                           << "sending the test frame"
+                           << std::endl;
+            fallback =
+                    this->m_transform.configure(this->m_testFrame.format(),
+                                                videoFormat,
+                                                this->m_transformParams)
+                    && this->m_transform.process(this->m_testFrame,
+                                                 planes,
+                                                 strides);
+        }
+
+        CVPixelBufferUnlockBaseAddress(imageBuffer, 0);
+
+        if (!converted && !fallback) {
+            CFRelease(imageBuffer);
+
+            // Or the last pixel buffer sent, if any.
+            if (!this->m_imageBuffer
+                || !this->m_imageRepeats.isKept(videoFormat))
+                return;
+
+            imageBuffer = this->m_imageBuffer;
+            CFRetain(imageBuffer);
+        }
+
+        if (converted
+            && isCurrentFrame
+            && this->m_imageRepeats.keep(videoFormat,
+                                         this->m_transformParams)) {
+            if (this->m_imageBuffer)
+                CFRelease(this->m_imageBuffer);
+
+            this->m_imageBuffer = imageBuffer;
+            CFRetain(this->m_imageBuffer);
+        }
+    }
 
     CMVideoFormatDescriptionRef format = nullptr;
     CMVideoFormatDescriptionCreateForImageBuffer(kCFAllocatorDefault,
@@ -629,49 +734,15 @@ void AkVCam::StreamPrivate::sendFrame(const VideoFrame &frame)
                              this->m_queueAlteredRefCon);
 }
 
-void AkVCam::StreamPrivate::updateTestFrame()
-{
-    AkLogFunction();
-    this->m_testFrameAdapted = this->applyAdjusts(this->m_testFrame);
-}
-
-AkVCam::VideoFrame AkVCam::StreamPrivate::applyAdjusts(const VideoFrame &frame)
-{
-    AkLogFunction();
-
-    VideoFormat format;
-    this->self->m_properties.getProperty(kCMIOStreamPropertyFormatDescription,
-                                         &format);
-
-    FourCC fourcc = format.fourcc();
-    int width = format.width();
-    int height = format.height();
-
-    if (width * height > frame.format().width() * frame.format().height()) {
-        return frame.mirror(this->m_horizontalMirror,
-                            this->m_verticalMirror)
-                    .swapRgb(this->m_swapRgb)
-                    .scaled(width, height,
-                            this->m_scaling,
-                            this->m_aspectRatio)
-                    .convert(fourcc);
-    }
-
-    return frame.scaled(width, height,
-                        this->m_scaling,
-                        this->m_aspectRatio)
-                .mirror(this->m_horizontalMirror,
-                        this->m_verticalMirror)
-                .swapRgb(this->m_swapRgb)
-            .convert(fourcc);
-}
-
 AkVCam::VideoFrame AkVCam::StreamPrivate::randomFrame()
 {
     VideoFormat format;
     this->self->m_properties.getProperty(kCMIOStreamPropertyFormatDescription,
                                          &format);
-    VideoData data(format.size());
+
+    // Noise is generated as RGB so sendFrame() can apply the controls to it.
+    VideoFormat rgbFormat(PixelFormatRGB24, format.width(), format.height());
+    VideoData data(rgbFormat.size());
     static std::uniform_int_distribution<uint8_t> distribution(std::numeric_limits<uint8_t>::min(),
                                                                std::numeric_limits<uint8_t>::max());
     static std::default_random_engine engine;
@@ -680,7 +751,7 @@ AkVCam::VideoFrame AkVCam::StreamPrivate::randomFrame()
     });
 
     VideoFrame frame;
-    frame.format() = format;
+    frame.format() = rgbFormat;
     frame.data() = data;
 
     return frame;
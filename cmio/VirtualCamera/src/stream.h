@@ -58,8 +58,12 @@ namespace AkVCam
             void setBroadcasting(const std::string &broadcaster);
             void setHorizontalMirror(bool horizontalMirror);
             void setVerticalMirror(bool verticalMirror);
+            void setRotation(int rotation);
             void setScaling(Scaling scaling);
             void setAspectRatio(AspectRatio aspectRatio);
+            void setZoom(int zoom);
+            void setPan(int pan);
+            void setTilt(int tilt);
             void setSwapRgb(bool swap);
 
             // Stream Interface
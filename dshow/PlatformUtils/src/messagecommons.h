@@ -71,6 +71,7 @@ namespace AkVCam
         int32_t width;
         int32_t height;
         uint32_t size;
+        uint64_t hash;      // VideoFrame::hash() of the source frame.
         uint8_t data[4];
     };
 
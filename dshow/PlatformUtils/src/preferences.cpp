@@ -640,6 +640,16 @@ bool AkVCam::Preferences::setLogLevel(int logLevel)
     return write("loglevel", logLevel, true);
 }
 
+int AkVCam::Preferences::maxThreads()
+{
+    return readInt("maxthreads", 0, true);
+}
+
+bool AkVCam::Preferences::setMaxThreads(int maxThreads)
+{
+    return write("maxthreads", maxThreads, true);
+}
+
 void AkVCam::Preferences::splitSubKey(const std::string &key,
                                       std::string &subKey,
                                       std::string &value)
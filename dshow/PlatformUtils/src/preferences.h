@@ -91,6 +91,8 @@ namespace AkVCam
         bool setPicture(const std::string &picture);
         int logLevel();
         bool setLogLevel(int logLevel);
+        int maxThreads();
+        bool setMaxThreads(int maxThreads);
     }
 }
 
@@ -1206,7 +1206,9 @@ const std::vector<AkVCam::VideoFormatSpecsPrivate> &AkVCam::VideoFormatSpecsPriv
         {PixelFormatRGB15, BI_BITFIELDS                  , MEDIASUBTYPE_RGB555, bits555},
         {PixelFormatUYVY , MAKEFOURCC('U', 'Y', 'V', 'Y'), MEDIASUBTYPE_UYVY  , nullptr},
         {PixelFormatYUY2 , MAKEFOURCC('Y', 'U', 'Y', '2'), MEDIASUBTYPE_YUY2  , nullptr},
-        {PixelFormatNV12 , MAKEFOURCC('N', 'V', '1', '2'), MEDIASUBTYPE_NV12  , nullptr}
+        {PixelFormatNV12 , MAKEFOURCC('N', 'V', '1', '2'), MEDIASUBTYPE_NV12  , nullptr},
+        {PixelFormatI420 , MAKEFOURCC('I', 'Y', 'U', 'V'), MEDIASUBTYPE_IYUV  , nullptr},
+        {PixelFormatYV12 , MAKEFOURCC('Y', 'V', '1', '2'), MEDIASUBTYPE_YV12  , nullptr}
     };
 
     return formats;
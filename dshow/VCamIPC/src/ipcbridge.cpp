@@ -59,6 +59,10 @@ namespace AkVCam
     {
         SharedMemory sharedMemory;
         Mutex mutex;
+
+        // Last frame read from the shared memory, and its hash.
+        VideoFrame frame;
+        uint64_t frameHash;
     };
 
     class Hack
@@ -354,7 +358,9 @@ std::vector<AkVCam::PixelFormat> AkVCam::IpcBridge::supportedPixelFormats(Stream
         PixelFormatRGB15,
         PixelFormatUYVY,
         PixelFormatYUY2,
-        PixelFormatNV12
+        PixelFormatNV12,
+        PixelFormatI420,
+        PixelFormatYV12
     };
 }
 
@@ -736,29 +742,41 @@ bool AkVCam::IpcBridge::write(const std::string &deviceId,
     if (frame.format().size() < 1)
         return false;
 
+    auto hash = frame.hash();
     auto buffer =
             reinterpret_cast<Frame *>(this->d->m_sharedMemory.lock(&this->d->m_globalMutex));
 
     if (!buffer)
         return false;
 
-    if (size_t(frame.format().width() * frame.format().height()) > maxFrameSize) {
-        auto scaledFrame = frame.scaled(maxFrameSize);
-        buffer->format = scaledFrame.format().fourcc();
-        buffer->width = scaledFrame.format().width();
-        buffer->height = scaledFrame.format().height();
-        buffer->size = uint32_t(frame.data().size());
-        memcpy(buffer->data,
-               scaledFrame.data().data(),
-               scaledFrame.data().size());
-    } else {
-        buffer->format = frame.format().fourcc();
-        buffer->width = frame.format().width();
-        buffer->height = frame.format().height();
-        buffer->size = uint32_t(frame.data().size());
-        memcpy(buffer->data,
-               frame.data().data(),
-               frame.data().size());
+    /* Static content, like slides or a screen share, sends the same frame
+     * over and over, in that case the shared memory already has it and only
+     * the clients are notified.
+     */
+    if (buffer->size < 1 || buffer->hash != hash) {
+        auto src = &frame;
+        VideoFrame scaledFrame;
+
+        if (size_t(frame.format().width() * frame.format().height()) > maxFrameSize) {
+            scaledFrame = frame.scaled(maxFrameSize);
+            src = &scaledFrame;
+        }
+
+        // Write the frame straight into the shared memory.
+        if (!src->convert(src->format(),
+                          buffer->data,
+                          maxBufferSize - sizeof(Frame))) {
+            buffer->size = 0;
+            this->d->m_sharedMemory.unlock(&this->d->m_globalMutex);
+
+            return false;
+        }
+
+        buffer->format = src->format().fourcc();
+        buffer->width = src->format().width();
+        buffer->height = src->format().height();
+        buffer->size = uint32_t(src->format().size());
+        buffer->hash = hash;
     }
 
     this->d->m_sharedMemory.unlock(&this->d->m_globalMutex);
@@ -929,22 +947,36 @@ const std::vector<AkVCam::DeviceControl> &AkVCam::IpcBridgePrivate::controls() c
 {
     static const std::vector<std::string> scalingMenu {
         "Fast",
-        "Linear"
+        "Linear",
+        "Area",
+        "Cubic",
+        "Lanczos"
     };
     static const std::vector<std::string> aspectRatioMenu {
         "Ignore",
         "Keep",
         "Expanding"
     };
+    static const std::vector<std::string> rotationMenu {
+        "0",
+        "90",
+        "180",
+        "270"
+    };
     static const auto scalingMax = int(scalingMenu.size()) - 1;
     static const auto aspectRatioMax = int(aspectRatioMenu.size()) - 1;
+    static const auto rotationMax = int(rotationMenu.size()) - 1;
 
     static const std::vector<DeviceControl> controls {
-        {"hflip"       , "Horizontal Mirror", ControlTypeBoolean, 0, 1             , 1, 0, 0, {}             },
-        {"vflip"       , "Vertical Mirror"  , ControlTypeBoolean, 0, 1             , 1, 0, 0, {}             },
-        {"scaling"     , "Scaling"          , ControlTypeMenu   , 0, scalingMax    , 1, 0, 0, scalingMenu    },
-        {"aspect_ratio", "Aspect Ratio"     , ControlTypeMenu   , 0, aspectRatioMax, 1, 0, 0, aspectRatioMenu},
-        {"swap_rgb"    , "Swap RGB"         , ControlTypeBoolean, 0, 1             , 1, 0, 0, {}             },
+        {"hflip"       , "Horizontal Mirror", ControlTypeBoolean, 0   , 1             , 1, 0, 0, {}             },
+        {"vflip"       , "Vertical Mirror"  , ControlTypeBoolean, 0   , 1             , 1, 0, 0, {}             },
+        {"rotation"    , "Rotation"         , ControlTypeMenu   , 0   , rotationMax   , 1, 0, 0, rotationMenu   },
+        {"scaling"     , "Scaling"          , ControlTypeMenu   , 0   , scalingMax    , 1, 0, 0, scalingMenu    },
+        {"aspect_ratio", "Aspect Ratio"     , ControlTypeMenu   , 0   , aspectRatioMax, 1, 0, 0, aspectRatioMenu},
+        {"zoom"        , "Zoom"             , ControlTypeInteger, 0   , 300           , 1, 0, 0, {}             },
+        {"pan"         , "Pan"              , ControlTypeInteger, -100, 100           , 1, 0, 0, {}             },
+        {"tilt"        , "Tilt"             , ControlTypeInteger, -100, 100           , 1, 0, 0, {}             },
+        {"swap_rgb"    , "Swap RGB"         , ControlTypeBoolean, 0   , 1             , 1, 0, 0, {}             },
     };
 
     return controls;
@@ -1126,19 +1158,29 @@ void AkVCam::IpcBridgePrivate::frameReady(Message *message)
         return;
     }
 
+    auto &device = this->m_devices[deviceId];
     auto frame =
-            reinterpret_cast<Frame *>(this->m_devices[deviceId]
-                                      .sharedMemory
-                                      .lock(&this->m_devices[deviceId].mutex));
+            reinterpret_cast<Frame *>(device.sharedMemory.lock(&device.mutex));
 
     if (!frame)
         return;
 
-    VideoFormat videoFormat(frame->format, frame->width, frame->height);
-    VideoFrame videoFrame(videoFormat);
-    memcpy(videoFrame.data().data(), frame->data, frame->size);
-    this->m_devices[deviceId].sharedMemory.unlock(&this->m_devices[deviceId].mutex);
-    AKVCAM_EMIT(this->self, FrameReady, deviceId, videoFrame)
+    if (frame->size < 1) {
+        device.sharedMemory.unlock(&device.mutex);
+
+        return;
+    }
+
+    // Only copy the frame if it's not the one read last time.
+    if (device.frame.format().size() < 1 || frame->hash != device.frameHash) {
+        VideoFormat videoFormat(frame->format, frame->width, frame->height);
+        device.frame = VideoFrame(videoFormat);
+        memcpy(device.frame.data().data(), frame->data, frame->size);
+        device.frameHash = frame->hash;
+    }
+
+    device.sharedMemory.unlock(&device.mutex);
+    AKVCAM_EMIT(this->self, FrameReady, deviceId, device.frame)
 }
 
 void AkVCam::IpcBridgePrivate::pictureUpdated(Message *message)
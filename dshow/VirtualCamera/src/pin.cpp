@@ -19,12 +19,14 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cstring>
 #include <functional>
 #include <limits>
 #include <mutex>
 #include <random>
 #include <sstream>
 #include <thread>
+#include <vector>
 #include <dshow.h>
 
 #include "pin.h"
@@ -38,6 +40,8 @@
 #include "videoprocamp.h"
 #include "PlatformUtils/src/preferences.h"
 #include "PlatformUtils/src/utils.h"
+#include "VCamUtils/src/frametransform.h"
+#include "VCamUtils/src/threadpool.h"
 #include "VCamUtils/src/videoformat.h"
 #include "VCamUtils/src/videoframe.h"
 #include "VCamUtils/src/utils.h"
@@ -70,7 +74,14 @@ namespace AkVCam
             std::mutex m_controlsMutex;
             VideoFrame m_currentFrame;
             VideoFrame m_testFrame;
-            VideoFrame m_testFrameAdapted;
+            FrameTransform m_transform;
+
+            /* Last sample sent for the current frame, static content is only
+             * transformed once and then copied.
+             */
+            std::vector<uint8_t> m_sample;
+            FrameTransformRepeats m_sampleRepeats;
+
             std::string m_broadcaster;
             bool m_horizontalFlip {false};   // Controlled by client
             bool m_verticalFlip {false};
@@ -82,16 +93,18 @@ namespace AkVCam
             LONG m_hue {0};
             LONG m_colorenable {0};
 
+            void setCurrentFrame(const VideoFrame &frame);
             void sendFrameOneShot();
             void sendFrameLoop();
             HRESULT sendFrame();
-            void updateTestFrame();
-            VideoFrame applyAdjusts(const VideoFrame &frame);
+            static FourCC nativeFourcc(FourCC fourcc);
+            FrameTransformParams transformParams(FourCC fourcc);
+            void sortByCost(std::vector<AM_MEDIA_TYPE *> &mediaTypes);
             static void propertyChanged(void *userData,
                                         LONG Property,
                                         LONG lValue,
                                         LONG Flags);
-            VideoFrame randomFrame();
+            static VideoFrame randomFrame(int width, int height);
     };
 }
 
@@ -102,6 +115,14 @@ AkVCam::Pin::Pin(BaseFilter *baseFilter,
 {
     this->setParent(this, &IID_IPin);
 
+    /* Hosts sensitive to latency can limit the threads used per frame, read
+     * it here since the registry can't be read from DllMain.
+     */
+    static std::once_flag maxThreadsSet;
+    std::call_once(maxThreadsSet, [] () {
+        ThreadPool::globalInstance()->setMaxThreadCount(Preferences::maxThreads());
+    });
+
     this->d = new PinPrivate;
     this->d->self = this;
     this->d->m_baseFilter = baseFilter;
@@ -118,10 +139,18 @@ AkVCam::Pin::Pin(BaseFilter *baseFilter,
             Preferences::cameraControlValue(cameraIndex, "hflip");
     this->d->m_controls["vflip"] =
             Preferences::cameraControlValue(cameraIndex, "vflip");
+    this->d->m_controls["rotation"] =
+            Preferences::cameraControlValue(cameraIndex, "rotation");
     this->d->m_controls["scaling"] =
             Preferences::cameraControlValue(cameraIndex, "scaling");
     this->d->m_controls["aspect_ratio"] =
             Preferences::cameraControlValue(cameraIndex, "aspect_ratio");
+    this->d->m_controls["zoom"] =
+            Preferences::cameraControlValue(cameraIndex, "zoom");
+    this->d->m_controls["pan"] =
+            Preferences::cameraControlValue(cameraIndex, "pan");
+    this->d->m_controls["tilt"] =
+            Preferences::cameraControlValue(cameraIndex, "tilt");
     this->d->m_controls["swap_rgb"] =
             Preferences::cameraControlValue(cameraIndex, "swap_rgb");
 
@@ -202,9 +231,8 @@ HRESULT AkVCam::Pin::stateChanged(void *userData, FILTER_STATE state)
         if (FAILED(self->d->m_memAllocator->Commit()))
             return VFW_E_NOT_COMMITTED;
 
-        self->d->updateTestFrame();
         self->d->m_mutex.lock();
-        self->d->m_currentFrame = self->d->m_testFrameAdapted;
+        self->d->setCurrentFrame(self->d->m_testFrame);
         self->d->m_mutex.unlock();
         self->d->m_pts = -1;
         self->d->m_ptsDrift = 0;
@@ -244,9 +272,8 @@ HRESULT AkVCam::Pin::stateChanged(void *userData, FILTER_STATE state)
         self->d->m_sendFrameEvent = nullptr;
         self->d->m_memAllocator->Decommit();
         self->d->m_mutex.lock();
-        self->d->m_currentFrame.clear();
+        self->d->setCurrentFrame({});
         self->d->m_mutex.unlock();
-        self->d->m_testFrameAdapted.clear();
     }
 
     self->d->m_prevState = state;
@@ -263,10 +290,9 @@ void AkVCam::Pin::serverStateChanged(IpcBridge::ServerState state)
         this->d->m_controlsMutex.lock();
         this->d->m_controls = {};
         this->d->m_controlsMutex.unlock();
-        this->d->updateTestFrame();
 
         this->d->m_mutex.lock();
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+        this->d->setCurrentFrame(this->d->m_testFrame);
         this->d->m_mutex.unlock();
     }
 }
@@ -282,12 +308,12 @@ void AkVCam::Pin::frameReady(const VideoFrame &frame)
 
     this->d->m_mutex.lock();
 
-    if (!this->d->m_broadcaster.empty()) {
-        auto frameAdjusted = this->d->applyAdjusts(frame);
-
-        if (frameAdjusted.format().size() > 0)
-            this->d->m_currentFrame = frameAdjusted;
-    }
+    /* The bridge sends the same frame again when its content doesn't
+     * change, keep the samples of the current frame in that case.
+     */
+    if (!this->d->m_broadcaster.empty()
+        && !frame.isCopyOf(this->d->m_currentFrame))
+        this->d->setCurrentFrame(frame);
 
     this->d->m_mutex.unlock();
 }
@@ -297,11 +323,10 @@ void AkVCam::Pin::setPicture(const std::string &picture)
     AkLogFunction();
     AkLogDebug() << "Picture: " << picture << std::endl;
     this->d->m_testFrame = loadPicture(picture);
-    this->d->updateTestFrame();
     this->d->m_mutex.lock();
 
     if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+        this->d->setCurrentFrame(this->d->m_testFrame);
 
     this->d->m_mutex.unlock();
 }
@@ -318,7 +343,7 @@ void AkVCam::Pin::setBroadcasting(const std::string &broadcaster)
     this->d->m_broadcaster = broadcaster;
 
     if (broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
+        this->d->setCurrentFrame(this->d->m_testFrame);
 
     this->d->m_mutex.unlock();
 }
@@ -339,13 +364,6 @@ void AkVCam::Pin::setControls(const std::map<std::string, int> &controls)
 
     this->d->m_controls = controls;
     this->d->m_controlsMutex.unlock();
-    this->d->updateTestFrame();
-    this->d->m_mutex.lock();
-
-    if (this->d->m_broadcaster.empty())
-        this->d->m_currentFrame = this->d->m_testFrameAdapted;
-
-    this->d->m_mutex.unlock();
 }
 
 bool AkVCam::Pin::horizontalFlip() const
@@ -368,6 +386,29 @@ void AkVCam::Pin::setVerticalFlip(bool flip)
     this->d->m_verticalFlip = flip;
 }
 
+AM_MEDIA_TYPE *AkVCam::Pin::defaultMediaType()
+{
+    std::vector<AM_MEDIA_TYPE *> mediaTypes;
+    IEnumMediaTypes *enumMediaTypes = nullptr;
+
+    if (FAILED(this->EnumMediaTypes(&enumMediaTypes)))
+        return nullptr;
+
+    AM_MEDIA_TYPE *mediaType = nullptr;
+    enumMediaTypes->Reset();
+
+    while (enumMediaTypes->Next(1, &mediaType, nullptr) == S_OK)
+        mediaTypes.push_back(mediaType);
+
+    enumMediaTypes->Release();
+    this->d->sortByCost(mediaTypes);
+
+    for (size_t i = 1; i < mediaTypes.size(); i++)
+        deleteMediaType(&mediaTypes[i]);
+
+    return mediaTypes.empty()? nullptr: mediaTypes.front();
+}
+
 HRESULT AkVCam::Pin::QueryInterface(const IID &riid, void **ppvObject)
 {
     AkLogFunction();
@@ -476,6 +517,7 @@ HRESULT AkVCam::Pin::Connect(IPin *pReceivePin, const AM_MEDIA_TYPE *pmt)
 
         if (!mediaType) {
             // Test media types supported by the input pin.
+            std::vector<AM_MEDIA_TYPE *> candidates;
             AM_MEDIA_TYPE *mt = nullptr;
             IEnumMediaTypes *mediaTypes = nullptr;
 
@@ -488,35 +530,44 @@ HRESULT AkVCam::Pin::Connect(IPin *pReceivePin, const AM_MEDIA_TYPE *pmt)
                                 << std::endl;
 
                     // If the mediatype match our suported mediatypes...
-                    if (this->QueryAccept(mt) == S_OK) {
-                        // set it.
-                        mediaType = mt;
-
-                        break;
-                    }
-
-                    deleteMediaType(&mt);
+                    if (this->QueryAccept(mt) == S_OK)
+                        candidates.push_back(mt);
+                    else
+                        deleteMediaType(&mt);
                 }
 
                 mediaTypes->Release();
             }
+
+            // ...set the one that is the cheapest to produce.
+            this->d->sortByCost(candidates);
+
+            if (!candidates.empty())
+                mediaType = candidates.front();
+
+            for (size_t i = 1; i < candidates.size(); i++)
+                deleteMediaType(&candidates[i]);
         }
 
         if (!mediaType) {
             /* If none of the input media types was suitable for us, ask to
-             * input pin if it at least supports one of us.
+             * input pin if it at least supports one of us, starting from the
+             * cheapest one.
              */
+            std::vector<AM_MEDIA_TYPE *> candidates;
             AM_MEDIA_TYPE *mt = nullptr;
             this->d->m_mediaTypes->Reset();
 
-            while (this->d->m_mediaTypes->Next(1, &mt, nullptr) == S_OK) {
-                if (pReceivePin->QueryAccept(mt) == S_OK) {
-                    mediaType = mt;
+            while (this->d->m_mediaTypes->Next(1, &mt, nullptr) == S_OK)
+                candidates.push_back(mt);
 
-                    break;
-                }
+            this->d->sortByCost(candidates);
 
-                deleteMediaType(&mt);
+            for (auto &candidate: candidates) {
+                if (!mediaType && pReceivePin->QueryAccept(candidate) == S_OK)
+                    mediaType = candidate;
+                else
+                    deleteMediaType(&candidate);
             }
         }
     }
@@ -813,6 +864,13 @@ HRESULT AkVCam::Pin::NewSegment(REFERENCE_TIME tStart,
     return S_OK;
 }
 
+void AkVCam::PinPrivate::setCurrentFrame(const VideoFrame &frame)
+{
+    this->m_currentFrame = frame;
+    this->m_sample.clear();
+    this->m_sampleRepeats.reset();
+}
+
 void AkVCam::PinPrivate::sendFrameOneShot()
 {
     AkLogFunction();
@@ -873,32 +931,78 @@ HRESULT AkVCam::PinPrivate::sendFrame()
         return E_FAIL;
     }
 
+    AM_MEDIA_TYPE *mediaType = nullptr;
+    self->GetFormat(&mediaType);
+    auto format = formatFromMediaType(mediaType);
+    deleteMediaType(&mediaType);
+
+    /* Mirror, adjust, scale and convert the frame in a single pass straight
+     * into the sample buffer.
+     */
+    VideoFormat outputFormat(this->nativeFourcc(format.fourcc()),
+                             format.width(),
+                             format.height());
+    auto params = this->transformParams(format.fourcc());
+    bool written = false;
     this->m_mutex.lock();
 
     if (this->m_currentFrame.format().size() > 0) {
-        auto copyBytes = (std::min)(size_t(size),
-                                    this->m_currentFrame.data().size());
-
-        if (copyBytes > 0)
-            memcpy(buffer, this->m_currentFrame.data().data(), copyBytes);
+        if (this->m_sampleRepeats.isKept(outputFormat, params)
+            && this->m_sample.size() == size_t(size)) {
+            memcpy(buffer, this->m_sample.data(), this->m_sample.size());
+            written = true;
+        } else if (this->m_transform.configure(this->m_currentFrame.format(),
+                                               outputFormat,
+                                               params)
+                   && this->m_transform.process(this->m_currentFrame,
+                                                buffer,
+                                                size_t(size))) {
+            written = true;
+
+            if (this->m_sampleRepeats.keep(outputFormat, params))
+                this->m_sample.assign(buffer, buffer + size);
+        } else {
+            AkLogWarning() << "Can't transform the frame, "
+                           << "sending the test frame"
+                           << std::endl;
+
+            // Send the test frame instead, or the last sample sent.
+            if (this->m_testFrame.format().size() > 0
+                && this->m_transform.configure(this->m_testFrame.format(),
+                                               outputFormat,
+                                               params)
+                && this->m_transform.process(this->m_testFrame,
+                                             buffer,
+                                             size_t(size))) {
+                written = true;
+            } else if (this->m_sampleRepeats.isKept(outputFormat)
+                       && this->m_sample.size() == size_t(size)) {
+                memcpy(buffer,
+                       this->m_sample.data(),
+                       this->m_sample.size());
+                written = true;
+            }
+        }
     } else {
-        auto frame = this->randomFrame();
-        auto copyBytes = (std::min)(size_t(size),
-                                    frame.data().size());
+        auto frame = randomFrame(format.width(), format.height());
 
-        if (copyBytes > 0)
-            memcpy(buffer, frame.data().data(), copyBytes);
+        written = this->m_transform.configure(frame.format(),
+                                              outputFormat,
+                                              params)
+                  && this->m_transform.process(frame, buffer, size_t(size));
     }
 
     this->m_mutex.unlock();
 
+    // Never deliver a sample that wasn't written.
+    if (!written) {
+        sample->Release();
+
+        return S_OK;
+    }
+
     REFERENCE_TIME clock = 0;
     this->m_baseFilter->referenceClock()->GetTime(&clock);
-
-    AM_MEDIA_TYPE *mediaType = nullptr;
-    self->GetFormat(&mediaType);
-    auto format = formatFromMediaType(mediaType);
-    deleteMediaType(&mediaType);
     auto fps = format.minimumFrameRate();
     auto duration = REFERENCE_TIME(TIME_BASE / fps.value());
 
@@ -933,45 +1037,28 @@ HRESULT AkVCam::PinPrivate::sendFrame()
     return result;
 }
 
-void AkVCam::PinPrivate::updateTestFrame()
+AkVCam::FourCC AkVCam::PinPrivate::nativeFourcc(FourCC fourcc)
 {
-    AkLogFunction();
-    auto frame = this->applyAdjusts(this->m_testFrame);
-
-    if (frame.format().size() < 1)
-        return;
-
-    this->m_testFrameAdapted = frame;
-}
-
-AkVCam::VideoFrame AkVCam::PinPrivate::applyAdjusts(const VideoFrame &frame)
-{
-    AM_MEDIA_TYPE *mediaType = nullptr;
-
-    if (FAILED(this->self->GetFormat(&mediaType)))
-        return {};
-
-    auto format = formatFromMediaType(mediaType);
-    deleteMediaType(&mediaType);
-    FourCC fourcc = format.fourcc();
-    int width = format.width();
-    int height = format.height();
-
     /* In Windows red and blue channels are swapped, so hack it with the
      * opposite format. Endianness problem maybe?
      */
-    std::map<FourCC, FourCC> fixFormat {
+    static const std::map<FourCC, FourCC> fixFormat {
         {PixelFormatRGB32, PixelFormatBGR32},
         {PixelFormatRGB24, PixelFormatBGR24},
         {PixelFormatRGB16, PixelFormatBGR16},
         {PixelFormatRGB15, PixelFormatBGR15},
     };
 
+    auto it = fixFormat.find(fourcc);
+
+    return it == fixFormat.end()? fourcc: it->second;
+}
+
+AkVCam::FrameTransformParams AkVCam::PinPrivate::transformParams(FourCC fourcc)
+{
+    FrameTransformParams params;
     bool horizontalMirror = false;
     bool verticalMirror = false;
-    Scaling scaling = ScalingFast;
-    AspectRatio aspectRatio = AspectRatioIgnore;
-    bool swapRgb = false;
     this->m_controlsMutex.lock();
 
     if (this->m_controls.count("hflip") > 0)
@@ -980,61 +1067,89 @@ AkVCam::VideoFrame AkVCam::PinPrivate::applyAdjusts(const VideoFrame &frame)
     if (this->m_controls.count("vflip") > 0)
         verticalMirror = this->m_controls["vflip"];
 
+    if (this->m_controls.count("rotation") > 0)
+        params.rotation = 90 * this->m_controls["rotation"];
+
     if (this->m_controls.count("scaling") > 0)
-        scaling = Scaling(this->m_controls["scaling"]);
+        params.scaling = Scaling(this->m_controls["scaling"]);
 
     if (this->m_controls.count("aspect_ratio") > 0)
-        aspectRatio = AspectRatio(this->m_controls["aspect_ratio"]);
+        params.aspectRatio = AspectRatio(this->m_controls["aspect_ratio"]);
+
+    if (this->m_controls.count("zoom") > 0)
+        params.zoom = this->m_controls["zoom"];
+
+    if (this->m_controls.count("pan") > 0)
+        params.pan = this->m_controls["pan"];
+
+    if (this->m_controls.count("tilt") > 0)
+        params.tilt = this->m_controls["tilt"];
 
     if (this->m_controls.count("swap_rgb") > 0)
-        swapRgb = this->m_controls["swap_rgb"];
+        params.swapRgb = this->m_controls["swap_rgb"];
 
     this->m_controlsMutex.unlock();
-    bool vmirror;
+    params.horizontalMirror = horizontalMirror != this->m_horizontalFlip;
 
-    if (fixFormat.count(fourcc) > 0) {
-        fourcc = fixFormat[fourcc];
-        vmirror = verticalMirror == this->m_verticalFlip;
-    } else {
-        vmirror = verticalMirror != this->m_verticalFlip;
-    }
+    if (this->nativeFourcc(fourcc) != fourcc)
+        params.verticalMirror = verticalMirror == this->m_verticalFlip;
+    else
+        params.verticalMirror = verticalMirror != this->m_verticalFlip;
 
-    VideoFrame newFrame;
-
-    if (width * height > frame.format().width() * frame.format().height()) {
-        newFrame =
-                frame
-                .mirror(horizontalMirror != this->m_horizontalFlip,
-                        vmirror)
-                .swapRgb(swapRgb)
-                .adjust(this->m_hue,
-                        this->m_saturation,
-                        this->m_brightness,
-                        this->m_gamma,
-                        this->m_contrast,
-                        !this->m_colorenable)
-                .scaled(width, height, scaling, aspectRatio)
-                .convert(fourcc);
-    } else {
-        newFrame =
-                frame
-                .scaled(width, height, scaling, aspectRatio)
-                .mirror(horizontalMirror != this->m_horizontalFlip,
-                        vmirror)
-                .swapRgb(swapRgb)
-                .adjust(this->m_hue,
-                        this->m_saturation,
-                        this->m_brightness,
-                        this->m_gamma,
-                        this->m_contrast,
-                        !this->m_colorenable)
-                .convert(fourcc);
+    params.hue = this->m_hue;
+    params.saturation = this->m_saturation;
+    params.luminance = this->m_brightness;
+    params.gamma = this->m_gamma;
+    params.contrast = this->m_contrast;
+    params.gray = !this->m_colorenable;
+
+    return params;
+}
+
+void AkVCam::PinPrivate::sortByCost(std::vector<AM_MEDIA_TYPE *> &mediaTypes)
+{
+    /* The frames come from the broadcaster, the test picture, or the random
+     * frame generator, which makes frames of the size of the output.
+     */
+    this->m_mutex.lock();
+    auto inputFormat = this->m_currentFrame.format();
+    this->m_mutex.unlock();
+
+    if (inputFormat.size() < 1)
+        inputFormat = {PixelFormatRGB24, 0, 0};
+
+    std::vector<std::pair<double, AM_MEDIA_TYPE *>> costs;
+
+    for (auto &mediaType: mediaTypes) {
+        auto format = formatFromMediaType(mediaType);
+        VideoFormat outputFormat(nativeFourcc(format.fourcc()),
+                                 format.width(),
+                                 format.height());
+        auto input = inputFormat;
 
+        if (input.width() < 1 || input.height() < 1) {
+            input.width() = outputFormat.width();
+            input.height() = outputFormat.height();
+        }
+
+        auto cost = FrameTransform::cost(input, outputFormat);
+
+        // Put the unsupported formats at the end.
+        if (cost < 0.0)
+            cost = std::numeric_limits<double>::max();
+
+        costs.push_back({cost, mediaType});
     }
 
-    newFrame.format().fourcc() = format.fourcc();
+    std::stable_sort(costs.begin(),
+                     costs.end(),
+                     [] (const std::pair<double, AM_MEDIA_TYPE *> &a,
+                         const std::pair<double, AM_MEDIA_TYPE *> &b) {
+        return a.first < b.first;
+    });
 
-    return newFrame;
+    for (size_t i = 0; i < costs.size(); i++)
+        mediaTypes[i] = costs[i].second;
 }
 
 void AkVCam::PinPrivate::propertyChanged(void *userData,
@@ -1079,24 +1194,11 @@ void AkVCam::PinPrivate::propertyChanged(void *userData,
     default:
         break;
     }
-
-    self->updateTestFrame();
-    self->m_mutex.lock();
-    self->m_currentFrame = self->m_testFrameAdapted;
-    self->m_mutex.unlock();
 }
 
-AkVCam::VideoFrame AkVCam::PinPrivate::randomFrame()
+AkVCam::VideoFrame AkVCam::PinPrivate::randomFrame(int width, int height)
 {
-    AM_MEDIA_TYPE *mediaType = nullptr;
-
-    if (FAILED(this->self->GetFormat(&mediaType)))
-        return {};
-
-    auto format = formatFromMediaType(mediaType);
-    deleteMediaType(&mediaType);
-
-    VideoFormat rgbFormat(PixelFormatRGB24, format.width(), format.height());
+    VideoFormat rgbFormat(PixelFormatRGB24, width, height);
     VideoData data(rgbFormat.size());
     static std::uniform_int_distribution<int> distribution(0, 255);
     static std::default_random_engine engine;
@@ -1108,11 +1210,5 @@ AkVCam::VideoFrame AkVCam::PinPrivate::randomFrame()
     rgbFrame.format() = rgbFormat;
     rgbFrame.data() = data;
 
-    return rgbFrame.adjust(this->m_hue,
-                           this->m_saturation,
-                           this->m_brightness,
-                           this->m_gamma,
-                           this->m_contrast,
-                           !this->m_colorenable)
-                   .convert(format.fourcc());
+    return rgbFrame;
 }
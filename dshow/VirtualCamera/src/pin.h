@@ -57,6 +57,9 @@ namespace AkVCam
             bool verticalFlip() const;
             void setVerticalFlip(bool flip);
 
+            // The cheapest media type to produce, used until a format is set.
+            AM_MEDIA_TYPE *defaultMediaType();
+
             DECLARE_IAMSTREAMCONFIG_NQ
 
             // IUNknown
@@ -22,6 +22,7 @@
 #include "classfactory.h"
 #include "PlatformUtils/src/preferences.h"
 #include "PlatformUtils/src/utils.h"
+#include "VCamUtils/src/threadpool.h"
 #include "VCamUtils/src/utils.h"
 
 inline AkVCam::PluginInterface *pluginInterface()
@@ -90,7 +91,15 @@ STDAPI DllCanUnloadNow()
 {
     AkLogFunction();
 
-    return AkVCam::ClassFactory::locked()? S_FALSE: S_OK;
+    if (AkVCam::ClassFactory::locked())
+        return S_FALSE;
+
+    /* The workers must not be running the module code once it's unloaded,
+     * join them here, outside the loader lock.
+     */
+    AkVCam::ThreadPool::globalInstance()->stop();
+
+    return S_OK;
 }
 
 STDAPI DllRegisterServer()
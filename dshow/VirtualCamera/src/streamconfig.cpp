@@ -110,18 +110,10 @@ HRESULT AkVCam::StreamConfig::GetFormat(AM_MEDIA_TYPE **pmt)
     if (this->d->m_mediaType) {
         *pmt = createMediaType(this->d->m_mediaType);
     } else {
-        IEnumMediaTypes *mediaTypes = nullptr;
-
-        if (FAILED(this->d->m_pin->EnumMediaTypes(&mediaTypes)))
+        if (!this->d->m_pin)
             return E_FAIL;
 
-        AM_MEDIA_TYPE *mediaType = nullptr;
-        mediaTypes->Reset();
-
-        if (mediaTypes->Next(1, &mediaType, nullptr) == S_OK)
-            *pmt = mediaType;
-
-        mediaTypes->Release();
+        *pmt = this->d->m_pin->defaultMediaType();
     }
 
     AkLogInfo() << "MediaType: " << stringFromMediaType(*pmt) << std::endl;